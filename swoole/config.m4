@@ -56,9 +56,6 @@ PHP_ARG_WITH(openssl_dir, for OpenSSL support,
 PHP_ARG_ENABLE(mysqlnd, enable mysqlnd support,
 [  --enable-mysqlnd       Do you have mysqlnd?], no, no)
 
-PHP_ARG_ENABLE(picohttpparser, enable picohttpparser support,
-[  --enable-picohttpparser       Do you have picohttpparser?], no, no)
-
 AC_DEFUN([SWOOLE_HAVE_PHP_EXT], [
     extname=$1
     haveext=$[PHP_]translit($1,a-z_-,A-Z__)
@@ -262,10 +259,16 @@ if test "$PHP_SWOOLE" != "no"; then
     AC_CHECK_LIB(pcre, pcre_compile, AC_DEFINE(HAVE_PCRE, 1, [have pcre]))
     AC_CHECK_LIB(hiredis, redisConnect, AC_DEFINE(HAVE_HIREDIS, 1, [have hiredis]))
     AC_CHECK_LIB(nghttp2, nghttp2_hd_inflate_new, AC_DEFINE(HAVE_NGHTTP2, 1, [have nghttp2]))
+    AC_CHECK_HEADER(linux/io_uring.h, AC_DEFINE(HAVE_IO_URING, 1, [have io_uring]))
 
     AC_CHECK_LIB(z, gzgets, [
         AC_DEFINE(SW_HAVE_ZLIB, 1, [have zlib])
         PHP_ADD_LIBRARY(z, 1, SWOOLE_SHARED_LIBADD)
+    ])
+
+    AC_CHECK_LIB(brotlienc, BrotliEncoderCreateInstance, [
+        AC_DEFINE(SW_HAVE_BROTLI, 1, [have brotli])
+        PHP_ADD_LIBRARY(brotlienc, 1, SWOOLE_SHARED_LIBADD)
     ])    
 
     swoole_source_file="swoole.c \
@@ -295,6 +298,7 @@ if test "$PHP_SWOOLE" != "no"; then
         src/core/base.c \
         src/core/log.c \
         src/core/hashmap.c \
+        src/core/flatmap.c \
         src/core/RingQueue.c \
         src/core/Channel.c \
         src/core/string.c \
@@ -302,10 +306,12 @@ if test "$PHP_SWOOLE" != "no"; then
         src/core/socket.c \
         src/core/list.c \
         src/core/heap.c \
+        src/core/timewheel.c \
         src/memory/ShareMemory.c \
         src/memory/MemoryGlobal.c \
         src/memory/RingBuffer.c \
         src/memory/FixedPool.c \
+        src/memory/Slab.c \
         src/memory/Malloc.c \
         src/memory/Table.c \
         src/memory/Buffer.c \
@@ -320,12 +326,16 @@ if test "$PHP_SWOOLE" != "no"; then
         src/pipe/PipeBase.c \
         src/pipe/PipeEventfd.c \
         src/pipe/PipeUnsock.c \
+        src/pipe/PipeRing.c \
         src/lock/Semaphore.c \
         src/lock/Mutex.c \
         src/lock/RWLock.c \
         src/lock/SpinLock.c \
         src/lock/FileLock.c \
         src/network/Server.c \
+        src/network/Heartbeat.c \
+        src/network/Stats.c \
+        src/network/Affinity.c \
         src/network/TaskWorker.c \
         src/network/Client.c \
         src/network/Connection.c \
@@ -341,6 +351,8 @@ if test "$PHP_SWOOLE" != "no"; then
         src/os/base.c \
         src/os/dl.c \
         src/os/linux_aio.c \
+        src/os/io_uring.c \
+        src/os/cpu.c \
         src/os/msg_queue.c \
         src/os/sendfile.c \
         src/os/signal.c \
@@ -359,21 +371,11 @@ if test "$PHP_SWOOLE" != "no"; then
     swoole_source_file="$swoole_source_file thirdparty/php_http_parser.c"
     swoole_source_file="$swoole_source_file thirdparty/multipart_parser.c"
 
-    if test "$PHP_PICOHTTPPARSER" = "yes"; then
-        AC_DEFINE(SW_USE_PICOHTTPPARSER, 1, [enable picohttpparser support])
-        swoole_source_file="$swoole_source_file thirdparty/picohttpparser/picohttpparser.c"
-    fi
-
     PHP_NEW_EXTENSION(swoole, $swoole_source_file, $ext_shared)
 
     PHP_ADD_INCLUDE([$ext_srcdir])
     PHP_ADD_INCLUDE([$ext_srcdir/include])
 
-    if test "$PHP_PICOHTTPPARSER" = "yes"; then
-        PHP_ADD_INCLUDE([$ext_srcdir/thirdparty/picohttpparser])
-        PHP_ADD_BUILD_DIR($ext_builddir/thirdparty/picohttpparser)
-    fi
-
     PHP_ADD_BUILD_DIR($ext_builddir/src/core)
     PHP_ADD_BUILD_DIR($ext_builddir/src/memory)
     PHP_ADD_BUILD_DIR($ext_builddir/src/factory)
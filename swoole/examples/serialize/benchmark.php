@@ -0,0 +1,115 @@
+<?php
+/**
+ * swoole_serialize pack/unpack throughput and output size with RPC-like payloads,
+ * the schema format against SWOOLE_PACK_NO_SCHEMA and php serialize()
+ *
+ * php benchmark.php [rounds]
+ */
+class User
+{
+    public $id;
+    public $name;
+    public $email;
+    public $age;
+    public $score;
+    public $tags;
+
+    function __construct($id)
+    {
+        $this->id = $id;
+        $this->name = "user_" . $id;
+        $this->email = "user_{$id}@example.com";
+        $this->age = 18 + $id % 50;
+        $this->score = $id * 1.5;
+        $this->tags = array('vip', 'active');
+    }
+}
+
+class Order
+{
+    public $order_id;
+    public $user;
+    public $amount;
+    public $status;
+    public $created_at;
+}
+
+function make_payloads()
+{
+    $users = array();
+    for ($i = 0; $i < 100; $i++)
+    {
+        $users[] = new User($i);
+    }
+
+    $orders = array();
+    for ($i = 0; $i < 100; $i++)
+    {
+        $order = new Order;
+        $order->order_id = 1000000 + $i;
+        $order->user = new User($i % 10);
+        $order->amount = $i * 9.9;
+        $order->status = $i % 3 ? 'paid' : 'pending';
+        $order->created_at = 1500000000 + $i;
+        $orders[] = $order;
+    }
+
+    $rows = array();
+    for ($i = 0; $i < 100; $i++)
+    {
+        $rows[] = array('id' => $i, 'title' => "item $i", 'price' => $i * 0.5, 'stock' => $i * 3, 'enabled' => true);
+    }
+
+    return array(
+        'object list' => array('code' => 0, 'data' => $users),
+        'nested objects' => array('code' => 0, 'data' => $orders),
+        'array rows' => array('code' => 0, 'data' => $rows),
+        'single object' => new User(1),
+    );
+}
+
+function bench($name, $rounds, $pack, $unpack)
+{
+    $data = $pack();
+    $start = microtime(true);
+    for ($i = 0; $i < $rounds; $i++)
+    {
+        $pack();
+    }
+    $pack_time = microtime(true) - $start;
+
+    $start = microtime(true);
+    for ($i = 0; $i < $rounds; $i++)
+    {
+        $unpack($data);
+    }
+    $unpack_time = microtime(true) - $start;
+
+    printf("  %-22s %8d bytes  pack %10.0f/s  unpack %10.0f/s\n", $name, strlen($data), $rounds / $pack_time, $rounds / $unpack_time);
+}
+
+$rounds = isset($argv[1]) ? intval($argv[1]) : 10000;
+
+foreach (make_payloads() as $title => $payload)
+{
+    echo "$title:\n";
+    bench('schema', $rounds, function () use ($payload) {
+        return swoole_serialize::pack($payload);
+    }, function ($data) {
+        return swoole_serialize::unpack($data);
+    });
+    bench('SWOOLE_PACK_NO_SCHEMA', $rounds, function () use ($payload) {
+        return swoole_serialize::pack($payload, SWOOLE_PACK_NO_SCHEMA);
+    }, function ($data) {
+        return swoole_serialize::unpack($data);
+    });
+    bench('serialize', $rounds, function () use ($payload) {
+        return serialize($payload);
+    }, function ($data) {
+        return unserialize($data);
+    });
+    if (swoole_serialize::unpack(swoole_serialize::pack($payload)) != $payload)
+    {
+        echo "  unpack(pack()) is not equal to the payload\n";
+    }
+}
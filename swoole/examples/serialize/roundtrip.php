@@ -0,0 +1,79 @@
+<?php
+/**
+ * swoole_serialize round trip of objects with inherited private and protected properties,
+ * with and without schemas, the unpacked objects must equal the originals property by property
+ *
+ * php roundtrip.php
+ */
+class Base
+{
+    private $secret;
+    protected $level;
+    public $name;
+
+    function __construct($i)
+    {
+        $this->secret = "base_secret_" . $i;
+        $this->level = $i;
+        $this->name = "name_" . $i;
+    }
+
+    function getBaseSecret()
+    {
+        return $this->secret;
+    }
+}
+
+class Child extends Base
+{
+    //the same name as the private property of the parent, both must survive
+    private $secret;
+    protected $tags;
+
+    function __construct($i)
+    {
+        parent::__construct($i);
+        $this->secret = "child_secret_" . $i;
+        $this->tags = array('a' . $i, 'b' . $i);
+    }
+
+    function getChildSecret()
+    {
+        return $this->secret;
+    }
+}
+
+function check($objects, $flag)
+{
+    $result = swoole_serialize::unpack(swoole_serialize::pack($objects, $flag));
+    foreach ($objects as $i => $object)
+    {
+        $copy = $result[$i];
+        if (get_class($copy) !== get_class($object)
+            or (array) $copy !== (array) $object
+            or $copy->getBaseSecret() !== $object->getBaseSecret()
+            or $copy->getChildSecret() !== $object->getChildSecret())
+        {
+            echo "object#$i is not restored, flag=$flag\n";
+            var_dump($object, $copy);
+            exit(1);
+        }
+        //no property may turn into a dynamic public one
+        if (count(get_object_vars($copy)) !== count(get_object_vars($object)))
+        {
+            echo "object#$i has extra properties, flag=$flag\n";
+            exit(1);
+        }
+    }
+}
+
+$objects = array();
+for ($i = 0; $i < 10; $i++)
+{
+    //the first object defines the schema, the others refer to it
+    $objects[] = new Child($i);
+}
+
+check($objects, 0);
+check($objects, SWOOLE_PACK_NO_SCHEMA);
+echo "OK\n";
@@ -80,6 +80,11 @@ typedef struct _swClient
 
     uint32_t reuse_count;
 
+    /**
+     * connection pool of the php client, see swoole_client.c
+     */
+    void *pool;
+
     char *server_str;
     void *ptr;
     void *params;
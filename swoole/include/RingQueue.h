@@ -17,41 +17,51 @@
 #ifndef _SW_RINGQUEUE_H_
 #define _SW_RINGQUEUE_H_
 
-#ifdef SW_USE_RINGQUEUE_TS
 #include "atomic.h"
-typedef struct _swRingQueue
-{
-	void **data;
-	char *flags;
-	// 0：push ready 1: push now
-	// 2：pop ready; 3: pop now
-	uint size;
-	uint num;
-	uint head;
-	uint tail;
 
-} swRingQueue;
+/**
+ * cell->sequence is pos when the cell is free for the lap of pos, pos + 1 when it holds the element pushed at pos
+ */
+typedef struct _swRingQueue_cell
+{
+    sw_atomic_t sequence;
+    void *data;
+} swRingQueue_cell;
 
-int swRingQueue_init(swRingQueue *, int buffer_size);
-#define swRingQueue_count(q) (q->num)
-int swRingQueue_push(swRingQueue *, void *);
-int swRingQueue_pop(swRingQueue *, void **);
-#else
+/**
+ * Bounded MPMC queue (Dmitry Vyukov), the capacity is rounded up to a power of two.
+ * swRingQueue_new(size, 1) puts the whole queue in shared memory, the elements must then
+ * be meaningful in every process (integers or pointers into the same shared memory).
+ */
 typedef struct _swRingQueue
 {
-	int head; /* 头部，出队列方向*/
-	int tail; /* 尾部，入队列方向*/
-	int tag; /* 为空还是为满的标志位*/
-	int size; /* 队列总尺寸 */
-	void **data; /* 队列空间 */
+    uint32_t size;
+    uint32_t mask;
+    swRingQueue_cell *cells;
+    uint8_t shared;
+    uint8_t alloc;
+
+    /**
+     * pop side
+     */
+    sw_atomic_t head __attribute__((aligned(SW_CACHELINE_SIZE)));
+    /**
+     * push side
+     */
+    sw_atomic_t tail __attribute__((aligned(SW_CACHELINE_SIZE)));
 } swRingQueue;
 
 int swRingQueue_init(swRingQueue *queue, int buffer_size);
+swRingQueue* swRingQueue_new(int buffer_size, int shared);
 int swRingQueue_push(swRingQueue *queue, void *);
 int swRingQueue_pop(swRingQueue *queue, void **);
 void swRingQueue_free(swRingQueue *queue);
 
-#define swRingQueue_empty(q) ( (q->head == q->tail) && (q->tag == 0))
-#define swRingQueue_full(q) ( (q->head == q->tail) && (q->tag == 1))
+/**
+ * exact when there is no concurrent push or pop
+ */
+#define swRingQueue_count(q)   ((uint32_t) ((q)->tail - (q)->head))
+#define swRingQueue_empty(q)   (swRingQueue_count(q) == 0)
+#define swRingQueue_full(q)    (swRingQueue_count(q) >= (q)->size)
+
 #endif
-#endif 
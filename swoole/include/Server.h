@@ -20,6 +20,7 @@
 #include "swoole.h"
 #include "buffer.h"
 #include "Connection.h"
+#include "hash.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -67,6 +68,15 @@ enum swEventType
     SW_EVENT_BUFFER_EMPTY,
 };
 
+/**
+ * swDataHead.flags, set by the reactor thread only
+ */
+enum swEventDataFlag
+{
+    //the request was packed by swHttpRequest_pack_upload, the worker trusts its temporary files
+    SW_EVENT_DATA_UPLOAD = 1u << 0,
+};
+
 enum swIPCType
 {
     SW_IPC_UNIXSOCK = 1,
@@ -110,6 +120,7 @@ enum swTaskType
     SW_TASK_NONBLOCK   = 4,  //task
     SW_TASK_CALLBACK   = 8,  //callback
     SW_TASK_WAITALL    = 16, //for taskWaitAll
+    SW_TASK_SHM        = 32, //shared memory arena
 };
 
 typedef struct _swUdpFd
@@ -131,6 +142,47 @@ typedef struct _swReactorThread
     int c_udp_fd;  //ڴudp
 } swReactorThread;
 
+/**
+ * connections of one reactor ordered by the time they become idle, in shared memory,
+ * so that the heartbeat check and swoole_server::heartbeat() in the workers only visit expired ones
+ */
+typedef struct _swIdleWheel
+{
+    swLock lock;
+    swTimeWheel wheel;
+} swIdleWheel;
+
+/**
+ * latency bucket i counts the requests answered in [2^i, 2^(i+1)) microseconds, the last one all slower ones
+ */
+#define SW_STATS_LATENCY_BUCKETS     24
+
+enum swStats_format
+{
+    SW_STATS_DEFAULT     = 0,
+    SW_STATS_TEXT        = 1,
+    SW_STATS_PROMETHEUS  = 2,
+};
+
+/**
+ * written only by its worker, read through swServer_stats_worker()
+ */
+typedef struct _swWorkerStats
+{
+    /**
+     * seqlock version, odd while the worker updates the counters
+     */
+    sw_atomic_t version __attribute__((aligned(SW_CACHELINE_SIZE)));
+    uint64_t request_count;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    /**
+     * sum of the time spent in the onReceive/onPacket callbacks
+     */
+    uint64_t latency_usec;
+    uint64_t latency[SW_STATS_LATENCY_BUCKETS];
+} swWorkerStats;
+
 typedef struct _swListenPort
 {
     struct _swListenPort *next, *prev;
@@ -181,6 +233,10 @@ typedef struct _swListenPort
      * built-in websocket protocol
      */
     uint32_t open_websocket_protocol :1;
+    /**
+     * negotiate permessage-deflate with websocket clients
+     */
+    uint32_t websocket_compression :1;
     /**
      *  one package: length check
      */
@@ -384,6 +440,10 @@ struct _swServer
      * oepn cpu affinity setting
      */
     uint32_t open_cpu_affinity :1;   //CPU׺Ͷ
+    /**
+     * place reactors and workers by NUMA node and RX queue interrupts, see swServer_cpu_affinity_init
+     */
+    uint32_t cpu_affinity_numa :1;
     /**
      * Udisable notice when use SW_DISPATCH_ROUND and SW_DISPATCH_QUEUE
      */
@@ -396,6 +456,15 @@ struct _swServer
      * parse x-www-form-urlencoded data
      */
     uint32_t http_parse_post :1;
+    /**
+     * compress responses the client accepts, and serve .gz/.br files next to the sendfile target
+     */
+    uint32_t http_compression :1;
+    uint32_t http_gzip_static :1;
+    /**
+     * serve the files under document_root in the worker without calling onRequest
+     */
+    uint32_t enable_static_handler :1;
     /**
      * enable onConnect/onClose event when use dispatch_mode=1/3
      */
@@ -408,6 +477,14 @@ struct _swServer
      * run as a daemon process
      */
     uint32_t reload_async :1;
+    /**
+     * per-worker counters in worker_stats
+     */
+    uint32_t enable_stats :1;
+    /**
+     * reactor threads send the stream events to the workers through pipe_rings
+     */
+    uint32_t enable_pipe_ring :1;
 
     /* heartbeat check time*/
     uint16_t heartbeat_idle_time; //ʱ
@@ -415,6 +492,16 @@ struct _swServer
 
     int *cpu_affinity_available;
     int cpu_affinity_available_num;
+    /**
+     * network device whose RX queue interrupts the reactors follow, e.g. eth0
+     */
+    char *cpu_affinity_irq_device;
+    /**
+     * cpu of every reactor and worker and NUMA node of every worker, set by swServer_cpu_affinity_init
+     */
+    int *reactor_cpu;
+    int *worker_cpu;
+    int16_t *worker_node;
     
     uint16_t listen_port_num;
     time_t reload_time;
@@ -444,6 +531,14 @@ struct _swServer
     pthread_barrier_t barrier;
 #endif
 
+    swIdleWheel *idle_wheels;
+    uint16_t idle_wheel_num;
+
+    swWorkerStats *worker_stats;
+    /**
+     * shared memory ring of every event worker, swPipeRing
+     */
+    swPipe *pipe_rings;
     swConnection *connection_list;  //б
     swSession *session_list;   
 
@@ -452,10 +547,21 @@ struct _swServer
      */
     char *upload_tmp_dir;
 
+    uint8_t http_compression_level;
+    uint32_t http_compression_min_length;
+
+    char *document_root;
+    uint16_t document_root_len;
+
     /**
      * master process pid
      */
     char *pid_file;
+    /**
+     * rewritten by the manager (worker#0 in SWOOLE_BASE) every SW_STATS_FILE_INTERVAL ms in stats_file_format
+     */
+    char *stats_file;
+    uint8_t stats_file_format;
 
     /**
      * message queue key
@@ -515,6 +621,15 @@ typedef struct
     char tmpfile[SW_TASK_TMPDIR_SIZE + sizeof(SW_TASK_TMP_FILE)];
 } swPackage_task;
 
+typedef struct
+{
+    int length;
+    /**
+     * offset of the block in SwooleG.task_arena
+     */
+    uint32_t offset;
+} swPackage_task_shm;
+
 typedef struct
 {
 	int length;
@@ -537,6 +652,28 @@ int swServer_create(swServer *serv);
 int swServer_free(swServer *serv);
 int swServer_shutdown(swServer *serv);
 
+int swServer_heartbeat_init(swServer *serv);
+void swServer_heartbeat_free(swServer *serv);
+void swServer_heartbeat_add(swServer *serv, swConnection *conn);
+void swServer_heartbeat_del(swServer *serv, swConnection *conn);
+int swServer_heartbeat_expire(swServer *serv, uint16_t reactor_id, time_t now, swArray *fds);
+int swServer_heartbeat_idle(swServer *serv, uint16_t reactor_id, time_t now, swArray *fds);
+
+int swServer_cpu_affinity_init(swServer *serv);
+void swServer_cpu_affinity_free(swServer *serv);
+int swServer_cpu_affinity_reactor(swServer *serv, uint16_t reactor_id);
+int swServer_cpu_affinity_worker(swServer *serv, uint32_t worker_id);
+
+int swServer_stats_init(swServer *serv);
+void swServer_stats_free(swServer *serv);
+void swServer_stats_worker(swServer *serv, uint32_t worker_id, swWorkerStats *stats);
+uint32_t swWorkerStats_percentile(swWorkerStats *stats, double percent);
+int swServer_stats_dump(swServer *serv, swString *buffer, int format);
+int swServer_stats_dump_file(swServer *serv, char *file, int format);
+
+int swServer_pipe_ring_init(swServer *serv);
+void swServer_pipe_ring_free(swServer *serv);
+
 static sw_inline swString *swServer_get_buffer(swServer *serv, int fd)
 {
     swString *buffer = serv->connection_list[fd].recv_buffer;
@@ -640,9 +777,63 @@ int swTaskWorker_finish(swServer *serv, char *data, int data_len, int flags);
 
 #define swTask_type(task)                  ((task)->info.from_fd)
 
+/**
+ * copy the payload into a block of the shared arena and pass its offset, the receiver frees it.
+ * @return SW_ERR when the arena is missing or full
+ */
+static sw_inline int swTaskWorker_arena_pack(swEventData *task, void *data, int data_len)
+{
+    swMemoryPool *arena = SwooleG.task_arena;
+    swPackage_task_shm _pkg;
+    char *slice;
+
+    if (arena == NULL)
+    {
+        return SW_ERR;
+    }
+    slice = arena->alloc(arena, data_len);
+    if (slice == NULL)
+    {
+        return SW_ERR;
+    }
+    memcpy(slice, data, data_len);
+
+    _pkg.length = data_len;
+    _pkg.offset = slice - (char *) arena;
+    memcpy(task->data, &_pkg, sizeof(_pkg));
+    task->info.len = sizeof(_pkg);
+    swTask_type(task) |= SW_TASK_SHM;
+    return SW_OK;
+}
+
+static sw_inline swString* swTaskWorker_arena_unpack(swEventData *task_result)
+{
+    swMemoryPool *arena = SwooleG.task_arena;
+    swPackage_task_shm _pkg;
+    char *slice;
+
+    memcpy(&_pkg, task_result->data, sizeof(_pkg));
+    slice = (char *) arena + _pkg.offset;
+
+    if (SwooleG.module_stack->size < _pkg.length && swString_extend_align(SwooleG.module_stack, _pkg.length) < 0)
+    {
+        arena->free(arena, slice);
+        return NULL;
+    }
+    memcpy(SwooleG.module_stack->str, slice, _pkg.length);
+    SwooleG.module_stack->length = _pkg.length;
+    arena->free(arena, slice);
+    return SwooleG.module_stack;
+}
+
 static sw_inline swString* swTaskWorker_large_unpack(swEventData *task_result)
 {
     swPackage_task _pkg;
+
+    if (swTask_type(task_result) & SW_TASK_SHM)
+    {
+        return swTaskWorker_arena_unpack(task_result);
+    }
     memcpy(&_pkg, task_result->data, sizeof(_pkg));
 
     int tmp_file_fd = open(_pkg.tmpfile, O_RDONLY);
@@ -732,6 +923,62 @@ static sw_inline swWorker* swServer_get_worker(swServer *serv, uint16_t worker_i
     return NULL;
 }
 
+static sw_inline uint32_t swServer_get_ip_key(swServer *serv, uint32_t schedule_key)
+{
+    swConnection *conn = swServer_connection_get(serv, schedule_key);
+    //UDP
+    if (conn == NULL)
+    {
+        return schedule_key;
+    }
+    //IPv4
+    else if (conn->socket_type == SW_SOCK_TCP)
+    {
+        return conn->info.addr.inet_v4.sin_addr.s_addr;
+    }
+    //IPv6
+    else
+    {
+#ifdef HAVE_KQUEUE
+        return *(((uint32_t *) &conn->info.addr.inet_v6.sin6_addr) + 3);
+#else
+        return conn->info.addr.inet_v6.sin6_addr.s6_addr32[3];
+#endif
+    }
+}
+
+static sw_inline uint32_t swServer_get_uid_key(swServer *serv, uint32_t schedule_key)
+{
+    swConnection *conn = swServer_connection_get(serv, schedule_key);
+    if (conn == NULL || conn->uid == 0)
+    {
+        return schedule_key;
+    }
+    return conn->uid;
+}
+
+/**
+ * the worker with the fewest in-flight requests, scanning from a rotating offset so that ties are spread
+ */
+static sw_inline uint32_t swServer_worker_least_request(swServer *serv)
+{
+    uint32_t i, n = serv->worker_num;
+    uint32_t start = sw_atomic_fetch_add(&serv->worker_round_id, 1) % n;
+    uint32_t target_worker_id = start, worker_id;
+    uint32_t min = serv->workers[start].inflight_num;
+
+    for (i = 1; i < n && min > 0; i++)
+    {
+        worker_id = start + i < n ? start + i : start + i - n;
+        if (serv->workers[worker_id].inflight_num < min)
+        {
+            min = serv->workers[worker_id].inflight_num;
+            target_worker_id = worker_id;
+        }
+    }
+    return target_worker_id;
+}
+
 static sw_inline uint32_t swServer_worker_schedule(swServer *serv, uint32_t schedule_key)
 {
     uint32_t target_worker_id = 0;
@@ -749,43 +996,24 @@ static sw_inline uint32_t swServer_worker_schedule(swServer *serv, uint32_t sche
     //Using the IP touch access to hash
     else if (serv->dispatch_mode == SW_DISPATCH_IPMOD)
     {
-        swConnection *conn = swServer_connection_get(serv, schedule_key);
-        //UDP
-        if (conn == NULL)
-        {
-            target_worker_id = schedule_key % serv->worker_num;
-        }
-        //IPv4
-        else if (conn->socket_type == SW_SOCK_TCP)
-        {
-            target_worker_id = conn->info.addr.inet_v4.sin_addr.s_addr % serv->worker_num;
-        }
-        //IPv6
-        else
-        {
-#ifdef HAVE_KQUEUE
-            uint32_t ipv6_last_int = *(((uint32_t *) &conn->info.addr.inet_v6.sin6_addr) + 3);
-            target_worker_id = ipv6_last_int % serv->worker_num;
-#else
-            target_worker_id = conn->info.addr.inet_v6.sin6_addr.s6_addr32[3] % serv->worker_num;
-#endif
-        }
+        target_worker_id = swServer_get_ip_key(serv, schedule_key) % serv->worker_num;
     }
     else if (serv->dispatch_mode == SW_DISPATCH_UIDMOD)
     {
-        swConnection *conn = swServer_connection_get(serv, schedule_key);
-        if (conn == NULL)
-        {
-            target_worker_id = schedule_key % serv->worker_num;
-        }
-        else if (conn->uid)
-        {
-            target_worker_id = conn->uid % serv->worker_num;
-        }
-        else
-        {
-            target_worker_id = schedule_key % serv->worker_num;
-        }
+        target_worker_id = swServer_get_uid_key(serv, schedule_key) % serv->worker_num;
+    }
+    else if (serv->dispatch_mode == SW_DISPATCH_IPHASH)
+    {
+        target_worker_id = swoole_hash_jump(swServer_get_ip_key(serv, schedule_key), serv->worker_num);
+    }
+    else if (serv->dispatch_mode == SW_DISPATCH_UIDHASH)
+    {
+        target_worker_id = swoole_hash_jump(swServer_get_uid_key(serv, schedule_key), serv->worker_num);
+    }
+    else if (serv->dispatch_mode == SW_DISPATCH_LEASTREQ)
+    {
+        target_worker_id = swServer_worker_least_request(serv);
+        sw_atomic_fetch_add(&serv->workers[target_worker_id].inflight_num, 1);
     }
     //Preemptive distribution
     else
@@ -804,6 +1032,77 @@ static sw_inline uint32_t swServer_worker_schedule(swServer *serv, uint32_t sche
     return target_worker_id;
 }
 
+/**
+ * called by the worker when it has handled a request dispatched by swServer_worker_schedule
+ */
+static sw_inline void swServer_worker_request_end(swServer *serv, uint32_t worker_id)
+{
+    if (serv->dispatch_mode == SW_DISPATCH_LEASTREQ && worker_id < serv->worker_num)
+    {
+        swWorker *worker = &serv->workers[worker_id];
+        uint32_t n;
+        //never wrap below zero
+        while ((n = worker->inflight_num) > 0 && !sw_atomic_cmp_set(&worker->inflight_num, n, n - 1));
+    }
+}
+
+/**
+ * monotonic microseconds, wrapping every 71 minutes
+ */
+static sw_inline uint32_t swServer_stats_usec(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t) ((uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000);
+}
+
+static sw_inline void swServer_stats_write_begin(sw_atomic_t *version)
+{
+    (*version)++;
+    sw_atomic_memory_barrier();
+}
+
+static sw_inline void swServer_stats_write_end(sw_atomic_t *version)
+{
+    sw_atomic_memory_barrier();
+    (*version)++;
+}
+
+/**
+ * called by the worker when the callback of a request returns, start is swServer_stats_usec() before it was called
+ */
+static sw_inline void swServer_stats_request_end(swServer *serv, uint32_t worker_id, uint32_t start, uint32_t length)
+{
+    if (serv->worker_stats == NULL || worker_id >= serv->worker_num)
+    {
+        return;
+    }
+    swWorkerStats *stats = &serv->worker_stats[worker_id];
+    swServer_stats_write_begin(&stats->version);
+    stats->request_count++;
+    stats->bytes_in += length;
+    uint32_t usec = swServer_stats_usec() - start;
+    int bucket = usec < 2 ? 0 : 31 - __builtin_clz(usec);
+    stats->latency[bucket < SW_STATS_LATENCY_BUCKETS ? bucket : SW_STATS_LATENCY_BUCKETS - 1]++;
+    stats->latency_usec += usec;
+    swServer_stats_write_end(&stats->version);
+}
+
+/**
+ * called by the worker for the bytes it sends to the clients
+ */
+static sw_inline void swServer_stats_worker_send(swServer *serv, uint32_t worker_id, uint32_t length)
+{
+    if (serv->worker_stats && worker_id < serv->worker_num)
+    {
+        swWorkerStats *stats = &serv->worker_stats[worker_id];
+        swServer_stats_write_begin(&stats->version);
+        stats->bytes_out += length;
+        swServer_stats_write_end(&stats->version);
+    }
+}
+
 void swServer_worker_onStart(swServer *serv);
 void swServer_worker_onStop(swServer *serv);
 
@@ -25,6 +25,7 @@ enum swAioMode
 {
     SW_AIO_BASE = 0,
     SW_AIO_LINUX,
+    SW_AIO_URING,
 };
 
 enum
@@ -78,4 +79,8 @@ int swAioGcc_init(int max_aio_events);
 int swAioLinux_init(int max_aio_events);
 #endif
 
+#ifdef HAVE_IO_URING
+int swAioUring_init(int max_aio_events);
+#endif
+
 #endif /* _SW_ASYNC_H_ */
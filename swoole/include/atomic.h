@@ -29,4 +29,13 @@ typedef atomic_uint32_t  sw_atomic_t;
 
 #define sw_spinlock_release(lock)         __sync_lock_release(lock)
 
+/**
+ * x86 never reorders loads with other loads, a compiler barrier is enough for the reader side of a seqlock
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#define sw_atomic_read_barrier()          __asm__ __volatile__ ("" ::: "memory")
+#else
+#define sw_atomic_read_barrier()          __sync_synchronize()
+#endif
+
 #endif
@@ -0,0 +1,102 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef __SW_FLATMAP_H
+#define __SW_FLATMAP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * string keys shorter than this are packed into key_int, no strdup and no memcmp
+ */
+#define SW_FLATMAP_SHORT_KEY_LEN   8
+
+typedef void (*swFlatMap_dtor)(void *data);
+
+enum swFlatMap_key_type
+{
+    SW_FLATMAP_KEY_INT = 1,
+    SW_FLATMAP_KEY_SHORT,
+    SW_FLATMAP_KEY_STR,
+};
+
+typedef struct
+{
+    /**
+     * integer key, or a short string key packed in place
+     */
+    uint64_t key_int;
+    /**
+     * only for SW_FLATMAP_KEY_STR
+     */
+    char *key_str;
+    void *data;
+    uint32_t hash;
+    uint16_t key_len;
+    uint8_t type;
+    uint8_t removed;
+} swFlatMap_entry;
+
+typedef struct
+{
+    /**
+     * index into entries + 1, 0 is an empty slot
+     */
+    uint32_t index;
+    uint32_t hash;
+} swFlatMap_slot;
+
+/**
+ * Robin Hood open addressing over a dense entry array,
+ * probing only touches the 8 byte slots and iteration keeps the insertion order.
+ */
+typedef struct
+{
+    swFlatMap_slot *slots;
+    swFlatMap_entry *entries;
+    uint32_t slot_mask;
+    uint32_t entry_size;
+    uint32_t entry_used;
+    uint32_t num;
+    uint32_t iterator;
+    swFlatMap_dtor dtor;
+} swFlatMap;
+
+swFlatMap* swFlatMap_new(uint32_t bucket_num, swFlatMap_dtor dtor);
+void swFlatMap_free(swFlatMap *hmap);
+
+int swFlatMap_add(swFlatMap *hmap, char *key, uint16_t key_len, void *data);
+void swFlatMap_add_int(swFlatMap *hmap, uint64_t key, void *data);
+void* swFlatMap_find(swFlatMap *hmap, char *key, uint16_t key_len);
+void* swFlatMap_find_int(swFlatMap *hmap, uint64_t key);
+void swFlatMap_update_int(swFlatMap *hmap, uint64_t key, void *data);
+int swFlatMap_update(swFlatMap *hmap, char *key, uint16_t key_len, void *data);
+int swFlatMap_del(swFlatMap *hmap, char *key, uint16_t key_len);
+int swFlatMap_del_int(swFlatMap *hmap, uint64_t key);
+int swFlatMap_move(swFlatMap *hmap, char *old_key, uint16_t old_key_len, char *new_key, uint16_t new_key_len);
+int swFlatMap_move_int(swFlatMap *hmap, uint64_t old_key, uint64_t new_key);
+void* swFlatMap_each(swFlatMap* hmap, char **key);
+void* swFlatMap_each_int(swFlatMap* hmap, uint64_t *key);
+#define swFlatMap_each_reset(hmap)    (hmap->iterator = 0)
+#define swFlatMap_count(hmap)         (hmap->num)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
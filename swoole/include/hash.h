@@ -215,4 +215,20 @@ static inline uint64_t swoole_hash_php(char *key, uint32_t len)
 
 uint32_t swoole_crc32(char *data, uint32_t size);
 
+/**
+ * Jump Consistent Hash, Lamping & Veach. Maps key to [0, buckets),
+ * growing buckets from n to n+1 only moves 1/(n+1) of the keys.
+ */
+static inline int32_t swoole_hash_jump(uint64_t key, int32_t buckets)
+{
+    int64_t b = -1, j = 0;
+    while (j < buckets)
+    {
+        b = j;
+        key = key * 2862933555777941757ULL + 1;
+        j = (b + 1) * ((double) (1LL << 31) / (double) ((key >> 33) + 1));
+    }
+    return (int32_t) b;
+}
+
 #endif /* SW_HASH_H_ */
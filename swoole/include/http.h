@@ -25,6 +25,8 @@ extern "C"
 #include <sys/types.h>
 #include <stdint.h>
 
+#include "thirdparty/multipart_parser.h"
+
 enum swHttpMethod
 {
     HTTP_DELETE = 1, HTTP_GET, HTTP_HEAD, HTTP_POST, HTTP_PUT, HTTP_PATCH,
@@ -46,6 +48,151 @@ enum swHttpVersion
     HTTP_VERSION_11,
 };
 
+/**
+ * Streaming upload: the reactor parses a multipart/form-data body while it arrives, writes the
+ * file parts to temporary files and forwards the request with Content-Type SW_HTTP_UPLOAD_CONTENT_TYPE
+ * and a body of swHttpUpload_item records, each followed by name, filename, content type and value.
+ * The value is the field content, or the temporary file of an upload.
+ * The reactor dispatches it with SW_EVENT_DATA_UPLOAD in swDataHead.flags, the worker ignores
+ * the content type on any other request.
+ */
+#define SW_HTTP_UPLOAD_CONTENT_TYPE     "application/x-swoole-upload"
+
+enum swHttpUpload_type
+{
+    SW_HTTP_UPLOAD_FIELD = 1,
+    SW_HTTP_UPLOAD_FILE,
+};
+
+/**
+ * same values as UPLOAD_ERR_* of PHP
+ */
+enum swHttpUpload_error
+{
+    SW_HTTP_UPLOAD_ERR_OK = 0,
+    SW_HTTP_UPLOAD_ERR_NO_TMP_DIR = 6,
+    SW_HTTP_UPLOAD_ERR_CANT_WRITE = 7,
+};
+
+typedef struct
+{
+    uint8_t type;
+    uint8_t error;
+    uint16_t name_len;
+    uint16_t filename_len;
+    uint16_t content_type_len;
+    uint32_t value_len;
+    uint64_t size;
+} swHttpUpload_item;
+
+typedef struct _swHttpMultipart
+{
+    multipart_parser *parser;
+    char *tmp_dir;
+    /**
+     * a header line may be split over several reads
+     */
+    swString *header_field;
+    swString *header_value;
+    uint8_t header_state;
+    /**
+     * the current part
+     */
+    swHttpUpload_item item;
+    swString *name;
+    swString *filename;
+    swString *content_type;
+    swString *value;
+    int fd;
+    char tmp_name[SW_HTTP_UPLOAD_TMPDIR_SIZE];
+    /**
+     * bytes of field values and part headers held in memory, see SW_HTTP_UPLOAD_FIELD_MAX_SIZE
+     */
+    size_t memory_size;
+    /**
+     * encoded items, the body forwarded to the worker
+     */
+    swString *result;
+} swHttpMultipart;
+
+enum swHttp_parse_result
+{
+    SW_HTTP_PARSE_ERROR = -1,
+    SW_HTTP_PARSE_PARTIAL = 0,
+    SW_HTTP_PARSE_COMPLETE = 1,
+};
+
+enum swHttp_parser_state
+{
+    SW_HTTP_PARSER_REQUEST_LINE = 0,
+    SW_HTTP_PARSER_HEADERS,
+    SW_HTTP_PARSER_DONE,
+};
+
+enum swHttp_parser_flag
+{
+    SW_HTTP_CONTENT_LENGTH = 1u << 0,
+    SW_HTTP_CHUNKED = 1u << 1,
+    SW_HTTP_CONNECTION_KEEPALIVE = 1u << 2,
+    SW_HTTP_CONNECTION_CLOSE = 1u << 3,
+    SW_HTTP_CONNECTION_UPGRADE = 1u << 4,
+    SW_HTTP_UPGRADE = 1u << 5,
+    SW_HTTP_EXPECT_CONTINUE = 1u << 6,
+};
+
+/**
+ * offsets into the parsed buffer, the buffer may be reallocated between two reads
+ */
+typedef struct
+{
+    uint32_t name_offset;
+    uint32_t value_offset;
+    uint32_t value_len;
+    uint16_t name_len;
+} swHttp_header;
+
+/**
+ * Single pass request head parser. The reactor feeds it every read to find the end of the header
+ * block and the body length, the worker runs it once over the complete request to build the
+ * request object. A header line is only committed when it is complete, so a partial read resumes
+ * at the start of the last line instead of scanning the whole head again.
+ * A zeroed struct is a valid parser which does not keep the header slices.
+ */
+typedef struct _swHttp_parser
+{
+    uint8_t state;
+    uint8_t method;
+    uint8_t version;
+    uint8_t flags;
+    /**
+     * bytes consumed, the length of the head when state is SW_HTTP_PARSER_DONE
+     */
+    uint32_t offset;
+    uint32_t path_offset;
+    uint32_t path_len;
+    /**
+     * 0 if the request target has no query string
+     */
+    uint32_t query_offset;
+    uint32_t query_len;
+    uint32_t content_length;
+    /**
+     * headers seen, may be greater than header_max, only the first header_max are kept
+     */
+    uint16_t header_num;
+    uint16_t header_max;
+    swHttp_header *headers;
+} swHttp_parser;
+
+static sw_inline int swHttp_parser_keepalive(swHttp_parser *parser)
+{
+    if (parser->version == HTTP_VERSION_11)
+    {
+        return !(parser->flags & SW_HTTP_CONNECTION_CLOSE);
+    }
+    return (parser->flags & SW_HTTP_CONNECTION_KEEPALIVE) != 0;
+}
+
 typedef struct _swHttpRequest
 {
     uint8_t method;
@@ -60,13 +207,27 @@ typedef struct _swHttpRequest
 
     uint8_t opcode;
 
+    swHttpMultipart *multipart;
+
+    swHttp_parser parser;
+
 } swHttpRequest;
 
 int swHttp_get_method(const char *method_str, int method_len);
+void swHttp_parser_init(swHttp_parser *parser, swHttp_header *headers, uint16_t header_max);
+int swHttp_parse_request(swHttp_parser *parser, char *data, size_t length);
+int swHttpRequest_parse(swHttpRequest *request);
 int swHttpRequest_get_protocol(swHttpRequest *request);
 int swHttpRequest_get_content_length(swHttpRequest *request);
 int swHttpRequest_get_header_length(swHttpRequest *request);
 void swHttpRequest_free(swConnection *conn);
+
+int swHttpRequest_get_multipart_boundary(swHttpRequest *request, char **boundary, int *boundary_len);
+int swHttpRequest_upload_begin(swHttpRequest *request, char *tmp_dir);
+int swHttpRequest_pack_upload(swHttpRequest *request, swString *out);
+swHttpMultipart* swHttpMultipart_new(char *boundary, int boundary_len, char *tmp_dir);
+int swHttpMultipart_execute(swHttpMultipart *mp, char *data, size_t length);
+void swHttpMultipart_free(swHttpMultipart *mp, int unlink_files);
 #ifdef SW_HTTP_100_CONTINUE
 int swHttpRequest_has_expect_header(swHttpRequest *request);
 #endif
@@ -87,6 +87,10 @@ enum swHttp2SettingId
 #define SW_HTTP2_STREAM_ID_SIZE               4
 #define SW_HTTP2_SETTINGS_PARAM_SIZE          6
 
+#define SW_HTTP2_DEFAULT_WINDOW               65535
+#define SW_HTTP2_DEFAULT_FRAME_SIZE           16384
+#define SW_HTTP2_DEFAULT_WEIGHT               16
+
 /**
  +-----------------------------------------------+
  |                 Length (24)                   |
@@ -113,6 +117,53 @@ static sw_inline uint32_t swHttp2_get_length(char *buf)
     return (((uint8_t) buf[0]) << 16) + (((uint8_t) buf[1]) << 8) + (uint8_t) buf[2];
 }
 
+/**
+ * a response body waiting for flow-control window
+ */
+typedef struct _swHttp2_stream
+{
+    uint32_t id;
+    uint32_t dependency;
+    uint16_t weight;
+    int32_t send_window;
+    /**
+     * points to the memory of the caller until swHttp2_scheduler_detach() copies the rest into buffer
+     */
+    char *data;
+    size_t length;
+    size_t offset;
+    swString *buffer;
+    /**
+     * virtual finish time, the stream with the smallest one sends the next frame
+     */
+    uint64_t vtime;
+} swHttp2_stream;
+
+/**
+ * Send side of a connection. DATA frames are cut to the windows of the connection and the stream
+ * and to the frame size of the peer, streams are interleaved by weighted fair queueing and a
+ * stream waits while the stream it depends on can still send.
+ */
+typedef struct _swHttp2_scheduler
+{
+    int32_t send_window;
+    uint32_t init_window;
+    uint32_t max_frame_size;
+    uint64_t vtime;
+    uint32_t stream_num;
+    swHttp2_stream *streams[SW_HTTP2_MAX_CONCURRENT_STREAMS];
+} swHttp2_scheduler;
+
+void swHttp2_scheduler_init(swHttp2_scheduler *scheduler);
+void swHttp2_scheduler_free(swHttp2_scheduler *scheduler);
+swHttp2_stream* swHttp2_scheduler_add(swHttp2_scheduler *scheduler, uint32_t id, char *data, size_t length);
+swHttp2_stream* swHttp2_scheduler_find(swHttp2_scheduler *scheduler, uint32_t id);
+void swHttp2_scheduler_remove(swHttp2_scheduler *scheduler, swHttp2_stream *stream);
+int swHttp2_scheduler_window_update(swHttp2_scheduler *scheduler, uint32_t stream_id, uint32_t increment);
+int swHttp2_scheduler_set_init_window(swHttp2_scheduler *scheduler, uint32_t init_window);
+int swHttp2_scheduler_run(swHttp2_scheduler *scheduler, swString *out, size_t limit);
+int swHttp2_scheduler_detach(swHttp2_scheduler *scheduler);
+
 int swHttp2_get_frame_length(swProtocol *protocol, swConnection *conn, char *buf, uint32_t length);
 int swHttp2_send_setting_frame(swProtocol *protocol, swConnection *conn);
 int swHttp2_parse_frame(swProtocol *protocol, swConnection *conn, char *data, uint32_t length);
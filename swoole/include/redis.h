@@ -44,7 +44,48 @@ enum swRedis_reply_type
 
 #define SW_REDIS_MAX_COMMAND_SIZE           64
 #define SW_REDIS_MAX_LINES                  128
+#define SW_REDIS_MAX_ARGS                   1024
 #define SW_REDIS_MAX_STRING_SIZE            536870912  //512M
+#define SW_REDIS_MAX_HEADER_SIZE            24
+
+enum swRedis_parse_result
+{
+    SW_REDIS_PARSE_ERROR = -1,
+    SW_REDIS_PARSE_PARTIAL = 0,
+    SW_REDIS_PARSE_COMPLETE = 1,
+};
+
+/**
+ * one argument of a command, a slice of the receive buffer
+ */
+typedef struct
+{
+    uint32_t offset;
+    uint32_t length;
+    uint8_t type;
+} swRedis_arg;
+
+typedef struct
+{
+    uint8_t state;
+    uint32_t n_args_total;
+    uint32_t n_args;
+    uint32_t n_bytes;
+    /**
+     * next byte to parse and start of the current command, relative to the buffer
+     */
+    size_t offset;
+    size_t command_offset;
+    /**
+     * NULL: only find the command boundaries
+     */
+    swRedis_arg *args;
+    /**
+     * commands with more arguments are rejected, with or without args
+     */
+    uint32_t args_size;
+    uint32_t max_string_size;
+} swRedis_parser;
 
 static sw_inline char* swRedis_get_number(char *p, int *_ret)
 {
@@ -65,6 +106,17 @@ static sw_inline char* swRedis_get_number(char *p, int *_ret)
 
 int swRedis_recv(swProtocol *protocol, swConnection *conn, swString *buffer);
 
+void swRedis_parser_init(swRedis_parser *parser, swRedis_arg *args, uint32_t args_size);
+int swRedis_parse(swRedis_parser *parser, char *data, size_t length);
+void swRedis_parser_consume(swRedis_parser *parser, size_t n);
+
+int swRedis_reply_nil(swString *buffer);
+int swRedis_reply_status(swString *buffer, char *str, int length);
+int swRedis_reply_error(swString *buffer, char *str, int length);
+int swRedis_reply_int(swString *buffer, long value);
+int swRedis_reply_string(swString *buffer, char *str, int length);
+int swRedis_reply_array(swString *buffer, int n);
+
 #ifdef __cplusplus
 }
 #endif
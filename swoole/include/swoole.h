@@ -141,8 +141,10 @@ typedef unsigned long ulong_t;
 #include "swoole_config.h"
 #include "atomic.h"
 #include "hashmap.h"
+#include "flatmap.h"
 #include "list.h"
 #include "heap.h"
+#include "timewheel.h"
 #include "RingQueue.h"
 #include "array.h"
 #include "error.h"
@@ -217,6 +219,7 @@ enum swFd_type
     SW_FD_USER            = 15, //SW_FD_USER or SW_FD_USER+n: for custom event
     SW_FD_STREAM_CLIENT   = 16, //swClient stream
     SW_FD_DGRAM_CLIENT    = 17, //swClient dgram
+    SW_FD_PIPE_RING       = 18, //eventfd of swPipeRing
 };
 
 enum swBool_type
@@ -273,6 +276,15 @@ enum swFactory_dispatch_mode
     SW_DISPATCH_IPMOD = 4,
     SW_DISPATCH_UIDMOD = 5,
     SW_DISPATCH_USERFUNC = 6,
+    /**
+     * worker with the fewest dispatched but unfinished requests
+     */
+    SW_DISPATCH_LEASTREQ = 7,
+    /**
+     * consistent (jump) hash of IP/UID, changing worker_num only remaps ~1/N of the keys
+     */
+    SW_DISPATCH_IPHASH = 8,
+    SW_DISPATCH_UIDHASH = 9,
 };
 
 enum swWorker_status
@@ -539,6 +551,11 @@ typedef struct _swConnection
      */
     time_t last_time;
 
+    /**
+     * in the idle wheel of the reactor, it expires at last_time + heartbeat_idle_time
+     */
+    swTimeWheel_node idle_node;
+
     /**
      * bind uid
      */
@@ -553,6 +570,7 @@ typedef struct _swConnection
      * upgarde websocket
      */
     uint8_t websocket_status;
+    uint8_t websocket_compression;
 
     /**
      * unfinished data frame
@@ -734,6 +752,7 @@ int swPipeBase_create(swPipe *p, int blocking);
 int swPipeEventfd_create(swPipe *p, int blocking, int semaphore, int timeout);
 int swPipeUnsock_create(swPipe *p, int blocking, int protocol);
 int swPipeUnsock_close_ext(swPipe *p, int which);
+int swPipeRing_create(swPipe *p, int blocking, uint32_t size);
 
 static inline int swPipeNotify_auto(swPipe *p, int blocking, int semaphore)
 {
@@ -947,6 +966,11 @@ typedef struct _swFixedPool
  
 swMemoryPool* swFixedPool_new(uint32_t slice_num, uint32_t slice_size, uint8_t shared);
 swMemoryPool* swFixedPool_new2(uint32_t slice_size, void *memory, size_t size);
+/**
+ * size-class allocator with per-thread caches, blocks can be freed by any process when shared
+ */
+swMemoryPool* swSlab_new(size_t size, uint8_t shared);
+void swSlab_flush(void);
 swMemoryPool* swMalloc_new();
 
 /**
@@ -1171,6 +1195,7 @@ long swoole_file_size(char *filename);
 void swoole_open_remote_debug(void);
 char *swoole_dec2hex(int value, int base);
 int swoole_version_compare(char *version1, char *version2);
+int swoole_memfind(char *haystack, uint32_t length, char *needle, uint32_t needle_length);
 #ifdef HAVE_EXECINFO
 void swoole_print_trace(void);
 #endif
@@ -1437,6 +1462,11 @@ struct _swWorker
      */
     sw_atomic_t tasking_num;
 
+    /**
+     * requests dispatched to this worker and not finished yet, SW_DISPATCH_LEASTREQ
+     */
+    sw_atomic_t inflight_num;
+
 	/**
 	 * worker id
 	 */
@@ -1621,6 +1651,14 @@ enum SW_CHANNEL_FLAGS
     SW_CHAN_LOCK     = 1u << 1,
     SW_CHAN_NOTIFY   = 1u << 2,
     SW_CHAN_SHM      = 1u << 3,
+    /**
+     * lock-free, one producer and one consumer
+     */
+    SW_CHAN_SPSC     = 1u << 4,
+    /**
+     * lock-free, any number of producers and consumers
+     */
+    SW_CHAN_MPMC     = 1u << 5,
 };
 
 typedef struct _swChannel
@@ -1637,8 +1675,35 @@ typedef struct _swChannel
     void *mem;   //内存块
     swLock lock;
     swPipe notify_fd;
+
+    /**
+     * SW_CHAN_SPSC: ring of ring_size bytes
+     * SW_CHAN_MPMC: ring of cell_num cells, each with a sequence number in cell_seq
+     */
+    uint32_t ring_size;
+    uint32_t ring_mask;
+    uint32_t cell_num;
+    sw_atomic_t *cell_seq;
+
+    sw_atomic_t read_pos __attribute__((aligned(SW_CACHELINE_SIZE)));
+    sw_atomic_t read_num;
+    uint64_t read_bytes;
+
+    sw_atomic_t write_pos __attribute__((aligned(SW_CACHELINE_SIZE)));
+    sw_atomic_t write_num;
+    uint64_t write_bytes;
+
+    /**
+     * consumers sleep on futex, producers only wake when waiting is set
+     */
+    sw_atomic_t futex __attribute__((aligned(SW_CACHELINE_SIZE)));
+    sw_atomic_t waiting;
 } swChannel;
 
+#define swChannel_lockfree(ch)   ((ch)->flag & (SW_CHAN_SPSC | SW_CHAN_MPMC))
+#define swChannel_num(ch)        (swChannel_lockfree(ch) ? (int) ((ch)->write_num - (ch)->read_num) : (ch)->num)
+#define swChannel_bytes(ch)      (swChannel_lockfree(ch) ? (size_t) ((ch)->write_bytes - (ch)->read_bytes) : (ch)->bytes)
+
 swChannel* swChannel_new(size_t size, int maxlen, int flag);
 int swChannel_pop(swChannel *object, void *out, int buffer_length);
 int swChannel_push(swChannel *object, void *in, int data_length);
@@ -1647,6 +1712,9 @@ int swChannel_in(swChannel *object, void *in, int data_length);
 int swChannel_wait(swChannel *object);
 int swChannel_notify(swChannel *object);
 void swChannel_free(swChannel *object);
+int swChannel_push_batch(swChannel *object, void **in, int *lengths, int n);
+int swChannel_pop_batch(swChannel *object, void *out, int buffer_length, int *lengths, int n);
+int swChannel_pop_wait(swChannel *object, void *out, int buffer_length, int timeout_ms);
 
 swLinkedList* swLinkedList_new(uint8_t type, swDestructor dtor);
 int swLinkedList_append(swLinkedList *ll, void *data);
@@ -1876,6 +1944,10 @@ typedef struct
     uint16_t task_tmpdir_len;
     uint8_t task_ipc_mode;
     uint16_t task_max_request;
+    /**
+     * shared slab for large task payloads, see swTaskWorker_arena_pack
+     */
+    swMemoryPool *task_arena;
 
     uint16_t cpu_num;   //CPUĺ
 
@@ -1935,6 +2007,27 @@ int swoole_sendfile(int out_fd, int in_fd, off_t *offset, size_t size);
 #define swoole_sendfile(out_fd, in_fd, offset, limit)    sendfile(out_fd, in_fd, offset, limit)
 #endif
 
+#define SW_CPU_TOPOLOGY_MAX           1024
+#define SW_NUMA_NODE_MAX              64
+
+typedef struct _swCpuTopology
+{
+    /**
+     * NUMA node of every cpu, -1 if it is offline
+     */
+    int16_t cpu_node[SW_CPU_TOPOLOGY_MAX];
+    /**
+     * the highest cpu id + 1
+     */
+    uint16_t cpu_max;
+    uint16_t node_num;
+} swCpuTopology;
+
+int swoole_cpulist_parse(char *str, int *cpus, int size);
+int swCpuTopology_load(swCpuTopology *topology);
+int swCpuTopology_irq_cpus(char *device, int *cpus, int size);
+int swoole_set_mempolicy_node(int node);
+
 static sw_inline void sw_spinlock(sw_atomic_t *lock)
 {
     uint32_t i, n;
@@ -25,11 +25,14 @@
 
 typedef struct _swTableRow
 {
-    sw_atomic_t lock;
     /**
      * 1:used, 0:empty
      */
     uint8_t active;
+    /**
+     * hash of the key, compared before the key and used to split buckets
+     */
+    uint32_t hash;
     /**
      * next slot
      */
@@ -41,44 +44,120 @@ typedef struct _swTableRow
     char data[0];
 } swTableRow;
 
+typedef struct _swTableBucket
+{
+    /**
+     * writer lock
+     */
+    sw_atomic_t lock;
+    /**
+     * seqlock version of every row in this bucket, odd while a writer is inside.
+     * readers copy the row and retry if the version moved, they never take the lock.
+     */
+    sw_atomic_t version;
+    swTableRow *head;
+} swTableBucket;
+
 typedef struct
 {
     uint32_t absolute_index;
     uint32_t collision_index;
+    /**
+     * points to buffer when the iterator is valid, NULL at the end
+     */
     swTableRow *row;
+    swTableRow *buffer;
 } swTable_iterator;
 
+typedef struct _swTableColumn swTableColumn;
+
+/**
+ * secondary index entry, one per indexed column at the tail of every row
+ */
+typedef struct _swTableIndexLink
+{
+    struct _swTableRow *prev;
+    struct _swTableRow *next;
+    /**
+     * the value the row is linked under
+     */
+    int64_t value;
+    uint8_t linked;
+} swTableIndexLink;
+
+typedef struct _swTableIndexBucket
+{
+    sw_atomic_t lock;
+    struct _swTableRow *head;
+} swTableIndexBucket;
+
 typedef struct
 {
     swHashMap *columns;
+    /**
+     * columns ordered by offset, built by swTable_create
+     */
+    swTableColumn **column_list;
     uint16_t column_num;
+    /**
+     * columns with SW_TABLE_FLAG_INDEX, their links start at row + link_offset
+     */
+    uint16_t index_num;
+    uint16_t columnar_num;
+    uint32_t link_offset;
+    uint32_t index_bucket_num;
     swLock lock;
+    /**
+     * initial bucket num
+     */
     uint32_t size;
-    uint32_t mask;
     uint32_t item_size;
+    /**
+     * sizeof(swTableRow) + item_size, aligned
+     */
+    uint32_t row_size;
+
+    /**
+     * buckets in use, grows one bucket at a time (linear hashing)
+     * up to max_bucket_num, which is size * SW_TABLE_MAX_RESIZE_MULTIPLE
+     */
+    sw_atomic_t bucket_num;
+    uint32_t max_bucket_num;
 
     /**
      * total rows that in active state(shm)
      */
     sw_atomic_t row_num;
+    uint32_t max_row_num;
+    uint32_t row_alloc_num;
+    swTableRow *free_list;
 
-    swTableRow **rows;
-    swMemoryPool *pool;
-
-    uint32_t compress_threshold;
+    swTableBucket *buckets;
+    char *rows;
 
     swTable_iterator *iterator;
 
     void *memory;
+    size_t memory_size;
 } swTable;
 
-typedef struct
+struct _swTableColumn
 {
    uint8_t type;
    uint32_t size;
    swString* name;
    uint16_t index;
-} swTableColumn;
+   uint8_t flags;
+   /**
+    * SW_TABLE_FLAG_INDEX: position of the link in the row and the index buckets
+    */
+   uint16_t link_id;
+   swTableIndexBucket *index_buckets;
+   /**
+    * SW_TABLE_FLAG_COLUMNAR: one int64_t/double per row slot, scanned without touching the rows
+    */
+   void *shadow;
+};
 
 enum swoole_table_type
 {
@@ -93,6 +172,18 @@ enum swoole_table_type
     SW_TABLE_STRING,
 };
 
+enum swoole_table_column_flag
+{
+    /**
+     * hash index on an integer column, used by swTable_find with SW_TABLE_FIND_EQ
+     */
+    SW_TABLE_FLAG_INDEX = 1u << 0,
+    /**
+     * keep a copy of a numeric column in a dense array for vectorized scans
+     */
+    SW_TABLE_FLAG_COLUMNAR = 1u << 1,
+};
+
 enum swoole_table_find
 {
     SW_TABLE_FIND_EQ = 1,
@@ -104,17 +195,68 @@ enum swoole_table_find
     SW_TABLE_FIND_LIKE,
 };
 
+typedef struct
+{
+    swTableColumn *column;
+    uint8_t op;
+    int64_t lval;
+    double dval;
+    char *str;
+    uint32_t length;
+} swTable_condition;
+
+/**
+ * row is a consistent copy, valid until the handler returns
+ */
+typedef void (*swTable_find_handler)(swTable *table, swTableRow *row, void *udata);
+
 swTable* swTable_new(uint32_t rows_size);
 int swTable_create(swTable *table);
 void swTable_free(swTable *table);
-int swTableColumn_add(swTable *table, char *name, int len, int type, int size);
-swTableRow* swTableRow_set(swTable *table, char *key, int keylen, sw_atomic_t **rowlock);
-swTableRow* swTableRow_get(swTable *table, char *key, int keylen, sw_atomic_t **rowlock);
+int swTableColumn_add(swTable *table, char *name, int len, int type, int size, int flags);
+swTableRow* swTableRow_set(swTable *table, char *key, int keylen, swTableBucket **bucket);
+void swTableRow_commit(swTable *table, swTableRow *row, swTableBucket *bucket);
+int swTableRow_read(swTable *table, char *key, int keylen, swTableRow *out);
 
 void swTable_iterator_rewind(swTable *table);
 swTableRow* swTable_iterator_current(swTable *table);
 void swTable_iterator_forward(swTable *table);
 int swTableRow_del(swTable *table, char *key, int keylen);
+int swTable_find(swTable *table, swTable_condition *cond, swTable_find_handler handler, void *udata);
+
+static sw_inline uint32_t swTableBucket_read_begin(swTableBucket *bucket)
+{
+    uint32_t version, i = 0;
+    while ((version = bucket->version) & 1)
+    {
+        if (++i < SW_SPINLOCK_LOOP_N)
+        {
+            sw_atomic_cpu_pause();
+        }
+        else
+        {
+            swYield();
+        }
+    }
+    sw_atomic_read_barrier();
+    return version;
+}
+
+static sw_inline int swTableBucket_read_retry(swTableBucket *bucket, uint32_t version)
+{
+    sw_atomic_read_barrier();
+    return bucket->version != version;
+}
+
+/**
+ * release the bucket, rows changed through swTableRow_set must go through swTableRow_commit
+ */
+static sw_inline void swTableBucket_write_unlock(swTableBucket *bucket)
+{
+    sw_atomic_memory_barrier();
+    bucket->version++;
+    sw_spinlock_release(&bucket->lock);
+}
 
 static sw_inline swTableColumn* swTableColumn_get(swTable *table, char *column_key, int keylen)
 {
@@ -123,6 +265,38 @@ static sw_inline swTableColumn* swTableColumn_get(swTable *table, char *column_k
 
 typedef uint32_t swTable_string_length_t;
 
+static sw_inline int64_t swTableRow_get_long(swTableRow *row, swTableColumn *col)
+{
+    switch(col->type)
+    {
+    case SW_TABLE_INT8:
+        return *(int8_t *) (row->data + col->index);
+    case SW_TABLE_INT16:
+    {
+        int16_t v;
+        memcpy(&v, row->data + col->index, sizeof(v));
+        return v;
+    }
+    case SW_TABLE_INT32:
+    {
+        int32_t v;
+        memcpy(&v, row->data + col->index, sizeof(v));
+        return v;
+    }
+    default:
+    {
+        int64_t v;
+        memcpy(&v, row->data + col->index, sizeof(v));
+        return v;
+    }
+    }
+}
+
+static sw_inline swTableIndexLink* swTableRow_get_link(swTable *table, swTableRow *row, swTableColumn *col)
+{
+    return (swTableIndexLink *) ((char *) row + table->link_offset) + col->link_id;
+}
+
 static sw_inline void swTableRow_set_value(swTableRow *row, swTableColumn * col, void *value, int vlen)
 {
     switch(col->type)
@@ -34,6 +34,7 @@ swUnitTest(mem_test1);
 swUnitTest(mem_test2);
 swUnitTest(mem_test3);
 swUnitTest(mem_test4);
+swUnitTest(mem_slab_test);
 
 swUnitTest(dnslookup_test);
 swUnitTest(client_test);
@@ -42,8 +43,13 @@ swUnitTest(server_test);
 swUnitTest(hashmap_test1);
 swUnitTest(ds_test2);
 swUnitTest(ds_test1);
+swUnitTest(flatmap_test);
+swUnitTest(table_find_test);
 
 swUnitTest(chan_test);
+swUnitTest(chan_bench_test);
+swUnitTest(ringqueue_test);
+swUnitTest(ringqueue_bench_test);
 
 swUnitTest(u1_test2);
 swUnitTest(u1_test1);
@@ -52,22 +58,38 @@ swUnitTest(u1_test3);
 swUnitTest(http_test2);
 
 swUnitTest(type_test1);
+swUnitTest(memfind_test);
 
 swUnitTest(aio_test);
 swUnitTest(aio_test2);
+swUnitTest(aio_bench);
 
 swUnitTest(ws_test1);
+swUnitTest(ws_mask_test);
 
 swUnitTest(http_test1);
+swUnitTest(http_upload_test);
+swUnitTest(http_parser_test);
+swUnitTest(http_parser_bench_test);
+swUnitTest(http2_scheduler_test);
+swUnitTest(http2_scheduler_bench_test);
 swUnitTest(http_test2);
 
+swUnitTest(redis_parser_test);
+swUnitTest(redis_bench_test);
+
 swUnitTest(heap_test1);
+swUnitTest(timer_bench_test);
+swUnitTest(heartbeat_test);
 swUnitTest(linkedlist_test);
 swUnitTest(rbtree_test);
 void p_str(void *str);
 
 swUnitTest(pool_thread);
+swUnitTest(pool_slab_test);
 
 swUnitTest(ringbuffer_test1);
+swUnitTest(ipc_ring_test);
+swUnitTest(dispatch_test);
 
 #endif /* SW_TESTS_H_ */
@@ -0,0 +1,90 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef SW_TIMEWHEEL_H_
+#define SW_TIMEWHEEL_H_
+
+/**
+ * swTimeWheel is not a swTimer backend yet: swTimer_init/add/del/select live in src/network/Timer.c,
+ * which this tree does not have. To select it at swTimer_init, swTimer_node would embed a swTimeWheel_node
+ * next to heap_node, swTimer would hold the wheel next to the heap, and swTimer_select would run
+ * swTimeWheel_expire() and arm the system timer with swTimeWheel_next_msec().
+ *
+ * level 0 has 256 slots of one tick, level 1-3 have 64 slots of 256, 16K and 1M ticks,
+ * 2^26 ticks in total (about 18 hours with a 1ms tick), later timers wait in the last level.
+ */
+#define SW_TIMEWHEEL_ROOT_BITS    8
+#define SW_TIMEWHEEL_LEVEL_BITS   6
+#define SW_TIMEWHEEL_LEVEL_NUM    4
+#define SW_TIMEWHEEL_ROOT_SIZE    (1 << SW_TIMEWHEEL_ROOT_BITS)
+#define SW_TIMEWHEEL_LEVEL_SIZE   (1 << SW_TIMEWHEEL_LEVEL_BITS)
+#define SW_TIMEWHEEL_SLOT_NUM     (SW_TIMEWHEEL_ROOT_SIZE + (SW_TIMEWHEEL_LEVEL_NUM - 1) * SW_TIMEWHEEL_LEVEL_SIZE)
+#define SW_TIMEWHEEL_MAX_TICKS    (1ULL << (SW_TIMEWHEEL_ROOT_BITS + (SW_TIMEWHEEL_LEVEL_NUM - 1) * SW_TIMEWHEEL_LEVEL_BITS))
+
+/**
+ * embedded in the timer object and zeroed before the first add, adding and removing never allocates
+ */
+typedef struct _swTimeWheel_node
+{
+    struct _swTimeWheel_node *prev;
+    struct _swTimeWheel_node *next;
+    /**
+     * expire time in ticks
+     */
+    uint64_t expire;
+    void *data;
+} swTimeWheel_node;
+
+typedef struct _swTimeWheel
+{
+    /**
+     * the next tick to run
+     */
+    uint64_t current;
+    uint32_t tick_msec;
+    uint32_t num;
+    /**
+     * for the expire handler
+     */
+    void *ptr;
+    swTimeWheel_node slots[SW_TIMEWHEEL_SLOT_NUM];
+} swTimeWheel;
+
+typedef void (*swTimeWheel_handler)(swTimeWheel *wheel, swTimeWheel_node *node);
+
+swTimeWheel* swTimeWheel_new(uint32_t tick_msec, int64_t now_msec);
+void swTimeWheel_init(swTimeWheel *wheel, uint32_t tick_msec, int64_t now_msec);
+void swTimeWheel_free(swTimeWheel *wheel);
+void swTimeWheel_add(swTimeWheel *wheel, swTimeWheel_node *node, int64_t exec_msec);
+int swTimeWheel_expire(swTimeWheel *wheel, int64_t now_msec, swTimeWheel_handler handler);
+int swTimeWheel_peek(swTimeWheel *wheel, int64_t now_msec, swTimeWheel_handler handler);
+int64_t swTimeWheel_next_msec(swTimeWheel *wheel);
+
+#define swTimeWheel_count(wheel)         ((wheel)->num)
+#define swTimeWheel_node_active(node)    ((node)->next != NULL)
+
+static inline void swTimeWheel_del(swTimeWheel *wheel, swTimeWheel_node *node)
+{
+    if (node->next)
+    {
+        node->prev->next = node->next;
+        node->next->prev = node->prev;
+        node->prev = node->next = NULL;
+        wheel->num--;
+    }
+}
+
+#endif /* SW_TIMEWHEEL_H_ */
@@ -32,8 +32,21 @@ extern "C"
 #define SW_WEBSOCKET_EXT16_MAX_LEN 0xFFFF
 #define SW_WEBSOCKET_EXT64_LENGTH 0x7F
 #define SW_WEBSOCKET_MASKED(frm) (frm->header.MASK)
+/**
+ * 2 + 8 byte length + 4 byte mask key
+ */
+#define SW_WEBSOCKET_HEADER_MAX_LEN  14
+
+/**
+ * flags of swWebSocket_encode, also the first byte of the frame header the reactor passes to the worker
+ */
+#define SW_WEBSOCKET_FLAG_FIN        0x01
+#define SW_WEBSOCKET_FLAG_COMPRESS   0x02
+
+#define SW_WEBSOCKET_EXTENSION_DEFLATE  "permessage-deflate; server_no_context_takeover; client_no_context_takeover"
 
 #define FRAME_SET_FIN(BYTE) (((BYTE) & 0x01) << 7)
+#define FRAME_SET_RSV1(BYTE) (((BYTE) & 0x01) << 6)
 #define FRAME_SET_OPCODE(BYTE) ((BYTE) & 0x0F)
 #define FRAME_SET_MASK(BYTE) (((BYTE) & 0x01) << 7)
 #define FRAME_SET_LENGTH(X64, IDX) (unsigned char)(((X64) >> ((IDX)*8)) & 0xFF)
@@ -91,8 +104,15 @@ enum swWebsocketCode
 };
 
 int swWebSocket_get_package_length(swProtocol *protocol, swConnection *conn, char *data, uint32_t length);
-void swWebSocket_encode(swString *buffer, char *data, size_t length, char opcode, int finish, int mask);
+int swWebSocket_encode_header(char *header, size_t length, char opcode, int flags, int mask);
+void swWebSocket_encode(swString *buffer, char *data, size_t length, char opcode, int flags, int mask);
+int swWebSocket_send_frame(swReactor *reactor, swConnection *conn, char *data, size_t length, char opcode, int flags);
+void swWebSocket_mask(char *data, size_t length, char *mask_key);
 void swWebSocket_decode(swWebSocket_frame *frame, swString *data);
+#ifdef SW_HAVE_ZLIB
+int swWebSocket_deflate(swString *out, char *data, size_t length);
+int swWebSocket_inflate(swString *out, char *data, size_t length, size_t max_length);
+#endif
 void swWebSocket_print_frame(swWebSocket_frame *frame);
 int swWebSocket_dispatch_frame(swConnection *conn, char *data, uint32_t length);
 
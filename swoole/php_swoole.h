@@ -346,6 +346,7 @@ void swoole_http_client_init(int module_number TSRMLS_DC);
 void swoole_redis_init(int module_number TSRMLS_DC);
 #endif
 void swoole_redis_server_init(int module_number TSRMLS_DC);
+void swoole_redis_server_flush(swServer *serv, int fd);
 void swoole_process_init(int module_number TSRMLS_DC);
 void swoole_http_server_init(int module_number TSRMLS_DC);
 #ifdef SW_USE_HTTP2
@@ -367,9 +368,11 @@ void php_swoole_check_reactor();
 void php_swoole_event_init();
 void php_swoole_event_wait();
 void php_swoole_check_timer(int interval);
+long php_swoole_add_internal_timer(int ms, int is_tick, void (*handler)(swTimer_node *tnode, void *data), void *data);
 void php_swoole_register_callback(swServer *serv);
 void php_swoole_client_free(zval *object, swClient *cli TSRMLS_DC);
 swClient* php_swoole_client_new(zval *object, char *host, int host_len, int port);
+int php_swoole_client_pool_release(swClient *cli);
 void php_swoole_client_check_setting(swClient *cli, zval *zset TSRMLS_DC);
 zval* php_swoole_websocket_unpack(swString *data TSRMLS_DC);
 void php_swoole_sha1(const char *str, int _len, unsigned char *digest);
@@ -412,6 +415,7 @@ php_socket *swoole_convert_to_socket(int sock);
 #endif
 
 void php_swoole_server_before_start(swServer *serv, zval *zobject TSRMLS_DC);
+void php_swoole_server_after_stop(swServer *serv);
 void php_swoole_get_recv_data(zval *zdata, swEventData *req, char *header, uint32_t header_length);
 int php_swoole_get_send_data(zval *zdata, char **str TSRMLS_DC);
 void php_swoole_onConnect(swServer *, swDataHead *);
@@ -16,7 +16,18 @@
 
 #include "swoole.h"
 
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <limits.h>
+#endif
+
 #define SW_CHANNEL_MIN_MEM (1024*64)
+/**
+ * MPMC records take whole cells, a cell holds the item header and 60 bytes of payload
+ */
+#define SW_CHANNEL_CELL_SIZE   64
+#define SW_CHANNEL_ALIGN(n)    (((n) + 7) & ~7)
 
 #define swChannel_empty(q) (q->num == 0)
 #define swChannel_full(q) ((q->head == q->tail) && (q->tail_tag != q->head_tag))
@@ -35,13 +46,21 @@ int swChannel_wait(swChannel *object);
 int swChannel_notify(swChannel *object);
 void swChannel_free(swChannel *object);
 
+static int swChannel_spsc_push(swChannel *object, void **in, int *lengths, int n);
+static int swChannel_spsc_pop(swChannel *object, void *out, int buffer_length, int *lengths, int n);
+static int swChannel_mpmc_push(swChannel *object, void **in, int *lengths, int n);
+static int swChannel_mpmc_pop(swChannel *object, void *out, int buffer_length, int *lengths, int n);
+
 swChannel* swChannel_new(size_t size, int maxlen, int flags)
 {
     assert(size > SW_CHANNEL_MIN_MEM + maxlen);
     int ret;
     void *mem;
 
-    //use shared memory
+    /**
+     * the records live inline in one ring, they are not separate blocks that could come from swSlab:
+     * a push is a copy at the tail, and a slab block per record would add an alloc, a free and a pointer chase
+     */
     if (flags & SW_CHAN_SHM)
     {
         mem = sw_shm_malloc(size);
@@ -67,6 +86,35 @@ swChannel* swChannel_new(size_t size, int maxlen, int flags)
     object->maxlen = maxlen;
     object->flag = flags;
 
+    if (flags & (SW_CHAN_SPSC | SW_CHAN_MPMC))
+    {
+        size_t available = size - sizeof(swChannel);
+        uint32_t ring_size = SW_CHANNEL_CELL_SIZE * 2;
+        uint32_t i;
+
+        if (flags & SW_CHAN_MPMC)
+        {
+            //each cell needs a sequence number besides its data
+            available = available / (SW_CHANNEL_CELL_SIZE + sizeof(sw_atomic_t)) * SW_CHANNEL_CELL_SIZE;
+        }
+        while ((size_t) ring_size * 2 <= available && ring_size < (1u << 31))
+        {
+            ring_size <<= 1;
+        }
+        object->ring_size = ring_size;
+        object->ring_mask = ring_size - 1;
+        if (flags & SW_CHAN_MPMC)
+        {
+            object->cell_num = ring_size / SW_CHANNEL_CELL_SIZE;
+            object->cell_seq = (sw_atomic_t *) ((char *) mem + ring_size);
+            for (i = 0; i < object->cell_num; i++)
+            {
+                object->cell_seq[i] = i;
+            }
+        }
+        assert(SW_CHANNEL_ALIGN(sizeof(int) + maxlen) <= ring_size);
+    }
+
     //use lock
     if (flags & SW_CHAN_LOCK)
     {
@@ -179,6 +227,14 @@ int swChannel_notify(swChannel *object)
  */
 int swChannel_push(swChannel *object, void *in, int data_length)
 {
+    if (object->flag & SW_CHAN_SPSC)
+    {
+        return swChannel_spsc_push(object, &in, &data_length, 1) == 1 ? SW_OK : SW_ERR;
+    }
+    else if (object->flag & SW_CHAN_MPMC)
+    {
+        return swChannel_mpmc_push(object, &in, &data_length, 1) == 1 ? SW_OK : SW_ERR;
+    }
     assert(object->flag & SW_CHAN_LOCK);
     object->lock.lock(&object->lock);
     int ret = swChannel_in(object, in, data_length);
@@ -214,6 +270,15 @@ void swChannel_free(swChannel *object)
  */
 int swChannel_pop(swChannel *object, void *out, int buffer_length)
 {
+    int length;
+    if (swChannel_lockfree(object))
+    {
+        if (swChannel_pop_batch(object, out, buffer_length, &length, 1) == 1)
+        {
+            return length;
+        }
+        return SW_ERR;
+    }
     assert(object->flag & SW_CHAN_LOCK);
     object->lock.lock(&object->lock);
     int n = swChannel_out(object, out, buffer_length);
@@ -221,3 +286,391 @@ int swChannel_pop(swChannel *object, void *out, int buffer_length)
     return n;
 }
 
+
+#ifdef __linux__
+static sw_inline int swChannel_futex_wait(sw_atomic_t *futex, uint32_t value, int timeout_ms)
+{
+    struct timespec timeout, *ptimeout = NULL;
+    if (timeout_ms >= 0)
+    {
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_nsec = (timeout_ms % 1000) * 1000 * 1000;
+        ptimeout = &timeout;
+    }
+    return syscall(SYS_futex, futex, FUTEX_WAIT, value, ptimeout, NULL, 0);
+}
+
+static sw_inline void swChannel_futex_wake(sw_atomic_t *futex, int n)
+{
+    syscall(SYS_futex, futex, FUTEX_WAKE, n, NULL, NULL, 0);
+}
+#else
+/**
+ * no futex, poll every millisecond
+ */
+static sw_inline int swChannel_futex_wait(sw_atomic_t *futex, uint32_t value, int timeout_ms)
+{
+    usleep(1000);
+    return SW_OK;
+}
+
+static sw_inline void swChannel_futex_wake(sw_atomic_t *futex, int n)
+{
+
+}
+#endif
+
+/**
+ * the system call is only made by the first producer after a consumer went to sleep,
+ * all sleepers are woken and the ones that find nothing set waiting again
+ */
+static sw_inline void swChannel_wakeup(swChannel *object)
+{
+    sw_atomic_memory_barrier();
+    if (object->waiting && sw_atomic_cmp_set(&object->waiting, 1, 0))
+    {
+        sw_atomic_fetch_add(&object->futex, 1);
+        swChannel_futex_wake(&object->futex, INT_MAX);
+    }
+}
+
+static sw_inline void swChannel_copy_in(swChannel *object, uint32_t offset, void *src, uint32_t n)
+{
+    uint32_t index = offset & object->ring_mask;
+    uint32_t first = object->ring_size - index;
+    if (n <= first)
+    {
+        memcpy((char *) object->mem + index, src, n);
+    }
+    else
+    {
+        memcpy((char *) object->mem + index, src, first);
+        memcpy(object->mem, (char *) src + first, n - first);
+    }
+}
+
+static sw_inline void swChannel_copy_out(swChannel *object, uint32_t offset, void *dst, uint32_t n)
+{
+    uint32_t index = offset & object->ring_mask;
+    uint32_t first = object->ring_size - index;
+    if (n <= first)
+    {
+        memcpy(dst, (char *) object->mem + index, n);
+    }
+    else
+    {
+        memcpy(dst, (char *) object->mem + index, first);
+        memcpy((char *) dst + first, object->mem, n - first);
+    }
+}
+
+/**
+ * head and tail are free running byte counters, the producer owns write_pos and the consumer read_pos
+ */
+static int swChannel_spsc_push(swChannel *object, void **in, int *lengths, int n)
+{
+    uint32_t tail = object->write_pos;
+    uint32_t head = __atomic_load_n(&object->read_pos, __ATOMIC_ACQUIRE);
+    uint32_t msize;
+    uint64_t bytes = 0;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        assert(lengths[i] < object->maxlen);
+        msize = SW_CHANNEL_ALIGN(sizeof(int) + lengths[i]);
+        if (object->ring_size - (tail - head) < msize)
+        {
+            break;
+        }
+        swChannel_copy_in(object, tail, &lengths[i], sizeof(int));
+        swChannel_copy_in(object, tail + sizeof(int), in[i], lengths[i]);
+        tail += msize;
+        bytes += lengths[i];
+    }
+    if (i == 0)
+    {
+        return 0;
+    }
+    object->write_num += i;
+    object->write_bytes += bytes;
+    __atomic_store_n(&object->write_pos, tail, __ATOMIC_RELEASE);
+    swChannel_wakeup(object);
+    return i;
+}
+
+static int swChannel_spsc_pop(swChannel *object, void *out, int buffer_length, int *lengths, int n)
+{
+    uint32_t head = object->read_pos;
+    uint32_t tail = __atomic_load_n(&object->write_pos, __ATOMIC_ACQUIRE);
+    uint64_t bytes = 0;
+    int i, length;
+
+    for (i = 0; i < n && head != tail; i++)
+    {
+        swChannel_copy_out(object, head, &length, sizeof(int));
+        if (length > buffer_length)
+        {
+            if (i == 0)
+            {
+                swWarn("item is too big, length=%d, buffer_length=%d.", length, buffer_length);
+                errno = EMSGSIZE;
+                return SW_ERR;
+            }
+            break;
+        }
+        swChannel_copy_out(object, head + sizeof(int), out, length);
+        out = (char *) out + length;
+        buffer_length -= length;
+        lengths[i] = length;
+        bytes += length;
+        head += SW_CHANNEL_ALIGN(sizeof(int) + length);
+    }
+    if (i > 0)
+    {
+        object->read_num += i;
+        object->read_bytes += bytes;
+        __atomic_store_n(&object->read_pos, head, __ATOMIC_RELEASE);
+    }
+    return i;
+}
+
+/**
+ * Cells carry a sequence number (bounded MPMC queue by Dmitry Vyukov, extended to records of several cells).
+ * cell_seq[pos % cell_num] is pos when the cell is free for the lap of pos and pos + 1 when a record starting
+ * at pos is published. Producers claim cells by moving write_pos with CAS, consumers by moving read_pos.
+ */
+static sw_inline int swChannel_mpmc_cells(int length)
+{
+    return (sizeof(int) + length + SW_CHANNEL_CELL_SIZE - 1) / SW_CHANNEL_CELL_SIZE;
+}
+
+static int swChannel_mpmc_push(swChannel *object, void **in, int *lengths, int n)
+{
+    uint32_t mask = object->cell_num - 1;
+    uint32_t pos, cells = 0, i;
+    uint64_t bytes = 0;
+    int32_t diff;
+    int j;
+
+    for (j = 0; j < n; j++)
+    {
+        assert(lengths[j] < object->maxlen);
+        cells += swChannel_mpmc_cells(lengths[j]);
+        bytes += lengths[j];
+    }
+
+    _retry:
+    pos = object->write_pos;
+    for (i = 0; i < cells; i++)
+    {
+        diff = (int32_t) (__atomic_load_n(&object->cell_seq[(pos + i) & mask], __ATOMIC_ACQUIRE) - (pos + i));
+        if (diff < 0)
+        {
+            //still used by the previous lap
+            return 0;
+        }
+        else if (diff > 0)
+        {
+            //another producer got here first
+            goto _retry;
+        }
+    }
+    if (!sw_atomic_cmp_set(&object->write_pos, pos, pos + cells))
+    {
+        goto _retry;
+    }
+
+    for (j = 0; j < n; j++)
+    {
+        uint32_t offset = pos * SW_CHANNEL_CELL_SIZE;
+        swChannel_copy_in(object, offset, &lengths[j], sizeof(int));
+        swChannel_copy_in(object, offset + sizeof(int), in[j], lengths[j]);
+        __atomic_store_n(&object->cell_seq[pos & mask], pos + 1, __ATOMIC_RELEASE);
+        pos += swChannel_mpmc_cells(lengths[j]);
+    }
+    sw_atomic_fetch_add(&object->write_num, n);
+    __sync_fetch_and_add(&object->write_bytes, bytes);
+    swChannel_wakeup(object);
+    return n;
+}
+
+static int swChannel_mpmc_pop(swChannel *object, void *out, int buffer_length, int *lengths, int n)
+{
+    uint32_t mask = object->cell_num - 1;
+    uint32_t head, pos, seq, i;
+    uint64_t bytes;
+    int32_t diff;
+    int count, total, length;
+
+    _retry:
+    head = object->read_pos;
+    pos = head;
+    total = 0;
+    for (count = 0; count < n; count++)
+    {
+        seq = __atomic_load_n(&object->cell_seq[pos & mask], __ATOMIC_ACQUIRE);
+        diff = (int32_t) (seq - (pos + 1));
+        if (diff != 0)
+        {
+            if (count == 0 && diff > 0)
+            {
+                goto _retry;
+            }
+            break;
+        }
+        swChannel_copy_out(object, pos * SW_CHANNEL_CELL_SIZE, &length, sizeof(int));
+        if (length < 0 || length > buffer_length - total)
+        {
+            if (count == 0 && object->read_pos == head)
+            {
+                swWarn("item is too big, length=%d, buffer_length=%d.", length, buffer_length);
+                errno = EMSGSIZE;
+                return SW_ERR;
+            }
+            break;
+        }
+        total += length;
+        pos += swChannel_mpmc_cells(length);
+    }
+    if (count == 0)
+    {
+        return 0;
+    }
+    if (!sw_atomic_cmp_set(&object->read_pos, head, pos))
+    {
+        goto _retry;
+    }
+
+    bytes = 0;
+    pos = head;
+    for (i = 0; i < count; i++)
+    {
+        uint32_t cells;
+        swChannel_copy_out(object, pos * SW_CHANNEL_CELL_SIZE, &length, sizeof(int));
+        swChannel_copy_out(object, pos * SW_CHANNEL_CELL_SIZE + sizeof(int), out, length);
+        out = (char *) out + length;
+        lengths[i] = length;
+        bytes += length;
+        cells = swChannel_mpmc_cells(length);
+        //hand the cells to the producers of the next lap
+        while (cells--)
+        {
+            __atomic_store_n(&object->cell_seq[pos & mask], pos + object->cell_num, __ATOMIC_RELEASE);
+            pos++;
+        }
+    }
+    sw_atomic_fetch_add(&object->read_num, count);
+    __sync_fetch_and_add(&object->read_bytes, bytes);
+    return count;
+}
+
+/**
+ * push several items with a single reservation and at most one wakeup
+ * @return the number of items pushed, fewer than n when the channel is full
+ */
+int swChannel_push_batch(swChannel *object, void **in, int *lengths, int n)
+{
+    int i;
+    if (object->flag & SW_CHAN_SPSC)
+    {
+        return swChannel_spsc_push(object, in, lengths, n);
+    }
+    else if (object->flag & SW_CHAN_MPMC)
+    {
+        //all or nothing, retry one by one when the whole batch does not fit
+        if (swChannel_mpmc_push(object, in, lengths, n) == n)
+        {
+            return n;
+        }
+        for (i = 0; i < n; i++)
+        {
+            if (swChannel_mpmc_push(object, &in[i], &lengths[i], 1) != 1)
+            {
+                break;
+            }
+        }
+        return i;
+    }
+    for (i = 0; i < n; i++)
+    {
+        if (swChannel_push(object, in[i], lengths[i]) < 0)
+        {
+            break;
+        }
+    }
+    return i;
+}
+
+/**
+ * pop up to n items into out back to back, the length of each is stored in lengths
+ * @return the number of items, 0 when the channel is empty
+ */
+int swChannel_pop_batch(swChannel *object, void *out, int buffer_length, int *lengths, int n)
+{
+    int i, ret;
+    if (object->flag & SW_CHAN_SPSC)
+    {
+        return swChannel_spsc_pop(object, out, buffer_length, lengths, n);
+    }
+    else if (object->flag & SW_CHAN_MPMC)
+    {
+        return swChannel_mpmc_pop(object, out, buffer_length, lengths, n);
+    }
+    for (i = 0; i < n; i++)
+    {
+        ret = swChannel_pop(object, out, buffer_length);
+        if (ret < 0)
+        {
+            break;
+        }
+        lengths[i] = ret;
+        out = (char *) out + ret;
+        buffer_length -= ret;
+    }
+    return i;
+}
+
+/**
+ * blocking pop of a lock-free channel, the consumer sleeps on a futex in the shared memory
+ * @return the item length, SW_ERR on timeout (timeout_ms < 0 waits forever)
+ */
+int swChannel_pop_wait(swChannel *object, void *out, int buffer_length, int timeout_ms)
+{
+    int length, ret, wait_ms = -1;
+    uint32_t value;
+    double deadline = 0;
+
+    assert(swChannel_lockfree(object));
+    if (timeout_ms >= 0)
+    {
+        deadline = swoole_microtime() + (double) timeout_ms / 1000;
+    }
+    while (1)
+    {
+        ret = swChannel_pop_batch(object, out, buffer_length, &length, 1);
+        if (ret != 0)
+        {
+            return ret < 0 ? SW_ERR : length;
+        }
+        if (timeout_ms >= 0)
+        {
+            wait_ms = (int) ((deadline - swoole_microtime()) * 1000);
+            if (wait_ms <= 0)
+            {
+                return SW_ERR;
+            }
+        }
+        value = object->futex;
+        object->waiting = 1;
+        sw_atomic_memory_barrier();
+        //a producer that missed the waiting flag has already published
+        ret = swChannel_pop_batch(object, out, buffer_length, &length, 1);
+        if (ret != 0)
+        {
+            return ret < 0 ? SW_ERR : length;
+        }
+        swChannel_futex_wait(&object->futex, value, wait_ms);
+    }
+    return SW_ERR;
+}
@@ -17,135 +17,165 @@
 #include "swoole.h"
 #include "RingQueue.h"
 
-#ifdef SW_USE_RINGQUEUE_TS
+/**
+ * contended CAS: spin with pause a growing number of times, then give up the CPU
+ */
+#define SW_RINGQUEUE_SPIN_MAX    64
 
-int swRingQueue_init(swRingQueue *queue, int buffer_size)
+static sw_inline void swRingQueue_backoff(uint32_t *spin)
 {
-    queue->size = buffer_size;
-    queue->flags = (char *)sw_malloc(queue->size);
-    if (queue->flags == NULL)
+    uint32_t i;
+    if (*spin < SW_RINGQUEUE_SPIN_MAX)
     {
-        return -1;
+        for (i = 0; i < *spin; i++)
+        {
+            sw_atomic_cpu_pause();
+        }
+        *spin <<= 1;
     }
-    queue->data = (void **)sw_calloc(queue->size, sizeof(void*));
-    if (queue->data == NULL)
+    else
     {
-        sw_free(queue->flags);
-        return -1;
+        swYield();
     }
-    queue->head = 0;
-    queue->tail = 0;
-    memset(queue->flags, 0, queue->size);
-    memset(queue->data, 0, queue->size * sizeof(void*));
-    return 0;
 }
 
-int swRingQueue_push(swRingQueue *queue, void * ele)
+static void swRingQueue_reset(swRingQueue *queue, uint32_t size, swRingQueue_cell *cells)
 {
-    if (!(queue->num < queue->size))
-    {
-        return -1;
-    }
-    int cur_tail_index = queue->tail;
-    char * cur_tail_flag_index = queue->flags + cur_tail_index;
-    //TODO Scheld
-    while (!sw_atomic_cmp_set(cur_tail_flag_index, 0, 1))
+    uint32_t i;
+    queue->size = size;
+    queue->mask = size - 1;
+    queue->cells = cells;
+    queue->head = 0;
+    queue->tail = 0;
+    for (i = 0; i < size; i++)
     {
-        cur_tail_index = queue->tail;
-        cur_tail_flag_index = queue->flags + cur_tail_index;
+        cells[i].sequence = i;
+        cells[i].data = NULL;
     }
-
-    // 两个入队线程之间的同步
-    //TODO 取模操作可以优化
-    int update_tail_index = (cur_tail_index + 1) % queue->size;
-
-    // 如果已经被其他的线程更新过，则不需要更新；
-    // 否则，更新为 (cur_tail_index+1) % size;
-    sw_atomic_cmp_set(&queue->tail, cur_tail_index, update_tail_index);
-
-    // 申请到可用的存储空间
-    *(queue->data + cur_tail_index) = ele;
-
-    sw_atomic_fetch_add(cur_tail_flag_index, 1);
-    sw_atomic_fetch_add(&queue->num, 1);
-    return 0;
 }
 
-int swRingQueue_pop(swRingQueue *queue, void **ele)
+static uint32_t swRingQueue_capacity(int buffer_size)
 {
-    if (!(queue->num > 0))
-        return -1;
-    int cur_head_index = queue->head;
-    char * cur_head_flag_index = queue->flags + cur_head_index;
-
-    while (!sw_atomic_cmp_set(cur_head_flag_index, 2, 3))
+    uint32_t size = 2;
+    while (size < (uint32_t) buffer_size && size < (1u << 30))
     {
-        cur_head_index = queue->head;
-        cur_head_flag_index = queue->flags + cur_head_index;
+        size <<= 1;
     }
-    //TODO 取模操作可以优化
-    int update_head_index = (cur_head_index + 1) % queue->size;
-    sw_atomic_cmp_set(&queue->head, cur_head_index, update_head_index);
-    *ele = *(queue->data + cur_head_index);
-
-    sw_atomic_fetch_sub(cur_head_flag_index, 3);
-    sw_atomic_fetch_sub(&queue->num, 1);
-    return 0;
+    return size;
 }
-#else
 
 int swRingQueue_init(swRingQueue *queue, int buffer_size)
 {
-    queue->data = sw_calloc(buffer_size, sizeof(void*));
-    if (queue->data == NULL)
+    uint32_t size = swRingQueue_capacity(buffer_size);
+    swRingQueue_cell *cells = sw_malloc(sizeof(swRingQueue_cell) * size);
+    if (cells == NULL)
     {
-        swWarn("malloc failed.");
-        return -1;
+        swWarn("malloc(%ld) failed.", sizeof(swRingQueue_cell) * size);
+        return SW_ERR;
     }
-    queue->size = buffer_size;
-    queue->head = 0;
-    queue->tail = 0;
-    queue->tag = 0;
-    return 0;
+    swRingQueue_reset(queue, size, cells);
+    queue->shared = 0;
+    queue->alloc = 0;
+    return SW_OK;
 }
 
-void swRingQueue_free(swRingQueue *queue)
+swRingQueue* swRingQueue_new(int buffer_size, int shared)
 {
-    sw_free(queue->data);
+    uint32_t size = swRingQueue_capacity(buffer_size);
+    size_t mem_size = sizeof(swRingQueue) + sizeof(swRingQueue_cell) * size;
+    swRingQueue *queue = shared ? sw_shm_malloc(mem_size) : sw_malloc(mem_size);
+    if (queue == NULL)
+    {
+        swWarn("malloc(%ld) failed.", mem_size);
+        return NULL;
+    }
+    swRingQueue_reset(queue, size, (swRingQueue_cell *) (queue + 1));
+    queue->shared = shared;
+    queue->alloc = 1;
+    return queue;
 }
 
-int swRingQueue_push(swRingQueue *queue, void *push_data)
+void swRingQueue_free(swRingQueue *queue)
 {
-    if (swRingQueue_full(queue))
+    if (!queue->alloc)
     {
-        return SW_ERR;
+        sw_free(queue->cells);
+    }
+    else if (queue->shared)
+    {
+        sw_shm_free(queue);
+    }
+    else
+    {
+        sw_free(queue);
     }
+}
 
-    queue->data[queue->tail] = push_data;
-    queue->tail = (queue->tail + 1) % queue->size;
+int swRingQueue_push(swRingQueue *queue, void *push_data)
+{
+    swRingQueue_cell *cell;
+    uint32_t pos = queue->tail;
+    uint32_t spin = 1;
+    int32_t diff;
 
-    if (queue->tail == queue->head)
+    while (1)
     {
-        queue->tag = 1;
+        cell = &queue->cells[pos & queue->mask];
+        diff = (int32_t) (__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0)
+        {
+            if (sw_atomic_cmp_set(&queue->tail, pos, pos + 1))
+            {
+                break;
+            }
+            swRingQueue_backoff(&spin);
+            pos = queue->tail;
+        }
+        else if (diff < 0)
+        {
+            //the consumer of the previous lap has not taken it yet
+            return SW_ERR;
+        }
+        else
+        {
+            pos = queue->tail;
+        }
     }
+    cell->data = push_data;
+    __atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
     return SW_OK;
 }
 
 int swRingQueue_pop(swRingQueue *queue, void **pop_data)
 {
-    if (swRingQueue_empty(queue))
-    {
-        return SW_ERR;
-    }
+    swRingQueue_cell *cell;
+    uint32_t pos = queue->head;
+    uint32_t spin = 1;
+    int32_t diff;
 
-    *pop_data = queue->data[queue->head];
-    queue->head = (queue->head + 1) % queue->size;
-
-    if (queue->tail == queue->head)
+    while (1)
     {
-        queue->tag = 0;
+        cell = &queue->cells[pos & queue->mask];
+        diff = (int32_t) (__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) - (pos + 1));
+        if (diff == 0)
+        {
+            if (sw_atomic_cmp_set(&queue->head, pos, pos + 1))
+            {
+                break;
+            }
+            swRingQueue_backoff(&spin);
+            pos = queue->head;
+        }
+        else if (diff < 0)
+        {
+            return SW_ERR;
+        }
+        else
+        {
+            pos = queue->head;
+        }
     }
+    *pop_data = cell->data;
+    __atomic_store_n(&cell->sequence, pos + queue->mask + 1, __ATOMIC_RELEASE);
     return SW_OK;
 }
-
-#endif
@@ -22,6 +22,15 @@
 #include <sys/ioctl.h>
 #include <limits.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define SW_MEMFIND_AVX2 1
+#endif
+
 #ifdef HAVE_EXECINFO
 #include <execinfo.h>
 #endif
@@ -896,6 +905,127 @@ char *swoole_kmp_strnstr(char *haystack, char *needle, uint32_t length)
     return match;
 }
 
+static int swoole_memfind_scalar(char *haystack, uint32_t length, char *needle, uint32_t needle_length)
+{
+    char *p = haystack;
+    char *end = haystack + length - needle_length + 1;
+
+    while (p < end)
+    {
+        p = memchr(p, needle[0], end - p);
+        if (p == NULL)
+        {
+            return -1;
+        }
+        if (memcmp(p + 1, needle + 1, needle_length - 1) == 0)
+        {
+            return p - haystack;
+        }
+        p++;
+    }
+    return -1;
+}
+
+#ifdef __SSE2__
+/**
+ * compare the first and the last byte of the needle against 16 positions at once,
+ * memcmp() is only called for the candidates where both match.
+ */
+static int swoole_memfind_sse2(char *haystack, uint32_t length, char *needle, uint32_t needle_length)
+{
+    __m128i first = _mm_set1_epi8(needle[0]);
+    __m128i last = _mm_set1_epi8(needle[needle_length - 1]);
+    uint32_t i = 0;
+    int n;
+
+    for (; i + needle_length - 1 + 16 <= length; i += 16)
+    {
+        __m128i block_first = _mm_loadu_si128((__m128i *) (haystack + i));
+        __m128i block_last = _mm_loadu_si128((__m128i *) (haystack + i + needle_length - 1));
+        uint32_t mask = _mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last)));
+        while (mask)
+        {
+            int bit = __builtin_ctz(mask);
+            if (memcmp(haystack + i + bit + 1, needle + 1, needle_length - 2) == 0)
+            {
+                return i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    n = swoole_memfind_scalar(haystack + i, length - i, needle, needle_length);
+    return n < 0 ? -1 : i + n;
+}
+#endif
+
+#ifdef SW_MEMFIND_AVX2
+__attribute__((target("avx2")))
+static int swoole_memfind_avx2(char *haystack, uint32_t length, char *needle, uint32_t needle_length)
+{
+    __m256i first = _mm256_set1_epi8(needle[0]);
+    __m256i last = _mm256_set1_epi8(needle[needle_length - 1]);
+    uint32_t i = 0;
+    int n;
+
+    for (; i + needle_length - 1 + 32 <= length; i += 32)
+    {
+        __m256i block_first = _mm256_loadu_si256((__m256i *) (haystack + i));
+        __m256i block_last = _mm256_loadu_si256((__m256i *) (haystack + i + needle_length - 1));
+        uint32_t mask = _mm256_movemask_epi8(
+                _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last)));
+        while (mask)
+        {
+            int bit = __builtin_ctz(mask);
+            if (memcmp(haystack + i + bit + 1, needle + 1, needle_length - 2) == 0)
+            {
+                return i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    n = swoole_memfind_scalar(haystack + i, length - i, needle, needle_length);
+    return n < 0 ? -1 : i + n;
+}
+#endif
+
+static int swoole_memfind_init(char *haystack, uint32_t length, char *needle, uint32_t needle_length);
+static int (*swoole_memfind_func)(char *, uint32_t, char *, uint32_t) = swoole_memfind_init;
+
+static int swoole_memfind_init(char *haystack, uint32_t length, char *needle, uint32_t needle_length)
+{
+#if defined(SW_MEMFIND_AVX2)
+    swoole_memfind_func = __builtin_cpu_supports("avx2") ? swoole_memfind_avx2 : swoole_memfind_sse2;
+#elif defined(__SSE2__)
+    swoole_memfind_func = swoole_memfind_sse2;
+#else
+    swoole_memfind_func = swoole_memfind_scalar;
+#endif
+    return swoole_memfind_func(haystack, length, needle, needle_length);
+}
+
+/**
+ * position of the first needle in haystack, -1 if not found
+ */
+int swoole_memfind(char *haystack, uint32_t length, char *needle, uint32_t needle_length)
+{
+    if (needle_length == 0 || length < needle_length)
+    {
+        return -1;
+    }
+    else if (needle_length == 1)
+    {
+        char *p = memchr(haystack, needle[0], length);
+        return p ? p - haystack : -1;
+    }
+    //short haystacks are not worth a vector setup
+    else if (length < 32)
+    {
+        return swoole_memfind_scalar(haystack, length, needle, needle_length);
+    }
+    return swoole_memfind_func(haystack, length, needle, needle_length);
+}
+
 /**
  * DNS lookup
  */
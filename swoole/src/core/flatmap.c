@@ -0,0 +1,487 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "swoole.h"
+#include "flatmap.h"
+#include "hash.h"
+
+#define swFlatMap_distance(hmap, pos, hash)   (((pos) - ((hash) & (hmap)->slot_mask)) & (hmap)->slot_mask)
+
+static sw_inline uint32_t swFlatMap_hash_int(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return (uint32_t) key;
+}
+
+static sw_inline void swFlatMap_key_int(swFlatMap_entry *key, uint64_t key_int)
+{
+    key->type = SW_FLATMAP_KEY_INT;
+    key->key_int = key_int;
+    key->key_str = NULL;
+    key->key_len = 0;
+    key->hash = swFlatMap_hash_int(key_int);
+}
+
+static sw_inline void swFlatMap_key_str(swFlatMap_entry *key, char *str, uint16_t len)
+{
+    key->key_int = 0;
+    key->key_len = len;
+    if (len < SW_FLATMAP_SHORT_KEY_LEN)
+    {
+        //the last byte stays 0, so &key_int is a C string
+        key->type = SW_FLATMAP_KEY_SHORT;
+        key->key_str = NULL;
+        memcpy(&key->key_int, str, len);
+        key->hash = swFlatMap_hash_int(key->key_int ^ ((uint64_t) len << 56));
+    }
+    else
+    {
+        key->type = SW_FLATMAP_KEY_STR;
+        key->key_str = str;
+        key->hash = swFlatMap_hash_int(swoole_hash_php(str, len));
+    }
+}
+
+static sw_inline int swFlatMap_key_equal(swFlatMap_entry *entry, swFlatMap_entry *key)
+{
+    if (entry->type != key->type || entry->key_int != key->key_int || entry->key_len != key->key_len)
+    {
+        return 0;
+    }
+    return key->type != SW_FLATMAP_KEY_STR || memcmp(entry->key_str, key->key_str, key->key_len) == 0;
+}
+
+static int swFlatMap_find_slot(swFlatMap *hmap, swFlatMap_entry *key)
+{
+    uint32_t pos = key->hash & hmap->slot_mask;
+    uint32_t dist = 0;
+    swFlatMap_slot *slot;
+
+    while (1)
+    {
+        slot = &hmap->slots[pos];
+        if (slot->index == 0 || swFlatMap_distance(hmap, pos, slot->hash) < dist)
+        {
+            return SW_ERR;
+        }
+        if (slot->hash == key->hash && swFlatMap_key_equal(&hmap->entries[slot->index - 1], key))
+        {
+            return pos;
+        }
+        pos = (pos + 1) & hmap->slot_mask;
+        dist++;
+    }
+}
+
+static void swFlatMap_insert_slot(swFlatMap *hmap, uint32_t index, uint32_t hash)
+{
+    swFlatMap_slot insert, tmp;
+    uint32_t pos = hash & hmap->slot_mask;
+    uint32_t dist = 0, slot_dist;
+
+    insert.index = index;
+    insert.hash = hash;
+
+    while (1)
+    {
+        swFlatMap_slot *slot = &hmap->slots[pos];
+        if (slot->index == 0)
+        {
+            *slot = insert;
+            return;
+        }
+        //robin hood: the entry closer to its home slot gives way
+        slot_dist = swFlatMap_distance(hmap, pos, slot->hash);
+        if (slot_dist < dist)
+        {
+            tmp = *slot;
+            *slot = insert;
+            insert = tmp;
+            dist = slot_dist;
+        }
+        pos = (pos + 1) & hmap->slot_mask;
+        dist++;
+    }
+}
+
+/**
+ * backward shift deletion, no tombstones in the slot array
+ */
+static void swFlatMap_remove_slot(swFlatMap *hmap, uint32_t pos)
+{
+    uint32_t next = (pos + 1) & hmap->slot_mask;
+
+    while (hmap->slots[next].index != 0 && swFlatMap_distance(hmap, next, hmap->slots[next].hash) != 0)
+    {
+        hmap->slots[pos] = hmap->slots[next];
+        pos = next;
+        next = (next + 1) & hmap->slot_mask;
+    }
+    hmap->slots[pos].index = 0;
+}
+
+static int swFlatMap_rehash(swFlatMap *hmap, uint32_t slot_num)
+{
+    swFlatMap_slot *slots = sw_calloc(slot_num, sizeof(swFlatMap_slot));
+    uint32_t i;
+
+    if (slots == NULL)
+    {
+        swWarn("calloc(%d) failed.", (int) (slot_num * sizeof(swFlatMap_slot)));
+        return SW_ERR;
+    }
+    sw_free(hmap->slots);
+    hmap->slots = slots;
+    hmap->slot_mask = slot_num - 1;
+
+    for (i = 0; i < hmap->entry_used; i++)
+    {
+        if (!hmap->entries[i].removed)
+        {
+            swFlatMap_insert_slot(hmap, i + 1, hmap->entries[i].hash);
+        }
+    }
+    return SW_OK;
+}
+
+static swFlatMap_entry* swFlatMap_append(swFlatMap *hmap, swFlatMap_entry *key)
+{
+    swFlatMap_entry *entry;
+    uint32_t i, j;
+
+    if (hmap->entry_used == hmap->entry_size)
+    {
+        //a quarter of the entries are removed, compact instead of growing
+        if (hmap->entry_used - hmap->num >= hmap->entry_size / 4)
+        {
+            for (i = 0, j = 0; i < hmap->entry_used; i++)
+            {
+                if (!hmap->entries[i].removed)
+                {
+                    hmap->entries[j++] = hmap->entries[i];
+                }
+            }
+            hmap->entry_used = j;
+            hmap->iterator = 0;
+            if (swFlatMap_rehash(hmap, hmap->slot_mask + 1) < 0)
+            {
+                return NULL;
+            }
+        }
+        else
+        {
+            uint32_t entry_size = hmap->entry_size * 2;
+            swFlatMap_entry *entries = sw_realloc(hmap->entries, entry_size * sizeof(swFlatMap_entry));
+            if (entries == NULL)
+            {
+                swWarn("realloc(%d) failed.", (int) (entry_size * sizeof(swFlatMap_entry)));
+                return NULL;
+            }
+            hmap->entries = entries;
+            hmap->entry_size = entry_size;
+            //keep the load factor of the slot array under 0.5
+            if (swFlatMap_rehash(hmap, entry_size * 2) < 0)
+            {
+                return NULL;
+            }
+        }
+    }
+
+    entry = &hmap->entries[hmap->entry_used++];
+    *entry = *key;
+    entry->removed = 0;
+    swFlatMap_insert_slot(hmap, hmap->entry_used, entry->hash);
+    hmap->num++;
+    return entry;
+}
+
+static void swFlatMap_remove(swFlatMap *hmap, uint32_t pos, int free_data)
+{
+    swFlatMap_entry *entry = &hmap->entries[hmap->slots[pos].index - 1];
+
+    swFlatMap_remove_slot(hmap, pos);
+    if (free_data && hmap->dtor)
+    {
+        hmap->dtor(entry->data);
+    }
+    if (entry->type == SW_FLATMAP_KEY_STR)
+    {
+        sw_free(entry->key_str);
+    }
+    entry->removed = 1;
+    hmap->num--;
+
+    //the map is empty and not being iterated, reuse the entry array from the head
+    if (hmap->num == 0 && hmap->iterator == 0)
+    {
+        hmap->entry_used = 0;
+    }
+}
+
+swFlatMap* swFlatMap_new(uint32_t bucket_num, swFlatMap_dtor dtor)
+{
+    uint32_t entry_size = 8;
+
+    swFlatMap *hmap = sw_malloc(sizeof(swFlatMap));
+    if (!hmap)
+    {
+        swWarn("malloc[1] failed.");
+        return NULL;
+    }
+    bzero(hmap, sizeof(swFlatMap));
+
+    while (entry_size < bucket_num)
+    {
+        entry_size <<= 1;
+    }
+    hmap->entries = sw_malloc(entry_size * sizeof(swFlatMap_entry));
+    if (!hmap->entries)
+    {
+        swWarn("malloc[2] failed.");
+        sw_free(hmap);
+        return NULL;
+    }
+    hmap->entry_size = entry_size;
+    if (swFlatMap_rehash(hmap, entry_size * 2) < 0)
+    {
+        sw_free(hmap->entries);
+        sw_free(hmap);
+        return NULL;
+    }
+    hmap->dtor = dtor;
+    return hmap;
+}
+
+int swFlatMap_add(swFlatMap *hmap, char *key, uint16_t key_len, void *data)
+{
+    swFlatMap_entry _key;
+    swFlatMap_key_str(&_key, key, key_len);
+    if (_key.type == SW_FLATMAP_KEY_STR)
+    {
+        _key.key_str = strndup(key, key_len);
+        if (_key.key_str == NULL)
+        {
+            swWarn("strndup() failed.");
+            return SW_ERR;
+        }
+    }
+    _key.data = data;
+    if (swFlatMap_append(hmap, &_key) == NULL)
+    {
+        if (_key.type == SW_FLATMAP_KEY_STR)
+        {
+            sw_free(_key.key_str);
+        }
+        return SW_ERR;
+    }
+    return SW_OK;
+}
+
+void swFlatMap_add_int(swFlatMap *hmap, uint64_t key, void *data)
+{
+    swFlatMap_entry _key;
+    swFlatMap_key_int(&_key, key);
+    _key.data = data;
+    swFlatMap_append(hmap, &_key);
+}
+
+void* swFlatMap_find(swFlatMap *hmap, char *key, uint16_t key_len)
+{
+    swFlatMap_entry _key;
+    swFlatMap_key_str(&_key, key, key_len);
+    int pos = swFlatMap_find_slot(hmap, &_key);
+    if (pos < 0)
+    {
+        return NULL;
+    }
+    return hmap->entries[hmap->slots[pos].index - 1].data;
+}
+
+void* swFlatMap_find_int(swFlatMap *hmap, uint64_t key)
+{
+    swFlatMap_entry _key;
+    swFlatMap_key_int(&_key, key);
+    int pos = swFlatMap_find_slot(hmap, &_key);
+    if (pos < 0)
+    {
+        return NULL;
+    }
+    return hmap->entries[hmap->slots[pos].index - 1].data;
+}
+
+int swFlatMap_update(swFlatMap *hmap, char *key, uint16_t key_len, void *data)
+{
+    swFlatMap_entry _key;
+    swFlatMap_key_str(&_key, key, key_len);
+    int pos = swFlatMap_find_slot(hmap, &_key);
+    if (pos < 0)
+    {
+        return SW_ERR;
+    }
+    swFlatMap_entry *entry = &hmap->entries[hmap->slots[pos].index - 1];
+    if (hmap->dtor)
+    {
+        hmap->dtor(entry->data);
+    }
+    entry->data = data;
+    return SW_OK;
+}
+
+void swFlatMap_update_int(swFlatMap *hmap, uint64_t key, void *data)
+{
+    swFlatMap_entry _key;
+    swFlatMap_key_int(&_key, key);
+    int pos = swFlatMap_find_slot(hmap, &_key);
+    if (pos < 0)
+    {
+        return;
+    }
+    swFlatMap_entry *entry = &hmap->entries[hmap->slots[pos].index - 1];
+    if (hmap->dtor)
+    {
+        hmap->dtor(entry->data);
+    }
+    entry->data = data;
+}
+
+int swFlatMap_del(swFlatMap *hmap, char *key, uint16_t key_len)
+{
+    swFlatMap_entry _key;
+    swFlatMap_key_str(&_key, key, key_len);
+    int pos = swFlatMap_find_slot(hmap, &_key);
+    if (pos < 0)
+    {
+        return SW_ERR;
+    }
+    swFlatMap_remove(hmap, pos, 1);
+    return SW_OK;
+}
+
+int swFlatMap_del_int(swFlatMap *hmap, uint64_t key)
+{
+    swFlatMap_entry _key;
+    swFlatMap_key_int(&_key, key);
+    int pos = swFlatMap_find_slot(hmap, &_key);
+    if (pos < 0)
+    {
+        return SW_ERR;
+    }
+    swFlatMap_remove(hmap, pos, 1);
+    return SW_OK;
+}
+
+int swFlatMap_move(swFlatMap *hmap, char *old_key, uint16_t old_key_len, char *new_key, uint16_t new_key_len)
+{
+    swFlatMap_entry _key;
+    swFlatMap_key_str(&_key, old_key, old_key_len);
+    int pos = swFlatMap_find_slot(hmap, &_key);
+    if (pos < 0)
+    {
+        return SW_ERR;
+    }
+    void *data = hmap->entries[hmap->slots[pos].index - 1].data;
+    swFlatMap_remove(hmap, pos, 0);
+    return swFlatMap_add(hmap, new_key, new_key_len, data);
+}
+
+int swFlatMap_move_int(swFlatMap *hmap, uint64_t old_key, uint64_t new_key)
+{
+    swFlatMap_entry _key;
+    swFlatMap_key_int(&_key, old_key);
+    int pos = swFlatMap_find_slot(hmap, &_key);
+    if (pos < 0)
+    {
+        return SW_ERR;
+    }
+    void *data = hmap->entries[hmap->slots[pos].index - 1].data;
+    swFlatMap_remove(hmap, pos, 0);
+    swFlatMap_add_int(hmap, new_key, data);
+    return SW_OK;
+}
+
+static sw_inline swFlatMap_entry* swFlatMap_entry_each(swFlatMap *hmap)
+{
+    swFlatMap_entry *entry;
+
+    while (hmap->iterator < hmap->entry_used)
+    {
+        entry = &hmap->entries[hmap->iterator++];
+        if (!entry->removed)
+        {
+            return entry;
+        }
+    }
+    hmap->iterator = 0;
+    return NULL;
+}
+
+void* swFlatMap_each(swFlatMap* hmap, char **key)
+{
+    swFlatMap_entry *entry = swFlatMap_entry_each(hmap);
+    if (entry)
+    {
+        *key = entry->type == SW_FLATMAP_KEY_STR ? entry->key_str : (char *) &entry->key_int;
+        return entry->data;
+    }
+    else
+    {
+        return NULL;
+    }
+}
+
+void* swFlatMap_each_int(swFlatMap* hmap, uint64_t *key)
+{
+    swFlatMap_entry *entry = swFlatMap_entry_each(hmap);
+    if (entry)
+    {
+        *key = entry->key_int;
+        return entry->data;
+    }
+    else
+    {
+        return NULL;
+    }
+}
+
+void swFlatMap_free(swFlatMap *hmap)
+{
+    uint32_t i;
+    swFlatMap_entry *entry;
+
+    for (i = 0; i < hmap->entry_used; i++)
+    {
+        entry = &hmap->entries[i];
+        if (entry->removed)
+        {
+            continue;
+        }
+        if (hmap->dtor)
+        {
+            hmap->dtor(entry->data);
+        }
+        if (entry->type == SW_FLATMAP_KEY_STR)
+        {
+            sw_free(entry->key_str);
+        }
+    }
+    sw_free(hmap->slots);
+    sw_free(hmap->entries);
+    sw_free(hmap);
+}
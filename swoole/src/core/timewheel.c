@@ -0,0 +1,281 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "swoole.h"
+#include "timewheel.h"
+
+#define swTimeWheel_level_shift(level)   (SW_TIMEWHEEL_ROOT_BITS + ((level) - 1) * SW_TIMEWHEEL_LEVEL_BITS)
+#define swTimeWheel_level_slot(level, i) (SW_TIMEWHEEL_ROOT_SIZE + ((level) - 1) * SW_TIMEWHEEL_LEVEL_SIZE + (i))
+
+static sw_inline void swTimeWheel_list_init(swTimeWheel_node *head)
+{
+    head->prev = head->next = head;
+}
+
+static sw_inline void swTimeWheel_list_append(swTimeWheel_node *head, swTimeWheel_node *node)
+{
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+/**
+ * move all nodes of the slot to an empty list
+ */
+static sw_inline void swTimeWheel_list_splice(swTimeWheel_node *head, swTimeWheel_node *to)
+{
+    if (head->next == head)
+    {
+        swTimeWheel_list_init(to);
+        return;
+    }
+    to->next = head->next;
+    to->prev = head->prev;
+    to->next->prev = to;
+    to->prev->next = to;
+    swTimeWheel_list_init(head);
+}
+
+static void swTimeWheel_place(swTimeWheel *wheel, swTimeWheel_node *node)
+{
+    uint64_t expire = node->expire;
+    uint64_t delta;
+    uint32_t slot;
+    int level;
+
+    if (expire < wheel->current)
+    {
+        expire = wheel->current;
+    }
+    delta = expire - wheel->current;
+    //beyond the last level, park it in the farthest slot and place it again when that slot cascades
+    if (delta >= SW_TIMEWHEEL_MAX_TICKS)
+    {
+        expire = wheel->current + SW_TIMEWHEEL_MAX_TICKS - 1;
+        delta = SW_TIMEWHEEL_MAX_TICKS - 1;
+    }
+
+    if (delta < SW_TIMEWHEEL_ROOT_SIZE)
+    {
+        slot = expire & (SW_TIMEWHEEL_ROOT_SIZE - 1);
+    }
+    else
+    {
+        for (level = 1; level < SW_TIMEWHEEL_LEVEL_NUM - 1; level++)
+        {
+            if (delta < (1ULL << swTimeWheel_level_shift(level + 1)))
+            {
+                break;
+            }
+        }
+        slot = swTimeWheel_level_slot(level,
+                (expire >> swTimeWheel_level_shift(level)) & (SW_TIMEWHEEL_LEVEL_SIZE - 1));
+    }
+    swTimeWheel_list_append(&wheel->slots[slot], node);
+}
+
+/**
+ * redistribute one slot of a higher level into the lower levels
+ */
+static uint32_t swTimeWheel_cascade(swTimeWheel *wheel, int level)
+{
+    uint32_t index = (wheel->current >> swTimeWheel_level_shift(level)) & (SW_TIMEWHEEL_LEVEL_SIZE - 1);
+    swTimeWheel_node list, *node;
+
+    swTimeWheel_list_splice(&wheel->slots[swTimeWheel_level_slot(level, index)], &list);
+    while (list.next != &list)
+    {
+        node = list.next;
+        list.next = node->next;
+        node->next->prev = &list;
+        swTimeWheel_place(wheel, node);
+    }
+    return index;
+}
+
+swTimeWheel* swTimeWheel_new(uint32_t tick_msec, int64_t now_msec)
+{
+    swTimeWheel *wheel = sw_malloc(sizeof(swTimeWheel));
+    if (!wheel)
+    {
+        swWarn("malloc(%ld) failed.", sizeof(swTimeWheel));
+        return NULL;
+    }
+    swTimeWheel_init(wheel, tick_msec, now_msec);
+    return wheel;
+}
+
+/**
+ * for a wheel embedded in another object, e.g. in shared memory
+ */
+void swTimeWheel_init(swTimeWheel *wheel, uint32_t tick_msec, int64_t now_msec)
+{
+    int i;
+    wheel->tick_msec = tick_msec > 0 ? tick_msec : 1;
+    wheel->current = now_msec / wheel->tick_msec;
+    wheel->num = 0;
+    wheel->ptr = NULL;
+    for (i = 0; i < SW_TIMEWHEEL_SLOT_NUM; i++)
+    {
+        swTimeWheel_list_init(&wheel->slots[i]);
+    }
+}
+
+void swTimeWheel_free(swTimeWheel *wheel)
+{
+    sw_free(wheel);
+}
+
+void swTimeWheel_add(swTimeWheel *wheel, swTimeWheel_node *node, int64_t exec_msec)
+{
+    swTimeWheel_del(wheel, node);
+    node->expire = exec_msec < 0 ? 0 : exec_msec / wheel->tick_msec;
+    swTimeWheel_place(wheel, node);
+    wheel->num++;
+}
+
+/**
+ * run all timers expired at now_msec, the handler may add or delete timers
+ * @return the number of expired timers
+ */
+int swTimeWheel_expire(swTimeWheel *wheel, int64_t now_msec, swTimeWheel_handler handler)
+{
+    uint64_t now = now_msec / wheel->tick_msec;
+    swTimeWheel_node list, *node;
+    uint32_t index;
+    int level, n = 0;
+
+    while (wheel->current <= now)
+    {
+        //nothing to cascade or run, jump to now
+        if (wheel->num == 0)
+        {
+            wheel->current = now + 1;
+            break;
+        }
+        index = wheel->current & (SW_TIMEWHEEL_ROOT_SIZE - 1);
+        if (index == 0)
+        {
+            for (level = 1; level < SW_TIMEWHEEL_LEVEL_NUM; level++)
+            {
+                if (swTimeWheel_cascade(wheel, level) != 0)
+                {
+                    break;
+                }
+            }
+        }
+        swTimeWheel_list_splice(&wheel->slots[index], &list);
+        //timers added by the handler go to the next tick at the earliest
+        wheel->current++;
+
+        while (list.next != &list)
+        {
+            node = list.next;
+            swTimeWheel_del(wheel, node);
+            handler(wheel, node);
+            n++;
+        }
+    }
+    return n;
+}
+
+/**
+ * call the handler for the timers expired at now_msec without running or moving them,
+ * only the slots that may hold them are visited. the handler must not add or delete timers.
+ * @return the number of expired timers
+ */
+int swTimeWheel_peek(swTimeWheel *wheel, int64_t now_msec, swTimeWheel_handler handler)
+{
+    uint64_t now = now_msec / wheel->tick_msec;
+    uint64_t tick, from, to;
+    swTimeWheel_node *head, *node;
+    uint32_t i, count;
+    int level, n = 0;
+
+    if (wheel->num == 0)
+    {
+        return 0;
+    }
+    for (level = 0; level < SW_TIMEWHEEL_LEVEL_NUM; level++)
+    {
+        if (level == 0)
+        {
+            from = wheel->current;
+            to = now;
+            count = SW_TIMEWHEEL_ROOT_SIZE;
+        }
+        else
+        {
+            from = wheel->current >> swTimeWheel_level_shift(level);
+            to = now >> swTimeWheel_level_shift(level);
+            count = SW_TIMEWHEEL_LEVEL_SIZE;
+        }
+        //timers placed before current are in the slot of current
+        if (to < from)
+        {
+            to = from;
+        }
+        if (to - from >= count)
+        {
+            to = from + count - 1;
+        }
+        for (tick = from; tick <= to; tick++)
+        {
+            i = tick & (count - 1);
+            head = level == 0 ? &wheel->slots[i] : &wheel->slots[swTimeWheel_level_slot(level, i)];
+            for (node = head->next; node != head; node = node->next)
+            {
+                if (node->expire <= now)
+                {
+                    handler(wheel, node);
+                    n++;
+                }
+            }
+        }
+    }
+    return n;
+}
+
+/**
+ * the earliest time a timer may expire, -1 if there is none.
+ * only the root level is scanned, beyond it the time of the next cascade is returned.
+ */
+int64_t swTimeWheel_next_msec(swTimeWheel *wheel)
+{
+    uint64_t tick = wheel->current;
+    swTimeWheel_node *head;
+
+    if (wheel->num == 0)
+    {
+        return -1;
+    }
+    //stop at the next cascade, it may bring timers down to the root level
+    if ((tick & (SW_TIMEWHEEL_ROOT_SIZE - 1)) == 0)
+    {
+        return tick * wheel->tick_msec;
+    }
+    do
+    {
+        head = &wheel->slots[tick & (SW_TIMEWHEEL_ROOT_SIZE - 1)];
+        if (head->next != head)
+        {
+            break;
+        }
+        tick++;
+    } while ((tick & (SW_TIMEWHEEL_ROOT_SIZE - 1)) != 0);
+    return tick * wheel->tick_msec;
+}
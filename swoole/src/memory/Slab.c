@@ -0,0 +1,580 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "swoole.h"
+
+/**
+ * The memory is cut into 64K pages. A page is either carved into objects of one size class
+ * (16 byte to 16K, two classes per power of two) or belongs to a run of pages for a larger block.
+ * Every thread keeps a small stack of free objects per class, the global lock is only taken to
+ * refill or drain that stack in batches and for large blocks. The free lists live in the shared
+ * memory, so a block may be freed by any process.
+ */
+#define SW_SLAB_PAGE_SHIFT      16
+#define SW_SLAB_PAGE_SIZE       (1 << SW_SLAB_PAGE_SHIFT)
+#define SW_SLAB_CLASS_NUM       20
+#define SW_SLAB_MAX_SMALL       16384
+#define SW_SLAB_CACHE_SIZE      64
+#define SW_SLAB_POOL_MAX        16
+
+enum swSlab_page_type
+{
+    SW_SLAB_PAGE_UNUSED = 0,
+    SW_SLAB_PAGE_SMALL,
+    SW_SLAB_PAGE_LARGE,
+    SW_SLAB_PAGE_FREE,
+};
+
+typedef struct _swSlab_page
+{
+    uint8_t type;
+    uint8_t class_id;
+    /**
+     * length of the run, set on the first and the last page of a large or free run
+     */
+    uint32_t pages;
+} swSlab_page;
+
+/**
+ * header of a free run, stored in its first page
+ */
+typedef struct _swSlab_run
+{
+    struct _swSlab_run *prev;
+    struct _swSlab_run *next;
+} swSlab_run;
+
+typedef struct _swSlab_class
+{
+    void *free_list;
+    uint32_t free_num;
+    uint32_t size;
+} swSlab_class;
+
+typedef struct _swSlab
+{
+    sw_atomic_t lock;
+    uint8_t shared;
+    uint8_t id;
+    pthread_key_t cache_key;
+
+    char *memory;
+    uint32_t page_num;
+    /**
+     * pages below this index have been handed out at least once
+     */
+    uint32_t page_top;
+    swSlab_page *pages;
+    swSlab_run *free_runs;
+
+    swSlab_class classes[SW_SLAB_CLASS_NUM];
+
+    /**
+     * statistics
+     */
+    uint64_t alloc_bytes;
+} swSlab;
+
+typedef struct _swSlab_cache
+{
+    swMemoryPool *pool;
+    uint16_t count[SW_SLAB_CLASS_NUM];
+    void *objects[SW_SLAB_CLASS_NUM][SW_SLAB_CACHE_SIZE];
+} swSlab_cache;
+
+static void* swSlab_alloc(swMemoryPool *pool, uint32_t size);
+static void swSlab_free(swMemoryPool *pool, void *ptr);
+static void swSlab_destroy(swMemoryPool *pool);
+static void swSlab_cache_free(void *cache);
+
+/**
+ * pools of this process, their thread caches are dropped in a child after fork
+ */
+static swMemoryPool *swSlab_pools[SW_SLAB_POOL_MAX];
+static int swSlab_atfork_installed = 0;
+
+static sw_inline int swSlab_class_index(uint32_t size)
+{
+    int bit;
+    if (size <= 64)
+    {
+        return size <= 16 ? 0 : (size + 15) / 16 - 1;
+    }
+    //2^bit < size <= 2^(bit+1), two classes: 1.5 * 2^bit and 2^(bit+1)
+    bit = 31 - __builtin_clz(size - 1);
+    return 4 + (bit - 6) * 2 + (size > (3u << (bit - 1)));
+}
+
+static sw_inline uint32_t swSlab_class_size(int index)
+{
+    if (index < 4)
+    {
+        return (index + 1) * 16;
+    }
+    index -= 4;
+    return (index & 1) ? (128u << (index / 2)) : (96u << (index / 2));
+}
+
+static sw_inline swSlab_page* swSlab_get_page(swSlab *slab, void *ptr)
+{
+    return &slab->pages[((char *) ptr - slab->memory) >> SW_SLAB_PAGE_SHIFT];
+}
+
+static sw_inline void* swSlab_page_addr(swSlab *slab, uint32_t index)
+{
+    return slab->memory + ((size_t) index << SW_SLAB_PAGE_SHIFT);
+}
+
+static sw_inline uint32_t swSlab_page_index(swSlab *slab, void *ptr)
+{
+    return ((char *) ptr - slab->memory) >> SW_SLAB_PAGE_SHIFT;
+}
+
+static void swSlab_child_atfork(void)
+{
+    int i;
+    swSlab *slab;
+    void *cache;
+
+    for (i = 0; i < SW_SLAB_POOL_MAX; i++)
+    {
+        if (swSlab_pools[i] == NULL)
+        {
+            continue;
+        }
+        slab = swSlab_pools[i]->object;
+        cache = pthread_getspecific(slab->cache_key);
+        //the objects cached by the parent thread still belong to the parent
+        if (cache)
+        {
+            pthread_setspecific(slab->cache_key, NULL);
+            sw_free(cache);
+        }
+    }
+}
+
+swMemoryPool* swSlab_new(size_t size, uint8_t shared)
+{
+    size_t page_num = size >> SW_SLAB_PAGE_SHIFT;
+    size_t header_size = sizeof(swMemoryPool) + sizeof(swSlab) + sizeof(swSlab_page) * page_num;
+    size_t mem_size;
+    swMemoryPool *pool;
+    swSlab *slab;
+    char *mem;
+    int i, id = -1;
+
+    for (i = 0; i < SW_SLAB_POOL_MAX; i++)
+    {
+        if (swSlab_pools[i] == NULL)
+        {
+            id = i;
+            break;
+        }
+    }
+    if (id < 0 || page_num == 0 || page_num > 0xffffffffu)
+    {
+        swWarn("cannot create the slab pool, size=%ld.", size);
+        return NULL;
+    }
+
+    header_size = (header_size + SW_CACHELINE_SIZE - 1) & ~((size_t) SW_CACHELINE_SIZE - 1);
+    mem_size = header_size + (page_num << SW_SLAB_PAGE_SHIFT);
+    if (shared)
+    {
+        mem = sw_shm_malloc(mem_size);
+    }
+    else
+    {
+        mem = sw_malloc(mem_size);
+    }
+    if (mem == NULL)
+    {
+        swWarn("malloc(%ld) failed.", mem_size);
+        return NULL;
+    }
+
+    pool = (swMemoryPool *) mem;
+    slab = (swSlab *) (pool + 1);
+    bzero(slab, sizeof(swSlab));
+    slab->shared = shared;
+    slab->id = id;
+    slab->page_num = page_num;
+    slab->pages = (swSlab_page *) (slab + 1);
+    bzero(slab->pages, sizeof(swSlab_page) * page_num);
+    //the pages are only touched when they are used
+    slab->memory = mem + header_size;
+    for (i = 0; i < SW_SLAB_CLASS_NUM; i++)
+    {
+        slab->classes[i].size = swSlab_class_size(i);
+    }
+    if (pthread_key_create(&slab->cache_key, swSlab_cache_free) != 0)
+    {
+        swWarn("pthread_key_create() failed.");
+        if (shared)
+        {
+            sw_shm_free(mem);
+        }
+        else
+        {
+            sw_free(mem);
+        }
+        return NULL;
+    }
+
+    pool->object = slab;
+    pool->alloc = swSlab_alloc;
+    pool->free = swSlab_free;
+    pool->destroy = swSlab_destroy;
+
+    swSlab_pools[id] = pool;
+    if (!swSlab_atfork_installed)
+    {
+        pthread_atfork(NULL, NULL, swSlab_child_atfork);
+        swSlab_atfork_installed = 1;
+    }
+    return pool;
+}
+
+static sw_inline void swSlab_run_unlink(swSlab *slab, swSlab_run *run)
+{
+    if (run->prev)
+    {
+        run->prev->next = run->next;
+    }
+    else
+    {
+        slab->free_runs = run->next;
+    }
+    if (run->next)
+    {
+        run->next->prev = run->prev;
+    }
+}
+
+static sw_inline void swSlab_run_mark(swSlab *slab, uint32_t index, uint32_t pages, uint8_t type)
+{
+    slab->pages[index].type = type;
+    slab->pages[index].pages = pages;
+    slab->pages[index + pages - 1].type = type;
+    slab->pages[index + pages - 1].pages = pages;
+}
+
+/**
+ * first fit in the free runs, then the untouched pages. lock held.
+ */
+static uint32_t swSlab_page_alloc(swSlab *slab, uint32_t pages)
+{
+    swSlab_run *run;
+    uint32_t index, run_pages;
+
+    for (run = slab->free_runs; run; run = run->next)
+    {
+        index = swSlab_page_index(slab, run);
+        run_pages = slab->pages[index].pages;
+        if (run_pages < pages)
+        {
+            continue;
+        }
+        swSlab_run_unlink(slab, run);
+        if (run_pages > pages)
+        {
+            //the tail stays free
+            swSlab_run *rest = swSlab_page_addr(slab, index + pages);
+            swSlab_run_mark(slab, index + pages, run_pages - pages, SW_SLAB_PAGE_FREE);
+            rest->prev = NULL;
+            rest->next = slab->free_runs;
+            if (slab->free_runs)
+            {
+                slab->free_runs->prev = rest;
+            }
+            slab->free_runs = rest;
+        }
+        return index;
+    }
+    if (slab->page_num - slab->page_top < pages)
+    {
+        return (uint32_t) -1;
+    }
+    index = slab->page_top;
+    slab->page_top += pages;
+    return index;
+}
+
+/**
+ * merge with free neighbours and put the run back. lock held.
+ */
+static void swSlab_page_free(swSlab *slab, uint32_t index, uint32_t pages)
+{
+    swSlab_run *run;
+    uint32_t n;
+
+    //next run
+    if (index + pages < slab->page_top && slab->pages[index + pages].type == SW_SLAB_PAGE_FREE)
+    {
+        n = slab->pages[index + pages].pages;
+        swSlab_run_unlink(slab, swSlab_page_addr(slab, index + pages));
+        slab->pages[index + pages].type = SW_SLAB_PAGE_UNUSED;
+        pages += n;
+    }
+    //previous run, found by the tag on its last page
+    if (index > 0 && slab->pages[index - 1].type == SW_SLAB_PAGE_FREE)
+    {
+        n = slab->pages[index - 1].pages;
+        swSlab_run_unlink(slab, swSlab_page_addr(slab, index - n));
+        slab->pages[index - 1].type = SW_SLAB_PAGE_UNUSED;
+        index -= n;
+        pages += n;
+    }
+    //give the pages at the top back to the bump allocator
+    if (index + pages == slab->page_top)
+    {
+        slab->page_top = index;
+        slab->pages[index].type = SW_SLAB_PAGE_UNUSED;
+        slab->pages[index + pages - 1].type = SW_SLAB_PAGE_UNUSED;
+        return;
+    }
+    swSlab_run_mark(slab, index, pages, SW_SLAB_PAGE_FREE);
+    run = swSlab_page_addr(slab, index);
+    run->prev = NULL;
+    run->next = slab->free_runs;
+    if (slab->free_runs)
+    {
+        slab->free_runs->prev = run;
+    }
+    slab->free_runs = run;
+}
+
+static swSlab_cache* swSlab_get_cache(swMemoryPool *pool, swSlab *slab)
+{
+    swSlab_cache *cache = pthread_getspecific(slab->cache_key);
+    if (cache == NULL)
+    {
+        cache = sw_malloc(sizeof(swSlab_cache));
+        if (cache == NULL)
+        {
+            return NULL;
+        }
+        cache->pool = pool;
+        bzero(cache->count, sizeof(cache->count));
+        pthread_setspecific(slab->cache_key, cache);
+    }
+    return cache;
+}
+
+/**
+ * move half a stack of objects from the global list, carve a new page when it is empty
+ */
+static int swSlab_refill(swSlab *slab, swSlab_cache *cache, int class_id)
+{
+    swSlab_class *sc = &slab->classes[class_id];
+    uint32_t index, i, n;
+    char *obj;
+    void **stack = cache->objects[class_id];
+    int count = cache->count[class_id];
+
+    sw_spinlock(&slab->lock);
+    if (sc->free_list == NULL)
+    {
+        index = swSlab_page_alloc(slab, 1);
+        if (index == (uint32_t) -1)
+        {
+            sw_spinlock_release(&slab->lock);
+            return SW_ERR;
+        }
+        slab->pages[index].type = SW_SLAB_PAGE_SMALL;
+        slab->pages[index].class_id = class_id;
+        slab->pages[index].pages = 1;
+        n = SW_SLAB_PAGE_SIZE / sc->size;
+        obj = swSlab_page_addr(slab, index);
+        //link from the end, the list is popped from the start of the page
+        for (i = n; i > 0; i--)
+        {
+            *(void **) (obj + (i - 1) * sc->size) = sc->free_list;
+            sc->free_list = obj + (i - 1) * sc->size;
+        }
+        sc->free_num += n;
+    }
+    while (sc->free_list && count < SW_SLAB_CACHE_SIZE / 2)
+    {
+        stack[count++] = sc->free_list;
+        sc->free_list = *(void **) sc->free_list;
+        sc->free_num--;
+    }
+    sw_spinlock_release(&slab->lock);
+    cache->count[class_id] = count;
+    return SW_OK;
+}
+
+/**
+ * give the older half of a full stack back to the global list
+ */
+static void swSlab_drain(swSlab *slab, swSlab_cache *cache, int class_id, int n)
+{
+    swSlab_class *sc = &slab->classes[class_id];
+    void **stack = cache->objects[class_id];
+    int i;
+
+    if (n == 0)
+    {
+        return;
+    }
+    //chain them before taking the lock
+    for (i = 0; i < n - 1; i++)
+    {
+        *(void **) stack[i] = stack[i + 1];
+    }
+    sw_spinlock(&slab->lock);
+    *(void **) stack[n - 1] = sc->free_list;
+    sc->free_list = stack[0];
+    sc->free_num += n;
+    sw_spinlock_release(&slab->lock);
+
+    cache->count[class_id] -= n;
+    memmove(stack, stack + n, sizeof(void *) * cache->count[class_id]);
+}
+
+static void swSlab_cache_free(void *ptr)
+{
+    swSlab_cache *cache = ptr;
+    swSlab *slab = cache->pool->object;
+    int i;
+
+    for (i = 0; i < SW_SLAB_CLASS_NUM; i++)
+    {
+        swSlab_drain(slab, cache, i, cache->count[i]);
+    }
+    sw_free(cache);
+}
+
+/**
+ * give the objects cached by the calling thread back to the free lists of every pool,
+ * the pthread key destructor does not run when the process calls exit()
+ */
+void swSlab_flush(void)
+{
+    int i;
+    swSlab *slab;
+    void *cache;
+
+    for (i = 0; i < SW_SLAB_POOL_MAX; i++)
+    {
+        if (swSlab_pools[i] == NULL)
+        {
+            continue;
+        }
+        slab = swSlab_pools[i]->object;
+        cache = pthread_getspecific(slab->cache_key);
+        if (cache)
+        {
+            pthread_setspecific(slab->cache_key, NULL);
+            swSlab_cache_free(cache);
+        }
+    }
+}
+
+static void* swSlab_alloc(swMemoryPool *pool, uint32_t size)
+{
+    swSlab *slab = pool->object;
+    swSlab_cache *cache;
+    uint32_t index, pages;
+    int class_id;
+
+    if (size <= SW_SLAB_MAX_SMALL)
+    {
+        class_id = swSlab_class_index(size);
+        cache = swSlab_get_cache(pool, slab);
+        if (cache == NULL)
+        {
+            return NULL;
+        }
+        if (cache->count[class_id] == 0 && swSlab_refill(slab, cache, class_id) < 0)
+        {
+            return NULL;
+        }
+        return cache->objects[class_id][--cache->count[class_id]];
+    }
+
+    pages = (size + SW_SLAB_PAGE_SIZE - 1) >> SW_SLAB_PAGE_SHIFT;
+    sw_spinlock(&slab->lock);
+    index = swSlab_page_alloc(slab, pages);
+    if (index == (uint32_t) -1)
+    {
+        sw_spinlock_release(&slab->lock);
+        return NULL;
+    }
+    swSlab_run_mark(slab, index, pages, SW_SLAB_PAGE_LARGE);
+    slab->alloc_bytes += (uint64_t) pages << SW_SLAB_PAGE_SHIFT;
+    sw_spinlock_release(&slab->lock);
+    return swSlab_page_addr(slab, index);
+}
+
+static void swSlab_free(swMemoryPool *pool, void *ptr)
+{
+    swSlab *slab = pool->object;
+    swSlab_page *page = swSlab_get_page(slab, ptr);
+    swSlab_cache *cache;
+    int class_id;
+
+    if (page->type == SW_SLAB_PAGE_SMALL)
+    {
+        class_id = page->class_id;
+        cache = swSlab_get_cache(pool, slab);
+        if (cache == NULL)
+        {
+            return;
+        }
+        if (cache->count[class_id] == SW_SLAB_CACHE_SIZE)
+        {
+            swSlab_drain(slab, cache, class_id, SW_SLAB_CACHE_SIZE / 2);
+        }
+        cache->objects[class_id][cache->count[class_id]++] = ptr;
+    }
+    else if (page->type == SW_SLAB_PAGE_LARGE)
+    {
+        sw_spinlock(&slab->lock);
+        slab->alloc_bytes -= (uint64_t) page->pages << SW_SLAB_PAGE_SHIFT;
+        swSlab_page_free(slab, swSlab_page_index(slab, ptr), page->pages);
+        sw_spinlock_release(&slab->lock);
+    }
+    else
+    {
+        swWarn("invalid pointer %p.", ptr);
+    }
+}
+
+static void swSlab_destroy(swMemoryPool *pool)
+{
+    swSlab *slab = pool->object;
+    void *cache = pthread_getspecific(slab->cache_key);
+
+    //caches of other threads are dropped with their thread
+    if (cache)
+    {
+        pthread_setspecific(slab->cache_key, NULL);
+        sw_free(cache);
+    }
+    pthread_key_delete(slab->cache_key);
+    swSlab_pools[slab->id] = NULL;
+
+    if (slab->shared)
+    {
+        sw_shm_free(pool);
+    }
+    else
+    {
+        sw_free(pool);
+    }
+}
@@ -0,0 +1,1116 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "swoole.h"
+#include "table.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define SW_TABLE_SCAN_AVX2 1
+#endif
+
+#define SW_TABLE_ROW_ALIGN(n)    (((n) + 7) & ~7)
+#define SW_TABLE_SCAN_BLOCK      64
+
+typedef uint64_t (*swTable_scan_long_t)(int64_t *values, uint32_t n, int op, int64_t value);
+typedef uint64_t (*swTable_scan_double_t)(double *values, uint32_t n, int op, double value);
+
+static void swTableColumn_free(swTableColumn *col);
+static uint64_t swTable_scan_long(int64_t *values, uint32_t n, int op, int64_t value);
+static uint64_t swTable_scan_double(double *values, uint32_t n, int op, double value);
+#ifdef SW_TABLE_SCAN_AVX2
+static uint64_t swTable_scan_long_avx2(int64_t *values, uint32_t n, int op, int64_t value);
+static uint64_t swTable_scan_double_avx2(double *values, uint32_t n, int op, double value);
+#endif
+
+static swTable_scan_long_t swTable_scan_long_func = swTable_scan_long;
+static swTable_scan_double_t swTable_scan_double_func = swTable_scan_double;
+
+swTable* swTable_new(uint32_t rows_size)
+{
+    if (rows_size >= 0x80000000)
+    {
+        rows_size = 0x80000000;
+    }
+    else
+    {
+        uint32_t i = 10;
+        while ((1U << i) < rows_size)
+        {
+            i++;
+        }
+        rows_size = 1 << i;
+    }
+
+    swTable *table = SwooleG.memory_pool->alloc(SwooleG.memory_pool, sizeof(swTable));
+    if (table == NULL)
+    {
+        return NULL;
+    }
+    if (swMutex_create(&table->lock, 1) < 0)
+    {
+        swWarn("mutex create failed.");
+        return NULL;
+    }
+    table->iterator = sw_malloc(sizeof(swTable_iterator));
+    if (!table->iterator)
+    {
+        swWarn("malloc failed.");
+        return NULL;
+    }
+    table->columns = swHashMap_new(SW_HASHMAP_INIT_BUCKET_N, (swHashMap_dtor) swTableColumn_free);
+    if (!table->columns)
+    {
+        return NULL;
+    }
+
+    table->size = rows_size;
+    table->column_list = NULL;
+    table->column_num = 0;
+    table->index_num = 0;
+    table->columnar_num = 0;
+    table->item_size = 0;
+    table->row_num = 0;
+    table->free_list = NULL;
+    table->row_alloc_num = 0;
+
+    bzero(table->iterator, sizeof(swTable_iterator));
+    table->memory = NULL;
+    return table;
+}
+
+int swTableColumn_add(swTable *table, char *name, int len, int type, int size, int flags)
+{
+    swTableColumn *col = sw_malloc(sizeof(swTableColumn));
+    if (!col)
+    {
+        return SW_ERR;
+    }
+    col->name = swString_dup(name, len);
+    if (!col->name)
+    {
+        sw_free(col);
+        return SW_ERR;
+    }
+    switch(type)
+    {
+    case SW_TABLE_INT:
+        switch(size)
+        {
+        case 1:
+            col->size = 1;
+            col->type = SW_TABLE_INT8;
+            break;
+        case 2:
+            col->size = 2;
+            col->type = SW_TABLE_INT16;
+            break;
+#ifdef __x86_64__
+        case 8:
+            col->size = 8;
+            col->type = SW_TABLE_INT64;
+            break;
+#endif
+        default:
+            col->size = 4;
+            col->type = SW_TABLE_INT32;
+            break;
+        }
+        break;
+    case SW_TABLE_FLOAT:
+        col->size = sizeof(double);
+        col->type = SW_TABLE_FLOAT;
+        break;
+    case SW_TABLE_STRING:
+        col->size = size + sizeof(swTable_string_length_t);
+        col->type = SW_TABLE_STRING;
+        break;
+    default:
+        swWarn("unkown column type.");
+        swTableColumn_free(col);
+        return SW_ERR;
+    }
+    if ((flags & SW_TABLE_FLAG_INDEX) && (col->type == SW_TABLE_FLOAT || col->type == SW_TABLE_STRING))
+    {
+        swWarn("index is only supported on integer columns.");
+        flags &= ~SW_TABLE_FLAG_INDEX;
+    }
+    if ((flags & SW_TABLE_FLAG_COLUMNAR) && col->type == SW_TABLE_STRING)
+    {
+        swWarn("columnar layout is only supported on numeric columns.");
+        flags &= ~SW_TABLE_FLAG_COLUMNAR;
+    }
+    col->flags = flags;
+    col->link_id = 0;
+    col->index_buckets = NULL;
+    col->shadow = NULL;
+    if (flags & SW_TABLE_FLAG_INDEX)
+    {
+        col->link_id = table->index_num++;
+    }
+    if (flags & SW_TABLE_FLAG_COLUMNAR)
+    {
+        table->columnar_num++;
+    }
+
+    col->index = table->item_size;
+    table->item_size += col->size;
+    table->column_num ++;
+    return swHashMap_add(table->columns, name, len, col);
+}
+
+int swTable_create(swTable *table)
+{
+    uint32_t i = 0;
+    char *key;
+    swTableColumn *col;
+
+    table->column_list = sw_malloc(sizeof(swTableColumn *) * (table->column_num + 1));
+    if (!table->column_list)
+    {
+        return SW_ERR;
+    }
+    swHashMap_each_reset(table->columns);
+    while ((col = swHashMap_each(table->columns, &key)) != NULL)
+    {
+        table->column_list[i++] = col;
+    }
+    table->column_list[i] = NULL;
+
+    table->link_offset = SW_TABLE_ROW_ALIGN(sizeof(swTableRow) + table->item_size);
+    table->row_size = table->link_offset + sizeof(swTableIndexLink) * table->index_num;
+    table->iterator->buffer = sw_malloc(table->row_size);
+    if (!table->iterator->buffer)
+    {
+        return SW_ERR;
+    }
+
+    /**
+     * reserve address space for the largest table, pages are only touched when buckets/rows are used.
+     * the mapping is created before fork, so every worker sees the same addresses.
+     */
+    uint32_t max_bucket_num = table->size;
+    for (i = 1; i < SW_TABLE_MAX_RESIZE_MULTIPLE && max_bucket_num < 0x80000000; i <<= 1)
+    {
+        max_bucket_num <<= 1;
+    }
+
+    void *memory;
+    size_t memory_size;
+    while (1)
+    {
+        table->max_bucket_num = max_bucket_num;
+        table->max_row_num = max_bucket_num + max_bucket_num * SW_TABLE_CONFLICT_PROPORTION;
+        memory_size = sizeof(swTableBucket) * max_bucket_num + (size_t) table->row_size * table->max_row_num;
+        memory_size += sizeof(swTableIndexBucket) * max_bucket_num * table->index_num;
+        memory_size += sizeof(int64_t) * table->max_row_num * table->columnar_num;
+        memory = mmap(NULL, memory_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (memory != MAP_FAILED)
+        {
+            break;
+        }
+        if (max_bucket_num == table->size)
+        {
+            swSysError("mmap(%ld) failed.", memory_size);
+            return SW_ERR;
+        }
+        //cannot reserve the address space, fixed size table
+        max_bucket_num = table->size;
+    }
+
+    table->memory = memory;
+    table->memory_size = memory_size;
+    table->buckets = memory;
+    table->rows = (char *) memory + sizeof(swTableBucket) * max_bucket_num;
+    table->bucket_num = table->size;
+    table->index_bucket_num = max_bucket_num;
+
+    char *p = table->rows + (size_t) table->row_size * table->max_row_num;
+    for (i = 0; i < table->column_num; i++)
+    {
+        col = table->column_list[i];
+        if (col->flags & SW_TABLE_FLAG_INDEX)
+        {
+            col->index_buckets = (swTableIndexBucket *) p;
+            p += sizeof(swTableIndexBucket) * table->index_bucket_num;
+        }
+        if (col->flags & SW_TABLE_FLAG_COLUMNAR)
+        {
+            col->shadow = p;
+            p += sizeof(int64_t) * table->max_row_num;
+        }
+    }
+
+#ifdef SW_TABLE_SCAN_AVX2
+    if (table->columnar_num > 0 && __builtin_cpu_supports("avx2"))
+    {
+        swTable_scan_long_func = swTable_scan_long_avx2;
+        swTable_scan_double_func = swTable_scan_double_avx2;
+    }
+#endif
+    return SW_OK;
+}
+
+void swTable_free(swTable *table)
+{
+#ifdef SW_DEBUG
+    printf("swoole_table: size=%d, bucket_num=%d, row_num=%d, row_alloc_num=%d\n", table->size, table->bucket_num,
+            table->row_num, table->row_alloc_num);
+#endif
+    swHashMap_free(table->columns);
+    sw_free(table->column_list);
+    sw_free(table->iterator->buffer);
+    sw_free(table->iterator);
+    if (table->memory)
+    {
+        munmap(table->memory, table->memory_size);
+        table->memory = NULL;
+    }
+}
+
+static void swTableColumn_free(swTableColumn *col)
+{
+    swString_free(col->name);
+    sw_free(col);
+}
+
+static sw_inline uint32_t swTable_hash(char *key, int keylen)
+{
+#ifdef SW_TABLE_USE_PHP_HASH
+    return (uint32_t) swoole_hash_php(key, keylen);
+#else
+    return swoole_hash_austin(key, keylen);
+#endif
+}
+
+/**
+ * linear hashing: buckets [0, bucket_num - base) have been split and use one more bit of the hash
+ */
+static sw_inline uint32_t swTable_bucket_index(uint32_t bucket_num, uint32_t hash)
+{
+    uint32_t base = 1u << (31 - __builtin_clz(bucket_num));
+    uint32_t index = hash & (base - 1);
+    if (index < bucket_num - base)
+    {
+        index = hash & ((base << 1) - 1);
+    }
+    return index;
+}
+
+static sw_inline int swTableRow_key_equals(swTableRow *row, uint32_t hash, char *key, int keylen)
+{
+    if (row->hash != hash || memcmp(row->key, key, keylen) != 0)
+    {
+        return 0;
+    }
+    return keylen == SW_TABLE_KEY_SIZE || row->key[keylen] == '\0';
+}
+
+/**
+ * readers may walk a chain that is being changed, never follow more links than there are rows
+ */
+static sw_inline swTableRow* swTableBucket_find(swTable *table, swTableBucket *bucket, uint32_t hash, char *key,
+        int keylen, swTableRow **prev)
+{
+    swTableRow *row = bucket->head;
+    uint32_t n = 0;
+
+    if (prev)
+    {
+        *prev = NULL;
+    }
+    while (row && n++ < table->max_row_num)
+    {
+        if (swTableRow_key_equals(row, hash, key, keylen))
+        {
+            return row;
+        }
+        if (prev)
+        {
+            *prev = row;
+        }
+        row = row->next;
+    }
+    return NULL;
+}
+
+/**
+ * lock the bucket the hash belongs to, the bucket may be split while we wait for the lock
+ */
+static swTableBucket* swTable_lock_bucket(swTable *table, uint32_t hash)
+{
+    uint32_t index;
+    swTableBucket *bucket;
+
+    while (1)
+    {
+        index = swTable_bucket_index(table->bucket_num, hash);
+        bucket = &table->buckets[index];
+        sw_spinlock(&bucket->lock);
+        if (swTable_bucket_index(table->bucket_num, hash) == index)
+        {
+            return bucket;
+        }
+        sw_spinlock_release(&bucket->lock);
+    }
+    return NULL;
+}
+
+/**
+ * split one bucket, the rows with the next hash bit set move to the new bucket
+ */
+static void swTable_grow(swTable *table)
+{
+    if (table->lock.trylock(&table->lock) != 0)
+    {
+        return;
+    }
+
+    uint32_t bucket_num = table->bucket_num;
+    if (bucket_num >= table->max_bucket_num)
+    {
+        table->lock.unlock(&table->lock);
+        return;
+    }
+
+    uint32_t base = 1u << (31 - __builtin_clz(bucket_num));
+    swTableBucket *from = &table->buckets[bucket_num - base];
+    swTableBucket *to = &table->buckets[bucket_num];
+    swTableRow *row, *prev = NULL, *next;
+
+    //a writer holding this bucket may be waiting for table->lock in swTable_alloc_row,
+    //give up and let the next insert try again
+    if (!sw_atomic_cmp_set(&from->lock, 0, 1))
+    {
+        table->lock.unlock(&table->lock);
+        return;
+    }
+    from->version++;
+    sw_atomic_memory_barrier();
+
+    to->head = NULL;
+    for (row = from->head; row; row = next)
+    {
+        next = row->next;
+        if (row->hash & base)
+        {
+            if (prev)
+            {
+                prev->next = next;
+            }
+            else
+            {
+                from->head = next;
+            }
+            row->next = to->head;
+            to->head = row;
+        }
+        else
+        {
+            prev = row;
+        }
+    }
+
+    sw_atomic_memory_barrier();
+    table->bucket_num = bucket_num + 1;
+    swTableBucket_write_unlock(from);
+    table->lock.unlock(&table->lock);
+}
+
+static swTableRow* swTable_alloc_row(swTable *table)
+{
+    swTableRow *row = NULL;
+
+    table->lock.lock(&table->lock);
+    if (table->free_list)
+    {
+        row = table->free_list;
+        table->free_list = row->next;
+    }
+    else if (table->row_alloc_num < table->max_row_num)
+    {
+        row = (swTableRow *) (table->rows + (size_t) table->row_size * table->row_alloc_num);
+        table->row_alloc_num++;
+    }
+    table->lock.unlock(&table->lock);
+    return row;
+}
+
+static void swTable_free_row(swTable *table, swTableRow *row)
+{
+    table->lock.lock(&table->lock);
+    row->next = table->free_list;
+    table->free_list = row;
+    table->lock.unlock(&table->lock);
+}
+
+static sw_inline swTableIndexBucket* swTable_index_bucket(swTable *table, swTableColumn *col, int64_t value)
+{
+    uint64_t h = (uint64_t) value * 0x9E3779B97F4A7C15ULL;
+    return &col->index_buckets[(h >> 32) & (table->index_bucket_num - 1)];
+}
+
+static void swTable_index_link(swTable *table, swTableColumn *col, swTableRow *row)
+{
+    swTableIndexLink *link = swTableRow_get_link(table, row, col);
+    swTableIndexBucket *bucket = swTable_index_bucket(table, col, link->value);
+
+    sw_spinlock(&bucket->lock);
+    link->prev = NULL;
+    link->next = bucket->head;
+    if (bucket->head)
+    {
+        swTableRow_get_link(table, bucket->head, col)->prev = row;
+    }
+    bucket->head = row;
+    link->linked = 1;
+    sw_spinlock_release(&bucket->lock);
+}
+
+static void swTable_index_unlink(swTable *table, swTableColumn *col, swTableRow *row)
+{
+    swTableIndexLink *link = swTableRow_get_link(table, row, col);
+    swTableIndexBucket *bucket = swTable_index_bucket(table, col, link->value);
+
+    sw_spinlock(&bucket->lock);
+    if (link->prev)
+    {
+        swTableRow_get_link(table, link->prev, col)->next = link->next;
+    }
+    else
+    {
+        bucket->head = link->next;
+    }
+    if (link->next)
+    {
+        swTableRow_get_link(table, link->next, col)->prev = link->prev;
+    }
+    link->prev = link->next = NULL;
+    link->linked = 0;
+    sw_spinlock_release(&bucket->lock);
+}
+
+/**
+ * find or insert the row, the bucket is returned locked for writing,
+ * the caller must release it with swTableBucket_write_unlock even when NULL is returned.
+ */
+swTableRow* swTableRow_set(swTable *table, char *key, int keylen, swTableBucket **rowbucket)
+{
+    if (keylen > SW_TABLE_KEY_SIZE)
+    {
+        keylen = SW_TABLE_KEY_SIZE;
+    }
+
+    uint32_t hash = swTable_hash(key, keylen);
+    if (table->row_num >= table->bucket_num * SW_TABLE_LOAD_FACTOR)
+    {
+        swTable_grow(table);
+    }
+
+    swTableBucket *bucket = swTable_lock_bucket(table, hash);
+    *rowbucket = bucket;
+    bucket->version++;
+    sw_atomic_memory_barrier();
+
+    swTableRow *row = swTableBucket_find(table, bucket, hash, key, keylen, NULL);
+    if (row)
+    {
+        return row;
+    }
+
+    row = swTable_alloc_row(table);
+    if (!row)
+    {
+        swWarn("no memory for new row, row_num=%d.", table->row_num);
+        return NULL;
+    }
+
+    //data and index links
+    bzero(row->data, table->row_size - sizeof(swTableRow));
+    bzero(row->key, SW_TABLE_KEY_SIZE);
+    memcpy(row->key, key, keylen);
+    row->hash = hash;
+    row->active = 1;
+    row->next = bucket->head;
+    bucket->head = row;
+    sw_atomic_fetch_add(&table->row_num, 1);
+    return row;
+}
+
+/**
+ * publish the values written into the row to the indexes and the columnar copies, then unlock the bucket.
+ * the row bucket is still locked, so set/del of the same key cannot interleave with the index update.
+ */
+void swTableRow_commit(swTable *table, swTableRow *row, swTableBucket *bucket)
+{
+    if (row && (table->index_num > 0 || table->columnar_num > 0))
+    {
+        uint32_t slot = ((char *) row - table->rows) / table->row_size;
+        swTableColumn *col;
+        swTableColumn **column_list = table->column_list;
+        swTableIndexLink *link;
+        int64_t value;
+
+        while ((col = *column_list++) != NULL)
+        {
+            if (col->flags & SW_TABLE_FLAG_COLUMNAR)
+            {
+                if (col->type == SW_TABLE_FLOAT)
+                {
+                    memcpy((double *) col->shadow + slot, row->data + col->index, sizeof(double));
+                }
+                else
+                {
+                    ((int64_t *) col->shadow)[slot] = swTableRow_get_long(row, col);
+                }
+            }
+            if (col->flags & SW_TABLE_FLAG_INDEX)
+            {
+                link = swTableRow_get_link(table, row, col);
+                value = swTableRow_get_long(row, col);
+                if (link->linked && link->value == value)
+                {
+                    continue;
+                }
+                if (link->linked)
+                {
+                    swTable_index_unlink(table, col, row);
+                }
+                link->value = value;
+                swTable_index_link(table, col, row);
+            }
+        }
+    }
+    swTableBucket_write_unlock(bucket);
+}
+
+/**
+ * lock-free lookup, copy the row to out (table->row_size bytes) if it is not NULL
+ */
+int swTableRow_read(swTable *table, char *key, int keylen, swTableRow *out)
+{
+    if (keylen > SW_TABLE_KEY_SIZE)
+    {
+        keylen = SW_TABLE_KEY_SIZE;
+    }
+
+    uint32_t hash = swTable_hash(key, keylen);
+    uint32_t index, version;
+    swTableBucket *bucket;
+    swTableRow *row;
+
+    while (1)
+    {
+        index = swTable_bucket_index(table->bucket_num, hash);
+        bucket = &table->buckets[index];
+        version = swTableBucket_read_begin(bucket);
+
+        row = swTableBucket_find(table, bucket, hash, key, keylen, NULL);
+        if (row && out)
+        {
+            memcpy(out, row, table->row_size);
+        }
+        if (swTableBucket_read_retry(bucket, version))
+        {
+            continue;
+        }
+        //the bucket was split before we read it
+        if (row == NULL && swTable_bucket_index(table->bucket_num, hash) != index)
+        {
+            continue;
+        }
+        return row ? SW_OK : SW_ERR;
+    }
+    return SW_ERR;
+}
+
+int swTableRow_del(swTable *table, char *key, int keylen)
+{
+    if (keylen > SW_TABLE_KEY_SIZE)
+    {
+        keylen = SW_TABLE_KEY_SIZE;
+    }
+
+    uint32_t hash = swTable_hash(key, keylen);
+    swTableBucket *bucket = swTable_lock_bucket(table, hash);
+    swTableRow *prev;
+
+    bucket->version++;
+    sw_atomic_memory_barrier();
+
+    swTableRow *row = swTableBucket_find(table, bucket, hash, key, keylen, &prev);
+    if (!row)
+    {
+        swTableBucket_write_unlock(bucket);
+        return SW_ERR;
+    }
+    if (prev)
+    {
+        prev->next = row->next;
+    }
+    else
+    {
+        bucket->head = row->next;
+    }
+    row->active = 0;
+    if (table->index_num > 0)
+    {
+        swTableColumn *col;
+        swTableColumn **column_list = table->column_list;
+        while ((col = *column_list++) != NULL)
+        {
+            if ((col->flags & SW_TABLE_FLAG_INDEX) && swTableRow_get_link(table, row, col)->linked)
+            {
+                swTable_index_unlink(table, col, row);
+            }
+        }
+    }
+    swTableBucket_write_unlock(bucket);
+
+    sw_atomic_fetch_sub(&table->row_num, 1);
+    swTable_free_row(table, row);
+    return SW_OK;
+}
+
+void swTable_iterator_rewind(swTable *table)
+{
+    table->iterator->absolute_index = 0;
+    table->iterator->collision_index = 0;
+    table->iterator->row = NULL;
+}
+
+swTableRow* swTable_iterator_current(swTable *table)
+{
+    return table->iterator->row;
+}
+
+/**
+ * the current row is copied into the iterator buffer, so current/key never see a half written row
+ */
+void swTable_iterator_forward(swTable *table)
+{
+    swTable_iterator *iterator = table->iterator;
+    swTableBucket *bucket;
+    swTableRow *row;
+    uint32_t version, i;
+
+    for (; iterator->absolute_index < table->bucket_num; iterator->absolute_index++)
+    {
+        bucket = &table->buckets[iterator->absolute_index];
+        do
+        {
+            version = swTableBucket_read_begin(bucket);
+            row = bucket->head;
+            for (i = 0; row && i < iterator->collision_index && i < table->max_row_num; i++)
+            {
+                row = row->next;
+            }
+            if (row)
+            {
+                memcpy(iterator->buffer, row, table->row_size);
+            }
+        } while (swTableBucket_read_retry(bucket, version));
+
+        if (row)
+        {
+            iterator->collision_index++;
+            iterator->row = iterator->buffer;
+            return;
+        }
+        iterator->collision_index = 0;
+    }
+    iterator->row = NULL;
+}
+
+/**
+ * copy a row found by address instead of by key, fails if it was deleted or is being reused
+ */
+static int swTable_copy_row(swTable *table, swTableRow *row, swTableRow *out)
+{
+    uint32_t hash, index, version, n;
+    swTableBucket *bucket;
+    swTableRow *cursor;
+
+    while (1)
+    {
+        hash = row->hash;
+        index = swTable_bucket_index(table->bucket_num, hash);
+        bucket = &table->buckets[index];
+        version = swTableBucket_read_begin(bucket);
+
+        cursor = bucket->head;
+        for (n = 0; cursor && cursor != row && n < table->max_row_num; n++)
+        {
+            cursor = cursor->next;
+        }
+        if (cursor == row)
+        {
+            memcpy(out, row, table->row_size);
+        }
+        if (swTableBucket_read_retry(bucket, version))
+        {
+            continue;
+        }
+        if (cursor != row && (row->hash != hash || swTable_bucket_index(table->bucket_num, hash) != index))
+        {
+            continue;
+        }
+        return cursor == row ? SW_OK : SW_ERR;
+    }
+    return SW_ERR;
+}
+
+static int swTable_condition_match(swTable_condition *cond, swTableRow *row)
+{
+    swTableColumn *col = cond->column;
+
+    if (col->type == SW_TABLE_STRING)
+    {
+        swTable_string_length_t vlen;
+        memcpy(&vlen, row->data + col->index, sizeof(vlen));
+        char *str = row->data + col->index + sizeof(swTable_string_length_t);
+        int cmp;
+
+        switch (cond->op)
+        {
+        case SW_TABLE_FIND_EQ:
+            return vlen == cond->length && memcmp(str, cond->str, vlen) == 0;
+        case SW_TABLE_FIND_NEQ:
+            return vlen != cond->length || memcmp(str, cond->str, vlen) != 0;
+        case SW_TABLE_FIND_GT:
+        case SW_TABLE_FIND_LT:
+            cmp = memcmp(str, cond->str, vlen < cond->length ? vlen : cond->length);
+            if (cmp == 0)
+            {
+                cmp = (int) vlen - (int) cond->length;
+            }
+            return cond->op == SW_TABLE_FIND_GT ? cmp > 0 : cmp < 0;
+        case SW_TABLE_FIND_LEFTLIKE:
+            return vlen >= cond->length && memcmp(str, cond->str, cond->length) == 0;
+        case SW_TABLE_FIND_RIGHTLIKE:
+            return vlen >= cond->length && memcmp(str + vlen - cond->length, cond->str, cond->length) == 0;
+        case SW_TABLE_FIND_LIKE:
+            return memmem(str, vlen, cond->str, cond->length) != NULL;
+        default:
+            return 0;
+        }
+    }
+    else if (col->type == SW_TABLE_FLOAT)
+    {
+        double dval;
+        memcpy(&dval, row->data + col->index, sizeof(dval));
+        switch (cond->op)
+        {
+        case SW_TABLE_FIND_EQ:
+            return dval == cond->dval;
+        case SW_TABLE_FIND_NEQ:
+            return dval != cond->dval;
+        case SW_TABLE_FIND_GT:
+            return dval > cond->dval;
+        case SW_TABLE_FIND_LT:
+            return dval < cond->dval;
+        default:
+            return 0;
+        }
+    }
+    else
+    {
+        int64_t lval = swTableRow_get_long(row, col);
+        switch (cond->op)
+        {
+        case SW_TABLE_FIND_EQ:
+            return lval == cond->lval;
+        case SW_TABLE_FIND_NEQ:
+            return lval != cond->lval;
+        case SW_TABLE_FIND_GT:
+            return lval > cond->lval;
+        case SW_TABLE_FIND_LT:
+            return lval < cond->lval;
+        default:
+            return 0;
+        }
+    }
+}
+
+/**
+ * bit i is set if values[i] matches, n <= SW_TABLE_SCAN_BLOCK
+ */
+static uint64_t swTable_scan_long(int64_t *values, uint32_t n, int op, int64_t value)
+{
+    uint64_t mask = 0;
+    uint32_t i;
+
+    for (i = 0; i < n; i++)
+    {
+        switch (op)
+        {
+        case SW_TABLE_FIND_EQ:
+            mask |= (uint64_t) (values[i] == value) << i;
+            break;
+        case SW_TABLE_FIND_NEQ:
+            mask |= (uint64_t) (values[i] != value) << i;
+            break;
+        case SW_TABLE_FIND_GT:
+            mask |= (uint64_t) (values[i] > value) << i;
+            break;
+        default:
+            mask |= (uint64_t) (values[i] < value) << i;
+            break;
+        }
+    }
+    return mask;
+}
+
+static uint64_t swTable_scan_double(double *values, uint32_t n, int op, double value)
+{
+    uint64_t mask = 0;
+    uint32_t i;
+
+    for (i = 0; i < n; i++)
+    {
+        switch (op)
+        {
+        case SW_TABLE_FIND_EQ:
+            mask |= (uint64_t) (values[i] == value) << i;
+            break;
+        case SW_TABLE_FIND_NEQ:
+            mask |= (uint64_t) (values[i] != value) << i;
+            break;
+        case SW_TABLE_FIND_GT:
+            mask |= (uint64_t) (values[i] > value) << i;
+            break;
+        default:
+            mask |= (uint64_t) (values[i] < value) << i;
+            break;
+        }
+    }
+    return mask;
+}
+
+#ifdef SW_TABLE_SCAN_AVX2
+__attribute__((target("avx2")))
+static uint64_t swTable_scan_long_avx2(int64_t *values, uint32_t n, int op, int64_t value)
+{
+    __m256i needle = _mm256_set1_epi64x(value);
+    __m256i x, r;
+    uint64_t mask = 0;
+    uint32_t i;
+
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+        x = _mm256_loadu_si256((__m256i *) (values + i));
+        switch (op)
+        {
+        case SW_TABLE_FIND_EQ:
+            r = _mm256_cmpeq_epi64(x, needle);
+            break;
+        case SW_TABLE_FIND_NEQ:
+            r = _mm256_xor_si256(_mm256_cmpeq_epi64(x, needle), _mm256_set1_epi64x(-1));
+            break;
+        case SW_TABLE_FIND_GT:
+            r = _mm256_cmpgt_epi64(x, needle);
+            break;
+        default:
+            r = _mm256_cmpgt_epi64(needle, x);
+            break;
+        }
+        mask |= (uint64_t) _mm256_movemask_pd(_mm256_castsi256_pd(r)) << i;
+    }
+    if (i < n)
+    {
+        mask |= swTable_scan_long(values + i, n - i, op, value) << i;
+    }
+    return mask;
+}
+
+__attribute__((target("avx2")))
+static uint64_t swTable_scan_double_avx2(double *values, uint32_t n, int op, double value)
+{
+    __m256d needle = _mm256_set1_pd(value);
+    __m256d x, r;
+    uint64_t mask = 0;
+    uint32_t i;
+
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+        x = _mm256_loadu_pd(values + i);
+        switch (op)
+        {
+        case SW_TABLE_FIND_EQ:
+            r = _mm256_cmp_pd(x, needle, _CMP_EQ_OQ);
+            break;
+        case SW_TABLE_FIND_NEQ:
+            r = _mm256_cmp_pd(x, needle, _CMP_NEQ_UQ);
+            break;
+        case SW_TABLE_FIND_GT:
+            r = _mm256_cmp_pd(x, needle, _CMP_GT_OQ);
+            break;
+        default:
+            r = _mm256_cmp_pd(x, needle, _CMP_LT_OQ);
+            break;
+        }
+        mask |= (uint64_t) _mm256_movemask_pd(r) << i;
+    }
+    if (i < n)
+    {
+        mask |= swTable_scan_double(values + i, n - i, op, value) << i;
+    }
+    return mask;
+}
+#endif
+
+static int swTable_find_emit(swTable *table, swTableRow *row, swTable_condition *cond, swTableRow *out,
+        swTable_find_handler handler, void *udata)
+{
+    if (!row->active || swTable_copy_row(table, row, out) < 0 || !swTable_condition_match(cond, out))
+    {
+        return 0;
+    }
+    handler(table, out, udata);
+    return 1;
+}
+
+/**
+ * collect the candidates under the index lock, copy them after it is released:
+ * a writer holds its row bucket while it waits for the index lock.
+ */
+static int swTable_find_index(swTable *table, swTable_condition *cond, swTableRow *out, swTable_find_handler handler,
+        void *udata)
+{
+    swTableColumn *col = cond->column;
+    swTableIndexBucket *bucket = swTable_index_bucket(table, col, cond->lval);
+    swTableIndexLink *link;
+    swTableRow *row, **list = NULL, **tmp;
+    uint32_t size = 0, n = 0, i;
+    int count = 0;
+
+    sw_spinlock(&bucket->lock);
+    for (row = bucket->head; row; row = link->next)
+    {
+        link = swTableRow_get_link(table, row, col);
+        if (link->value != cond->lval)
+        {
+            continue;
+        }
+        if (n == size)
+        {
+            size = size ? size * 2 : 16;
+            tmp = sw_realloc(list, sizeof(swTableRow *) * size);
+            if (!tmp)
+            {
+                sw_spinlock_release(&bucket->lock);
+                sw_free(list);
+                swWarn("realloc(%ld) failed.", sizeof(swTableRow *) * size);
+                return SW_ERR;
+            }
+            list = tmp;
+        }
+        list[n++] = row;
+    }
+    sw_spinlock_release(&bucket->lock);
+
+    for (i = 0; i < n; i++)
+    {
+        count += swTable_find_emit(table, list[i], cond, out, handler, udata);
+    }
+    sw_free(list);
+    return count;
+}
+
+static int swTable_find_columnar(swTable *table, swTable_condition *cond, swTableRow *out,
+        swTable_find_handler handler, void *udata)
+{
+    swTableColumn *col = cond->column;
+    uint32_t alloc_num = table->row_alloc_num;
+    uint32_t offset, n;
+    uint64_t mask;
+    int count = 0;
+
+    for (offset = 0; offset < alloc_num; offset += SW_TABLE_SCAN_BLOCK)
+    {
+        n = alloc_num - offset < SW_TABLE_SCAN_BLOCK ? alloc_num - offset : SW_TABLE_SCAN_BLOCK;
+        if (col->type == SW_TABLE_FLOAT)
+        {
+            mask = swTable_scan_double_func((double *) col->shadow + offset, n, cond->op, cond->dval);
+        }
+        else
+        {
+            mask = swTable_scan_long_func((int64_t *) col->shadow + offset, n, cond->op, cond->lval);
+        }
+        while (mask)
+        {
+            uint32_t slot = offset + __builtin_ctzll(mask);
+            mask &= mask - 1;
+            count += swTable_find_emit(table, (swTableRow *) (table->rows + (size_t) table->row_size * slot), cond,
+                    out, handler, udata);
+        }
+    }
+    return count;
+}
+
+static int swTable_find_rows(swTable *table, swTable_condition *cond, swTableRow *out, swTable_find_handler handler,
+        void *udata)
+{
+    uint32_t alloc_num = table->row_alloc_num;
+    uint32_t slot;
+    int count = 0;
+
+    for (slot = 0; slot < alloc_num; slot++)
+    {
+        count += swTable_find_emit(table, (swTableRow *) (table->rows + (size_t) table->row_size * slot), cond, out,
+                handler, udata);
+    }
+    return count;
+}
+
+/**
+ * call handler for every row matching the condition, return the number of rows.
+ * EQ on an indexed column reads one index bucket, a columnar column is scanned as a dense array,
+ * anything else walks the row slots. Rows changed during the call may or may not be reported.
+ */
+int swTable_find(swTable *table, swTable_condition *cond, swTable_find_handler handler, void *udata)
+{
+    swTableColumn *col = cond->column;
+    int count;
+
+    if (cond->op < SW_TABLE_FIND_EQ || cond->op > SW_TABLE_FIND_LIKE)
+    {
+        swWarn("unknown find operator[%d].", cond->op);
+        return SW_ERR;
+    }
+
+    swTableRow *out = sw_malloc(table->row_size);
+    if (!out)
+    {
+        swWarn("malloc(%d) failed.", table->row_size);
+        return SW_ERR;
+    }
+
+    if (cond->op == SW_TABLE_FIND_EQ && (col->flags & SW_TABLE_FLAG_INDEX))
+    {
+        count = swTable_find_index(table, cond, out, handler, udata);
+    }
+    else if ((col->flags & SW_TABLE_FLAG_COLUMNAR) && cond->op <= SW_TABLE_FIND_LT)
+    {
+        count = swTable_find_columnar(table, cond, out, handler, udata);
+    }
+    else
+    {
+        count = swTable_find_rows(table, cond, out, handler, udata);
+    }
+    sw_free(out);
+    return count;
+}
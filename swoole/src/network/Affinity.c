@@ -0,0 +1,284 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "swoole.h"
+#include "Server.h"
+
+/**
+ * Each reactor goes to the cpu serving one RX queue of cpu_affinity_irq_device, so the packets
+ * are read where the interrupt left them in cache, or round-robin over the NUMA nodes without a device.
+ * The pipe of worker i is polled by reactor i % reactor_num, the worker goes to a free cpu
+ * on the node of that reactor and the memory it allocates is preferred on the same node.
+ * In SWOOLE_BASE mode every worker is its own reactor.
+ */
+
+static int swServer_cpu_affinity_pick(swCpuTopology *topology, int *available, int num, int node, uint8_t *used, int *cursor)
+{
+    int i, cpu, pass;
+
+    //a cpu of the node not taken by a reactor, then any cpu of the node
+    for (pass = 0; pass < 2; pass++)
+    {
+        for (i = 0; i < num; i++)
+        {
+            cpu = available[(cursor[node] + i) % num];
+            if (topology->cpu_node[cpu] == node && (pass == 1 || !used[cpu]))
+            {
+                cursor[node] = (cursor[node] + i + 1) % num;
+                return cpu;
+            }
+        }
+    }
+    return available[cursor[node]++ % num];
+}
+
+int swServer_cpu_affinity_init(swServer *serv)
+{
+    swCpuTopology topology;
+    int *available = NULL, *queues = NULL, *cursor = NULL, *nodes = NULL;
+    uint8_t *used = NULL;
+    int available_num = 0, queue_num = 0, node_num = 0;
+    int i, n, cpu, node, ret = SW_ERR;
+    int base_mode = serv->factory_mode == SW_MODE_BASE;
+    int reactor_num = base_mode ? serv->worker_num : serv->reactor_num;
+
+    if (swCpuTopology_load(&topology) < 0)
+    {
+        return SW_ERR;
+    }
+
+    available = sw_malloc(sizeof(int) * topology.cpu_max);
+    queues = sw_malloc(sizeof(int) * topology.cpu_max);
+    cursor = sw_calloc(topology.node_num, sizeof(int));
+    nodes = sw_malloc(sizeof(int) * topology.node_num);
+    used = sw_calloc(topology.cpu_max, sizeof(uint8_t));
+    serv->reactor_cpu = sw_malloc(sizeof(int) * reactor_num);
+    serv->worker_cpu = sw_malloc(sizeof(int) * serv->worker_num);
+    serv->worker_node = sw_malloc(sizeof(int16_t) * serv->worker_num);
+    if (!available || !queues || !cursor || !nodes || !used || !serv->reactor_cpu || !serv->worker_cpu || !serv->worker_node)
+    {
+        swWarn("malloc() failed.");
+        goto _free;
+    }
+
+    //cpu_affinity_ignore
+    if (serv->cpu_affinity_available)
+    {
+        for (i = 0; i < serv->cpu_affinity_available_num; i++)
+        {
+            cpu = serv->cpu_affinity_available[i];
+            if (cpu < topology.cpu_max && topology.cpu_node[cpu] >= 0)
+            {
+                available[available_num++] = cpu;
+            }
+        }
+    }
+    else
+    {
+        for (cpu = 0; cpu < topology.cpu_max; cpu++)
+        {
+            if (topology.cpu_node[cpu] >= 0)
+            {
+                available[available_num++] = cpu;
+            }
+        }
+    }
+    if (available_num == 0)
+    {
+        swWarn("no cpu is available.");
+        goto _free;
+    }
+    for (node = 0; node < topology.node_num; node++)
+    {
+        for (i = 0; i < available_num; i++)
+        {
+            if (topology.cpu_node[available[i]] == node)
+            {
+                nodes[node_num++] = node;
+                break;
+            }
+        }
+    }
+
+    if (serv->cpu_affinity_irq_device)
+    {
+        n = swCpuTopology_irq_cpus(serv->cpu_affinity_irq_device, queues, topology.cpu_max);
+        for (i = 0; i < n; i++)
+        {
+            if (queues[i] < topology.cpu_max && topology.cpu_node[queues[i]] >= 0)
+            {
+                queues[queue_num++] = queues[i];
+            }
+        }
+    }
+
+    for (i = 0; i < reactor_num; i++)
+    {
+        if (queue_num > 0)
+        {
+            cpu = queues[i % queue_num];
+        }
+        else
+        {
+            cpu = swServer_cpu_affinity_pick(&topology, available, available_num, nodes[i % node_num], used, cursor);
+        }
+        serv->reactor_cpu[i] = cpu;
+        used[cpu] = 1;
+    }
+
+    for (i = 0; i < serv->worker_num; i++)
+    {
+        if (base_mode)
+        {
+            cpu = serv->reactor_cpu[i];
+        }
+        else
+        {
+            node = topology.cpu_node[serv->reactor_cpu[i % reactor_num]];
+            cpu = swServer_cpu_affinity_pick(&topology, available, available_num, node, used, cursor);
+        }
+        serv->worker_cpu[i] = cpu;
+        serv->worker_node[i] = topology.cpu_node[cpu];
+    }
+
+    swNotice("cpu placement: %d cpus, %d NUMA nodes, %d RX queues of %s.", available_num, topology.node_num, queue_num,
+            serv->cpu_affinity_irq_device ? serv->cpu_affinity_irq_device : "-");
+    for (i = 0; !base_mode && i < reactor_num; i++)
+    {
+        swNotice("reactor#%d: cpu %d, node %d.", i, serv->reactor_cpu[i], topology.cpu_node[serv->reactor_cpu[i]]);
+    }
+    for (i = 0; i < serv->worker_num; i++)
+    {
+        swNotice("worker#%d: cpu %d, node %d, pipe polled by reactor#%d.", i, serv->worker_cpu[i], serv->worker_node[i],
+                base_mode ? i : i % reactor_num);
+    }
+    ret = SW_OK;
+
+    _free:
+    if (available)
+    {
+        sw_free(available);
+    }
+    if (queues)
+    {
+        sw_free(queues);
+    }
+    if (cursor)
+    {
+        sw_free(cursor);
+    }
+    if (nodes)
+    {
+        sw_free(nodes);
+    }
+    if (used)
+    {
+        sw_free(used);
+    }
+    if (ret < 0)
+    {
+        if (serv->reactor_cpu)
+        {
+            sw_free(serv->reactor_cpu);
+        }
+        if (serv->worker_cpu)
+        {
+            sw_free(serv->worker_cpu);
+        }
+        if (serv->worker_node)
+        {
+            sw_free(serv->worker_node);
+        }
+        serv->reactor_cpu = serv->worker_cpu = NULL;
+        serv->worker_node = NULL;
+    }
+    return ret;
+}
+
+void swServer_cpu_affinity_free(swServer *serv)
+{
+    if (serv->reactor_cpu)
+    {
+        sw_free(serv->reactor_cpu);
+        serv->reactor_cpu = NULL;
+    }
+    if (serv->worker_cpu)
+    {
+        sw_free(serv->worker_cpu);
+        serv->worker_cpu = NULL;
+    }
+    if (serv->worker_node)
+    {
+        sw_free(serv->worker_node);
+        serv->worker_node = NULL;
+    }
+    if (serv->cpu_affinity_irq_device)
+    {
+        free(serv->cpu_affinity_irq_device);
+        serv->cpu_affinity_irq_device = NULL;
+    }
+}
+
+/**
+ * called by the master once the reactor threads are running, in SWOOLE_BASE mode the workers are the reactors
+ */
+int swServer_cpu_affinity_reactor(swServer *serv, uint16_t reactor_id)
+{
+#ifdef HAVE_CPU_AFFINITY
+    cpu_set_t cpu_set;
+
+    //reactor_cpu has worker_num entries in SWOOLE_BASE mode, reactor_num otherwise
+    if (serv->reactor_cpu == NULL || serv->factory_mode == SW_MODE_BASE || reactor_id >= serv->reactor_num)
+    {
+        return SW_ERR;
+    }
+    CPU_ZERO(&cpu_set);
+    CPU_SET(serv->reactor_cpu[reactor_id], &cpu_set);
+    if (pthread_setaffinity_np(serv->reactor_threads[reactor_id].thread_id, sizeof(cpu_set), &cpu_set) != 0)
+    {
+        swWarn("pthread_setaffinity_np(cpu=%d) failed.", serv->reactor_cpu[reactor_id]);
+        return SW_ERR;
+    }
+    return SW_OK;
+#else
+    return SW_ERR;
+#endif
+}
+
+/**
+ * called by the worker process when it starts, the memory it allocates from then on is on its node
+ */
+int swServer_cpu_affinity_worker(swServer *serv, uint32_t worker_id)
+{
+#if defined(HAVE_CPU_AFFINITY) && defined(__linux__)
+    cpu_set_t cpu_set;
+
+    if (serv->worker_cpu == NULL || worker_id >= serv->worker_num)
+    {
+        return SW_ERR;
+    }
+    CPU_ZERO(&cpu_set);
+    CPU_SET(serv->worker_cpu[worker_id], &cpu_set);
+    if (sched_setaffinity(getpid(), sizeof(cpu_set), &cpu_set) < 0)
+    {
+        swSysError("sched_setaffinity(cpu=%d) failed.", serv->worker_cpu[worker_id]);
+        return SW_ERR;
+    }
+    return swoole_set_mempolicy_node(serv->worker_node[worker_id]);
+#else
+    return SW_ERR;
+#endif
+}
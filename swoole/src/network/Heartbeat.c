@@ -0,0 +1,243 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "swoole.h"
+#include "Server.h"
+
+#include <stddef.h>
+
+/**
+ * Connections are added to the wheel of their reactor on accept and only moved when they expire:
+ * the receive path keeps updating conn->last_time alone, an expired node whose connection
+ * received data since then is put back at last_time + heartbeat_idle_time.
+ * A check therefore visits each live connection at most once per idle period, instead of
+ * walking the whole connection_list every heartbeat_check_interval.
+ * idle_node.data points to the wheel the node is on, from_id may already belong to the next accept.
+ */
+
+typedef struct
+{
+    swServer *serv;
+    time_t now;
+    swArray *fds;
+} swHeartbeat_context;
+
+#define swServer_heartbeat_conn(node)   ((swConnection *) ((char *) (node) - offsetof(swConnection, idle_node)))
+
+static sw_inline swIdleWheel* swServer_heartbeat_get_wheel(swServer *serv, swConnection *conn)
+{
+    return &serv->idle_wheels[conn->from_id % serv->idle_wheel_num];
+}
+
+static sw_inline int swServer_heartbeat_is_idle(swServer *serv, swConnection *conn, time_t now)
+{
+    return conn->active && conn->last_time < now - serv->heartbeat_idle_time;
+}
+
+/**
+ * take the node off the wheel it is on
+ */
+static void swServer_heartbeat_unlink(swConnection *conn)
+{
+    swIdleWheel *idle = conn->idle_node.data;
+    if (idle == NULL)
+    {
+        return;
+    }
+    idle->lock.lock(&idle->lock);
+    //the owner of the wheel may have moved it meanwhile
+    if (conn->idle_node.data == idle)
+    {
+        swTimeWheel_del(&idle->wheel, &conn->idle_node);
+        conn->idle_node.data = NULL;
+    }
+    idle->lock.unlock(&idle->lock);
+}
+
+/**
+ * idle when last_time < now - heartbeat_idle_time, the same as the full scan
+ */
+static sw_inline int64_t swServer_heartbeat_expire_msec(swServer *serv, time_t last_time)
+{
+    return ((int64_t) last_time + serv->heartbeat_idle_time + 1) * 1000;
+}
+
+static void swServer_heartbeat_onExpire(swTimeWheel *wheel, swTimeWheel_node *node)
+{
+    swHeartbeat_context *context = wheel->ptr;
+    swServer *serv = context->serv;
+    swConnection *conn = swServer_heartbeat_conn(node);
+
+    if (!conn->active)
+    {
+        conn->idle_node.data = NULL;
+        return;
+    }
+    //received data after it was added
+    if (conn->last_time >= context->now - serv->heartbeat_idle_time)
+    {
+        swTimeWheel_add(wheel, node, swServer_heartbeat_expire_msec(serv, conn->last_time));
+        return;
+    }
+    //report it again at the next check until it is closed
+    int interval = serv->heartbeat_check_interval > 0 ? serv->heartbeat_check_interval : 1;
+    swTimeWheel_add(wheel, node, ((int64_t) context->now + interval) * 1000);
+    swArray_append(context->fds, &conn->fd);
+}
+
+int swServer_heartbeat_init(swServer *serv)
+{
+    int i;
+    int64_t now_msec = (int64_t) time(NULL) * 1000;
+
+    if (serv->heartbeat_idle_time < 1)
+    {
+        return SW_OK;
+    }
+    serv->idle_wheel_num = serv->factory_mode == SW_MODE_BASE ? serv->worker_num : serv->reactor_num;
+    serv->idle_wheels = sw_shm_calloc(serv->idle_wheel_num, sizeof(swIdleWheel));
+    if (serv->idle_wheels == NULL)
+    {
+        swWarn("sw_shm_calloc(%ld) failed.", serv->idle_wheel_num * sizeof(swIdleWheel));
+        return SW_ERR;
+    }
+    for (i = 0; i < serv->idle_wheel_num; i++)
+    {
+        if (swMutex_create(&serv->idle_wheels[i].lock, 1) < 0)
+        {
+            swWarn("create mutex failed.");
+            serv->idle_wheel_num = i;
+            swServer_heartbeat_free(serv);
+            return SW_ERR;
+        }
+        swTimeWheel_init(&serv->idle_wheels[i].wheel, 1000, now_msec);
+    }
+    return SW_OK;
+}
+
+void swServer_heartbeat_free(swServer *serv)
+{
+    int i;
+
+    if (serv->idle_wheels == NULL)
+    {
+        return;
+    }
+    for (i = 0; i < serv->idle_wheel_num; i++)
+    {
+        serv->idle_wheels[i].lock.free(&serv->idle_wheels[i].lock);
+    }
+    sw_shm_free(serv->idle_wheels);
+    serv->idle_wheels = NULL;
+}
+
+/**
+ * called on accept, after from_id and last_time are set
+ */
+void swServer_heartbeat_add(swServer *serv, swConnection *conn)
+{
+    if (serv->idle_wheels == NULL)
+    {
+        return;
+    }
+    //the slot was closed without swServer_heartbeat_del, e.g. with disable_notify
+    swServer_heartbeat_unlink(conn);
+    swIdleWheel *idle = swServer_heartbeat_get_wheel(serv, conn);
+    idle->lock.lock(&idle->lock);
+    conn->idle_node.data = idle;
+    swTimeWheel_add(&idle->wheel, &conn->idle_node, swServer_heartbeat_expire_msec(serv, conn->last_time));
+    idle->lock.unlock(&idle->lock);
+}
+
+/**
+ * called on close, before the connection slot can be reset for the next accept
+ */
+void swServer_heartbeat_del(swServer *serv, swConnection *conn)
+{
+    if (serv->idle_wheels == NULL)
+    {
+        return;
+    }
+    swServer_heartbeat_unlink(conn);
+}
+
+/**
+ * append the fd of the connections of the reactor idle longer than heartbeat_idle_time to fds
+ * @return the number of idle connections
+ */
+int swServer_heartbeat_expire(swServer *serv, uint16_t reactor_id, time_t now, swArray *fds)
+{
+    swHeartbeat_context context;
+    uint32_t n = fds->item_num;
+
+    if (serv->idle_wheels == NULL || reactor_id >= serv->idle_wheel_num)
+    {
+        return 0;
+    }
+    swIdleWheel *idle = &serv->idle_wheels[reactor_id];
+    context.serv = serv;
+    context.now = now;
+    context.fds = fds;
+
+    idle->lock.lock(&idle->lock);
+    idle->wheel.ptr = &context;
+    swTimeWheel_expire(&idle->wheel, (int64_t) now * 1000, swServer_heartbeat_onExpire);
+    idle->wheel.ptr = NULL;
+    idle->lock.unlock(&idle->lock);
+
+    return fds->item_num - n;
+}
+
+static void swServer_heartbeat_onPeek(swTimeWheel *wheel, swTimeWheel_node *node)
+{
+    swHeartbeat_context *context = wheel->ptr;
+    swConnection *conn = swServer_heartbeat_conn(node);
+
+    if (swServer_heartbeat_is_idle(context->serv, conn, context->now))
+    {
+        swArray_append(context->fds, &conn->fd);
+    }
+}
+
+/**
+ * the same result as swServer_heartbeat_expire(), without moving anything on the wheel:
+ * for swoole_server::heartbeat(), the wheel stays as the heartbeat check of its reactor left it
+ * @return the number of idle connections
+ */
+int swServer_heartbeat_idle(swServer *serv, uint16_t reactor_id, time_t now, swArray *fds)
+{
+    swHeartbeat_context context;
+    uint32_t n = fds->item_num;
+    int interval = serv->heartbeat_check_interval > 0 ? serv->heartbeat_check_interval : 1;
+
+    if (serv->idle_wheels == NULL || reactor_id >= serv->idle_wheel_num)
+    {
+        return 0;
+    }
+    swIdleWheel *idle = &serv->idle_wheels[reactor_id];
+    context.serv = serv;
+    context.now = now;
+    context.fds = fds;
+
+    idle->lock.lock(&idle->lock);
+    idle->wheel.ptr = &context;
+    //connections already reported by the reactor wait on the wheel until its next check
+    swTimeWheel_peek(&idle->wheel, ((int64_t) now + interval) * 1000, swServer_heartbeat_onPeek);
+    idle->wheel.ptr = NULL;
+    idle->lock.unlock(&idle->lock);
+
+    return fds->item_num - n;
+}
@@ -0,0 +1,279 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "swoole.h"
+#include "Server.h"
+
+#include <stdarg.h>
+#include <limits.h>
+
+#define SW_STATS_LINE_SIZE   512
+
+static const char *prom_latency_name = "swoole_worker_request_duration_seconds";
+
+/**
+ * the segment lives in shared memory, so it must be created before the workers are forked
+ */
+int swServer_stats_init(swServer *serv)
+{
+    serv->worker_stats = sw_shm_calloc(serv->worker_num, sizeof(swWorkerStats));
+    if (serv->worker_stats == NULL)
+    {
+        swWarn("sw_shm_calloc(%ld) failed.", serv->worker_num * sizeof(swWorkerStats));
+        return SW_ERR;
+    }
+    return SW_OK;
+}
+
+void swServer_stats_free(swServer *serv)
+{
+    if (serv->worker_stats)
+    {
+        sw_shm_free(serv->worker_stats);
+        serv->worker_stats = NULL;
+    }
+}
+
+/**
+ * copy the counters without blocking the writer, retry while it is inside
+ */
+static void swServer_stats_read(sw_atomic_t *version, void *dst, void *src, size_t size)
+{
+    uint32_t begin;
+    do
+    {
+        while ((begin = *version) & 1)
+        {
+            sw_atomic_cpu_pause();
+        }
+        sw_atomic_read_barrier();
+        memcpy(dst, src, size);
+        sw_atomic_read_barrier();
+    } while (*version != begin);
+}
+
+void swServer_stats_worker(swServer *serv, uint32_t worker_id, swWorkerStats *stats)
+{
+    swWorkerStats *src = &serv->worker_stats[worker_id];
+    swServer_stats_read(&src->version, stats, src, sizeof(swWorkerStats));
+}
+
+/**
+ * upper bound in microseconds of the bucket holding the given percent of the requests, 0 if none
+ */
+uint32_t swWorkerStats_percentile(swWorkerStats *stats, double percent)
+{
+    uint64_t total = 0, count = 0;
+    int i;
+
+    for (i = 0; i < SW_STATS_LATENCY_BUCKETS; i++)
+    {
+        total += stats->latency[i];
+    }
+    if (total == 0)
+    {
+        return 0;
+    }
+    for (i = 0; i < SW_STATS_LATENCY_BUCKETS - 1; i++)
+    {
+        count += stats->latency[i];
+        if (count >= total * percent / 100)
+        {
+            break;
+        }
+    }
+    return 2U << i;
+}
+
+/**
+ * only dispatch_mode = SW_DISPATCH_LEASTREQ counts the requests dispatched to a worker and not handled yet
+ */
+static sw_inline int swServer_stats_has_inflight(swServer *serv)
+{
+    return serv->dispatch_mode == SW_DISPATCH_LEASTREQ && serv->workers;
+}
+
+static void swServer_stats_printf(swString *buffer, const char *format, ...)
+{
+    char line[SW_STATS_LINE_SIZE];
+    va_list args;
+    int n;
+
+    va_start(args, format);
+    n = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (n > 0)
+    {
+        swString_append_ptr(buffer, line, n < sizeof(line) ? n : sizeof(line) - 1);
+    }
+}
+
+static void swServer_stats_dump_text(swServer *serv, swString *buffer)
+{
+    swWorkerStats worker;
+    uint64_t count;
+    int i, j;
+
+    swServer_stats_printf(buffer, "start_time %ld\n", (long) SwooleStats->start_time);
+    swServer_stats_printf(buffer, "connection_num %u\n", SwooleStats->connection_num);
+    swServer_stats_printf(buffer, "accept_count %u\n", SwooleStats->accept_count);
+    swServer_stats_printf(buffer, "close_count %u\n", SwooleStats->close_count);
+    swServer_stats_printf(buffer, "tasking_num %u\n", SwooleStats->tasking_num);
+    swServer_stats_printf(buffer, "request_count %u\n", SwooleStats->request_count);
+
+    for (i = 0; serv->worker_stats && i < serv->worker_num; i++)
+    {
+        swServer_stats_worker(serv, i, &worker);
+        for (j = 0, count = 0; j < SW_STATS_LATENCY_BUCKETS; j++)
+        {
+            count += worker.latency[j];
+        }
+        swServer_stats_printf(buffer, "worker[%d] request_count=%lu bytes_in=%lu bytes_out=%lu "
+                "latency_avg_usec=%lu latency_p50_usec=%u latency_p99_usec=%u", i,
+                (unsigned long) worker.request_count, (unsigned long) worker.bytes_in, (unsigned long) worker.bytes_out,
+                (unsigned long) (count ? worker.latency_usec / count : 0),
+                swWorkerStats_percentile(&worker, 50), swWorkerStats_percentile(&worker, 99));
+        if (swServer_stats_has_inflight(serv))
+        {
+            swServer_stats_printf(buffer, " inflight=%u", serv->workers[i].inflight_num);
+        }
+        swServer_stats_printf(buffer, "\n");
+    }
+}
+
+static void swServer_stats_dump_prometheus(swServer *serv, swString *buffer)
+{
+    swWorkerStats *workers;
+    uint64_t count;
+    int i, j;
+
+    swServer_stats_printf(buffer, "# TYPE swoole_start_time_seconds gauge\nswoole_start_time_seconds %ld\n", (long) SwooleStats->start_time);
+    swServer_stats_printf(buffer, "# TYPE swoole_connections gauge\nswoole_connections %u\n", SwooleStats->connection_num);
+    swServer_stats_printf(buffer, "# TYPE swoole_accept_total counter\nswoole_accept_total %u\n", SwooleStats->accept_count);
+    swServer_stats_printf(buffer, "# TYPE swoole_close_total counter\nswoole_close_total %u\n", SwooleStats->close_count);
+    swServer_stats_printf(buffer, "# TYPE swoole_tasking gauge\nswoole_tasking %u\n", SwooleStats->tasking_num);
+    swServer_stats_printf(buffer, "# TYPE swoole_requests_total counter\nswoole_requests_total %u\n", SwooleStats->request_count);
+
+    //the samples of a metric must be contiguous, take the snapshots first
+    if (serv->worker_stats == NULL)
+    {
+        return;
+    }
+    workers = sw_malloc(serv->worker_num * sizeof(swWorkerStats));
+    if (workers == NULL)
+    {
+        return;
+    }
+    for (i = 0; i < serv->worker_num; i++)
+    {
+        swServer_stats_worker(serv, i, &workers[i]);
+    }
+
+    swServer_stats_printf(buffer, "# TYPE swoole_worker_requests_total counter\n");
+    for (i = 0; i < serv->worker_num; i++)
+    {
+        swServer_stats_printf(buffer, "swoole_worker_requests_total{worker=\"%d\"} %lu\n", i, (unsigned long) workers[i].request_count);
+    }
+    if (swServer_stats_has_inflight(serv))
+    {
+        swServer_stats_printf(buffer, "# TYPE swoole_worker_inflight gauge\n");
+        for (i = 0; i < serv->worker_num; i++)
+        {
+            swServer_stats_printf(buffer, "swoole_worker_inflight{worker=\"%d\"} %u\n", i, serv->workers[i].inflight_num);
+        }
+    }
+    swServer_stats_printf(buffer, "# TYPE swoole_worker_bytes_in_total counter\n");
+    for (i = 0; i < serv->worker_num; i++)
+    {
+        swServer_stats_printf(buffer, "swoole_worker_bytes_in_total{worker=\"%d\"} %lu\n", i, (unsigned long) workers[i].bytes_in);
+    }
+    swServer_stats_printf(buffer, "# TYPE swoole_worker_bytes_out_total counter\n");
+    for (i = 0; i < serv->worker_num; i++)
+    {
+        swServer_stats_printf(buffer, "swoole_worker_bytes_out_total{worker=\"%d\"} %lu\n", i, (unsigned long) workers[i].bytes_out);
+    }
+
+    swServer_stats_printf(buffer, "# TYPE %s histogram\n", prom_latency_name);
+    for (i = 0; i < serv->worker_num; i++)
+    {
+        //buckets are cumulative, the last one is only counted in +Inf
+        for (j = 0, count = 0; j < SW_STATS_LATENCY_BUCKETS - 1; j++)
+        {
+            count += workers[i].latency[j];
+            swServer_stats_printf(buffer, "%s_bucket{worker=\"%d\",le=\"%g\"} %lu\n", prom_latency_name, i,
+                    (double) (2U << j) / 1000000, (unsigned long) count);
+        }
+        count += workers[i].latency[SW_STATS_LATENCY_BUCKETS - 1];
+        swServer_stats_printf(buffer, "%s_bucket{worker=\"%d\",le=\"+Inf\"} %lu\n"
+                "%s_sum{worker=\"%d\"} %g\n%s_count{worker=\"%d\"} %lu\n",
+                prom_latency_name, i, (unsigned long) count,
+                prom_latency_name, i, (double) workers[i].latency_usec / 1000000,
+                prom_latency_name, i, (unsigned long) count);
+    }
+
+    sw_free(workers);
+}
+
+/**
+ * SW_STATS_TEXT: one line per counter, a line per reactor and per worker
+ * SW_STATS_PROMETHEUS: the Prometheus text exposition format
+ */
+int swServer_stats_dump(swServer *serv, swString *buffer, int format)
+{
+    if (format == SW_STATS_PROMETHEUS)
+    {
+        swServer_stats_dump_prometheus(serv, buffer);
+    }
+    else
+    {
+        swServer_stats_dump_text(serv, buffer);
+    }
+    return buffer->length;
+}
+
+/**
+ * called by the manager, readers of the file never see it half written
+ */
+int swServer_stats_dump_file(swServer *serv, char *file, int format)
+{
+    char tmp_file[PATH_MAX];
+    int ret;
+
+    if (snprintf(tmp_file, sizeof(tmp_file), "%s.tmp", file) >= sizeof(tmp_file))
+    {
+        swWarn("stats_file %s is too long.", file);
+        return SW_ERR;
+    }
+    swString *buffer = swString_new(SW_BUFFER_SIZE_STD);
+    if (buffer == NULL)
+    {
+        return SW_ERR;
+    }
+    swServer_stats_dump(serv, buffer, format);
+    ret = swoole_file_put_contents(tmp_file, buffer->str, buffer->length);
+    swString_free(buffer);
+    if (ret < 0)
+    {
+        return SW_ERR;
+    }
+    if (rename(tmp_file, file) < 0)
+    {
+        swSysError("rename(%s, %s) failed.", tmp_file, file);
+        unlink(tmp_file);
+        return SW_ERR;
+    }
+    return SW_OK;
+}
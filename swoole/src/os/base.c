@@ -52,6 +52,18 @@ int swAio_init(void)
     case SW_AIO_LINUX:
         ret = swAioLinux_init(SW_AIO_EVENT_NUM);
         break;
+#endif
+#ifdef HAVE_IO_URING
+    case SW_AIO_URING:
+        ret = swAioUring_init(SW_AIO_EVENT_NUM);
+        //kernel too old, io_uring disabled or the read/write opcodes missing, use the thread pool
+        if (ret < 0)
+        {
+            swWarn("io_uring is not available, fall back to the thread pool.");
+            SwooleAIO.mode = SW_AIO_BASE;
+            ret = swAioBase_init(SW_AIO_EVENT_NUM);
+        }
+        break;
 #endif
     default:
         ret = swAioBase_init(SW_AIO_EVENT_NUM);
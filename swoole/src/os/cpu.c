@@ -0,0 +1,292 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "swoole.h"
+
+#ifdef __linux__
+#include <dirent.h>
+#include <sys/syscall.h>
+#endif
+
+/**
+ * from linux/mempolicy.h, numaif.h is not always installed
+ */
+#define SW_MPOL_PREFERRED    1
+
+#define SW_ULONG_BITS        (8 * sizeof(unsigned long))
+
+/**
+ * "0-3,8,10-11" as written by the kernel in sysfs and procfs
+ * @return the number of cpus stored
+ */
+int swoole_cpulist_parse(char *str, int *cpus, int size)
+{
+    char *p = str;
+    long start, end;
+    int n = 0;
+
+    while (*p && *p != '\n')
+    {
+        if (!isdigit(*p))
+        {
+            return SW_ERR;
+        }
+        start = strtol(p, &p, 10);
+        end = start;
+        if (*p == '-')
+        {
+            end = strtol(p + 1, &p, 10);
+        }
+        for (; start <= end && n < size; start++)
+        {
+            cpus[n++] = start;
+        }
+        if (*p == ',')
+        {
+            p++;
+        }
+    }
+    return n;
+}
+
+#ifdef __linux__
+static int swoole_read_cpulist(char *file, int *cpus, int size)
+{
+    char line[4096];
+    FILE *fp = fopen(file, "r");
+    int n = SW_ERR;
+
+    if (fp == NULL)
+    {
+        return SW_ERR;
+    }
+    if (fgets(line, sizeof(line), fp))
+    {
+        n = swoole_cpulist_parse(line, cpus, size);
+    }
+    fclose(fp);
+    return n;
+}
+#endif
+
+/**
+ * read the NUMA node of every online cpu from /sys, a kernel without NUMA has everything on node 0
+ */
+int swCpuTopology_load(swCpuTopology *topology)
+{
+#ifdef __linux__
+    int cpus[SW_CPU_TOPOLOGY_MAX];
+    char file[128];
+    int i, n, node;
+
+    for (i = 0; i < SW_CPU_TOPOLOGY_MAX; i++)
+    {
+        topology->cpu_node[i] = -1;
+    }
+    topology->cpu_max = 0;
+    topology->node_num = 0;
+
+    //node ids may have holes
+    for (node = 0; node < SW_NUMA_NODE_MAX; node++)
+    {
+        snprintf(file, sizeof(file), "/sys/devices/system/node/node%d/cpulist", node);
+        n = swoole_read_cpulist(file, cpus, SW_CPU_TOPOLOGY_MAX);
+        if (n < 0)
+        {
+            continue;
+        }
+        for (i = 0; i < n; i++)
+        {
+            if (cpus[i] < SW_CPU_TOPOLOGY_MAX)
+            {
+                topology->cpu_node[cpus[i]] = node;
+            }
+        }
+        topology->node_num = node + 1;
+    }
+    if (topology->node_num == 0)
+    {
+        n = swoole_read_cpulist("/sys/devices/system/cpu/online", cpus, SW_CPU_TOPOLOGY_MAX);
+        if (n <= 0)
+        {
+            swWarn("cannot read the cpu topology.");
+            return SW_ERR;
+        }
+        for (i = 0; i < n; i++)
+        {
+            if (cpus[i] < SW_CPU_TOPOLOGY_MAX)
+            {
+                topology->cpu_node[cpus[i]] = 0;
+            }
+        }
+        topology->node_num = 1;
+    }
+    for (i = 0; i < SW_CPU_TOPOLOGY_MAX; i++)
+    {
+        if (topology->cpu_node[i] >= 0)
+        {
+            topology->cpu_max = i + 1;
+        }
+    }
+    return SW_OK;
+#else
+    swWarn("the cpu topology is only available on Linux.");
+    return SW_ERR;
+#endif
+}
+
+#ifdef __linux__
+static int swoole_irq_cpu(int irq)
+{
+    char file[128];
+    int cpu;
+
+    snprintf(file, sizeof(file), "/proc/irq/%d/effective_affinity_list", irq);
+    if (swoole_read_cpulist(file, &cpu, 1) == 1)
+    {
+        return cpu;
+    }
+    snprintf(file, sizeof(file), "/proc/irq/%d/smp_affinity_list", irq);
+    if (swoole_read_cpulist(file, &cpu, 1) == 1)
+    {
+        return cpu;
+    }
+    return SW_ERR;
+}
+
+static int swoole_irq_compare(const void *a, const void *b)
+{
+    return *(int *) a - *(int *) b;
+}
+
+/**
+ * the interrupt name of a queue is the device followed by '-', e.g. eth1-TxRx-0, or the device alone,
+ * eth1 must not match eth10-TxRx-0 or veth1-rx
+ */
+static char* swoole_irq_device_name(char *line, char *device)
+{
+    size_t len = strlen(device);
+    char *name = line;
+
+    while ((name = strstr(name, device)) != NULL)
+    {
+        if ((name == line || isspace(name[-1])) && (name[len] == '-' || name[len] == '\0' || isspace(name[len])))
+        {
+            return name;
+        }
+        name++;
+    }
+    return NULL;
+}
+#endif
+
+/**
+ * the cpu serving each RX queue of the network device, in queue order.
+ * the queue irqs are found by name in /proc/interrupts ("eth0-TxRx-3", "eth0-rx-3"),
+ * drivers naming them after the PCI device are found through /sys/class/net/<device>/device/msi_irqs
+ * @return the number of queues
+ */
+int swCpuTopology_irq_cpus(char *device, int *cpus, int size)
+{
+#ifdef __linux__
+    char line[8192], path[256];
+    int irqs[SW_CPU_TOPOLOGY_MAX];
+    int i, n = 0, cpu;
+    char *name;
+    FILE *fp;
+    DIR *dir;
+    struct dirent *entry;
+
+    fp = fopen("/proc/interrupts", "r");
+    if (fp == NULL)
+    {
+        swSysError("fopen(/proc/interrupts) failed.");
+        return SW_ERR;
+    }
+    while (n < SW_CPU_TOPOLOGY_MAX && fgets(line, sizeof(line), fp))
+    {
+        if (!isdigit(line[strspn(line, " ")]))
+        {
+            continue;
+        }
+        name = swoole_irq_device_name(line, device);
+        //transmit-only queues do not receive
+        if (name == NULL || (strstr(name, "-tx-") && !strstr(name, "rx")))
+        {
+            continue;
+        }
+        irqs[n++] = atoi(line);
+    }
+    fclose(fp);
+
+    if (n == 0)
+    {
+        snprintf(path, sizeof(path), "/sys/class/net/%s/device/msi_irqs", device);
+        dir = opendir(path);
+        if (dir == NULL)
+        {
+            swWarn("no interrupt of network device '%s' is found.", device);
+            return SW_ERR;
+        }
+        while (n < SW_CPU_TOPOLOGY_MAX && (entry = readdir(dir)) != NULL)
+        {
+            if (isdigit(entry->d_name[0]))
+            {
+                irqs[n++] = atoi(entry->d_name);
+            }
+        }
+        closedir(dir);
+        qsort(irqs, n, sizeof(int), swoole_irq_compare);
+    }
+
+    int num = 0;
+    for (i = 0; i < n && num < size; i++)
+    {
+        cpu = swoole_irq_cpu(irqs[i]);
+        if (cpu >= 0)
+        {
+            cpus[num++] = cpu;
+        }
+    }
+    return num;
+#else
+    return SW_ERR;
+#endif
+}
+
+/**
+ * the memory the calling process allocates from now on comes from the node first
+ */
+int swoole_set_mempolicy_node(int node)
+{
+#if defined(__linux__) && defined(SYS_set_mempolicy)
+    unsigned long nodemask[SW_NUMA_NODE_MAX / SW_ULONG_BITS] = {0};
+
+    if (node < 0 || node >= SW_NUMA_NODE_MAX)
+    {
+        return SW_ERR;
+    }
+    nodemask[node / SW_ULONG_BITS] |= 1UL << (node % SW_ULONG_BITS);
+    if (syscall(SYS_set_mempolicy, SW_MPOL_PREFERRED, nodemask, SW_NUMA_NODE_MAX + 1) < 0)
+    {
+        swSysError("set_mempolicy(node=%d) failed.", node);
+        return SW_ERR;
+    }
+    return SW_OK;
+#else
+    return SW_ERR;
+#endif
+}
@@ -0,0 +1,459 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "swoole.h"
+#include "async.h"
+
+#ifdef HAVE_IO_URING
+
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <linux/io_uring.h>
+
+typedef struct
+{
+    int fd;
+    uint32_t entries;
+
+    uint32_t *sq_head;
+    uint32_t *sq_tail;
+    uint32_t *sq_mask;
+    uint32_t *sq_array;
+    struct io_uring_sqe *sqes;
+
+    uint32_t *cq_head;
+    uint32_t *cq_tail;
+    uint32_t *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+
+    /**
+     * operations queued and not yet reaped, never more than the completion queue can hold
+     */
+    uint32_t inflight;
+    uint32_t cq_entries;
+    /**
+     * queued in the submission ring, not yet taken by the kernel
+     */
+    uint32_t pending;
+    uint8_t flush_deferred;
+    uint8_t reaping;
+} swAioUring;
+
+static swAioUring swoole_aio_uring;
+static int swoole_aio_eventfd;
+
+static int swAioUring_onFinish(swReactor *reactor, swEvent *event);
+static int swAioUring_read(int fd, void *outbuf, size_t size, off_t offset);
+static int swAioUring_write(int fd, void *inbuf, size_t size, off_t offset);
+static void swAioUring_flush(void *data);
+static void swAioUring_destroy();
+
+static sw_inline int io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static sw_inline int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static sw_inline int io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/**
+ * IORING_OP_READ/WRITE came with 5.6, older rings accept io_uring_setup and fail every request with EINVAL
+ */
+static int swAioUring_probe(swAioUring *ring)
+{
+    int opcodes[] = {IORING_OP_READ, IORING_OP_WRITE};
+    struct io_uring_probe *probe;
+    size_t size = sizeof(struct io_uring_probe) + sizeof(struct io_uring_probe_op) * 256;
+    int i, ret = SW_OK;
+
+    probe = sw_calloc(1, size);
+    if (probe == NULL)
+    {
+        return SW_ERR;
+    }
+    if (io_uring_register(ring->fd, IORING_REGISTER_PROBE, probe, 256) < 0)
+    {
+        swWarn("io_uring_register(IORING_REGISTER_PROBE) failed. Error: %s[%d]", strerror(errno), errno);
+        sw_free(probe);
+        return SW_ERR;
+    }
+    for (i = 0; i < sizeof(opcodes) / sizeof(opcodes[0]); i++)
+    {
+        if (opcodes[i] > probe->last_op || !(probe->ops[opcodes[i]].flags & IO_URING_OP_SUPPORTED))
+        {
+            swWarn("io_uring opcode %d is not supported.", opcodes[i]);
+            ret = SW_ERR;
+            break;
+        }
+    }
+    sw_free(probe);
+    return ret;
+}
+
+int swAioUring_init(int max_aio_events)
+{
+    struct io_uring_params params;
+    swAioUring *ring = &swoole_aio_uring;
+    char *ptr;
+
+    bzero(ring, sizeof(swAioUring));
+    bzero(&params, sizeof(params));
+
+    ring->fd = io_uring_setup(max_aio_events, &params);
+    if (ring->fd < 0)
+    {
+        swWarn("io_uring_setup() failed. Error: %s[%d]", strerror(errno), errno);
+        return SW_ERR;
+    }
+
+    if (swAioUring_probe(ring) < 0)
+    {
+        goto _close;
+    }
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if ((params.features & IORING_FEAT_SINGLE_MMAP) && ring->cq_ring_size > ring->sq_ring_size)
+    {
+        ring->sq_ring_size = ring->cq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+            IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED)
+    {
+        swWarn("mmap(IORING_OFF_SQ_RING) failed. Error: %s[%d]", strerror(errno), errno);
+        goto _close;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        ring->cq_ring = ring->sq_ring;
+    }
+    else
+    {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED)
+        {
+            swWarn("mmap(IORING_OFF_CQ_RING) failed. Error: %s[%d]", strerror(errno), errno);
+            munmap(ring->sq_ring, ring->sq_ring_size);
+            goto _close;
+        }
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+            IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+    {
+        swWarn("mmap(IORING_OFF_SQES) failed. Error: %s[%d]", strerror(errno), errno);
+        goto _unmap;
+    }
+
+    ptr = ring->sq_ring;
+    ring->sq_head = (uint32_t *) (ptr + params.sq_off.head);
+    ring->sq_tail = (uint32_t *) (ptr + params.sq_off.tail);
+    ring->sq_mask = (uint32_t *) (ptr + params.sq_off.ring_mask);
+    ring->sq_array = (uint32_t *) (ptr + params.sq_off.array);
+    ptr = ring->cq_ring;
+    ring->cq_head = (uint32_t *) (ptr + params.cq_off.head);
+    ring->cq_tail = (uint32_t *) (ptr + params.cq_off.tail);
+    ring->cq_mask = (uint32_t *) (ptr + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (ptr + params.cq_off.cqes);
+    ring->entries = params.sq_entries;
+    ring->cq_entries = params.cq_entries;
+
+    if (swPipeNotify_auto(&swoole_aio_pipe, 0, 0) < 0)
+    {
+        munmap(ring->sqes, ring->sqes_size);
+        goto _unmap;
+    }
+    swoole_aio_eventfd = swoole_aio_pipe.getFd(&swoole_aio_pipe, 0);
+    if (io_uring_register(ring->fd, IORING_REGISTER_EVENTFD, &swoole_aio_eventfd, 1) < 0)
+    {
+        swWarn("io_uring_register(IORING_REGISTER_EVENTFD) failed. Error: %s[%d]", strerror(errno), errno);
+        swoole_aio_pipe.close(&swoole_aio_pipe);
+        munmap(ring->sqes, ring->sqes_size);
+        goto _unmap;
+    }
+
+    SwooleG.main_reactor->setHandle(SwooleG.main_reactor, SW_FD_AIO, swAioUring_onFinish);
+    SwooleG.main_reactor->add(SwooleG.main_reactor, swoole_aio_eventfd, SW_FD_AIO);
+
+    SwooleAIO.callback = swAio_callback_test;
+    SwooleAIO.destroy = swAioUring_destroy;
+    SwooleAIO.read = swAioUring_read;
+    SwooleAIO.write = swAioUring_write;
+
+    return SW_OK;
+
+    _unmap:
+    if (ring->cq_ring != ring->sq_ring && ring->cq_ring)
+    {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    _close:
+    close(ring->fd);
+    ring->fd = -1;
+    return SW_ERR;
+}
+
+static struct io_uring_sqe* swAioUring_get_sqe(swAioUring *ring)
+{
+    uint32_t tail = *ring->sq_tail;
+    uint32_t head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    struct io_uring_sqe *sqe;
+
+    if (tail - head >= ring->entries || ring->inflight >= ring->cq_entries)
+    {
+        swWarn("too many aio requests, the io_uring is full.");
+        return NULL;
+    }
+    sqe = &ring->sqes[tail & *ring->sq_mask];
+    bzero(sqe, sizeof(struct io_uring_sqe));
+    return sqe;
+}
+
+/**
+ * the kernel takes everything queued in this loop iteration with one io_uring_enter,
+ * from the defer callback or after the completions have been reaped
+ */
+static void swAioUring_flush(void *data)
+{
+    swAioUring *ring = &swoole_aio_uring;
+    swAio_event **failed;
+    uint32_t tail, i, n;
+    int ret, error;
+
+    ring->flush_deferred = 0;
+    if (ring->pending == 0)
+    {
+        return;
+    }
+    ret = io_uring_enter(ring->fd, ring->pending, 0, 0);
+    error = ret < 0 ? errno : 0;
+    /**
+     * partly taken or out of kernel resources: the next completion flushes the rest,
+     * with nothing in the kernel to complete, try again in the next loop iteration
+     */
+    if (ret >= 0 || error == EAGAIN || error == EBUSY || error == EINTR)
+    {
+        if (ret > 0)
+        {
+            ring->pending -= ret;
+        }
+        if (ring->pending > 0 && ring->inflight == ring->pending)
+        {
+            SwooleG.main_reactor->defer(SwooleG.main_reactor, swAioUring_flush, NULL);
+            ring->flush_deferred = 1;
+        }
+        return;
+    }
+    swWarn("io_uring_enter() failed. Error: %s[%d]", strerror(error), error);
+
+    //take back what the kernel did not consume and fail it, the callbacks may queue new requests
+    n = ring->pending;
+    failed = sw_malloc(sizeof(swAio_event *) * n);
+    if (failed == NULL)
+    {
+        return;
+    }
+    tail = *ring->sq_tail - n;
+    for (i = 0; i < n; i++)
+    {
+        failed[i] = (swAio_event *) (uintptr_t) ring->sqes[ring->sq_array[(tail + i) & *ring->sq_mask]].user_data;
+    }
+    __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+    ring->pending = 0;
+    ring->inflight -= n;
+    SwooleAIO.task_num -= n;
+    for (i = 0; i < n; i++)
+    {
+        failed[i]->ret = -1;
+        failed[i]->error = error;
+        SwooleAIO.callback(failed[i]);
+        sw_free(failed[i]);
+    }
+    sw_free(failed);
+}
+
+static int swAioUring_submit(swAioUring *ring, struct io_uring_sqe *sqe, swAio_event *aio_ev)
+{
+    uint32_t tail = *ring->sq_tail;
+    int idle = ring->inflight == 0 && !ring->reaping;
+
+    aio_ev->task_id = SwooleAIO.current_id++;
+    sqe->user_data = (uint64_t) (uintptr_t) aio_ev;
+    ring->sq_array[tail & *ring->sq_mask] = sqe - ring->sqes;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    /**
+     * nothing in flight, no completion would flush it: submit now, so the error can still be returned
+     */
+    if (idle)
+    {
+        if (io_uring_enter(ring->fd, 1, 0, 0) < 0)
+        {
+            swWarn("io_uring_enter() failed. Error: %s[%d]", strerror(errno), errno);
+            //the kernel did not consume it, take the entry back
+            __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+            sw_free(aio_ev);
+            return SW_ERR;
+        }
+    }
+    else
+    {
+        ring->pending++;
+        if (!ring->flush_deferred && !ring->reaping)
+        {
+            SwooleG.main_reactor->defer(SwooleG.main_reactor, swAioUring_flush, NULL);
+            ring->flush_deferred = 1;
+        }
+    }
+    ring->inflight++;
+    SwooleAIO.task_num++;
+    return aio_ev->task_id;
+}
+
+static int swAioUring_onFinish(swReactor *reactor, swEvent *event)
+{
+    swAioUring *ring = &swoole_aio_uring;
+    struct io_uring_cqe *cqe;
+    swAio_event *aio_ev;
+    uint64_t notify;
+    uint32_t head, tail;
+
+    if (read(event->fd, &notify, sizeof(notify)) < 0 && errno != EAGAIN)
+    {
+        swWarn("read() failed. Error: %s[%d]", strerror(errno), errno);
+        return SW_ERR;
+    }
+
+    ring->reaping = 1;
+    head = *ring->cq_head;
+    while (1)
+    {
+        tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        if (head == tail)
+        {
+            break;
+        }
+        cqe = &ring->cqes[head & *ring->cq_mask];
+        aio_ev = (swAio_event *) (uintptr_t) cqe->user_data;
+        if (cqe->res < 0)
+        {
+            aio_ev->error = -cqe->res;
+            aio_ev->ret = -1;
+        }
+        else
+        {
+            aio_ev->ret = cqe->res;
+        }
+        head++;
+        //release the slot before the callback, it may submit new requests
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+        ring->inflight--;
+        SwooleAIO.task_num--;
+
+        if (aio_ev->type == SW_AIO_READ || aio_ev->type == SW_AIO_WRITE)
+        {
+            aio_ev->nbytes = aio_ev->ret;
+        }
+        SwooleAIO.callback(aio_ev);
+        sw_free(aio_ev);
+    }
+    ring->reaping = 0;
+    //the callbacks usually queue the next requests
+    swAioUring_flush(NULL);
+    return SW_OK;
+}
+
+static void swAioUring_destroy()
+{
+    swAioUring *ring = &swoole_aio_uring;
+
+    if (ring->fd < 0)
+    {
+        return;
+    }
+    SwooleG.main_reactor->del(SwooleG.main_reactor, swoole_aio_eventfd);
+    swoole_aio_pipe.close(&swoole_aio_pipe);
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring != ring->sq_ring)
+    {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+    ring->fd = -1;
+}
+
+static int swAioUring_rw(int type, int fd, void *buf, size_t size, off_t offset)
+{
+    swAioUring *ring = &swoole_aio_uring;
+    struct io_uring_sqe *sqe;
+
+    swAio_event *aio_ev = (swAio_event *) sw_calloc(1, sizeof(swAio_event));
+    if (aio_ev == NULL)
+    {
+        swWarn("malloc failed.");
+        return SW_ERR;
+    }
+    sqe = swAioUring_get_sqe(ring);
+    if (sqe == NULL)
+    {
+        sw_free(aio_ev);
+        return SW_ERR;
+    }
+    aio_ev->fd = fd;
+    aio_ev->type = type;
+    aio_ev->buf = buf;
+    aio_ev->nbytes = size;
+    aio_ev->offset = offset;
+
+    sqe->opcode = type == SW_AIO_READ ? IORING_OP_READ : IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t) (uintptr_t) buf;
+    sqe->len = size;
+    sqe->off = offset;
+
+    return swAioUring_submit(ring, sqe, aio_ev);
+}
+
+static int swAioUring_read(int fd, void *outbuf, size_t size, off_t offset)
+{
+    return swAioUring_rw(SW_AIO_READ, fd, outbuf, size, offset);
+}
+
+static int swAioUring_write(int fd, void *inbuf, size_t size, off_t offset)
+{
+    return swAioUring_rw(SW_AIO_WRITE, fd, inbuf, size, offset);
+}
+
+#endif
@@ -0,0 +1,308 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "swoole.h"
+#include "Server.h"
+
+/**
+ * Ring in shared memory with a single consumer.
+ * The reactor threads write, one worker process reads. A packet is copied into the ring once,
+ * no matter how large it is, so there is no SW_EVENT_PACKAGE_START/END fragmentation.
+ * The eventfd is only written when the consumer has declared itself idle.
+ */
+typedef struct _swPipeRing
+{
+    uint32_t size;
+    uint32_t mask;
+
+    /**
+     * consumer side
+     */
+    volatile uint32_t head __attribute__((aligned(SW_CACHELINE_SIZE)));
+    sw_atomic_t waiting;
+
+    /**
+     * producer side, the reactor threads take the lock in turn
+     */
+    volatile uint32_t tail __attribute__((aligned(SW_CACHELINE_SIZE)));
+    sw_atomic_t lock;
+
+    swPipe notify __attribute__((aligned(SW_CACHELINE_SIZE)));
+    char data[0];
+} swPipeRing;
+
+typedef struct _swPipeRing_item
+{
+    uint32_t length;
+    char data[0];
+} swPipeRing_item;
+
+#define SW_PIPE_RING_ALIGN(n)      (((n) + 7) & ~7)
+#define swPipeRing_used(r)         ((r)->tail - (r)->head)
+#define swPipeRing_empty(r)        ((r)->tail == (r)->head)
+
+static int swPipeRing_read(swPipe *p, void *data, int length);
+static int swPipeRing_write(swPipe *p, void *data, int length);
+static int swPipeRing_getFd(swPipe *p, int isWriteFd);
+static int swPipeRing_close(swPipe *p);
+
+int swPipeRing_create(swPipe *p, int blocking, uint32_t size)
+{
+    uint32_t real_size = 1024;
+    while (real_size < size)
+    {
+        real_size <<= 1;
+    }
+    if (real_size > (1u << 31))
+    {
+        swWarn("ring size[%u] is too large.", size);
+        return SW_ERR;
+    }
+
+    swPipeRing *object = sw_shm_malloc(sizeof(swPipeRing) + real_size);
+    if (object == NULL)
+    {
+        swWarn("sw_shm_malloc(%ld) failed.", sizeof(swPipeRing) + real_size);
+        return SW_ERR;
+    }
+    bzero(object, sizeof(swPipeRing));
+    object->size = real_size;
+    object->mask = real_size - 1;
+    //the consumer has not read yet, the first packet must wake it up
+    object->waiting = 1;
+
+    if (swPipeNotify_auto(&object->notify, blocking, 0) < 0)
+    {
+        swWarn("notify_fd init failed.");
+        sw_shm_free(object);
+        return SW_ERR;
+    }
+
+    p->blocking = blocking;
+    p->timeout = -1;
+    p->object = object;
+    p->read = swPipeRing_read;
+    p->write = swPipeRing_write;
+    p->getFd = swPipeRing_getFd;
+    p->close = swPipeRing_close;
+    return SW_OK;
+}
+
+static sw_inline void swPipeRing_copy_in(swPipeRing *object, uint32_t offset, void *src, uint32_t n)
+{
+    uint32_t index = offset & object->mask;
+    uint32_t first = object->size - index;
+    if (n <= first)
+    {
+        memcpy(object->data + index, src, n);
+    }
+    else
+    {
+        memcpy(object->data + index, src, first);
+        memcpy(object->data, (char *) src + first, n - first);
+    }
+}
+
+static sw_inline void swPipeRing_copy_out(swPipeRing *object, uint32_t offset, void *dst, uint32_t n)
+{
+    uint32_t index = offset & object->mask;
+    uint32_t first = object->size - index;
+    if (n <= first)
+    {
+        memcpy(dst, object->data + index, n);
+    }
+    else
+    {
+        memcpy(dst, object->data + index, first);
+        memcpy((char *) dst + first, object->data, n - first);
+    }
+}
+
+/**
+ * return packet length, 0 when the ring is empty
+ */
+static int swPipeRing_pop(swPipeRing *object, void *data, int length)
+{
+    uint32_t head = object->head;
+    if (head == object->tail)
+    {
+        return 0;
+    }
+    //read the payload only after seeing the tail
+    sw_atomic_memory_barrier();
+
+    uint32_t n;
+    swPipeRing_copy_out(object, head, &n, sizeof(n));
+    uint32_t msize = SW_PIPE_RING_ALIGN(sizeof(swPipeRing_item) + n);
+    int ret;
+
+    if (n > length)
+    {
+        swWarn("packet is too big, length=%d, buffer_length=%d.", n, length);
+        errno = EMSGSIZE;
+        ret = SW_ERR;
+    }
+    else
+    {
+        swPipeRing_copy_out(object, head + sizeof(swPipeRing_item), data, n);
+        ret = n;
+    }
+
+    sw_atomic_memory_barrier();
+    object->head = head + msize;
+    return ret;
+}
+
+static int swPipeRing_read(swPipe *p, void *data, int length)
+{
+    swPipeRing *object = p->object;
+    uint64_t flag;
+    int ret;
+
+    while (1)
+    {
+        ret = swPipeRing_pop(object, data, length);
+        if (ret != 0)
+        {
+            return ret;
+        }
+        if (!p->blocking)
+        {
+            //consume the pending notification first, otherwise the level-triggered reactor never stops
+            object->notify.read(&object->notify, &flag, sizeof(flag));
+        }
+        object->waiting = 1;
+        sw_atomic_memory_barrier();
+        if (!swPipeRing_empty(object))
+        {
+            object->waiting = 0;
+            continue;
+        }
+        if (!p->blocking)
+        {
+            errno = EAGAIN;
+            return SW_ERR;
+        }
+        if (object->notify.read(&object->notify, &flag, sizeof(flag)) < 0 && errno != EINTR)
+        {
+            return SW_ERR;
+        }
+    }
+    return SW_ERR;
+}
+
+static int swPipeRing_write(swPipe *p, void *data, int length)
+{
+    swPipeRing *object = p->object;
+    uint32_t msize = SW_PIPE_RING_ALIGN(sizeof(swPipeRing_item) + length);
+
+    if (msize > object->size)
+    {
+        swWarn("packet is too big, length=%d, ring_size=%d.", length, object->size);
+        errno = EMSGSIZE;
+        return SW_ERR;
+    }
+
+    sw_spinlock(&object->lock);
+    uint32_t tail = object->tail;
+    while (object->size - (tail - object->head) < msize)
+    {
+        if (!p->blocking)
+        {
+            sw_spinlock_release(&object->lock);
+            errno = EAGAIN;
+            return SW_ERR;
+        }
+        swYield();
+    }
+
+    uint32_t n = length;
+    swPipeRing_copy_in(object, tail, &n, sizeof(n));
+    swPipeRing_copy_in(object, tail + sizeof(swPipeRing_item), data, n);
+
+    sw_atomic_memory_barrier();
+    object->tail = tail + msize;
+    sw_spinlock_release(&object->lock);
+    sw_atomic_memory_barrier();
+
+    if (object->waiting && sw_atomic_cmp_set(&object->waiting, 1, 0))
+    {
+        uint64_t flag = 1;
+        object->notify.write(&object->notify, &flag, sizeof(flag));
+    }
+    return length;
+}
+
+static int swPipeRing_getFd(swPipe *p, int isWriteFd)
+{
+    swPipeRing *object = p->object;
+    return object->notify.getFd(&object->notify, isWriteFd);
+}
+
+static int swPipeRing_close(swPipe *p)
+{
+    swPipeRing *object = p->object;
+    int ret = object->notify.close(&object->notify);
+    sw_shm_free(object);
+    return ret;
+}
+
+/**
+ * one ring per event worker, shared by all reactor threads. Created non-blocking, so the worker
+ * reactor never blocks on the eventfd, the master turns blocking on to wait for room.
+ */
+int swServer_pipe_ring_init(swServer *serv)
+{
+    int i;
+
+    serv->pipe_rings = sw_calloc(serv->worker_num, sizeof(swPipe));
+    if (serv->pipe_rings == NULL)
+    {
+        swWarn("malloc[%d] failed.", (int) (serv->worker_num * sizeof(swPipe)));
+        return SW_ERR;
+    }
+    for (i = 0; i < serv->worker_num; i++)
+    {
+        if (swPipeRing_create(&serv->pipe_rings[i], 0, SW_PIPE_RING_SIZE) < 0)
+        {
+            while (--i >= 0)
+            {
+                serv->pipe_rings[i].close(&serv->pipe_rings[i]);
+            }
+            sw_free(serv->pipe_rings);
+            serv->pipe_rings = NULL;
+            return SW_ERR;
+        }
+        serv->pipe_rings[i].blocking = 1;
+    }
+    return SW_OK;
+}
+
+void swServer_pipe_ring_free(swServer *serv)
+{
+    int i;
+
+    if (serv->pipe_rings == NULL)
+    {
+        return;
+    }
+    for (i = 0; i < serv->worker_num; i++)
+    {
+        serv->pipe_rings[i].close(&serv->pipe_rings[i]);
+    }
+    sw_free(serv->pipe_rings);
+    serv->pipe_rings = NULL;
+}
@@ -45,88 +45,56 @@ int swProtocol_get_package_length(swProtocol *protocol, swConnection *conn, char
     return protocol->package_body_offset + body_length;
 }
 
+/**
+ * dispatch every complete package in the buffer in one pass, the unfinished tail is moved to the head of the buffer
+ * @return SW_ERR: close the connection
+ * @return 0: the buffer is empty
+ * @return >0: the length of the unfinished data
+ */
 static sw_inline int swProtocol_split_package_by_eof(swProtocol *protocol, swConnection *conn, swString *buffer)
 {
-#if 0
-    static count;
-    count ++;
-#endif
-
-    char stack_buf[SW_BUFFER_SIZE_BIG];
+    char *package = buffer->str;
+    uint32_t remaining_length = buffer->length;
+    //bytes before buffer->offset have been scanned by the previous call
+    uint32_t scan_offset = buffer->offset;
     int eof_pos;
-    if (buffer->length - buffer->offset < protocol->package_eof_len)
-    {
-        eof_pos = -1;
-    }
-    else
-    {
-        eof_pos = swoole_strnpos(buffer->str + buffer->offset, buffer->length - buffer->offset, protocol->package_eof, protocol->package_eof_len);
-    }
+    uint32_t length;
 
-    //swNotice("#[0] count=%d, length=%ld, size=%ld, offset=%ld", count, buffer->length, buffer->size, buffer->offset);
-
-    //waiting for more data
-    if (eof_pos < 0)
+    while (remaining_length >= protocol->package_eof_len)
     {
-        buffer->offset = buffer->length - protocol->package_eof_len;
-        return buffer->length;
+        eof_pos = swoole_memfind(package + scan_offset, remaining_length - scan_offset, protocol->package_eof,
+                protocol->package_eof_len);
+        if (eof_pos < 0)
+        {
+            break;
+        }
+        length = scan_offset + eof_pos + protocol->package_eof_len;
+        if (protocol->onPackage(conn, package, length) < 0)
+        {
+            return SW_ERR;
+        }
+        if (conn->removed)
+        {
+            return 0;
+        }
+        package += length;
+        remaining_length -= length;
+        scan_offset = 0;
     }
 
-    uint32_t length = buffer->offset + eof_pos + protocol->package_eof_len;
-    //swNotice("#[4] count=%d, length=%d", count, length);
-    if (protocol->onPackage(conn, buffer->str, length) < 0)
+    if (remaining_length == 0)
     {
-        return SW_ERR;
-    }
-    if (conn->removed)
-    {
-        return SW_OK;
+        swString_clear(buffer);
+        return 0;
     }
-
-    //there are remaining data
-    if (length < buffer->length)
+    if (package != buffer->str)
     {
-        uint32_t remaining_length = buffer->length - length;
-        char *remaining_data = buffer->str + length;
-        //swNotice("#[5] count=%d, remaining_length=%d", count, remaining_length);
-
-        while (1)
-        {
-            if (remaining_length < protocol->package_eof_len)
-            {
-                goto wait_more_data;
-            }
-            eof_pos = swoole_strnpos(remaining_data, remaining_length, protocol->package_eof, protocol->package_eof_len);
-            if (eof_pos < 0)
-            {
-                wait_more_data:
-                //swNotice("#[1] count=%d, remaining_length=%d, length=%d", count, remaining_length, length);
-                memcpy(stack_buf, remaining_data, remaining_length);
-                memcpy(buffer->str, stack_buf, remaining_length);
-                buffer->length = remaining_length;
-                buffer->offset = 0;
-                return remaining_length;
-            }
-            else
-            {
-                length = eof_pos + protocol->package_eof_len;
-                if (protocol->onPackage(conn, remaining_data, length) < 0)
-                {
-                    return SW_ERR;
-                }
-                if (conn->removed)
-                {
-                    return SW_OK;
-                }
-                //swNotice("#[2] count=%d, remaining_length=%d, length=%d", count, remaining_length, length);
-                remaining_data += length;
-                remaining_length -= length;
-            }
-        }
+        memmove(buffer->str, package, remaining_length);
+        buffer->length = remaining_length;
     }
-    //swNotice("#[3] length=%ld, size=%ld, offset=%ld", buffer->length, buffer->size, buffer->offset);
-    swString_clear(buffer);
-    return 0;
+    //the delimiter may be split across two reads, keep its first package_eof_len - 1 bytes for the next scan
+    buffer->offset = remaining_length >= protocol->package_eof_len ? remaining_length - protocol->package_eof_len + 1 : 0;
+    return remaining_length;
 }
 
 /**
@@ -301,7 +269,12 @@ int swProtocol_recv_check_eof(swProtocol *protocol, swConnection *conn, swString
 
         if (protocol->split_by_eof)
         {
-            if (swProtocol_split_package_by_eof(protocol, conn, buffer) == 0)
+            int remaining_length = swProtocol_split_package_by_eof(protocol, conn, buffer);
+            if (remaining_length < 0)
+            {
+                return SW_ERR;
+            }
+            else if (remaining_length == 0)
             {
                 return SW_OK;
             }
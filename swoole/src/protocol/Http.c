@@ -20,6 +20,11 @@
 #include <assert.h>
 #include <stddef.h>
 
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define SW_HTTP_SCAN_SIMD 1
+#endif
+
 static const char *method_strings[] =
 {
     "DELETE", "GET", "HEAD", "POST", "PUT", "PATCH", "CONNECT", "OPTIONS", "TRACE", "COPY", "LOCK", "MKCOL", "MOVE",
@@ -41,110 +46,543 @@ int swHttp_get_method(const char *method_str, int method_len)
 }
 
 /**
- * only GET/POST
+ * Byte classes the parser stops at, as ranges of [low, high] pairs in the format of
+ * _mm_cmpestri(_SIDD_CMP_RANGES). The scalar tables are built from the same ranges.
  */
-int swHttpRequest_get_protocol(swHttpRequest *request)
+enum swHttp_charset
 {
-    char *buf = request->buffer->str;
-    char *pe = buf + request->buffer->length;
+    SW_HTTP_CHARSET_PATH,
+    SW_HTTP_CHARSET_QUERY,
+    SW_HTTP_CHARSET_NAME,
+    SW_HTTP_CHARSET_VALUE,
+    SW_HTTP_CHARSET_NUM,
+};
 
-    //http method
-    if (memcmp(buf, "GET", 3) == 0)
-    {
-        request->method = HTTP_GET;
-        request->offset = 4;
-        buf += 4;
-    }
-    else if (memcmp(buf, "POST", 4) == 0)
-    {
-        request->method = HTTP_POST;
-        request->offset = 5;
-        buf += 5;
-    }
-    else if (memcmp(buf, "PUT", 3) == 0)
+typedef struct
+{
+    char ranges[16];
+    int size;
+} swHttp_ranges;
+
+static const swHttp_ranges swHttp_charset_ranges[SW_HTTP_CHARSET_NUM] =
+{
+    //CTL, SP, DEL and the start of the query string
+    { "\x00\x20" "??" "\x7f\x7f", 6 },
+    { "\x00\x20" "\x7f\x7f", 4 },
+    //CTL, SP, DEL and the end of the name
+    { "\x00\x20" "::" "\x7f\x7f", 6 },
+    //CTL except HTAB, and DEL
+    { "\x00\x08" "\x0a\x1f" "\x7f\x7f", 6 },
+};
+
+static uint8_t swHttp_charset_table[SW_HTTP_CHARSET_NUM][256];
+
+static char* swHttp_scan_scalar(char *p, char *pe, int charset)
+{
+    uint8_t *table = swHttp_charset_table[charset];
+    while (p < pe && !table[(uint8_t) *p])
     {
-        request->method = HTTP_PUT;
-        request->offset = 4;
-        buf += 4;
+        p++;
     }
-    else if (memcmp(buf, "PATCH", 5) == 0)
+    return p;
+}
+
+#ifdef SW_HTTP_SCAN_SIMD
+/**
+ * one pcmpestri checks 16 bytes against all the ranges of the class
+ */
+__attribute__((target("sse4.2"), always_inline))
+static inline char* swHttp_scan_ranges(char *p, char *pe, int charset)
+{
+    const swHttp_ranges *r = &swHttp_charset_ranges[charset];
+    __m128i ranges = _mm_loadu_si128((__m128i *) r->ranges);
+    int i;
+
+    for (; pe - p >= 16; p += 16)
     {
-        request->method = HTTP_PATCH;
-        request->offset = 6;
-        buf += 6;
+        __m128i block = _mm_loadu_si128((__m128i *) p);
+        i = _mm_cmpestri(ranges, r->size, block, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT);
+        if (i != 16)
+        {
+            return p + i;
+        }
     }
-    else if (memcmp(buf, "DELETE", 6) == 0)
+    return swHttp_scan_scalar(p, pe, charset);
+}
+
+__attribute__((target("sse4.2")))
+static char* swHttp_scan_sse42(char *p, char *pe, int charset)
+{
+    return swHttp_scan_ranges(p, pe, charset);
+}
+
+/**
+ * low <= c <= high is (c - low) <= (high - low) unsigned, which is min_epu8(c - low, high - low) == c - low.
+ * Every class has at most three ranges, an unused pair is [0, 0] which the first range already covers.
+ */
+__attribute__((target("avx2")))
+static char* swHttp_scan_avx2(char *p, char *pe, int charset)
+{
+    const swHttp_ranges *r = &swHttp_charset_ranges[charset];
+    __m256i low[3], span[3];
+    int i;
+
+    //most header lines end in the first 16 bytes, where setting up the ranges costs more than it saves
+    if (pe - p >= 16)
     {
-        request->method = HTTP_DELETE;
-        request->offset = 7;
-        buf += 7;
+        i = _mm_cmpestri(_mm_loadu_si128((__m128i *) r->ranges), r->size, _mm_loadu_si128((__m128i *) p), 16,
+                _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT);
+        if (i != 16)
+        {
+            return p + i;
+        }
+        p += 16;
     }
-    else if (memcmp(buf, "HEAD", 4) == 0)
+    if (pe - p < 32)
     {
-        request->method = HTTP_HEAD;
-        request->offset = 5;
-        buf += 5;
+        return swHttp_scan_ranges(p, pe, charset);
     }
-    else if (memcmp(buf, "OPTIONS", 7) == 0)
+    for (i = 0; i < 3; i++)
     {
-        request->method = HTTP_OPTIONS;
-        request->offset = 8;
-        buf += 8;
+        low[i] = _mm256_set1_epi8(r->ranges[i * 2]);
+        span[i] = _mm256_set1_epi8((uint8_t) r->ranges[i * 2 + 1] - (uint8_t) r->ranges[i * 2]);
     }
-#ifdef SW_USE_HTTP2
-    //HTTP2 Connection Preface
-    else if (memcmp(buf, "PRI", 3) == 0)
+    for (; pe - p >= 32; p += 32)
     {
-        request->method = HTTP_PRI;
-        if (memcmp(buf, SW_HTTP2_PRI_STRING, sizeof(SW_HTTP2_PRI_STRING) - 1) == 0)
+        __m256i block = _mm256_loadu_si256((__m256i *) p);
+        __m256i match = _mm256_setzero_si256();
+        for (i = 0; i < 3; i++)
         {
-            request->buffer->offset = sizeof(SW_HTTP2_PRI_STRING) - 1;
-            return SW_OK;
+            __m256i d = _mm256_sub_epi8(block, low[i]);
+            match = _mm256_or_si256(match, _mm256_cmpeq_epi8(_mm256_min_epu8(d, span[i]), d));
         }
-        else
+        uint32_t mask = _mm256_movemask_epi8(match);
+        if (mask)
         {
-            return SW_ERR;
+            return p + __builtin_ctz(mask);
         }
     }
+    //the tail is inlined to stay in VEX encoding
+    return swHttp_scan_ranges(p, pe, charset);
+}
 #endif
+
+static char* swHttp_scan_init(char *p, char *pe, int charset);
+static char* (*swHttp_scan_func)(char *, char *, int) = swHttp_scan_init;
+
+static char* swHttp_scan_init(char *p, char *pe, int charset)
+{
+    int i, j, c;
+    for (i = 0; i < SW_HTTP_CHARSET_NUM; i++)
+    {
+        for (j = 0; j < swHttp_charset_ranges[i].size; j += 2)
+        {
+            for (c = (uint8_t) swHttp_charset_ranges[i].ranges[j]; c <= (uint8_t) swHttp_charset_ranges[i].ranges[j + 1]; c++)
+            {
+                swHttp_charset_table[i][c] = 1;
+            }
+        }
+    }
+#ifdef SW_HTTP_SCAN_SIMD
+    if (__builtin_cpu_supports("avx2"))
+    {
+        swHttp_scan_func = swHttp_scan_avx2;
+    }
+    else if (__builtin_cpu_supports("sse4.2"))
+    {
+        swHttp_scan_func = swHttp_scan_sse42;
+    }
     else
+#endif
     {
-        return SW_ERR;
+        swHttp_scan_func = swHttp_scan_scalar;
     }
+    return swHttp_scan_func(p, pe, charset);
+}
 
-    //http version
-    char *p;
-    char cmp = 0;
-    for (p = buf; p < pe; p++)
+/**
+ * first byte of the class in [p, pe), pe if there is none
+ */
+static sw_inline char* swHttp_scan(char *p, char *pe, int charset)
+{
+    return swHttp_scan_func(p, pe, charset);
+}
+
+static int swHttp_parse_method(char *p, size_t length)
+{
+    int i;
+
+    if (length == 3 && memcmp(p, "GET", 3) == 0)
+    {
+        return HTTP_GET;
+    }
+    else if (length == 4 && memcmp(p, "POST", 4) == 0)
     {
-        if (cmp == 0 && *p == SW_SPACE)
+        return HTTP_POST;
+    }
+    for (i = 0; i < HTTP_PRI; i++)
+    {
+        if (strlen(method_strings[i]) == length && memcmp(method_strings[i], p, length) == 0)
         {
-            cmp = 1;
+            return i + 1;
         }
-        else if (cmp == 1)
+    }
+    return 0;
+}
+
+/**
+ * search a comma separated list of tokens for the given one, case-insensitive
+ */
+static int swHttp_has_token(char *value, size_t length, char *token, size_t token_len)
+{
+    char *p = value, *pe = value + length, *start;
+
+    while (p < pe)
+    {
+        while (p < pe && (*p == ' ' || *p == '\t' || *p == ','))
         {
-            if (p + 8 > pe)
+            p++;
+        }
+        start = p;
+        while (p < pe && *p != ',' && *p != ' ' && *p != '\t')
+        {
+            p++;
+        }
+        if (p - start == token_len && strncasecmp(start, token, token_len) == 0)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int swHttp_parse_header(swHttp_parser *parser, char *name, size_t name_len, char *value, size_t value_len)
+{
+    uint64_t content_length = 0;
+    size_t i;
+
+    switch (name_len)
+    {
+    case sizeof("Content-Length") - 1:
+        if (strncasecmp(name, "Content-Length", name_len) != 0)
+        {
+            break;
+        }
+        if (value_len == 0 || value_len > 10)
+        {
+            return SW_ERR;
+        }
+        for (i = 0; i < value_len; i++)
+        {
+            if (value[i] < '0' || value[i] > '9')
             {
                 return SW_ERR;
             }
-            if (memcmp(p, "HTTP/1.1", 8) == 0)
+            content_length = content_length * 10 + (value[i] - '0');
+        }
+        //a request with two different lengths can be split differently by a proxy in front of us
+        if (content_length > UINT32_MAX
+                || ((parser->flags & SW_HTTP_CONTENT_LENGTH) && parser->content_length != content_length))
+        {
+            return SW_ERR;
+        }
+        parser->content_length = content_length;
+        parser->flags |= SW_HTTP_CONTENT_LENGTH;
+        break;
+    case sizeof("Transfer-Encoding") - 1:
+        if (strncasecmp(name, "Transfer-Encoding", name_len) == 0 && swHttp_has_token(value, value_len, SW_STRL("chunked") - 1))
+        {
+            parser->flags |= SW_HTTP_CHUNKED;
+        }
+        break;
+    case sizeof("Connection") - 1:
+        if (strncasecmp(name, "Connection", name_len) != 0)
+        {
+            break;
+        }
+        if (swHttp_has_token(value, value_len, SW_STRL("keep-alive") - 1))
+        {
+            parser->flags |= SW_HTTP_CONNECTION_KEEPALIVE;
+        }
+        if (swHttp_has_token(value, value_len, SW_STRL("close") - 1))
+        {
+            parser->flags |= SW_HTTP_CONNECTION_CLOSE;
+        }
+        if (swHttp_has_token(value, value_len, SW_STRL("upgrade") - 1))
+        {
+            parser->flags |= SW_HTTP_CONNECTION_UPGRADE;
+        }
+        break;
+    case sizeof("Upgrade") - 1:
+        if (strncasecmp(name, "Upgrade", name_len) == 0)
+        {
+            parser->flags |= SW_HTTP_UPGRADE;
+        }
+        break;
+    case sizeof("Expect") - 1:
+        if (strncasecmp(name, "Expect", name_len) == 0 && value_len == sizeof("100-continue") - 1
+                && strncasecmp(value, "100-continue", value_len) == 0)
+        {
+            parser->flags |= SW_HTTP_EXPECT_CONTINUE;
+        }
+        break;
+    default:
+        break;
+    }
+    return SW_OK;
+}
+
+/**
+ * end of line at p, the position after CRLF or LF, NULL if more data is needed, pe + 1 if the line is invalid
+ */
+static sw_inline char* swHttp_parse_eol(char *p, char *pe)
+{
+    if (p >= pe)
+    {
+        return NULL;
+    }
+    else if (*p == '\n')
+    {
+        return p + 1;
+    }
+    else if (*p != '\r')
+    {
+        return pe + 1;
+    }
+    else if (p + 1 >= pe)
+    {
+        return NULL;
+    }
+    return p[1] == '\n' ? p + 2 : pe + 1;
+}
+
+static int swHttp_parse_request_line(swHttp_parser *parser, char *data, char *pe)
+{
+    char *p = data + parser->offset;
+    char *start = p, *eol;
+
+    //method, the longest one is UNSUBSCRIBE
+    for (; p < pe && *p != ' '; p++)
+    {
+        if (p - start >= 11 || !((*p >= 'A' && *p <= 'Z') || *p == '-'))
+        {
+            return SW_HTTP_PARSE_ERROR;
+        }
+    }
+    if (p >= pe)
+    {
+        return SW_HTTP_PARSE_PARTIAL;
+    }
+    int method = swHttp_parse_method(start, p - start);
+    if (method == 0)
+    {
+        return SW_HTTP_PARSE_ERROR;
+    }
+
+    //request target
+    char *path = ++p;
+    char *query = NULL;
+    p = swHttp_scan(p, pe, SW_HTTP_CHARSET_PATH);
+    if (p < pe && *p == '?')
+    {
+        query = ++p;
+        p = swHttp_scan(p, pe, SW_HTTP_CHARSET_QUERY);
+    }
+    if (p >= pe)
+    {
+        return SW_HTTP_PARSE_PARTIAL;
+    }
+    char *path_end = query ? query - 1 : p;
+    if (*p != ' ' || path_end == path)
+    {
+        return SW_HTTP_PARSE_ERROR;
+    }
+
+    //version
+    char *version = p + 1;
+    if (pe - version < sizeof("HTTP/1.1") - 1)
+    {
+        return memcmp(version, "HTTP/1.1", pe - version) == 0 || memcmp(version, "HTTP/1.0", pe - version) == 0 ?
+                SW_HTTP_PARSE_PARTIAL : SW_HTTP_PARSE_ERROR;
+    }
+    if (memcmp(version, "HTTP/1.", sizeof("HTTP/1.") - 1) != 0 || (version[7] != '0' && version[7] != '1'))
+    {
+        return SW_HTTP_PARSE_ERROR;
+    }
+    eol = swHttp_parse_eol(version + 8, pe);
+    if (eol == NULL)
+    {
+        return SW_HTTP_PARSE_PARTIAL;
+    }
+    else if (eol > pe)
+    {
+        return SW_HTTP_PARSE_ERROR;
+    }
+
+    parser->method = method;
+    parser->version = version[7] == '1' ? HTTP_VERSION_11 : HTTP_VERSION_10;
+    parser->path_offset = path - data;
+    parser->path_len = path_end - path;
+    if (query)
+    {
+        parser->query_offset = query - data;
+        parser->query_len = p - query;
+    }
+    parser->offset = eol - data;
+    parser->state = SW_HTTP_PARSER_HEADERS;
+    return SW_HTTP_PARSE_COMPLETE;
+}
+
+void swHttp_parser_init(swHttp_parser *parser, swHttp_header *headers, uint16_t header_max)
+{
+    bzero(parser, sizeof(swHttp_parser));
+    parser->headers = headers;
+    parser->header_max = header_max;
+}
+
+/**
+ * parse the request head in data[0, length), data must begin with the request line and
+ * grow between two calls. Returns SW_HTTP_PARSE_COMPLETE once the empty line is found.
+ */
+int swHttp_parse_request(swHttp_parser *parser, char *data, size_t length)
+{
+    char *pe = data + length;
+    char *p, *name, *name_end, *value, *value_end, *eol;
+    int ret;
+
+    if (parser->state == SW_HTTP_PARSER_DONE)
+    {
+        return SW_HTTP_PARSE_COMPLETE;
+    }
+    else if (parser->state == SW_HTTP_PARSER_REQUEST_LINE)
+    {
+        ret = swHttp_parse_request_line(parser, data, pe);
+        if (ret != SW_HTTP_PARSE_COMPLETE)
+        {
+            return ret;
+        }
+    }
+
+    while (1)
+    {
+        p = data + parser->offset;
+        if (p >= pe)
+        {
+            return SW_HTTP_PARSE_PARTIAL;
+        }
+        //the empty line
+        if (*p == '\r' || *p == '\n')
+        {
+            eol = swHttp_parse_eol(p, pe);
+            if (eol == NULL)
             {
-                request->version = HTTP_VERSION_11;
-                break;
+                return SW_HTTP_PARSE_PARTIAL;
             }
-            else if (memcmp(p, "HTTP/1.0", 8) == 0)
+            else if (eol > pe)
             {
-                request->version = HTTP_VERSION_10;
-                break;
+                return SW_HTTP_PARSE_ERROR;
             }
-            else
+            //the body length would be ambiguous
+            if ((parser->flags & SW_HTTP_CHUNKED) && (parser->flags & SW_HTTP_CONTENT_LENGTH))
             {
-                return SW_ERR;
+                return SW_HTTP_PARSE_ERROR;
             }
+            parser->offset = eol - data;
+            parser->state = SW_HTTP_PARSER_DONE;
+            return SW_HTTP_PARSE_COMPLETE;
+        }
+
+        name = p;
+        p = swHttp_scan(p, pe, SW_HTTP_CHARSET_NAME);
+        if (p >= pe)
+        {
+            return SW_HTTP_PARSE_PARTIAL;
+        }
+        //no obsolete line folding, no space before the colon
+        if (*p != ':' || p == name || p - name > UINT16_MAX)
+        {
+            return SW_HTTP_PARSE_ERROR;
+        }
+        name_end = p;
+        for (p++; p < pe && (*p == ' ' || *p == '\t'); p++);
+        value = p;
+        p = swHttp_scan(p, pe, SW_HTTP_CHARSET_VALUE);
+        eol = swHttp_parse_eol(p, pe);
+        if (eol == NULL)
+        {
+            return SW_HTTP_PARSE_PARTIAL;
+        }
+        else if (eol > pe)
+        {
+            return SW_HTTP_PARSE_ERROR;
+        }
+        for (value_end = p; value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t'); value_end--);
+
+        if (swHttp_parse_header(parser, name, name_end - name, value, value_end - value) < 0)
+        {
+            return SW_HTTP_PARSE_ERROR;
+        }
+        if (parser->header_num < parser->header_max)
+        {
+            swHttp_header *header = &parser->headers[parser->header_num];
+            header->name_offset = name - data;
+            header->name_len = name_end - name;
+            header->value_offset = value - data;
+            header->value_len = value_end - value;
         }
+        if (parser->header_num < UINT16_MAX)
+        {
+            parser->header_num++;
+        }
+        parser->offset = eol - data;
+    }
+}
+
+/**
+ * run the parser over what the reactor has received so far, the head is only scanned once
+ */
+int swHttpRequest_parse(swHttpRequest *request)
+{
+    swString *buffer = request->buffer;
+    int ret = swHttp_parse_request(&request->parser, buffer->str, buffer->length);
+
+    if (request->parser.state != SW_HTTP_PARSER_REQUEST_LINE)
+    {
+        request->method = request->parser.method;
+        request->version = request->parser.version;
+        request->offset = request->parser.path_offset;
+    }
+    if (ret == SW_HTTP_PARSE_COMPLETE)
+    {
+        request->header_length = request->parser.offset;
+    }
+    buffer->offset = request->parser.offset;
+    return ret;
+}
+
+int swHttpRequest_get_protocol(swHttpRequest *request)
+{
+#ifdef SW_USE_HTTP2
+    char *buf = request->buffer->str;
+    //HTTP2 Connection Preface
+    if (request->buffer->length >= 3 && memcmp(buf, "PRI", 3) == 0)
+    {
+        request->method = HTTP_PRI;
+        if (memcmp(buf, SW_HTTP2_PRI_STRING, sizeof(SW_HTTP2_PRI_STRING) - 1) == 0)
+        {
+            request->buffer->offset = sizeof(SW_HTTP2_PRI_STRING) - 1;
+            return SW_OK;
+        }
+        else
+        {
+            return SW_ERR;
+        }
+    }
+#endif
+    if (swHttpRequest_parse(request) == SW_HTTP_PARSE_ERROR || request->parser.state == SW_HTTP_PARSER_REQUEST_LINE)
+    {
+        return SW_ERR;
     }
-    p += 8;
-    request->buffer->offset = p - request->buffer->str;
     return SW_OK;
 }
 
@@ -159,6 +597,11 @@ void swHttpRequest_free(swConnection *conn)
     {
         swString_free(request->buffer);
     }
+    //the connection is closed in the middle of an upload
+    if (request->multipart)
+    {
+        swHttpMultipart_free(request->multipart, 1);
+    }
     bzero(request, sizeof(swHttpRequest));
     sw_free(request);
     conn->object = NULL;
@@ -169,100 +612,503 @@ void swHttpRequest_free(swConnection *conn)
  */
 int swHttpRequest_get_content_length(swHttpRequest *request)
 {
-    swString *buffer = request->buffer;
-    char *buf = buffer->str + buffer->offset;
-    int len = buffer->length - buffer->offset;
+    if (swHttpRequest_parse(request) == SW_HTTP_PARSE_ERROR || !(request->parser.flags & SW_HTTP_CONTENT_LENGTH))
+    {
+        return SW_ERR;
+    }
+    request->content_length = request->parser.content_length;
+    return SW_OK;
+}
+
+#ifdef SW_HTTP_100_CONTINUE
+int swHttpRequest_has_expect_header(swHttpRequest *request)
+{
+    swHttpRequest_parse(request);
+    return (request->parser.flags & SW_HTTP_EXPECT_CONTINUE) != 0;
+}
+#endif
 
-    char *pe = buf + len;
-    char *p;
+/**
+ * header-length
+ */
+int swHttpRequest_get_header_length(swHttpRequest *request)
+{
+    return swHttpRequest_parse(request) == SW_HTTP_PARSE_COMPLETE ? SW_OK : SW_ERR;
+}
+
+/**
+ * boundary of a multipart/form-data request, points into the header block
+ */
+int swHttpRequest_get_multipart_boundary(swHttpRequest *request, char **boundary, int *boundary_len)
+{
+    swString *buffer = request->buffer;
+    char *p = buffer->str;
+    char *pe = buffer->str + request->header_length;
     char *eol;
 
-    for (p = buf; p < pe; p++)
+    for (; p < pe; p++)
     {
-        if (*p == '\r' && pe - p > sizeof("Content-Length"))
+        if (*p != '\r' || pe - p < sizeof("\r\nContent-Type: multipart/form-data; boundary=") - 1
+                || strncasecmp(p, SW_STRL("\r\nContent-Type:") - 1) != 0)
+        {
+            continue;
+        }
+        p += sizeof("\r\nContent-Type:") - 1;
+        while (*p == ' ')
+        {
+            p++;
+        }
+        if (strncasecmp(p, SW_STRL("multipart/form-data") - 1) != 0)
+        {
+            return SW_ERR;
+        }
+        eol = memchr(p, '\r', pe - p);
+        if (eol == NULL)
+        {
+            return SW_ERR;
+        }
+        p = swoole_strnstr(p, "boundary=", eol - p);
+        if (p == NULL)
+        {
+            return SW_ERR;
+        }
+        p += sizeof("boundary=") - 1;
+        if (*p == '"' && eol - p > 2 && eol[-1] == '"')
         {
-            if (strncasecmp(p, SW_STRL("\r\nContent-Length") - 1) == 0)
+            p++;
+            eol--;
+        }
+        *boundary = p;
+        *boundary_len = eol - p;
+        return *boundary_len > 0 ? SW_OK : SW_ERR;
+    }
+    return SW_ERR;
+}
+
+/**
+ * called once the header and Content-Length are known: a multipart/form-data body of at least
+ * SW_HTTP_UPLOAD_SPOOL_SIZE bytes is decoded by request->multipart while it arrives, the reactor
+ * feeds it with swHttpMultipart_execute and forwards swHttpRequest_pack_upload at the end
+ */
+int swHttpRequest_upload_begin(swHttpRequest *request, char *tmp_dir)
+{
+    char *boundary;
+    int boundary_len;
+
+    if (request->content_length < SW_HTTP_UPLOAD_SPOOL_SIZE || tmp_dir == NULL
+            || swHttpRequest_get_multipart_boundary(request, &boundary, &boundary_len) < 0)
+    {
+        return SW_ERR;
+    }
+    request->multipart = swHttpMultipart_new(boundary, boundary_len, tmp_dir);
+    return request->multipart ? SW_OK : SW_ERR;
+}
+
+/**
+ * value of a parameter in a header like Content-Disposition: form-data; name="a"; filename="b"
+ */
+static int swHttp_get_param(char *value, size_t length, char *name, size_t name_len, char **param)
+{
+    char *p = value, *pe = value + length, *start;
+
+    while (p < pe)
+    {
+        //parameters start after ';'
+        p = memchr(p, ';', pe - p);
+        if (p == NULL)
+        {
+            return -1;
+        }
+        for (p++; p < pe && *p == ' '; p++);
+        if (pe - p > name_len && strncasecmp(p, name, name_len) == 0 && p[name_len] == '=')
+        {
+            p += name_len + 1;
+            if (p < pe && *p == '"')
             {
-                //strlen("\r\n") + strlen("Content-Length")
-                p += (2 + (sizeof("Content-Length:") - 1));
-                //skip space
-                if (*p == ' ')
+                start = ++p;
+                while (p < pe && *p != '"')
                 {
                     p++;
                 }
-                eol = strstr(p, "\r\n");
-                if (eol == NULL)
+            }
+            else
+            {
+                start = p;
+                while (p < pe && *p != ';' && *p != ' ')
                 {
-                    return SW_ERR;
+                    p++;
                 }
-                request->content_length = atoi(p);
-                return SW_OK;
             }
+            *param = start;
+            return p - start;
         }
     }
+    return -1;
+}
 
-    return SW_ERR;
+static void swHttpMultipart_header(swHttpMultipart *mp)
+{
+    char *param;
+    int len;
+    char *field = mp->header_field->str;
+    size_t field_len = mp->header_field->length;
+    char *value = mp->header_value->str;
+    size_t value_len = mp->header_value->length;
+
+    if (field_len == sizeof("Content-Disposition") - 1 && strncasecmp(field, "Content-Disposition", field_len) == 0)
+    {
+        if ((len = swHttp_get_param(value, value_len, SW_STRL("name") - 1, &param)) >= 0)
+        {
+            swString_append_ptr(mp->name, param, len);
+        }
+        if ((len = swHttp_get_param(value, value_len, SW_STRL("filename") - 1, &param)) >= 0)
+        {
+            swString_append_ptr(mp->filename, param, len);
+            mp->item.type = SW_HTTP_UPLOAD_FILE;
+        }
+    }
+    else if (field_len == sizeof("Content-Type") - 1 && strncasecmp(field, "Content-Type", field_len) == 0)
+    {
+        swString_append_ptr(mp->content_type, value, value_len);
+    }
+    swString_clear(mp->header_field);
+    swString_clear(mp->header_value);
+    mp->header_state = 0;
 }
 
-#ifdef SW_HTTP_100_CONTINUE
-int swHttpRequest_has_expect_header(swHttpRequest *request)
+static sw_inline int swHttpMultipart_reserve(swHttpMultipart *mp, size_t length)
 {
-    swString *buffer = request->buffer;
-    //char *buf = buffer->str + buffer->offset;
-    char *buf = buffer->str;
-    //int len = buffer->length - buffer->offset;
-    int len = buffer->length;
+    mp->memory_size += length;
+    if (mp->memory_size > SW_HTTP_UPLOAD_FIELD_MAX_SIZE)
+    {
+        swWarn("form fields of the upload exceed %d bytes.", SW_HTTP_UPLOAD_FIELD_MAX_SIZE);
+        return SW_ERR;
+    }
+    return SW_OK;
+}
+
+static int swHttpMultipart_on_header_field(multipart_parser *p, const char *at, size_t length)
+{
+    swHttpMultipart *mp = p->data;
+    if (swHttpMultipart_reserve(mp, length) < 0)
+    {
+        return -1;
+    }
+    //the previous header is complete
+    if (mp->header_state == 2)
+    {
+        swHttpMultipart_header(mp);
+    }
+    mp->header_state = 1;
+    return swString_append_ptr(mp->header_field, (char *) at, length) < 0 ? -1 : 0;
+}
+
+static int swHttpMultipart_on_header_value(multipart_parser *p, const char *at, size_t length)
+{
+    swHttpMultipart *mp = p->data;
+    if (swHttpMultipart_reserve(mp, length) < 0)
+    {
+        return -1;
+    }
+    mp->header_state = 2;
+    return swString_append_ptr(mp->header_value, (char *) at, length) < 0 ? -1 : 0;
+}
+
+static int swHttpMultipart_on_part_begin(multipart_parser *p)
+{
+    swHttpMultipart *mp = p->data;
+
+    bzero(&mp->item, sizeof(mp->item));
+    mp->item.type = SW_HTTP_UPLOAD_FIELD;
+    swString_clear(mp->name);
+    swString_clear(mp->filename);
+    swString_clear(mp->content_type);
+    swString_clear(mp->value);
+    mp->fd = -1;
+    return 0;
+}
 
-    char *pe = buf + len;
-    char *p;
+static int swHttpMultipart_on_headers_complete(multipart_parser *p)
+{
+    swHttpMultipart *mp = p->data;
 
-    for (p = buf; p < pe; p++)
+    if (mp->header_state == 2)
+    {
+        swHttpMultipart_header(mp);
+    }
+    if (mp->item.type != SW_HTTP_UPLOAD_FILE)
     {
+        return 0;
+    }
+    snprintf(mp->tmp_name, sizeof(mp->tmp_name), "%s/swoole.upfile.XXXXXX", mp->tmp_dir);
+    mp->fd = swoole_tmpfile(mp->tmp_name);
+    if (mp->fd < 0)
+    {
+        mp->item.error = SW_HTTP_UPLOAD_ERR_NO_TMP_DIR;
+        mp->tmp_name[0] = 0;
+    }
+    return 0;
+}
 
-        if (*p == '\r' && pe - p > sizeof("\r\nExpect"))
+/**
+ * flush the buffered file data
+ */
+static void swHttpMultipart_write(swHttpMultipart *mp)
+{
+    char *buf = mp->value->str;
+    size_t length = mp->value->length;
+    ssize_t n;
+
+    while (length > 0 && mp->fd >= 0)
+    {
+        n = write(mp->fd, buf, length);
+        if (n < 0)
         {
-            if (strncasecmp(p + 2, SW_STRL("\r\nExpect") - 1) == 0)
+            if (errno == EINTR)
             {
-                p += sizeof("Expect: ") + 1;
-                if (strncasecmp(p, SW_STRL("100-continue") - 1) == 0)
-                {
-                    return 1;
-                }
-                else
-                {
-                    return 0;
-                }
-            }
-            else
-            {
-                p++;
+                continue;
             }
+            swSysError("write(%s) failed.", mp->tmp_name);
+            mp->item.error = SW_HTTP_UPLOAD_ERR_CANT_WRITE;
+            close(mp->fd);
+            mp->fd = -1;
+            break;
         }
+        buf += n;
+        length -= n;
     }
+    swString_clear(mp->value);
+}
+
+static int swHttpMultipart_on_part_data(multipart_parser *p, const char *at, size_t length)
+{
+    swHttpMultipart *mp = p->data;
+
+    if (mp->item.type == SW_HTTP_UPLOAD_FILE)
+    {
+        if (mp->fd < 0)
+        {
+            return 0;
+        }
+        mp->item.size += length;
+        if (mp->value->length + length > SW_HTTP_UPLOAD_WRITE_SIZE)
+        {
+            swHttpMultipart_write(mp);
+        }
+        //large pieces go straight to the file
+        if (length >= SW_HTTP_UPLOAD_WRITE_SIZE)
+        {
+            swString data;
+            data.str = (char *) at;
+            data.length = length;
+            swString *buffer = mp->value;
+            mp->value = &data;
+            swHttpMultipart_write(mp);
+            mp->value = buffer;
+            return 0;
+        }
+    }
+    else if (swHttpMultipart_reserve(mp, length) < 0)
+    {
+        return -1;
+    }
+    return swString_append_ptr(mp->value, (char *) at, length) < 0 ? -1 : 0;
+}
+
+static int swHttpMultipart_on_part_end(multipart_parser *p)
+{
+    swHttpMultipart *mp = p->data;
+    swString *result = mp->result;
+    swHttpUpload_item *item = &mp->item;
+    char *value;
+
+    if (item->type == SW_HTTP_UPLOAD_FILE)
+    {
+        swHttpMultipart_write(mp);
+        if (mp->fd >= 0)
+        {
+            close(mp->fd);
+            mp->fd = -1;
+        }
+        value = mp->tmp_name;
+        item->value_len = strlen(mp->tmp_name);
+    }
+    else
+    {
+        value = mp->value->str;
+        item->value_len = mp->value->length;
+        item->size = mp->value->length;
+    }
+    if (mp->name->length > 0xffff || mp->filename->length > 0xffff || mp->content_type->length > 0xffff)
+    {
+        return -1;
+    }
+    item->name_len = mp->name->length;
+    item->filename_len = mp->filename->length;
+    item->content_type_len = mp->content_type->length;
+
+    if (swString_append_ptr(result, (char *) item, sizeof(*item)) < 0
+            || swString_append_ptr(result, mp->name->str, mp->name->length) < 0
+            || swString_append_ptr(result, mp->filename->str, mp->filename->length) < 0
+            || swString_append_ptr(result, mp->content_type->str, mp->content_type->length) < 0
+            || swString_append_ptr(result, value, item->value_len) < 0)
+    {
+        return -1;
+    }
+    swString_clear(mp->value);
     return 0;
 }
-#endif
+
+static const multipart_parser_settings swHttpMultipart_settings =
+{
+    swHttpMultipart_on_header_field,
+    swHttpMultipart_on_header_value,
+    swHttpMultipart_on_part_data,
+    swHttpMultipart_on_part_begin,
+    swHttpMultipart_on_headers_complete,
+    swHttpMultipart_on_part_end,
+    NULL,
+};
+
+swHttpMultipart* swHttpMultipart_new(char *boundary, int boundary_len, char *tmp_dir)
+{
+    swHttpMultipart *mp = sw_malloc(sizeof(swHttpMultipart));
+    if (mp == NULL)
+    {
+        swWarn("malloc(%ld) failed.", sizeof(swHttpMultipart));
+        return NULL;
+    }
+    bzero(mp, sizeof(swHttpMultipart));
+    mp->fd = -1;
+    mp->tmp_dir = tmp_dir;
+    mp->parser = multipart_parser_init(boundary, boundary_len, &swHttpMultipart_settings);
+    mp->header_field = swString_new(SW_HTTP_HEADER_KEY_SIZE);
+    mp->header_value = swString_new(SW_HTTP_HEADER_VALUE_SIZE);
+    mp->name = swString_new(SW_HTTP_HEADER_KEY_SIZE);
+    mp->filename = swString_new(SW_HTTP_HEADER_KEY_SIZE);
+    mp->content_type = swString_new(SW_HTTP_HEADER_KEY_SIZE);
+    mp->value = swString_new(SW_HTTP_UPLOAD_WRITE_SIZE);
+    mp->result = swString_new(SW_BUFFER_SIZE_STD);
+    if (!mp->parser || !mp->header_field || !mp->header_value || !mp->name || !mp->filename || !mp->content_type
+            || !mp->value || !mp->result)
+    {
+        swHttpMultipart_free(mp, 1);
+        return NULL;
+    }
+    mp->parser->data = mp;
+    return mp;
+}
 
 /**
- * header-length
+ * feed the next piece of the body, in any size
  */
-int swHttpRequest_get_header_length(swHttpRequest *request)
+int swHttpMultipart_execute(swHttpMultipart *mp, char *data, size_t length)
 {
-    swString *buffer = request->buffer;
-    char *buf = buffer->str + buffer->offset;
-    int len = buffer->length - buffer->offset;
+    if (multipart_parser_execute(mp->parser, data, length) != length)
+    {
+        swWarn("invalid multipart/form-data body.");
+        return SW_ERR;
+    }
+    return SW_OK;
+}
 
-    char *pe = buf + len;
-    char *p;
+void swHttpMultipart_free(swHttpMultipart *mp, int unlink_files)
+{
+    char *p, *pe;
+    swHttpUpload_item item;
 
-    for (p = buf; p < pe; p++)
+    if (mp->fd >= 0)
     {
-        if (*p == '\r' && p + 4 <= pe && memcmp(p, "\r\n\r\n", 4) == 0)
+        close(mp->fd);
+    }
+    if (unlink_files)
+    {
+        if (mp->fd >= 0 && mp->tmp_name[0])
         {
-            //strlen(header) + strlen("\r\n\r\n")
-            request->header_length = p - buffer->str + 4;
-            return SW_OK;
+            unlink(mp->tmp_name);
+        }
+        for (p = mp->result ? mp->result->str : NULL, pe = p + (p ? mp->result->length : 0); p && p < pe;)
+        {
+            memcpy(&item, p, sizeof(item));
+            p += sizeof(item) + item.name_len + item.filename_len + item.content_type_len;
+            if (item.type == SW_HTTP_UPLOAD_FILE && item.value_len > 0 && item.value_len < SW_HTTP_UPLOAD_TMPDIR_SIZE)
+            {
+                memcpy(mp->tmp_name, p, item.value_len);
+                mp->tmp_name[item.value_len] = 0;
+                unlink(mp->tmp_name);
+            }
+            p += item.value_len;
         }
     }
-    return SW_ERR;
+    if (mp->parser)
+    {
+        multipart_parser_free(mp->parser);
+    }
+    if (mp->header_field)
+    {
+        swString_free(mp->header_field);
+    }
+    if (mp->header_value)
+    {
+        swString_free(mp->header_value);
+    }
+    if (mp->name)
+    {
+        swString_free(mp->name);
+    }
+    if (mp->filename)
+    {
+        swString_free(mp->filename);
+    }
+    if (mp->content_type)
+    {
+        swString_free(mp->content_type);
+    }
+    if (mp->value)
+    {
+        swString_free(mp->value);
+    }
+    if (mp->result)
+    {
+        swString_free(mp->result);
+    }
+    sw_free(mp);
+}
+
+/**
+ * the request forwarded to the worker once the body is complete: the original header block with
+ * Content-Type and Content-Length replaced, followed by the upload items. The temporary files
+ * belong to the worker from now on, dispatch it with SW_EVENT_DATA_UPLOAD.
+ */
+int swHttpRequest_pack_upload(swHttpRequest *request, swString *out)
+{
+    swHttpMultipart *mp = request->multipart;
+    char *p = request->buffer->str;
+    char *pe = request->buffer->str + request->header_length - 2;
+    char *eol;
+    char buf[128];
+    int n;
+
+    swString_clear(out);
+    while (p < pe)
+    {
+        eol = memchr(p, '\n', pe - p);
+        eol = eol ? eol + 1 : pe;
+        if (strncasecmp(p, SW_STRL("Content-Type:") - 1) != 0 && strncasecmp(p, SW_STRL("Content-Length:") - 1) != 0)
+        {
+            if (swString_append_ptr(out, p, eol - p) < 0)
+            {
+                return SW_ERR;
+            }
+        }
+        p = eol;
+    }
+    n = snprintf(buf, sizeof(buf), "Content-Type: %s\r\nContent-Length: %ld\r\n\r\n", SW_HTTP_UPLOAD_CONTENT_TYPE, (long) mp->result->length);
+    if (swString_append_ptr(out, buf, n) < 0 || swString_append(out, mp->result) < 0)
+    {
+        return SW_ERR;
+    }
+    swHttpMultipart_free(mp, 0);
+    request->multipart = NULL;
+    return SW_OK;
 }
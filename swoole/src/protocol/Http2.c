@@ -90,6 +90,242 @@ int swHttp2_send_setting_frame(swProtocol *protocol, swConnection *conn)
     return swConnection_send(conn, setting_frame, sizeof(setting_frame), 0);
 }
 
+void swHttp2_scheduler_init(swHttp2_scheduler *scheduler)
+{
+    bzero(scheduler, sizeof(swHttp2_scheduler));
+    scheduler->send_window = SW_HTTP2_DEFAULT_WINDOW;
+    scheduler->init_window = SW_HTTP2_DEFAULT_WINDOW;
+    scheduler->max_frame_size = SW_HTTP2_DEFAULT_FRAME_SIZE;
+}
+
+void swHttp2_scheduler_free(swHttp2_scheduler *scheduler)
+{
+    while (scheduler->stream_num > 0)
+    {
+        swHttp2_scheduler_remove(scheduler, scheduler->streams[0]);
+    }
+}
+
+/**
+ * queue a response body, the stream starts with the initial window of the peer
+ */
+swHttp2_stream* swHttp2_scheduler_add(swHttp2_scheduler *scheduler, uint32_t id, char *data, size_t length)
+{
+    if (scheduler->stream_num == SW_HTTP2_MAX_CONCURRENT_STREAMS)
+    {
+        swWarn("too many streams waiting for the window.");
+        return NULL;
+    }
+    swHttp2_stream *stream = sw_malloc(sizeof(swHttp2_stream));
+    if (stream == NULL)
+    {
+        swWarn("malloc(%ld) failed.", sizeof(swHttp2_stream));
+        return NULL;
+    }
+    bzero(stream, sizeof(swHttp2_stream));
+    stream->id = id;
+    stream->weight = SW_HTTP2_DEFAULT_WEIGHT;
+    stream->send_window = scheduler->init_window;
+    stream->data = data;
+    stream->length = length;
+    //a new stream must not get the time the others have already used
+    stream->vtime = scheduler->vtime;
+    scheduler->streams[scheduler->stream_num++] = stream;
+    return stream;
+}
+
+swHttp2_stream* swHttp2_scheduler_find(swHttp2_scheduler *scheduler, uint32_t id)
+{
+    uint32_t i;
+    for (i = 0; i < scheduler->stream_num; i++)
+    {
+        if (scheduler->streams[i]->id == id)
+        {
+            return scheduler->streams[i];
+        }
+    }
+    return NULL;
+}
+
+void swHttp2_scheduler_remove(swHttp2_scheduler *scheduler, swHttp2_stream *stream)
+{
+    uint32_t i;
+    for (i = 0; i < scheduler->stream_num; i++)
+    {
+        if (scheduler->streams[i] == stream)
+        {
+            scheduler->streams[i] = scheduler->streams[--scheduler->stream_num];
+            break;
+        }
+    }
+    if (stream->buffer)
+    {
+        swString_free(stream->buffer);
+    }
+    sw_free(stream);
+}
+
+/**
+ * WINDOW_UPDATE, stream_id 0 is the connection. A window above 2^31-1 is a FLOW_CONTROL_ERROR.
+ */
+int swHttp2_scheduler_window_update(swHttp2_scheduler *scheduler, uint32_t stream_id, uint32_t increment)
+{
+    int32_t *window;
+
+    if (stream_id == 0)
+    {
+        window = &scheduler->send_window;
+    }
+    else
+    {
+        swHttp2_stream *stream = swHttp2_scheduler_find(scheduler, stream_id);
+        if (stream == NULL)
+        {
+            return SW_OK;
+        }
+        window = &stream->send_window;
+    }
+    if ((int64_t) *window + increment > SW_HTTP2_MAX_WINDOW)
+    {
+        return SW_ERR;
+    }
+    *window += increment;
+    return SW_OK;
+}
+
+/**
+ * SETTINGS_INITIAL_WINDOW_SIZE changes the window of every open stream by the difference
+ */
+int swHttp2_scheduler_set_init_window(swHttp2_scheduler *scheduler, uint32_t init_window)
+{
+    int64_t delta = (int64_t) init_window - scheduler->init_window;
+    uint32_t i;
+
+    if (init_window > SW_HTTP2_MAX_WINDOW)
+    {
+        return SW_ERR;
+    }
+    for (i = 0; i < scheduler->stream_num; i++)
+    {
+        if (scheduler->streams[i]->send_window + delta > SW_HTTP2_MAX_WINDOW)
+        {
+            return SW_ERR;
+        }
+        scheduler->streams[i]->send_window += delta;
+    }
+    scheduler->init_window = init_window;
+    return SW_OK;
+}
+
+/**
+ * a stream can send if it has window and the stream it depends on cannot
+ */
+static int swHttp2_scheduler_ready(swHttp2_scheduler *scheduler, swHttp2_stream *stream, int depth)
+{
+    if (stream->send_window <= 0)
+    {
+        return 0;
+    }
+    if (stream->dependency == 0 || depth == 8)
+    {
+        return 1;
+    }
+    swHttp2_stream *parent = swHttp2_scheduler_find(scheduler, stream->dependency);
+    return parent == NULL || !swHttp2_scheduler_ready(scheduler, parent, depth + 1);
+}
+
+/**
+ * append DATA frames to out until the windows are used up, no stream can send or out reaches limit.
+ * A stream is removed after its last frame, which carries END_STREAM. Returns the number of frames.
+ */
+int swHttp2_scheduler_run(swHttp2_scheduler *scheduler, swString *out, size_t limit)
+{
+    char frame_header[SW_HTTP2_FRAME_HEADER_SIZE];
+    swHttp2_stream *stream;
+    size_t n;
+    uint32_t i;
+    int frames = 0, flags;
+
+    while (scheduler->send_window > 0 && out->length < limit)
+    {
+        stream = NULL;
+        for (i = 0; i < scheduler->stream_num; i++)
+        {
+            if ((stream == NULL || scheduler->streams[i]->vtime < stream->vtime)
+                    && swHttp2_scheduler_ready(scheduler, scheduler->streams[i], 0))
+            {
+                stream = scheduler->streams[i];
+            }
+        }
+        if (stream == NULL)
+        {
+            break;
+        }
+
+        n = stream->length - stream->offset;
+        if (n > stream->send_window)
+        {
+            n = stream->send_window;
+        }
+        if (n > scheduler->send_window)
+        {
+            n = scheduler->send_window;
+        }
+        if (n > scheduler->max_frame_size)
+        {
+            n = scheduler->max_frame_size;
+        }
+        flags = stream->offset + n == stream->length ? SW_HTTP2_FLAG_END_STREAM : SW_HTTP2_FLAG_NONE;
+
+        swHttp2_set_frame_header(frame_header, SW_HTTP2_TYPE_DATA, n, flags, stream->id);
+        if (swString_append_ptr(out, frame_header, SW_HTTP2_FRAME_HEADER_SIZE) < 0
+                || swString_append_ptr(out, stream->data + stream->offset, n) < 0)
+        {
+            return SW_ERR;
+        }
+        stream->offset += n;
+        stream->send_window -= n;
+        scheduler->send_window -= n;
+        //a stream of weight 256 gets 16 times the bytes of one of weight 16
+        scheduler->vtime = stream->vtime;
+        stream->vtime += (n + 1) * 256 / stream->weight;
+        frames++;
+
+        if (flags & SW_HTTP2_FLAG_END_STREAM)
+        {
+            swHttp2_scheduler_remove(scheduler, stream);
+        }
+    }
+    return frames;
+}
+
+/**
+ * copy what is left of the bodies which still point to the memory of the caller
+ */
+int swHttp2_scheduler_detach(swHttp2_scheduler *scheduler)
+{
+    swHttp2_stream *stream;
+    uint32_t i;
+
+    for (i = 0; i < scheduler->stream_num; i++)
+    {
+        stream = scheduler->streams[i];
+        if (stream->buffer)
+        {
+            continue;
+        }
+        stream->buffer = swString_new(stream->length - stream->offset + 1);
+        if (stream->buffer == NULL || swString_append_ptr(stream->buffer, stream->data + stream->offset, stream->length - stream->offset) < 0)
+        {
+            return SW_ERR;
+        }
+        stream->data = stream->buffer->str;
+        stream->length -= stream->offset;
+        stream->offset = 0;
+    }
+    return SW_OK;
+}
+
 /**
  +-----------------------------------------------+
  |                 Length (24)                   |
@@ -20,42 +20,234 @@
 #include "redis.h"
 #include "Connection.h"
 
-typedef struct
+/**
+ * parse "<type><number>\r\n" at p, return the bytes consumed, 0 if the line is incomplete
+ */
+static sw_inline int swRedis_parse_line(char *p, char *pe, long *value)
 {
-    uint8_t state;
+    char *s = p + 1;
+    long n = 0;
+    int negative = 0;
+
+    if (pe - p > SW_REDIS_MAX_HEADER_SIZE)
+    {
+        pe = p + SW_REDIS_MAX_HEADER_SIZE;
+    }
+    if (s < pe && *s == '-')
+    {
+        negative = 1;
+        s++;
+    }
+    char *digits = s;
+    while (s < pe && *s >= '0' && *s <= '9')
+    {
+        //18 digits always fit in a long
+        if (s - digits == 18)
+        {
+            return SW_ERR;
+        }
+        n = n * 10 + (*s - '0');
+        s++;
+    }
+    if (pe - s < SW_CRLF_LEN)
+    {
+        return pe - p == SW_REDIS_MAX_HEADER_SIZE ? SW_ERR : 0;
+    }
+    if (s == digits || s[0] != '\r' || s[1] != '\n')
+    {
+        return SW_ERR;
+    }
+    *value = negative ? -n : n;
+    return s + SW_CRLF_LEN - p;
+}
 
-    int n_lines_total;
-    int n_lines_received;
+void swRedis_parser_init(swRedis_parser *parser, swRedis_arg *args, uint32_t args_size)
+{
+    bzero(parser, sizeof(swRedis_parser));
+    parser->state = SW_REDIS_RECEIVE_TOTAL_LINE;
+    parser->args = args;
+    parser->args_size = args_size;
+    parser->max_string_size = SW_REDIS_MAX_STRING_SIZE;
+}
 
-    int n_bytes_total;
-    int n_bytes_received;
+/**
+ * Parse the next command of a RESP stream, resuming where the last call stopped.
+ * Returns SW_REDIS_PARSE_COMPLETE with parser->offset at the end of the command and
+ * parser->args pointing into data, SW_REDIS_PARSE_PARTIAL if more data is needed.
+ */
+int swRedis_parse(swRedis_parser *parser, char *data, size_t length)
+{
+    char *p, *pe = data + length;
+    long value;
+    int n;
 
-    int offset;
+    while (1)
+    {
+        p = data + parser->offset;
+        if (p >= pe)
+        {
+            return SW_REDIS_PARSE_PARTIAL;
+        }
 
-} swRedis_request;
+        switch (parser->state)
+        {
+        case SW_REDIS_RECEIVE_TOTAL_LINE:
+            if (*p != '*')
+            {
+                goto failed;
+            }
+            n = swRedis_parse_line(p, pe, &value);
+            if (n <= 0)
+            {
+                goto partial;
+            }
+            if (value <= 0 || value > SW_REDIS_MAX_STRING_SIZE || value > parser->args_size)
+            {
+                goto failed;
+            }
+            parser->command_offset = parser->offset;
+            parser->offset += n;
+            parser->n_args_total = value;
+            parser->n_args = 0;
+            parser->state = SW_REDIS_RECEIVE_LENGTH;
+            break;
+
+        case SW_REDIS_RECEIVE_LENGTH:
+            if (*p != '$' && *p != ':')
+            {
+                goto failed;
+            }
+            n = swRedis_parse_line(p, pe, &value);
+            if (n <= 0)
+            {
+                goto partial;
+            }
+            if (*p == ':')
+            {
+                if (parser->args)
+                {
+                    parser->args[parser->n_args].type = SW_REDIS_REPLY_INT;
+                    parser->args[parser->n_args].offset = parser->offset + 1;
+                    parser->args[parser->n_args].length = n - 1 - SW_CRLF_LEN;
+                }
+                parser->offset += n;
+                goto next_arg;
+            }
+            if (value == -1)
+            {
+                if (parser->args)
+                {
+                    parser->args[parser->n_args].type = SW_REDIS_REPLY_NIL;
+                    parser->args[parser->n_args].offset = parser->offset;
+                    parser->args[parser->n_args].length = 0;
+                }
+                parser->offset += n;
+                goto next_arg;
+            }
+            if (value < 0 || value > parser->max_string_size)
+            {
+                goto failed;
+            }
+            parser->offset += n;
+            parser->n_bytes = value;
+            parser->state = SW_REDIS_RECEIVE_STRING;
+            break;
+
+        case SW_REDIS_RECEIVE_STRING:
+            //wait for the whole string, nothing is rescanned meanwhile
+            if (pe - p < (ssize_t) parser->n_bytes + SW_CRLF_LEN)
+            {
+                return SW_REDIS_PARSE_PARTIAL;
+            }
+            if (p[parser->n_bytes] != '\r' || p[parser->n_bytes + 1] != '\n')
+            {
+                goto failed;
+            }
+            if (parser->args)
+            {
+                parser->args[parser->n_args].type = SW_REDIS_REPLY_STRING;
+                parser->args[parser->n_args].offset = parser->offset;
+                parser->args[parser->n_args].length = parser->n_bytes;
+            }
+            parser->offset += parser->n_bytes + SW_CRLF_LEN;
+            parser->state = SW_REDIS_RECEIVE_LENGTH;
+
+            next_arg:
+            parser->n_args++;
+            if (parser->n_args == parser->n_args_total)
+            {
+                parser->state = SW_REDIS_RECEIVE_TOTAL_LINE;
+                return SW_REDIS_PARSE_COMPLETE;
+            }
+            break;
+
+        default:
+            goto failed;
+        }
+    }
+
+    partial:
+    if (n == 0)
+    {
+        return SW_REDIS_PARSE_PARTIAL;
+    }
+    failed:
+    return SW_REDIS_PARSE_ERROR;
+}
+
+/**
+ * the first n bytes of the buffer were removed
+ */
+void swRedis_parser_consume(swRedis_parser *parser, size_t n)
+{
+    parser->offset -= n;
+    parser->command_offset = parser->command_offset > n ? parser->command_offset - n : 0;
+}
 
 int swRedis_recv(swProtocol *protocol, swConnection *conn, swString *buffer)
 {
-    char *p, *pe;
+    swRedis_parser *parser;
+    size_t package_length;
     int ret;
-    char *buf_ptr;
-
-    swRedis_request *request;
 
     if (conn->object == NULL)
     {
-        request = sw_malloc(sizeof(swRedis_request));
-        bzero(request, sizeof(swRedis_request));
-        conn->object = request;
+        parser = sw_malloc(sizeof(swRedis_parser));
+        if (!parser)
+        {
+            swWarn("malloc(%ld) failed.", sizeof(swRedis_parser));
+            return SW_ERR;
+        }
+        //the same limit as the worker, which keeps the arguments in an array of SW_REDIS_MAX_ARGS
+        swRedis_parser_init(parser, NULL, SW_REDIS_MAX_ARGS);
+        parser->max_string_size = protocol->package_max_length;
+        conn->object = parser;
     }
     else
     {
-        request = (swRedis_request *) conn->object;
+        parser = (swRedis_parser *) conn->object;
     }
 
-    recv_data: buf_ptr = buffer->str + buffer->length;
+    recv_data:
+    if (buffer->length == buffer->size)
+    {
+        if (buffer->size >= protocol->package_max_length)
+        {
+            swWarn("Package is too big. package_length=%d", (int )buffer->length);
+            return SW_ERR;
+        }
+        uint32_t extend_size = swoole_size_align(buffer->size * 2, SwooleG.pagesize);
+        if (extend_size > protocol->package_max_length)
+        {
+            extend_size = protocol->package_max_length;
+        }
+        if (swString_extend(buffer, extend_size) < 0)
+        {
+            return SW_ERR;
+        }
+    }
 
-    int n = swConnection_recv(conn, buf_ptr, SW_BUFFER_SIZE_STD, 0);
+    int n = swConnection_recv(conn, buffer->str + buffer->length, buffer->size - buffer->length, 0);
     if (n < 0)
     {
         switch (swConnection_error(errno))
@@ -74,105 +266,107 @@ int swRedis_recv(swProtocol *protocol, swConnection *conn, swString *buffer)
     {
         return SW_ERR;
     }
-    else
+
+    buffer->length += n;
+
+    package_length = 0;
+    while ((ret = swRedis_parse(parser, buffer->str, buffer->length)) == SW_REDIS_PARSE_COMPLETE)
+    {
+        package_length = parser->offset;
+    }
+    if (ret == SW_REDIS_PARSE_ERROR)
+    {
+        swWarn("redis protocol error.");
+        return SW_ERR;
+    }
+    if (package_length == 0)
     {
-        p = buffer->str + buffer->length;
-        pe = p + n;
-        buffer->length += n;
+        goto recv_data;
+    }
 
-        if (strncmp(buffer->str + buffer->length - SW_CRLF_LEN, SW_CRLF, SW_CRLF_LEN) != 0)
-        {
-            if (buffer->size < protocol->package_max_length)
-            {
-                uint32_t extend_size = swoole_size_align(buffer->size * 2, SwooleG.pagesize);
-                if (extend_size > protocol->package_max_length)
-                {
-                    extend_size = protocol->package_max_length;
-                }
-                if (swString_extend(buffer, extend_size) < 0)
-                {
-                    return SW_ERR;
-                }
-            }
-            else if (buffer->length == buffer->size)
-            {
-                package_too_big:
-                swWarn("Package is too big. package_length=%d", (int )buffer->length);
-                return SW_ERR;
-            }
-            goto recv_data;
-        }
+    //all the pipelined commands of this read are dispatched as one package
+    if (protocol->onPackage(conn, buffer->str, package_length) < 0)
+    {
+        return SW_ERR;
+    }
+    if (conn->removed)
+    {
+        return SW_OK;
+    }
+    if (package_length < buffer->length)
+    {
+        memmove(buffer->str, buffer->str + package_length, buffer->length - package_length);
+    }
+    buffer->length -= package_length;
+    swRedis_parser_consume(parser, package_length);
+    return SW_OK;
+}
 
-        do
-        {
-            switch(request->state)
-            {
-            case SW_REDIS_RECEIVE_TOTAL_LINE:
-                if (*p == '*' && (p = swRedis_get_number(p, &ret)))
-                {
-                    request->n_lines_total = ret;
-                    request->state = SW_REDIS_RECEIVE_LENGTH;
-                    break;
-                }
-                /* no break */
+static sw_inline int swRedis_reply_header(swString *buffer, char type, long value)
+{
+    char header[SW_REDIS_MAX_HEADER_SIZE];
+    header[0] = type;
+    int n = swoole_itoa(header + 1, value) + 1;
+    memcpy(header + n, SW_CRLF, SW_CRLF_LEN);
+    return swString_append_ptr(buffer, header, n + SW_CRLF_LEN);
+}
 
-            case SW_REDIS_RECEIVE_LENGTH:
-                if (*p == '$' && (p = swRedis_get_number(p, &ret)))
-                {
-                    if (ret < 0)
-                    {
-                        break;
-                    }
-                    if (ret + buffer->length > protocol->package_max_length)
-                    {
-                        goto package_too_big;
-                    }
-                    request->n_bytes_total = ret;
-                    request->state = SW_REDIS_RECEIVE_STRING;
-                    break;
-                }
-                //integer
-                else if (*p == ':' && (p = swRedis_get_number(p, &ret)))
-                {
-                    break;
-                }
-                /* no break */
+static sw_inline int swRedis_reply_line(swString *buffer, char type, char *str, int length)
+{
+    size_t new_length = buffer->length + length + 1 + SW_CRLF_LEN;
+    if (new_length > buffer->size && swString_extend_align(buffer, new_length) < 0)
+    {
+        return SW_ERR;
+    }
+    char *p = buffer->str + buffer->length;
+    p[0] = type;
+    memcpy(p + 1, str, length);
+    memcpy(p + 1 + length, SW_CRLF, SW_CRLF_LEN);
+    buffer->length += length + 1 + SW_CRLF_LEN;
+    return SW_OK;
+}
 
-            case SW_REDIS_RECEIVE_STRING:
-                if (pe - p < request->n_bytes_total - request->n_bytes_received)
-                {
-                    request->n_bytes_received += pe - p;
-                    return SW_OK;
-                }
-                else
-                {
-                    p += request->n_bytes_total + SW_CRLF_LEN;
-                    request->n_bytes_total = 0;
-                    request->n_lines_received++;
-
-                    if (request->n_lines_received == request->n_lines_total)
-                    {
-                        if (protocol->onPackage(conn, buffer->str, buffer->length) < 0)
-                        {
-                            return SW_ERR;
-                        }
-                        if (conn->removed)
-                        {
-                            return SW_OK;
-                        }
-                        swString_clear(buffer);
-                        bzero(request, sizeof(swRedis_request));
-                        return SW_OK;
-                    }
-                }
-                break;
+/**
+ * reply encoders, append to the buffer so that many replies go out in one write
+ */
+int swRedis_reply_nil(swString *buffer)
+{
+    return swString_append_ptr(buffer, SW_STRL(SW_REDIS_RETURN_NIL) - 1);
+}
 
-            default:
-                goto failed;
-            }
-        } while(p < pe);
+int swRedis_reply_status(swString *buffer, char *str, int length)
+{
+    return swRedis_reply_line(buffer, '+', str, length);
+}
+
+int swRedis_reply_error(swString *buffer, char *str, int length)
+{
+    return swRedis_reply_line(buffer, '-', str, length);
+}
+
+int swRedis_reply_int(swString *buffer, long value)
+{
+    return swRedis_reply_header(buffer, ':', value);
+}
+
+int swRedis_reply_string(swString *buffer, char *str, int length)
+{
+    if (swRedis_reply_header(buffer, '$', length) < 0)
+    {
+        return SW_ERR;
     }
-    failed:
-    swWarn("redis protocol error.");
-    return SW_ERR;
+    size_t new_length = buffer->length + length + SW_CRLF_LEN;
+    if (new_length > buffer->size && swString_extend_align(buffer, new_length) < 0)
+    {
+        return SW_ERR;
+    }
+    memcpy(buffer->str + buffer->length, str, length);
+    memcpy(buffer->str + buffer->length + length, SW_CRLF, SW_CRLF_LEN);
+    buffer->length += length + SW_CRLF_LEN;
+    return SW_OK;
+}
+
+int swRedis_reply_array(swString *buffer, int n)
+{
+    return swRedis_reply_header(buffer, '*', n);
 }
@@ -20,6 +20,20 @@
 #include "Connection.h"
 
 #include <sys/time.h>
+#include <sys/uio.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define SW_WEBSOCKET_MASK_AVX2   1
+#endif
+
+#ifdef SW_HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 /*  The following is websocket data frame:
  +-+-+-+-+-------+-+-------------+-------------------------------+
@@ -91,64 +105,184 @@ int swWebSocket_get_package_length(swProtocol *protocol, swConnection *conn, cha
     return header_length + payload_length;
 }
 
-void swWebSocket_encode(swString *buffer, char *data, size_t length, char opcode, int finish, int mask)
+int swWebSocket_encode_header(char *header, size_t length, char opcode, int flags, int mask)
 {
     int pos = 0;
-    char frame_header[16];
 
-    /**
-     * frame header
-     */
-    frame_header[pos++] = FRAME_SET_FIN(finish) | FRAME_SET_OPCODE(opcode);
+    header[pos++] = FRAME_SET_FIN(flags & SW_WEBSOCKET_FLAG_FIN) | FRAME_SET_RSV1((flags & SW_WEBSOCKET_FLAG_COMPRESS) ? 1 : 0)
+            | FRAME_SET_OPCODE(opcode);
     if (length < 126)
     {
-        frame_header[pos++] = FRAME_SET_MASK(mask) | FRAME_SET_LENGTH(length, 0);
+        header[pos++] = FRAME_SET_MASK(mask) | FRAME_SET_LENGTH(length, 0);
     }
     else
     {
         if (length < 65536)
         {
-            frame_header[pos++] = FRAME_SET_MASK(mask) | 126;
+            header[pos++] = FRAME_SET_MASK(mask) | 126;
         }
         else
         {
-            frame_header[pos++] = FRAME_SET_MASK(mask) | 127;
-            frame_header[pos++] = FRAME_SET_LENGTH(length, 7);
-            frame_header[pos++] = FRAME_SET_LENGTH(length, 6);
-            frame_header[pos++] = FRAME_SET_LENGTH(length, 5);
-            frame_header[pos++] = FRAME_SET_LENGTH(length, 4);
-            frame_header[pos++] = FRAME_SET_LENGTH(length, 3);
-            frame_header[pos++] = FRAME_SET_LENGTH(length, 2);
+            header[pos++] = FRAME_SET_MASK(mask) | 127;
+            header[pos++] = FRAME_SET_LENGTH(length, 7);
+            header[pos++] = FRAME_SET_LENGTH(length, 6);
+            header[pos++] = FRAME_SET_LENGTH(length, 5);
+            header[pos++] = FRAME_SET_LENGTH(length, 4);
+            header[pos++] = FRAME_SET_LENGTH(length, 3);
+            header[pos++] = FRAME_SET_LENGTH(length, 2);
         }
-        frame_header[pos++] = FRAME_SET_LENGTH(length, 1);
-        frame_header[pos++] = FRAME_SET_LENGTH(length, 0);
+        header[pos++] = FRAME_SET_LENGTH(length, 1);
+        header[pos++] = FRAME_SET_LENGTH(length, 0);
+    }
+    if (mask)
+    {
+        memcpy(header + pos, SW_WEBSOCKET_MASK_DATA, SW_WEBSOCKET_MASK_LEN);
+        pos += SW_WEBSOCKET_MASK_LEN;
+    }
+    return pos;
+}
+
+void swWebSocket_encode(swString *buffer, char *data, size_t length, char opcode, int flags, int mask)
+{
+    char frame_header[SW_WEBSOCKET_HEADER_MAX_LEN];
+    int n = swWebSocket_encode_header(frame_header, length, opcode, flags, mask);
+
+    if (buffer->size < buffer->length + n + length)
+    {
+        swString_extend(buffer, buffer->length + n + length);
     }
-    swString_append_ptr(buffer, frame_header, pos);
+    swString_append_ptr(buffer, frame_header, n);
 
     /**
      * frame body
      */
     if (data && length > 0)
     {
+        swString_append_ptr(buffer, data, length);
         if (mask)
         {
-            char *_mask_data = SW_WEBSOCKET_MASK_DATA;
-            swString_append_ptr(buffer, _mask_data, SW_WEBSOCKET_MASK_LEN);
+            swWebSocket_mask(buffer->str + buffer->length - length, length, SW_WEBSOCKET_MASK_DATA);
+        }
+    }
+}
 
-            char *_data = buffer->str + buffer->length;
-            swString_append_ptr(buffer, data, length);
+/**
+ * write the frame header and the payload without assembling them, the payload is not copied
+ * unless the socket cannot take it now and the reactor has to buffer the rest.
+ */
+int swWebSocket_send_frame(swReactor *reactor, swConnection *conn, char *data, size_t length, char opcode, int flags)
+{
+    char header[SW_WEBSOCKET_HEADER_MAX_LEN];
+    int header_length = swWebSocket_encode_header(header, length, opcode, flags, 0);
+    ssize_t n = 0;
+
+#ifdef SW_USE_OPENSSL
+    if (!conn->ssl && swBuffer_empty(conn->out_buffer))
+#else
+    if (swBuffer_empty(conn->out_buffer))
+#endif
+    {
+        struct iovec iov[2];
+        iov[0].iov_base = header;
+        iov[0].iov_len = header_length;
+        iov[1].iov_base = data;
+        iov[1].iov_len = length;
 
-            int i;
-            for (i = 0; i < length; i++)
+        n = writev(conn->fd, iov, length > 0 ? 2 : 1);
+        if (n < 0)
+        {
+            if (swConnection_error(errno) != SW_WAIT)
             {
-                _data[i] ^= _mask_data[i % SW_WEBSOCKET_MASK_LEN];
+                swSysError("writev(%d) failed.", conn->fd);
+                return SW_ERR;
             }
+            n = 0;
         }
-        else
+    }
+
+    if (n < header_length)
+    {
+        if (reactor->write(reactor, conn->fd, header + n, header_length - n) < 0)
         {
-            swString_append_ptr(buffer, data, length);
+            return SW_ERR;
         }
+        n = header_length;
+    }
+    n -= header_length;
+    if (n < length && reactor->write(reactor, conn->fd, data + n, length - n) < 0)
+    {
+        return SW_ERR;
     }
+    return SW_OK;
+}
+
+static void swWebSocket_mask_word(char *data, size_t length, char *mask_key)
+{
+    uint32_t key32;
+    uint64_t key64, word;
+    size_t i = 0;
+
+    memcpy(&key32, mask_key, sizeof(key32));
+    key64 = ((uint64_t) key32 << 32) | key32;
+
+    for (; i + sizeof(word) <= length; i += sizeof(word))
+    {
+        memcpy(&word, data + i, sizeof(word));
+        word ^= key64;
+        memcpy(data + i, &word, sizeof(word));
+    }
+    for (; i < length; i++)
+    {
+        data[i] ^= mask_key[i & 3];
+    }
+}
+
+#ifdef SW_WEBSOCKET_MASK_AVX2
+__attribute__((target("avx2")))
+static size_t swWebSocket_mask_avx2(char *data, size_t length, uint32_t key32)
+{
+    __m256i key = _mm256_set1_epi32(key32);
+    size_t i = 0;
+
+    for (; i + 32 <= length; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((__m256i *) (data + i));
+        _mm256_storeu_si256((__m256i *) (data + i), _mm256_xor_si256(v, key));
+    }
+    return i;
+}
+#endif
+
+/**
+ * data[i] ^= mask_key[i % 4], 32 bytes per step with AVX2, 16 with SSE2, otherwise 8
+ */
+void swWebSocket_mask(char *data, size_t length, char *mask_key)
+{
+    size_t i = 0;
+
+#if defined(SW_WEBSOCKET_MASK_AVX2) || defined(__SSE2__)
+    uint32_t key32;
+    memcpy(&key32, mask_key, sizeof(key32));
+#endif
+
+#ifdef SW_WEBSOCKET_MASK_AVX2
+    if (length >= 64 && __builtin_cpu_supports("avx2"))
+    {
+        i = swWebSocket_mask_avx2(data, length, key32);
+    }
+#endif
+
+#ifdef __SSE2__
+    __m128i key = _mm_set1_epi32(key32);
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((__m128i *) (data + i));
+        _mm_storeu_si128((__m128i *) (data + i), _mm_xor_si128(v, key));
+    }
+#endif
+
+    //i is a multiple of 4, the mask key is still aligned with data + i
+    swWebSocket_mask_word(data + i, length - i, mask_key);
 }
 
 void swWebSocket_decode(swWebSocket_frame *frame, swString *data)
@@ -178,12 +312,7 @@ void swWebSocket_decode(swWebSocket_frame *frame, swString *data)
         char *mask_key = frame->mask_key;
         memcpy(mask_key, data->str + header_length, SW_WEBSOCKET_MASK_LEN);
         header_length += SW_WEBSOCKET_MASK_LEN;
-        buf = data->str + header_length;
-        int i;
-        for (i = 0; i < payload_length; i++)
-        {
-            buf[i] ^= mask_key[i % SW_WEBSOCKET_MASK_LEN];
-        }
+        swWebSocket_mask(data->str + header_length, payload_length, mask_key);
     }
     frame->payload_length = payload_length;
     frame->header_length = header_length;
@@ -202,6 +331,18 @@ void swWebSocket_print_frame(swWebSocket_frame *frame)
     }
 }
 
+/**
+ * fail the connection, the caller returns SW_ERR to close it
+ */
+static void swWebSocket_send_close(swConnection *conn, uint16_t code)
+{
+    char frame[4];
+    frame[0] = 0x88;
+    frame[1] = 0x02;
+    *(uint16_t *) (frame + 2) = htons(code);
+    swConnection_send(conn, frame, sizeof(frame), 0);
+}
+
 int swWebSocket_dispatch_frame(swConnection *conn, char *data, uint32_t length)
 {
     swString frame;
@@ -218,6 +359,18 @@ int swWebSocket_dispatch_frame(swConnection *conn, char *data, uint32_t length)
     swWebSocket_frame ws;
     swWebSocket_decode(&ws, &frame);
 
+    /**
+     * RSV1 marks the first frame of a compressed message, only after permessage-deflate was negotiated
+     */
+    if (ws.header.RSV1 && (!conn->websocket_compression || (ws.header.OPCODE != WEBSOCKET_OPCODE_TEXT_FRAME
+            && ws.header.OPCODE != WEBSOCKET_OPCODE_BINARY_FRAME)))
+    {
+        swWarn("unexpected RSV1 in frame[opcode=%d]. remote_addr=%s:%d.", ws.header.OPCODE, swConnection_get_ip(conn),
+                swConnection_get_port(conn));
+        swWebSocket_send_close(conn, WEBSOCKET_CLOSE_PROTOCOL_ERROR);
+        return SW_ERR;
+    }
+
     swString *frame_buffer;
     int frame_length;
     swListenPort *port;
@@ -255,7 +408,7 @@ int swWebSocket_dispatch_frame(swConnection *conn, char *data, uint32_t length)
     case WEBSOCKET_OPCODE_TEXT_FRAME:
     case WEBSOCKET_OPCODE_BINARY_FRAME:
         offset = length - ws.payload_length - 2;
-        data[offset] = 1;
+        data[offset] = SW_WEBSOCKET_FLAG_FIN | (ws.header.RSV1 ? SW_WEBSOCKET_FLAG_COMPRESS : 0);
         data[offset + 1] = ws.header.OPCODE;
         if (!ws.header.FIN)
         {
@@ -273,20 +426,26 @@ int swWebSocket_dispatch_frame(swConnection *conn, char *data, uint32_t length)
         break;
 
     case WEBSOCKET_OPCODE_PING:
-        if (length >= (sizeof(buf) - 2))
+        if (ws.payload_length > 0x7d)
         {
             swWarn("ping frame application data is too big. remote_addr=%s:%d.", swConnection_get_ip(conn), swConnection_get_port(conn));
             return SW_ERR;
         }
-        else if (length == 2)
-        {
-            swWebSocket_encode(&send_frame, NULL, 0, WEBSOCKET_OPCODE_PONG, 1, 0);
-        }
         else
         {
-            swWebSocket_encode(&send_frame, data += 2, length - 2, WEBSOCKET_OPCODE_PONG, 1, 0);
+            swServer *serv = SwooleG.serv;
+            swReactor *reactor = SwooleG.main_reactor;
+            if (serv->factory_mode == SW_MODE_PROCESS || serv->factory_mode == SW_MODE_THREAD)
+            {
+                reactor = &(swServer_get_thread(serv, conn->from_id)->reactor);
+            }
+            //echo the application data back without copying it into a new frame
+            if (swWebSocket_send_frame(reactor, conn, ws.payload, ws.payload_length, WEBSOCKET_OPCODE_PONG,
+                    SW_WEBSOCKET_FLAG_FIN) < 0)
+            {
+                return SW_ERR;
+            }
         }
-        swConnection_send(conn, send_frame.str, send_frame.length, 0);
         break;
 
     case WEBSOCKET_OPCODE_PONG:
@@ -309,3 +468,127 @@ int swWebSocket_dispatch_frame(swConnection *conn, char *data, uint32_t length)
     }
     return SW_OK;
 }
+
+#ifdef SW_HAVE_ZLIB
+/**
+ * permessage-deflate (RFC 7692) with no_context_takeover on both sides,
+ * so one stream per process is reset and reused for every message.
+ */
+int swWebSocket_deflate(swString *out, char *data, size_t length)
+{
+    static z_stream zstream;
+    static int inited = 0;
+    int status;
+
+    if (!inited)
+    {
+        bzero(&zstream, sizeof(zstream));
+        if (deflateInit2(&zstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            swWarn("deflateInit2() failed.");
+            return SW_ERR;
+        }
+        inited = 1;
+    }
+    else
+    {
+        deflateReset(&zstream);
+    }
+
+    swString_clear(out);
+    if (out->size < length + 16 && swString_extend(out, length + 16) < 0)
+    {
+        return SW_ERR;
+    }
+
+    zstream.next_in = (Bytef *) data;
+    zstream.avail_in = length;
+
+    do
+    {
+        if (out->size - out->length < 16 && swString_extend(out, out->size * 2) < 0)
+        {
+            return SW_ERR;
+        }
+        zstream.next_out = (Bytef *) (out->str + out->length);
+        zstream.avail_out = out->size - out->length;
+        status = deflate(&zstream, Z_SYNC_FLUSH);
+        if (status != Z_OK && status != Z_BUF_ERROR)
+        {
+            swWarn("deflate() failed, Error: %d.", status);
+            return SW_ERR;
+        }
+        out->length = out->size - zstream.avail_out;
+    } while (zstream.avail_in > 0 || zstream.avail_out == 0);
+
+    //strip the 00 00 ff ff tail of the sync flush
+    if (out->length >= 4 && memcmp(out->str + out->length - 4, "\x00\x00\xff\xff", 4) == 0)
+    {
+        out->length -= 4;
+    }
+    return SW_OK;
+}
+
+int swWebSocket_inflate(swString *out, char *data, size_t length, size_t max_length)
+{
+    static z_stream zstream;
+    static int inited = 0;
+    static char tail[] = { 0x00, 0x00, (char) 0xff, (char) 0xff };
+    int status;
+    int i;
+
+    if (!inited)
+    {
+        bzero(&zstream, sizeof(zstream));
+        if (inflateInit2(&zstream, -MAX_WBITS) != Z_OK)
+        {
+            swWarn("inflateInit2() failed.");
+            return SW_ERR;
+        }
+        inited = 1;
+    }
+    else
+    {
+        inflateReset(&zstream);
+    }
+
+    swString_clear(out);
+
+    for (i = 0; i < 2; i++)
+    {
+        zstream.next_in = (Bytef *) (i == 0 ? data : tail);
+        zstream.avail_in = i == 0 ? length : sizeof(tail);
+
+        while (zstream.avail_in > 0)
+        {
+            //one byte over max_length is enough to tell the message is too big
+            if (out->size - out->length < 64 && out->size <= max_length)
+            {
+                if (swString_extend(out, out->size * 2 > max_length ? max_length + 1 : out->size * 2) < 0)
+                {
+                    return SW_ERR;
+                }
+            }
+            zstream.next_out = (Bytef *) (out->str + out->length);
+            zstream.avail_out = (out->size > max_length ? max_length + 1 : out->size) - out->length;
+            status = inflate(&zstream, Z_SYNC_FLUSH);
+            out->length = (Bytef *) zstream.next_out - (Bytef *) out->str;
+            if (out->length > max_length)
+            {
+                swWarn("inflated message is too big, max_length=%ld.", (long) max_length);
+                return SW_ERR;
+            }
+            if (status == Z_STREAM_END)
+            {
+                break;
+            }
+            else if (status != Z_OK && !(status == Z_BUF_ERROR && zstream.avail_out == 0))
+            {
+                swWarn("inflate() failed, Error: %d.", status);
+                return SW_ERR;
+            }
+        }
+    }
+    return SW_OK;
+}
+#endif
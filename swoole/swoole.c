@@ -142,6 +142,10 @@ ZEND_END_ARG_INFO()
 ZEND_BEGIN_ARG_INFO_EX(arginfo_swoole_server_reload_oo, 0, 0, 0)
 ZEND_END_ARG_INFO()
 
+ZEND_BEGIN_ARG_INFO_EX(arginfo_swoole_server_stats_oo, 0, 0, 0)
+    ZEND_ARG_INFO(0, mode)
+ZEND_END_ARG_INFO()
+
 ZEND_BEGIN_ARG_INFO_EX(arginfo_swoole_server_heartbeat_oo, 0, 0, 1)
     ZEND_ARG_INFO(0, reactor_id)
 ZEND_END_ARG_INFO()
@@ -371,7 +375,7 @@ static zend_function_entry swoole_server_methods[] = {
     //process
     PHP_ME(swoole_server, sendMessage, arginfo_swoole_server_sendMessage, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_server, addProcess, arginfo_swoole_server_addProcess, ZEND_ACC_PUBLIC)
-    PHP_ME(swoole_server, stats, arginfo_swoole_void, ZEND_ACC_PUBLIC)
+    PHP_ME(swoole_server, stats, arginfo_swoole_server_stats_oo, ZEND_ACC_PUBLIC)
 #ifdef SWOOLE_SOCKETS_SUPPORT
     PHP_ME(swoole_server, getSocket, arginfo_swoole_server_getSocket, ZEND_ACC_PUBLIC)
 #endif
@@ -666,6 +670,13 @@ PHP_MINIT_FUNCTION(swoole)
     REGISTER_LONG_CONSTANT("SWOOLE_IPC_MSGQUEUE", SW_TASK_IPC_MSGQUEUE, CONST_CS | CONST_PERSISTENT);
     REGISTER_LONG_CONSTANT("SWOOLE_IPC_PREEMPTIVE", SW_TASK_IPC_PREEMPTIVE, CONST_CS | CONST_PERSISTENT);
 
+    /**
+     * swoole_server::stats() mode
+     */
+    REGISTER_LONG_CONSTANT("SWOOLE_STATS_DEFAULT", SW_STATS_DEFAULT, CONST_CS | CONST_PERSISTENT);
+    REGISTER_LONG_CONSTANT("SWOOLE_STATS_TEXT", SW_STATS_TEXT, CONST_CS | CONST_PERSISTENT);
+    REGISTER_LONG_CONSTANT("SWOOLE_STATS_PROMETHEUS", SW_STATS_PROMETHEUS, CONST_CS | CONST_PERSISTENT);
+
     /**
      * socket type
      */
@@ -935,6 +946,11 @@ PHP_RSHUTDOWN_FUNCTION(swoole)
     {
         swWorker_clean();
     }
+    //the slab objects cached by this process go back to the shared free lists before the worker exits
+    if (swIsWorker() || swIsTaskWorker())
+    {
+        swSlab_flush();
+    }
 
     if (SwooleGS->start > 0 && SwooleG.running > 0)
     {
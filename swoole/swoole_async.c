@@ -57,8 +57,8 @@ static void php_swoole_aio_onComplete(swAio_event *event);
 static void php_swoole_dns_callback(char *domain, swDNSResolver_result *result, void *data);
 static void php_swoole_file_request_free(void *data);
 
-static swHashMap *php_swoole_open_files;
-static swHashMap *php_swoole_aio_request;
+static swFlatMap *php_swoole_open_files;
+static swFlatMap *php_swoole_aio_request;
 
 static sw_inline void swoole_aio_free(void *ptr)
 {
@@ -112,13 +112,14 @@ void swoole_async_init(int module_number TSRMLS_DC)
 
     REGISTER_LONG_CONSTANT("SWOOLE_AIO_BASE", SW_AIO_BASE, CONST_CS | CONST_PERSISTENT);
     REGISTER_LONG_CONSTANT("SWOOLE_AIO_LINUX", SW_AIO_LINUX, CONST_CS | CONST_PERSISTENT);
+    REGISTER_LONG_CONSTANT("SWOOLE_AIO_URING", SW_AIO_URING, CONST_CS | CONST_PERSISTENT);
 
-    php_swoole_open_files = swHashMap_new(SW_HASHMAP_INIT_BUCKET_N, NULL);
+    php_swoole_open_files = swFlatMap_new(SW_HASHMAP_INIT_BUCKET_N, NULL);
     if (php_swoole_open_files == NULL)
     {
         swoole_php_fatal_error(E_ERROR, "create hashmap[1] failed.");
     }
-    php_swoole_aio_request = swHashMap_new(SW_HASHMAP_INIT_BUCKET_N, php_swoole_file_request_free);
+    php_swoole_aio_request = swFlatMap_new(SW_HASHMAP_INIT_BUCKET_N, php_swoole_file_request_free);
     if (php_swoole_aio_request == NULL)
     {
         swoole_php_fatal_error(E_ERROR, "create hashmap[2] failed.");
@@ -214,7 +215,7 @@ static void php_swoole_aio_onComplete(swAio_event *event)
     }
     else
     {
-        file_req = swHashMap_find_int(php_swoole_aio_request, event->task_id);
+        file_req = swFlatMap_find_int(php_swoole_aio_request, event->task_id);
         if (!file_req)
         {
             swoole_php_fatal_error(E_WARNING, "swoole_async: onAsyncComplete callback not found[1]");
@@ -314,18 +315,18 @@ static void php_swoole_aio_onComplete(swAio_event *event)
         {
             close_file:
             close(event->fd);
-            swHashMap_del_int(php_swoole_aio_request, event->task_id);
+            swFlatMap_del_int(php_swoole_aio_request, event->task_id);
         }
         else if(file_req->type == SW_AIO_WRITE)
         {
             if (retval != NULL && !ZVAL_IS_NULL(retval) && !Z_BVAL_P(retval))
             {
-                swHashMap_del(php_swoole_open_files, Z_STRVAL_P(file_req->filename), Z_STRLEN_P(file_req->filename));
+                swFlatMap_del(php_swoole_open_files, Z_STRVAL_P(file_req->filename), Z_STRLEN_P(file_req->filename));
                 goto close_file;
             }
             else
             {
-                swHashMap_del_int(php_swoole_aio_request, event->task_id);
+                swFlatMap_del_int(php_swoole_aio_request, event->task_id);
             }
         }
         else
@@ -343,7 +344,7 @@ static void php_swoole_aio_onComplete(swAio_event *event)
             }
             else
             {
-                swHashMap_move_int(php_swoole_aio_request, event->task_id, ret);
+                swFlatMap_move_int(php_swoole_aio_request, event->task_id, ret);
             }
         }
     }
@@ -451,7 +452,7 @@ PHP_FUNCTION(swoole_async_read)
     }
     else
     {
-        swHashMap_add_int(php_swoole_aio_request, ret, req);
+        swFlatMap_add_int(php_swoole_aio_request, ret, req);
         RETURN_TRUE;
     }
 
@@ -488,7 +489,7 @@ PHP_FUNCTION(swoole_async_write)
 
     convert_to_string(filename);
 
-    long fd = (long) swHashMap_find(php_swoole_open_files, Z_STRVAL_P(filename), Z_STRLEN_P(filename));
+    long fd = (long) swFlatMap_find(php_swoole_open_files, Z_STRVAL_P(filename), Z_STRLEN_P(filename));
     if (fd == 0)
     {
         int open_flag = O_WRONLY | O_CREAT;
@@ -512,7 +513,7 @@ PHP_FUNCTION(swoole_async_write)
             swoole_php_fatal_error(E_WARNING, "open(%s, %d) failed. Error: %s[%d]", Z_STRVAL_P(filename), open_flag, strerror(errno), errno);
             RETURN_FALSE;
         }
-        swHashMap_add(php_swoole_open_files, Z_STRVAL_P(filename), Z_STRLEN_P(filename), (void*) fd);
+        swFlatMap_add(php_swoole_open_files, Z_STRVAL_P(filename), Z_STRLEN_P(filename), (void*) fd);
     }
 
     if (offset < 0)
@@ -553,7 +554,7 @@ PHP_FUNCTION(swoole_async_write)
     }
     else
     {
-        swHashMap_add_int(php_swoole_aio_request, ret, req);
+        swFlatMap_add_int(php_swoole_aio_request, ret, req);
         RETURN_TRUE;
     }
 }
@@ -632,7 +633,7 @@ PHP_FUNCTION(swoole_async_readfile)
     }
     else
     {
-        swHashMap_add_int(php_swoole_aio_request, ret, req);
+        swFlatMap_add_int(php_swoole_aio_request, ret, req);
         RETURN_TRUE;
     }
 }
@@ -728,7 +729,7 @@ PHP_FUNCTION(swoole_async_writefile)
     }
     else
     {
-        swHashMap_add_int(php_swoole_aio_request, ret, req);
+        swFlatMap_add_int(php_swoole_aio_request, ret, req);
         RETURN_TRUE;
     }
 }
@@ -71,7 +71,7 @@ static PHP_METHOD(swoole_channel, __construct)
         size = 1024 * 128;
     }
 
-    swChannel *chan = swChannel_new(size, SW_BUFFER_SIZE_STD, SW_CHAN_LOCK | SW_CHAN_SHM);
+    swChannel *chan = swChannel_new(size, SW_BUFFER_SIZE_STD, SW_CHAN_MPMC | SW_CHAN_SHM);
     if (chan == NULL)
     {
         zend_throw_exception(swoole_exception_class_entry_ptr, "cahnnel create failed.", SW_ERROR_MALLOC_FAIL TSRMLS_CC);
@@ -122,6 +122,6 @@ static PHP_METHOD(swoole_channel, stats)
     swChannel *chan = swoole_get_object(getThis());
     array_init(return_value);
 
-    sw_add_assoc_long_ex(return_value, ZEND_STRS("queue_num"), chan->num);
-    sw_add_assoc_long_ex(return_value, ZEND_STRS("queue_bytes"), chan->bytes);
+    sw_add_assoc_long_ex(return_value, ZEND_STRS("queue_num"), swChannel_num(chan));
+    sw_add_assoc_long_ex(return_value, ZEND_STRS("queue_bytes"), swChannel_bytes(chan));
 }
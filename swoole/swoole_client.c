@@ -74,6 +74,7 @@ static PHP_METHOD(swoole_client, getsockname);
 static PHP_METHOD(swoole_client, getpeername);
 static PHP_METHOD(swoole_client, close);
 static PHP_METHOD(swoole_client, on);
+static PHP_METHOD(swoole_client, getPoolStats);
 
 #ifdef SWOOLE_SOCKETS_SUPPORT
 static PHP_METHOD(swoole_client, getSocket);
@@ -255,13 +256,15 @@ static const zend_function_entry swoole_client_methods[] =
     PHP_ME(swoole_client, getpeername, arginfo_swoole_client_void, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_client, close, arginfo_swoole_client_close, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_client, on, arginfo_swoole_client_on, ZEND_ACC_PUBLIC)
+    PHP_ME(swoole_client, getPoolStats, arginfo_swoole_client_void, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
 #ifdef SWOOLE_SOCKETS_SUPPORT
     PHP_ME(swoole_client, getSocket, arginfo_swoole_client_void, ZEND_ACC_PUBLIC)
 #endif
     PHP_FE_END
 };
 
-static swHashMap *php_sw_long_connections;
+static swHashMap *php_sw_client_pools;
+static long php_sw_client_pool_timer = 0;
 
 zend_class_entry swoole_client_ce;
 zend_class_entry *swoole_client_class_entry_ptr;
@@ -277,7 +280,7 @@ void swoole_client_init(int module_number TSRMLS_DC)
     zend_declare_property_bool(swoole_client_class_entry_ptr, SW_STRL("reuse")-1, 0, ZEND_ACC_PUBLIC TSRMLS_CC);
     zend_declare_property_long(swoole_client_class_entry_ptr, SW_STRL("reuseCount")-1, 0, ZEND_ACC_PUBLIC TSRMLS_CC);
 
-    php_sw_long_connections = swHashMap_new(SW_HASHMAP_INIT_BUCKET_N, NULL);
+    php_sw_client_pools = swHashMap_new(SW_HASHMAP_INIT_BUCKET_N, NULL);
 
     zend_declare_class_constant_long(swoole_client_class_entry_ptr, ZEND_STRL("MSG_OOB"), MSG_OOB TSRMLS_CC);
     zend_declare_class_constant_long(swoole_client_class_entry_ptr, ZEND_STRL("MSG_PEEK"), MSG_PEEK TSRMLS_CC);
@@ -810,6 +813,219 @@ void php_swoole_check_reactor()
     SwooleWG.reactor_init = 1;
 }
 
+/**
+ * per-worker pool of kept tcp connections, keyed by host:port and socket type
+ */
+typedef struct
+{
+    swLinkedList *idle;
+    uint32_t total;
+    uint32_t max_idle;
+    uint32_t max_total;
+    double idle_timeout;
+
+    uint64_t created;
+    uint64_t reused;
+    uint64_t expired;
+    uint64_t broken;
+    uint64_t rejected;
+} swClientPool;
+
+static void client_pool_onTimer(swTimer_node *tnode, void *data);
+
+static void client_pool_set(swClientPool *pool, zval *zobject TSRMLS_DC)
+{
+    zval *ztmp;
+    HashTable *vht;
+    zval *zset = sw_zend_read_property(swoole_client_class_entry_ptr, zobject, ZEND_STRL("setting"), 1 TSRMLS_CC);
+    if (zset == NULL || ZVAL_IS_NULL(zset))
+    {
+        return;
+    }
+    vht = Z_ARRVAL_P(zset);
+    if (php_swoole_array_get_value(vht, "pool_max_idle", ztmp))
+    {
+        convert_to_long(ztmp);
+        pool->max_idle = (uint32_t) Z_LVAL_P(ztmp);
+    }
+    if (php_swoole_array_get_value(vht, "pool_max_total", ztmp))
+    {
+        convert_to_long(ztmp);
+        pool->max_total = (uint32_t) Z_LVAL_P(ztmp);
+    }
+    if (php_swoole_array_get_value(vht, "pool_idle_timeout", ztmp))
+    {
+        convert_to_double(ztmp);
+        pool->idle_timeout = (double) Z_DVAL_P(ztmp);
+    }
+}
+
+static swClientPool* client_pool_get(char *key, int key_len, zval *zobject TSRMLS_DC)
+{
+    swClientPool *pool = swHashMap_find(php_sw_client_pools, key, key_len);
+    if (pool == NULL)
+    {
+        pool = sw_malloc(sizeof(swClientPool));
+        if (pool == NULL)
+        {
+            swWarn("malloc(%ld) failed.", sizeof(swClientPool));
+            return NULL;
+        }
+        bzero(pool, sizeof(swClientPool));
+        pool->idle = swLinkedList_new(0, NULL);
+        if (pool->idle == NULL)
+        {
+            sw_free(pool);
+            return NULL;
+        }
+        pool->max_idle = SW_CLIENT_POOL_MAX_IDLE;
+        pool->max_total = SW_CLIENT_POOL_MAX_TOTAL;
+        pool->idle_timeout = SW_CLIENT_POOL_IDLE_TIMEOUT;
+        //the client that creates the pool sets its limits, later clients of the same key share them
+        client_pool_set(pool, zobject TSRMLS_CC);
+        swHashMap_add(php_sw_client_pools, key, key_len, pool);
+    }
+    return pool;
+}
+
+/**
+ * close a connection that no object owns
+ */
+static void client_pool_close(swClientPool *pool, swClient *cli)
+{
+    pool->total--;
+    cli->pool = NULL;
+    cli->released = 1;
+    if (!cli->socket->closed)
+    {
+        cli->close(cli);
+    }
+    efree(cli->server_str);
+    swClient_free(cli);
+    pefree(cli, 1);
+}
+
+/**
+ * the idle list is in release order, the least recently used connections are at the head
+ */
+static void client_pool_expire(swClientPool *pool, double now)
+{
+    swLinkedList_node *node;
+    while ((node = pool->idle->head) && now - node->priority / 1000.0 > pool->idle_timeout)
+    {
+        pool->expired++;
+        client_pool_close(pool, swLinkedList_shift(pool->idle));
+    }
+}
+
+static swClient* client_pool_pop(swClientPool *pool)
+{
+    swClient *cli;
+    uint64_t tmp_buf;
+    int ret;
+
+    client_pool_expire(pool, swoole_microtime());
+
+    while ((cli = swLinkedList_pop(pool->idle)))
+    {
+        //health check: closed by the peer or reset
+        ret = recv(cli->socket->fd, &tmp_buf, sizeof(tmp_buf), MSG_DONTWAIT | MSG_PEEK);
+        if (ret == 0 || (ret < 0 && swConnection_error(errno) == SW_CLOSE))
+        {
+            pool->broken++;
+            client_pool_close(pool, cli);
+            continue;
+        }
+        //clear history data
+        if (ret > 0)
+        {
+            swSocket_clean(cli->socket->fd);
+        }
+        if (cli->async && SwooleG.main_reactor->add(SwooleG.main_reactor, cli->socket->fd, cli->reactor_fdtype | SW_EVENT_READ) < 0)
+        {
+            pool->broken++;
+            client_pool_close(pool, cli);
+            continue;
+        }
+        pool->reused++;
+        return cli;
+    }
+    return NULL;
+}
+
+static void client_pool_onIdle(swClient *cli)
+{
+    //not attached to any object
+}
+
+/**
+ * put a kept connection back to its pool, return SW_ERR if it must be closed by the caller
+ */
+int php_swoole_client_pool_release(swClient *cli)
+{
+    swClientPool *pool = cli->pool;
+    if (pool == NULL || !cli->socket->active || cli->socket->closed)
+    {
+        return SW_ERR;
+    }
+
+    double now = swoole_microtime();
+    client_pool_expire(pool, now);
+    if (pool->idle->num >= pool->max_idle || pool->idle_timeout <= 0)
+    {
+        return SW_ERR;
+    }
+    //idle async connections are not watched by the reactor, they are checked when taken out
+    if (cli->async)
+    {
+        if (SwooleG.main_reactor->del(SwooleG.main_reactor, cli->socket->fd) < 0)
+        {
+            return SW_ERR;
+        }
+        cli->onConnect = client_pool_onIdle;
+        cli->onError = client_pool_onIdle;
+        cli->onClose = client_pool_onIdle;
+        cli->onReceive = NULL;
+    }
+    cli->object = NULL;
+
+    if (swLinkedList_append(pool->idle, cli) < 0)
+    {
+        return SW_ERR;
+    }
+    pool->idle->tail->priority = (ulong_t) (now * 1000);
+
+    if (php_sw_client_pool_timer == 0 && SwooleG.serv && SwooleG.main_reactor)
+    {
+        php_sw_client_pool_timer = php_swoole_add_internal_timer(SW_CLIENT_POOL_CHECK_INTERVAL, 1, client_pool_onTimer, NULL);
+        if (php_sw_client_pool_timer < 0)
+        {
+            php_sw_client_pool_timer = 0;
+        }
+    }
+    return SW_OK;
+}
+
+static void client_pool_onTimer(swTimer_node *tnode, void *data)
+{
+    swClientPool *pool;
+    char *key;
+    uint32_t idle_num = 0;
+    double now = swoole_microtime();
+
+    swHashMap_each_reset(php_sw_client_pools);
+    while ((pool = swHashMap_each(php_sw_client_pools, &key)))
+    {
+        client_pool_expire(pool, now);
+        idle_num += pool->idle->num;
+    }
+    if (idle_num == 0)
+    {
+        tnode->remove = 1;
+        php_sw_client_pool_timer = 0;
+    }
+}
+
 void php_swoole_client_free(zval *zobject, swClient *cli TSRMLS_DC)
 {
     //socks5 proxy config
@@ -827,12 +1043,12 @@ void php_swoole_client_free(zval *zobject, swClient *cli TSRMLS_DC)
         zval *zcallback = cli->protocol.private_data;
         sw_zval_free(zcallback);
     }
-    //long tcp connection, delete from php_sw_long_connections
+    //long tcp connection, leave the pool
     if (cli->keep)
     {
-        if (swHashMap_del(php_sw_long_connections, cli->server_str, cli->server_strlen))
+        if (cli->pool)
         {
-            swoole_php_fatal_error(E_WARNING, "delete from hashtable failed.");
+            ((swClientPool *) cli->pool)->total--;
         }
         efree(cli->server_str);
         swClient_free(cli);
@@ -854,8 +1070,7 @@ swClient* php_swoole_client_new(zval *object, char *host, int host_len, int port
     int async = 0;
     char conn_key[SW_LONG_CONNECTION_KEY_LEN];
     int conn_key_len = 0;
-    uint64_t tmp_buf;
-    int ret;
+    swClientPool *pool = NULL;
 
 #if PHP_MAJOR_VERSION < 7
     TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
@@ -883,44 +1098,40 @@ swClient* php_swoole_client_new(zval *object, char *host, int host_len, int port
 
     if (connection_id == NULL || ZVAL_IS_NULL(connection_id))
     {
-        conn_key_len = snprintf(conn_key, SW_LONG_CONNECTION_KEY_LEN, "%s:%d", host, port) + 1;
+        conn_key_len = snprintf(conn_key, SW_LONG_CONNECTION_KEY_LEN, "%s:%d#%ld", host, port, type) + 1;
     }
     else
     {
-        conn_key_len = snprintf(conn_key, SW_LONG_CONNECTION_KEY_LEN, "%s", Z_STRVAL_P(connection_id)) + 1;
+        conn_key_len = snprintf(conn_key, SW_LONG_CONNECTION_KEY_LEN, "%s#%ld", Z_STRVAL_P(connection_id), type) + 1;
+    }
+    if (conn_key_len > SW_LONG_CONNECTION_KEY_LEN)
+    {
+        conn_key_len = SW_LONG_CONNECTION_KEY_LEN;
     }
 
     //keep the tcp connection
     if (type & SW_FLAG_KEEP)
     {
-        swClient *find = swHashMap_find(php_sw_long_connections, conn_key, conn_key_len);
-        if (find == NULL)
+        pool = client_pool_get(conn_key, conn_key_len, object TSRMLS_CC);
+        if (pool == NULL)
         {
-            cli = (swClient*) pemalloc(sizeof(swClient), 1);
-            if (swHashMap_add(php_sw_long_connections, conn_key, conn_key_len, cli) == FAILURE)
-            {
-                swoole_php_fatal_error(E_WARNING, "swoole_client_create_socket add to hashtable failed.");
-            }
-            goto create_socket;
+            return NULL;
         }
-        else
+        cli = client_pool_pop(pool);
+        if (cli == NULL)
         {
-            cli = find;
-            //try recv, check connection status
-            ret = recv(cli->socket->fd, &tmp_buf, sizeof(tmp_buf), MSG_DONTWAIT | MSG_PEEK);
-            if (ret == 0 || (ret < 0 && swConnection_error(errno) == SW_CLOSE))
-            {
-                cli->close(cli);
-                goto create_socket;
-            }
-            //clear history data
-            if (ret > 0)
+            if (pool->total >= pool->max_total)
             {
-                swSocket_clean(cli->socket->fd);
+                pool->rejected++;
+                swoole_php_fatal_error(E_WARNING, "connection pool of %s is full, max_total=%d.", conn_key, pool->max_total);
+                zend_update_property_long(swoole_client_class_entry_ptr, object, ZEND_STRL("errCode"), EAGAIN TSRMLS_CC);
+                return NULL;
             }
-            cli->reuse_count ++;
-            zend_update_property_long(swoole_client_class_entry_ptr, object, ZEND_STRL("reuseCount"), cli->reuse_count TSRMLS_CC);
+            cli = (swClient*) pemalloc(sizeof(swClient), 1);
+            goto create_socket;
         }
+        cli->reuse_count ++;
+        zend_update_property_long(swoole_client_class_entry_ptr, object, ZEND_STRL("reuseCount"), cli->reuse_count TSRMLS_CC);
     }
     else
     {
@@ -931,12 +1142,23 @@ swClient* php_swoole_client_new(zval *object, char *host, int host_len, int port
         {
             swoole_php_fatal_error(E_WARNING, "swClient_create() failed. Error: %s [%d]", strerror(errno), errno);
             zend_update_property_long(swoole_client_class_entry_ptr, object, ZEND_STRL("errCode"), errno TSRMLS_CC);
+            if (pool)
+            {
+                pefree(cli, 1);
+            }
             return NULL;
         }
 
         //don't forget free it
         cli->server_str = estrdup(conn_key);
         cli->server_strlen = conn_key_len;
+
+        if (pool)
+        {
+            cli->pool = pool;
+            pool->total++;
+            pool->created++;
+        }
     }
 
     zend_update_property_long(swoole_client_class_entry_ptr, object, ZEND_STRL("sock"), cli->socket->fd TSRMLS_CC);
@@ -1651,7 +1873,7 @@ static PHP_METHOD(swoole_client, close)
     }
     //Connection error, or short tcp connection.
     //No keep connection
-    if (force || !cli->keep || swConnection_error(SwooleG.error) == SW_CLOSE)
+    if (force || !cli->keep || swConnection_error(SwooleG.error) == SW_CLOSE || php_swoole_client_pool_release(cli) < 0)
     {
         cli->released = 1;
         ret = cli->close(cli);
@@ -1659,7 +1881,7 @@ static PHP_METHOD(swoole_client, close)
     }
     else
     {
-        //unset object
+        //back to the pool, unset object
         swoole_set_object(getThis(), NULL);
     }
     SW_CHECK_RETURN(ret);
@@ -1752,6 +1974,33 @@ static PHP_METHOD(swoole_client, on)
     RETURN_TRUE;
 }
 
+static PHP_METHOD(swoole_client, getPoolStats)
+{
+    swClientPool *pool;
+    char *key;
+    zval *zstats;
+
+    array_init(return_value);
+
+    swHashMap_each_reset(php_sw_client_pools);
+    while ((pool = swHashMap_each(php_sw_client_pools, &key)))
+    {
+        SW_MAKE_STD_ZVAL(zstats);
+        array_init(zstats);
+        add_assoc_long(zstats, "idle", pool->idle->num);
+        add_assoc_long(zstats, "active", pool->total - pool->idle->num);
+        add_assoc_long(zstats, "max_idle", pool->max_idle);
+        add_assoc_long(zstats, "max_total", pool->max_total);
+        add_assoc_double(zstats, "idle_timeout", pool->idle_timeout);
+        add_assoc_long(zstats, "created", pool->created);
+        add_assoc_long(zstats, "reused", pool->reused);
+        add_assoc_long(zstats, "expired", pool->expired);
+        add_assoc_long(zstats, "broken", pool->broken);
+        add_assoc_long(zstats, "rejected", pool->rejected);
+        add_assoc_zval(return_value, key, zstats);
+    }
+}
+
 static PHP_METHOD(swoole_client, sleep)
 {
     swClient *cli = client_get_ptr(getThis() TSRMLS_CC);
@@ -64,6 +64,11 @@
 #define SW_CLIENT_MAX_PORT         65535
 //#define SW_CLIENT_SOCKET_WAIT
 
+#define SW_CLIENT_POOL_MAX_IDLE        64
+#define SW_CLIENT_POOL_MAX_TOTAL       1024
+#define SW_CLIENT_POOL_IDLE_TIMEOUT    60      //second
+#define SW_CLIENT_POOL_CHECK_INTERVAL  1000    //millisecond
+
 //!!!Don't modify.----------------------------------------------------------
 #if __MACH__
 #define SW_IPC_MAX_SIZE            2048  //MacOS
@@ -156,7 +161,6 @@
 #define SW_RINGQUEUE_LEN                 1024           //RingQueue队列长度
 #define SW_RINGQUEUE_MEMSIZE             (1024*1024*4)  //内存区大小,默认分配4M的内存
 
-//#define SW_USE_RINGQUEUE_TS            1     //使用线程安全版本的RingQueue
 #define SW_RINGBUFFER_COLLECT_N          100   //collect max_count
 #define SW_RINGBUFFER_FREE_N_MAX         4     //when free_n > MAX, execute collect
 #define SW_RINGBUFFER_WARNING            100
@@ -196,11 +200,23 @@
 
 #define SW_TASK_TMP_FILE                 "/tmp/swoole.task.XXXXXX"
 #define SW_TASK_TMPDIR_SIZE              128
+/**
+ * large task payloads are copied into a block of the shared slab, tmpfile is used only when
+ * the arena is full
+ */
+#define SW_TASK_ARENA_SIZE               (64 * 1024 * 1024)
+
+#define SW_STATS_FILE_INTERVAL           1000 //ms
 
 #define SW_FILE_CHUNK_SIZE               65536
 
 #define SW_TABLE_CONFLICT_PROPORTION     0.2 //20%
-#define SW_TABLE_COMPRESS_PROPORTION     0.5 //50% skip, will compress the row list
+#define SW_TABLE_LOAD_FACTOR             0.75 //split one bucket per insert above this load
+/**
+ * a table may grow to this many times the size passed to swoole_table::__construct,
+ * set it to 1 to keep the fixed size of the older versions
+ */
+#define SW_TABLE_MAX_RESIZE_MULTIPLE     8
 #define SW_TABLE_KEY_SIZE                64
 //#define SW_TABLE_USE_PHP_HASH
 //#define SW_TABLE_DEBUG
@@ -212,6 +228,9 @@
 #define SW_SSL_HTTP2_NPN_ADVERTISE       "\x02h2"
 
 #define SW_SPINLOCK_LOOP_N               1024
+#define SW_CACHELINE_SIZE                64
+
+#define SW_PIPE_RING_SIZE                (1024*1024*4)  //shared memory ring pipe, reactor -> worker
 
 #define SW_STRING_BUFFER_MAXLEN          (1024*1024*128)
 #define SW_STRING_BUFFER_DEFAULT         128
@@ -234,14 +253,42 @@
 #define SW_HTTP_HEADER_MAX_SIZE          8192
 #define SW_HTTP_HEADER_KEY_SIZE          128
 #define SW_HTTP_HEADER_VALUE_SIZE        4096
+#define SW_HTTP_HEADER_NUM               64
 #define SW_HTTP_COMPRESS_GZIP
+/**
+ * http_compression: default level, smallest body worth compressing,
+ * idle deflate streams kept by each worker for reuse
+ */
+#define SW_HTTP_COMPRESSION_LEVEL        1
+#define SW_HTTP_COMPRESSION_MIN_LENGTH   256
+#define SW_HTTP_COMPRESSION_STREAM_NUM   16
+#define SW_HTTP_BROTLI_WINDOW_BITS       18
+/**
+ * static handler: cached entries per worker, seconds before an entry is checked again with stat,
+ * files up to this size are kept in memory
+ */
+#define SW_HTTP_STATIC_CACHE_NUM         1024
+#define SW_HTTP_STATIC_CACHE_TTL         1
+#define SW_HTTP_STATIC_CACHE_FILE_SIZE   (64 * 1024)
 #define SW_HTTP_UPLOAD_TMPDIR_SIZE       256
+/**
+ * multipart bodies larger than this are spooled to disk while they arrive,
+ * file parts are written in blocks of SW_HTTP_UPLOAD_WRITE_SIZE
+ */
+#define SW_HTTP_UPLOAD_SPOOL_SIZE        (1024 * 1024)
+#define SW_HTTP_UPLOAD_WRITE_SIZE        (64 * 1024)
+/**
+ * form fields and part headers of a spooled body are kept in memory, up to this many bytes per request
+ */
+#define SW_HTTP_UPLOAD_FIELD_MAX_SIZE    (1024 * 1024)
 #define SW_HTTP_DATE_FORMAT              "D, d M Y H:i:s T"
 //#define SW_HTTP_100_CONTINUE
 #define SW_HTTP2_DATA_BUFFSER_SIZE       8192
 #define SW_HTTP2_MAX_CONCURRENT_STREAMS  128
 #define SW_HTTP2_MAX_FRAME_SIZE          ((1u << 24) - 1)
 #define SW_HTTP2_MAX_WINDOW              ((1u << 31) - 1)
+#define SW_HTTP2_HEADER_TABLE_SIZE       4096
+#define SW_HTTP2_SEND_BATCH_SIZE         (256 * 1024)
 
 #define SW_HTTP_CLIENT_USERAGENT         "swoole-http-client"
 #define SW_HTTP_CLIENT_BOUNDARY_PREKEY   "----SwooleBoundary"
@@ -251,11 +298,13 @@
 #define SW_WEBSOCKET_SERVER_SOFTWARE     "swoole-websocket-server"
 #define SW_WEBSOCKET_VERSION             "13"
 #define SW_WEBSOCKET_KEY_LENGTH          16
+#define SW_WEBSOCKET_COMPRESS_MIN_LENGTH 128
 
 #define SW_MYSQL_QUERY_INIT_SIZE         8192
 #define SW_MYSQL_DEFAULT_PORT            3306
 #define SW_MYSQL_CONNECT_TIMEOUT         1.0
 #define SW_MYSQL_DEFAULT_CHARSET         33  //0x21, utf8_general_ci
+#define SW_MYSQL_STMT_CACHE_SIZE         1024 //prepared statements kept per connection
 
 #define SW_PHP_FUNCTION_MAX_ARG          16
 
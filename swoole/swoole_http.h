@@ -24,6 +24,7 @@
 
 #ifdef SW_USE_HTTP2
 #include <nghttp2/nghttp2.h>
+#include "http2.h"
 #endif
 
 enum http_response_flag
@@ -35,6 +36,16 @@ enum http_response_flag
     HTTP_RESPONSE_CONTENT_TYPE     = 1u << 5,
 };
 
+enum http_compress_method
+{
+    HTTP_COMPRESS_NONE,
+    HTTP_COMPRESS_GZIP,
+    HTTP_COMPRESS_DEFLATE,
+    HTTP_COMPRESS_BR,
+};
+
+#define HTTP_ACCEPT_ENCODING(method)   (1u << (method))
+
 typedef struct
 {
     enum php_http_method method;
@@ -44,6 +55,14 @@ typedef struct
     const char *ext;
     uint32_t ext_len;
     uint8_t post_form_urlencoded;
+    /**
+     * multipart body already spooled to disk by the reactor
+     */
+    uint8_t upload_spooled;
+    /**
+     * the reactor marked the request with SW_EVENT_DATA_UPLOAD, a client cannot set it
+     */
+    uint8_t upload_trusted;
 
     swString *post_buffer;
     uint32_t post_length;
@@ -96,6 +115,8 @@ typedef struct
     uint32_t send_header :1;
     uint32_t gzip_enable :1;
     uint32_t gzip_level :4;
+    uint32_t compression_method :2;
+    uint32_t accept_encoding :4;
     uint32_t chunk :1;
     uint32_t keepalive :1;
     uint32_t http2 :1;
@@ -105,8 +126,13 @@ typedef struct
     uint32_t content_sender_initialized :1;
 
 #ifdef SW_USE_HTTP2
-    uint8_t priority;
     uint32_t stream_id;
+    uint32_t dependency;
+    uint16_t weight;
+    /**
+     * WINDOW_UPDATE of the stream received before the response is queued
+     */
+    int32_t send_window_delta;
 #endif
 
     http_request request;
@@ -115,6 +141,10 @@ typedef struct
     php_http_parser parser;
     multipart_parser *mt_parser;
     struct _swoole_http_client *client;
+    /**
+     * compressor of a chunked response, z_stream or BrotliEncoderState
+     */
+    void *zstream;
 
     uint16_t input_var_num;
     char *current_header_name;
@@ -133,10 +163,22 @@ typedef struct _swoole_http_client
     uint32_t http2 :1;
 
 #ifdef SW_USE_HTTP2
-    swHashMap *streams;
-    nghttp2_hd_inflater *deflater;
+    /**
+     * open streams, from HEADERS until the response is queued
+     */
+    swFlatMap *streams;
+    /**
+     * the dynamic tables live as long as the connection
+     */
+    nghttp2_hd_deflater *deflater;
     nghttp2_hd_inflater *inflater;
-    uint32_t window_size;
+    swHttp2_scheduler *scheduler;
+    uint32_t header_table_size;
+    uint32_t last_stream_id;
+    /**
+     * DATA received since the last WINDOW_UPDATE of the connection
+     */
+    uint32_t recv_window_consumed;
 #endif
 
 } swoole_http_client;
@@ -414,16 +414,25 @@ static int http_client_execute(zval *zobject, char *uri, zend_size_t uri_len, zv
         return SW_OK;
     }
 
+    zval *ztmp;
+    HashTable *vht;
+    zval *zset = sw_zend_read_property(swoole_http_client_class_entry_ptr, zobject, ZEND_STRL("setting"), 1 TSRMLS_CC);
+
+    //kept-alive connections are shared with other objects through the connection pool
+    zval *ztype = sw_zend_read_property(swoole_client_class_entry_ptr, zobject, ZEND_STRL("type"), 0 TSRMLS_CC);
+    long type = Z_LVAL_P(ztype) & (~SW_FLAG_KEEP);
+    if (http->keep_alive && !(zset && !ZVAL_IS_NULL(zset) && php_swoole_array_get_value(Z_ARRVAL_P(zset), "http_proxy_host", ztmp)))
+    {
+        type |= SW_FLAG_KEEP;
+    }
+    zend_update_property_long(swoole_client_class_entry_ptr, zobject, ZEND_STRL("type"), type TSRMLS_CC);
+
     swClient *cli = php_swoole_client_new(zobject, http->host, http->host_len, http->port);
     if (cli == NULL)
     {
         return SW_ERR;
     }
     http->cli = cli;
-
-    zval *ztmp;
-    HashTable *vht;
-    zval *zset = sw_zend_read_property(swoole_http_client_class_entry_ptr, zobject, ZEND_STRL("setting"), 1 TSRMLS_CC);
     if (zset && !ZVAL_IS_NULL(zset))
     {
         vht = Z_ARRVAL_P(zset);
@@ -466,12 +475,6 @@ static int http_client_execute(zval *zobject, char *uri, zend_size_t uri_len, zv
         }
     }
 
-    if (cli->socket->active == 1)
-    {
-        swoole_php_fatal_error(E_WARNING, "swoole_http_client is already connected.");
-        return SW_ERR;
-    }
-
     cli->object = zobject;
     sw_copy_to_stack(cli->object, hcc->_object);
     sw_zval_add_ref(&zobject);
@@ -483,7 +486,17 @@ static int http_client_execute(zval *zobject, char *uri, zend_size_t uri_len, zv
     cli->onConnect = http_client_onConnect;
     cli->onClose = http_client_onClose;
     cli->onError = http_client_onError;
-    
+
+    //taken from the connection pool
+    if (cli->socket->active == 1)
+    {
+        if (cli->buffer)
+        {
+            swString_clear(cli->buffer);
+        }
+        return http_client_send_http_request(zobject TSRMLS_CC);
+    }
+
     return cli->connect(cli, http->host, http->port, http->timeout, 0);
 }
 
@@ -1454,7 +1467,8 @@ static PHP_METHOD(swoole_http_client, close)
         RETURN_FALSE;
     }
     int ret = SW_OK;
-    if (!cli->keep || swConnection_error(SwooleG.error) == SW_CLOSE)
+    if (!cli->keep || swConnection_error(SwooleG.error) == SW_CLOSE || http->state != HTTP_CLIENT_STATE_READY
+            || http->upgrade || php_swoole_client_pool_release(cli) < 0)
     {
         cli->released = 1;
         ret = cli->close(cli);
@@ -1462,8 +1476,13 @@ static PHP_METHOD(swoole_http_client, close)
     }
     else
     {
-        //unset object
-        swoole_set_object(getThis(), NULL);
+        //the connection is back in the pool
+        zval *zobject = getThis();
+        http->cli = NULL;
+        http_client_free(zobject TSRMLS_CC);
+        swoole_set_object(zobject, NULL);
+        //the reference taken on connect
+        sw_zval_ptr_dtor(&zobject);
     }
     SW_CHECK_RETURN(ret);
 }
@@ -35,16 +35,15 @@
 
 #ifdef SW_HAVE_ZLIB
 #include <zlib.h>
+#ifdef SW_HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
 #endif
 
 #ifdef SW_USE_HTTP2
 #include "http2.h"
 #endif
 
-#ifdef SW_USE_PICOHTTPPARSER
-#include "thirdparty/picohttpparser/picohttpparser.h"
-#endif
-
 static swArray *http_client_array;
 
 swString *swoole_http_buffer;
@@ -103,6 +102,7 @@ static int multipart_body_on_data_end(multipart_parser* p);
 static http_context* http_get_context(zval *object, int check_end TSRMLS_DC);
 
 static void http_parse_cookie(zval *array, const char *at, size_t length);
+static char *http_status_message(int code);
 static void http_build_header(http_context *, zval *object, swString *response, int body_length TSRMLS_DC);
 static int http_trim_double_quote(zval **value, char **ptr);
 
@@ -133,77 +133,14 @@ static inline void http_header_key_format(char *key, int length)
     }
 }
 
-#ifdef SW_USE_PICOHTTPPARSER
-enum flags
-{
-    F_CONNECTION_KEEP_ALIVE = 1 << 1,
-    F_CONNECTION_CLOSE = 1 << 2,
-};
-
-static inline long http_fast_parse(php_http_parser *parser, char *data, size_t length)
-{
-    http_context *ctx = parser->data;
-    const char *method;
-    size_t method_len;
-    int minor_version;
-    struct phr_header headers[64];
-    size_t num_headers = sizeof(headers) / sizeof(headers[0]);
-    const char *path;
-    size_t path_len;
-
-    int n = phr_parse_request(data, length, &method, &method_len, &path, &path_len, &minor_version, headers, &num_headers, 0);
-    if (n < 0)
-    {
-        return SW_ERR;
-    }
-
-    char *p = memchr(path, '?', path_len);
-    if (p)
-    {
-        http_request_on_path(parser, path, p - path);
-        http_request_on_query_string(parser, p + 1, path + path_len - p - 1);
-    }
-    else
-    {
-        http_request_on_path(parser, path, path_len);
-    }
-
-    int i;
-    for (i = 0; i < num_headers; i++)
-    {
-        if (strncasecmp(headers[i].name, "Connection", headers[i].name_len) == 0
-                && strncasecmp(headers[i].value, "keep-alive", headers[i].value_len) == 0)
-        {
-            parser->flags |= F_CONNECTION_KEEP_ALIVE;
-        }
-        else
-        {
-            parser->flags |= F_CONNECTION_CLOSE;
-        }
-        if (http_request_on_header_field(parser, headers[i].name, headers[i].name_len) < 0)
-        {
-            return SW_ERR;
-        }
-        if (http_request_on_header_value(parser, headers[i].value, headers[i].value_len) < 0)
-        {
-            return SW_ERR;
-        }
-    }
-    parser->method = swHttp_get_method(method, method_len) - 1;
-    parser->http_major = 1;
-    parser->http_minor = minor_version;
-    ctx->request.version = 100 + minor_version;
-    if (n < length)
-    {
-        http_request_on_body(parser, data + n, length - n);
-    }
-    http_request_on_headers_complete(parser);
-    return SW_OK;
-}
-#endif
 
 #ifdef SW_HAVE_ZLIB
-static int http_response_compress(swString *body, int level);
+static int http_response_compress(http_context *ctx, char *data, size_t length, int finish);
+static int http_response_compress_body(http_context *ctx, swString *body);
+static int http_response_compress_begin(http_context *ctx);
+static void http_response_compress_end(http_context *ctx);
+static void http_response_negotiate(http_context *ctx, int body_length);
+static int http_parse_accept_encoding(const char *at, size_t length);
 voidpf php_zlib_alloc(voidpf opaque, uInt items, uInt size);
 void php_zlib_free(voidpf opaque, voidpf address);
 #endif
@@ -586,6 +523,12 @@ static int http_request_on_header_value(php_http_parser *parser, const char *at,
         }
         conn->websocket_status = WEBSOCKET_STATUS_CONNECTION;
     }
+#ifdef SW_HAVE_ZLIB
+    else if (header_len == sizeof("accept-encoding") - 1 && memcmp(header_name, "accept-encoding", header_len) == 0)
+    {
+        ctx->accept_encoding = http_parse_accept_encoding(at, length);
+    }
+#endif
     else if (parser->method == PHP_HTTP_POST || parser->method == PHP_HTTP_PUT || parser->method == PHP_HTTP_DELETE || parser->method == PHP_HTTP_PATCH)
     {
         if (strncmp(header_name, "content-type", header_len) == 0)
@@ -594,6 +537,10 @@ static int http_request_on_header_value(php_http_parser *parser, const char *at,
             {
                 ctx->request.post_form_urlencoded = 1;
             }
+            else if (ctx->request.upload_trusted && http_strncasecmp(SW_HTTP_UPLOAD_CONTENT_TYPE, at, length))
+            {
+                ctx->request.upload_spooled = 1;
+            }
             else if (http_strncasecmp("multipart/form-data", at, length))
             {
                 int boundary_len = length - (sizeof("multipart/form-data; boundary=") - 1);
@@ -883,6 +830,105 @@ static int multipart_body_on_data_end(multipart_parser* p)
     return 0;
 }
 
+/**
+ * swHttpMultipart creates the temporary files as upload_tmp_dir/swoole.upfile.XXXXXX
+ */
+static int http_upload_tmpfile_check(const char *file, size_t length)
+{
+    char *dir = SwooleG.serv->upload_tmp_dir;
+    size_t dir_len = strlen(dir);
+    size_t prefix_len = sizeof("/swoole.upfile.") - 1;
+
+    if (length != dir_len + prefix_len + 6 || memcmp(file, dir, dir_len) != 0
+            || memcmp(file + dir_len, "/swoole.upfile.", prefix_len) != 0)
+    {
+        return SW_ERR;
+    }
+    return memchr(file + dir_len + prefix_len, '/', 6) ? SW_ERR : SW_OK;
+}
+
+/**
+ * form fields and uploaded files of a body spooled by the reactor, see swHttpRequest_pack_upload
+ */
+static void http_parse_upload_items(http_context *ctx, const char *at, size_t length TSRMLS_DC)
+{
+    zval *zrequest_object = ctx->request.zobject;
+    const char *p = at, *pe = at + length;
+    swHttpUpload_item item;
+    char *name, *filename, *content_type, *value;
+
+    while (p + sizeof(item) <= pe)
+    {
+        memcpy(&item, p, sizeof(item));
+        p += sizeof(item);
+        if (p + item.name_len + item.filename_len + item.content_type_len + item.value_len > pe)
+        {
+            swWarn("invalid upload item.");
+            return;
+        }
+        name = estrndup(p, item.name_len);
+        p += item.name_len;
+        filename = (char *) p;
+        p += item.filename_len;
+        content_type = (char *) p;
+        p += item.content_type_len;
+        value = (char *) p;
+        p += item.value_len;
+
+        if (item.type == SW_HTTP_UPLOAD_FIELD)
+        {
+            zval *zpost = sw_zend_read_property(swoole_http_request_class_entry_ptr, zrequest_object, ZEND_STRL("post"), 1 TSRMLS_CC);
+            if (ZVAL_IS_NULL(zpost))
+            {
+                swoole_http_server_array_init(post, request);
+            }
+            php_register_variable_safe(name, value, item.value_len, zpost TSRMLS_CC);
+            efree(name);
+            continue;
+        }
+        if (item.value_len > 0 && http_upload_tmpfile_check(value, item.value_len) < 0)
+        {
+            swWarn("invalid upload file[%.*s].", (int) item.value_len, value);
+            efree(name);
+            continue;
+        }
+
+        zval *multipart_header = NULL;
+        SW_ALLOC_INIT_ZVAL(multipart_header);
+        array_init(multipart_header);
+        sw_add_assoc_stringl(multipart_header, "name", filename, item.filename_len, 1);
+        sw_add_assoc_stringl(multipart_header, "type", content_type, item.content_type_len, 1);
+        sw_add_assoc_stringl(multipart_header, "tmp_name", value, item.value_len, 1);
+        add_assoc_long(multipart_header, "error", item.error);
+        add_assoc_long(multipart_header, "size", item.size);
+
+        if (item.value_len > 0)
+        {
+            zval *ztmpfiles = sw_zend_read_property(swoole_http_request_class_entry_ptr, zrequest_object, ZEND_STRL("tmpfiles"), 1 TSRMLS_CC);
+            if (ZVAL_IS_NULL(ztmpfiles))
+            {
+                swoole_http_server_array_init(tmpfiles, request);
+            }
+            sw_add_next_index_stringl(ztmpfiles, value, item.value_len, 1);
+            char *temp_filename = estrndup(value, item.value_len);
+            sw_zend_hash_add(SG(rfc1867_uploaded_files), temp_filename, item.value_len + 1, &temp_filename, sizeof(char *), NULL);
+        }
+
+        zval *zfiles = ctx->request.zfiles;
+        if (!zfiles)
+        {
+            swoole_http_server_array_init(files, request);
+        }
+        php_register_variable_ex(name, multipart_header, zfiles TSRMLS_CC);
+        efree(name);
+#if PHP_MAJOR_VERSION >= 7
+        efree(multipart_header);
+#else
+        sw_zval_ptr_dtor(&multipart_header);
+#endif
+    }
+}
+
 static int http_request_on_body(php_http_parser *parser, const char *at, size_t length)
 {
 #if PHP_MAJOR_VERSION < 7
@@ -902,6 +948,10 @@ static int http_request_on_body(php_http_parser *parser, const char *at, size_t
 
         sapi_module.treat_data(PARSE_STRING, body, zpost TSRMLS_CC);
     }
+    else if (ctx->request.upload_spooled)
+    {
+        http_parse_upload_items(ctx, at, length TSRMLS_CC);
+    }
     else if (ctx->mt_parser != NULL)
     {
         multipart_parser *multipart_parser = ctx->mt_parser;
@@ -915,6 +965,67 @@ static int http_request_on_body(php_http_parser *parser, const char *at, size_t
     return 0;
 }
 
+/**
+ * the request line and the headers are sliced by swHttp_parse_request, only a chunked body
+ * or a head with more than SW_HTTP_HEADER_NUM headers goes through the byte-wise parser
+ */
+static long http_request_parse(http_context *ctx, char *data, size_t length)
+{
+    php_http_parser *parser = &ctx->parser;
+    swHttp_header headers[SW_HTTP_HEADER_NUM];
+    swHttp_parser hp;
+    size_t body_length;
+    long n;
+    int i;
+
+    swHttp_parser_init(&hp, headers, SW_HTTP_HEADER_NUM);
+    int ret = swHttp_parse_request(&hp, data, length);
+    if (ret == SW_HTTP_PARSE_ERROR)
+    {
+        return SW_ERR;
+    }
+    if (ret == SW_HTTP_PARSE_PARTIAL || (hp.flags & SW_HTTP_CHUNKED) || hp.header_num > hp.header_max)
+    {
+        php_http_parser_init(parser, PHP_HTTP_REQUEST);
+        n = php_http_parser_execute(parser, &http_parser_settings, data, length);
+        ctx->keepalive = php_http_should_keep_alive(parser);
+        return n;
+    }
+
+    parser->method = hp.method - 1;
+    parser->http_major = 1;
+    parser->http_minor = hp.version == HTTP_VERSION_11 ? 1 : 0;
+    ctx->keepalive = swHttp_parser_keepalive(&hp);
+
+    http_request_on_path(parser, data + hp.path_offset, hp.path_len);
+    if (hp.query_offset)
+    {
+        http_request_on_query_string(parser, data + hp.query_offset, hp.query_len);
+    }
+    for (i = 0; i < hp.header_num; i++)
+    {
+        http_request_on_header_field(parser, data + headers[i].name_offset, headers[i].name_len);
+        if (http_request_on_header_value(parser, data + headers[i].value_offset, headers[i].value_len) < 0)
+        {
+            return SW_ERR;
+        }
+    }
+    http_request_on_headers_complete(parser);
+
+    //a request without Content-Length has no body
+    body_length = (hp.flags & SW_HTTP_CONTENT_LENGTH) ? hp.content_length : 0;
+    if (body_length > length - hp.offset)
+    {
+        body_length = length - hp.offset;
+    }
+    if (body_length > 0)
+    {
+        http_request_on_body(parser, data + hp.offset, body_length);
+    }
+    http_request_message_complete(parser);
+    return hp.offset + body_length;
+}
+
 static int http_request_message_complete(php_http_parser *parser)
 {
     http_context *ctx = parser->data;
@@ -934,15 +1045,386 @@ static int http_request_message_complete(php_http_parser *parser)
             break;
         }
     }
-    ctx->request_read = 1;
+    ctx->request_read = 1;
+
+    if (ctx->mt_parser)
+    {
+        multipart_parser_free(ctx->mt_parser);
+        ctx->mt_parser = NULL;
+    }
+
+    return 0;
+}
+
+/**
+ * files under document_root, each worker keeps the open fd, the stat result and the validators.
+ * an entry is checked again with stat after SW_HTTP_STATIC_CACHE_TTL seconds, so a replaced or
+ * modified file is picked up. fd = -1 remembers a path that is not a regular file.
+ */
+typedef struct
+{
+    int fd;
+    time_t expire;
+    ino_t ino;
+    off_t size;
+    time_t mtime;
+    const char *mime;
+    /**
+     * whole content of a small file
+     */
+    swString *content;
+    char etag[48];
+    char last_modified[32];
+} http_static_file;
+
+static swFlatMap *http_static_cache;
+
+static const struct
+{
+    char *ext;
+    char *mime;
+} http_mime_types[] =
+{
+    { "html", "text/html" },
+    { "htm", "text/html" },
+    { "css", "text/css" },
+    { "js", "application/javascript" },
+    { "json", "application/json" },
+    { "txt", "text/plain" },
+    { "xml", "application/xml" },
+    { "svg", "image/svg+xml" },
+    { "png", "image/png" },
+    { "jpg", "image/jpeg" },
+    { "jpeg", "image/jpeg" },
+    { "gif", "image/gif" },
+    { "ico", "image/x-icon" },
+    { "webp", "image/webp" },
+    { "woff", "font/woff" },
+    { "woff2", "font/woff2" },
+    { "ttf", "font/ttf" },
+    { "pdf", "application/pdf" },
+    { "wasm", "application/wasm" },
+    { "mp4", "video/mp4" },
+    { "map", "application/json" },
+};
+
+static const char* http_get_mime_type(const char *ext, uint32_t ext_len)
+{
+    int i;
+    for (i = 0; i < sizeof(http_mime_types) / sizeof(http_mime_types[0]); i++)
+    {
+        if (strlen(http_mime_types[i].ext) == ext_len && strncasecmp(http_mime_types[i].ext, ext, ext_len) == 0)
+        {
+            return http_mime_types[i].mime;
+        }
+    }
+    return "application/octet-stream";
+}
+
+static void http_static_file_free(void *data)
+{
+    http_static_file *file = data;
+    if (file->fd >= 0)
+    {
+        close(file->fd);
+    }
+    if (file->content)
+    {
+        swString_free(file->content);
+    }
+    sw_free(file);
+}
+
+static http_static_file* http_static_file_get(char *path, uint16_t path_len, const char *ext, uint32_t ext_len)
+{
+    http_static_file *file;
+    struct stat file_stat;
+    struct tm tm;
+    int fd;
+
+    if (http_static_cache == NULL)
+    {
+        http_static_cache = swFlatMap_new(SW_HTTP_STATIC_CACHE_NUM, http_static_file_free);
+        if (http_static_cache == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    file = swFlatMap_find(http_static_cache, path, path_len);
+    if (file)
+    {
+        if (file->expire > SwooleGS->now)
+        {
+            return file;
+        }
+        if (stat(path, &file_stat) == 0 ? (file->fd >= 0 && S_ISREG(file_stat.st_mode) && file_stat.st_ino == file->ino
+                && file_stat.st_mtime == file->mtime && file_stat.st_size == file->size) : file->fd < 0)
+        {
+            file->expire = SwooleGS->now + SW_HTTP_STATIC_CACHE_TTL;
+            return file;
+        }
+        swFlatMap_del(http_static_cache, path, path_len);
+    }
+
+    //drop everything instead of tracking the least recently used entry
+    if (http_static_cache->num >= SW_HTTP_STATIC_CACHE_NUM)
+    {
+        swFlatMap_free(http_static_cache);
+        http_static_cache = swFlatMap_new(SW_HTTP_STATIC_CACHE_NUM, http_static_file_free);
+        if (http_static_cache == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    file = sw_malloc(sizeof(http_static_file));
+    if (file == NULL)
+    {
+        return NULL;
+    }
+    bzero(file, sizeof(http_static_file));
+    file->expire = SwooleGS->now + SW_HTTP_STATIC_CACHE_TTL;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &file_stat) < 0 || !S_ISREG(file_stat.st_mode))
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        file->fd = -1;
+        swFlatMap_add(http_static_cache, path, path_len, file);
+        return file;
+    }
+    file->fd = fd;
+    file->ino = file_stat.st_ino;
+    file->size = file_stat.st_size;
+    file->mtime = file_stat.st_mtime;
+    file->mime = http_get_mime_type(ext, ext_len);
+    snprintf(file->etag, sizeof(file->etag), "\"%lx-%lx\"", (long) file->mtime, (long) file->size);
+    gmtime_r(&file->mtime, &tm);
+    strftime(file->last_modified, sizeof(file->last_modified), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+
+    if (file->size > 0 && file->size <= SW_HTTP_STATIC_CACHE_FILE_SIZE)
+    {
+        file->content = swString_new(file->size);
+        if (file->content && pread(fd, file->content->str, file->size, 0) == file->size)
+        {
+            file->content->length = file->size;
+        }
+        else if (file->content)
+        {
+            swString_free(file->content);
+            file->content = NULL;
+        }
+    }
+    swFlatMap_add(http_static_cache, path, path_len, file);
+    return file;
+}
+
+/**
+ * parse a single "bytes=first-last", "bytes=first-" or "bytes=-suffix" range.
+ * @return 1 for a valid range, 0 to ignore the header, -1 when it cannot be satisfied
+ */
+static int http_parse_range(char *range, size_t length, off_t size, off_t *first, off_t *last)
+{
+    char *p = range, *pe = range + length;
+    off_t a = -1, b = -1;
+
+    if (length < 7 || strncasecmp(range, "bytes=", 6) != 0 || memchr(range, ',', length))
+    {
+        return 0;
+    }
+    p += 6;
+    if (p < pe && *p >= '0' && *p <= '9')
+    {
+        for (a = 0; p < pe && *p >= '0' && *p <= '9'; p++)
+        {
+            a = a * 10 + (*p - '0');
+        }
+    }
+    if (p == pe || *p != '-')
+    {
+        return 0;
+    }
+    p++;
+    if (p < pe && *p >= '0' && *p <= '9')
+    {
+        for (b = 0; p < pe && *p >= '0' && *p <= '9'; p++)
+        {
+            b = b * 10 + (*p - '0');
+        }
+    }
+    if (p != pe || (a < 0 && b < 0) || (a >= 0 && b >= 0 && a > b))
+    {
+        return 0;
+    }
+    if (a < 0)
+    {
+        //the last b bytes
+        if (b == 0)
+        {
+            return -1;
+        }
+        a = b > size ? 0 : size - b;
+        b = size - 1;
+    }
+    else if (b < 0 || b >= size)
+    {
+        b = size - 1;
+    }
+    if (a > b || a >= size)
+    {
+        return -1;
+    }
+    *first = a;
+    *last = b;
+    return 1;
+}
+
+#define http_header_match(zvalue, str)   (Z_TYPE_P(zvalue) == IS_STRING && Z_STRLEN_P(zvalue) == strlen(str) \
+        && memcmp(Z_STRVAL_P(zvalue), str, Z_STRLEN_P(zvalue)) == 0)
+
+/**
+ * GET/HEAD of a file under document_root with conditional and Range requests.
+ * @return SW_ERR to pass the request to onRequest
+ */
+static int http_static_handler(swServer *serv, http_context *ctx TSRMLS_DC)
+{
+    char path[PATH_MAX];
+    int path_len;
+    http_static_file *file;
+    zval *zheader = ctx->request.zheader;
+    zval *zvalue;
+    int status = 200;
+    off_t first = 0, last;
+    char buf[SW_HTTP_HEADER_MAX_SIZE];
+    char *date_str;
+    int n, ret;
+
+    if (ctx->parser.method != PHP_HTTP_GET && ctx->parser.method != PHP_HTTP_HEAD)
+    {
+        return SW_ERR;
+    }
+    if (ctx->request.path_len == 0 || ctx->request.path[0] != '/' || ctx->request.path[ctx->request.path_len - 1] == '/'
+            || serv->document_root_len + ctx->request.path_len >= sizeof(path))
+    {
+        return SW_ERR;
+    }
+    memcpy(path, serv->document_root, serv->document_root_len);
+    memcpy(path + serv->document_root_len, ctx->request.path, ctx->request.path_len);
+    path_len = serv->document_root_len + php_url_decode(path + serv->document_root_len, ctx->request.path_len);
+    path[path_len] = 0;
+    //no way out of document_root
+    if (strlen(path) != path_len || strstr(path + serv->document_root_len, "/..") != NULL)
+    {
+        return SW_ERR;
+    }
+
+    file = http_static_file_get(path, path_len, ctx->request.ext, ctx->request.ext_len);
+    if (file == NULL || file->fd < 0)
+    {
+        return SW_ERR;
+    }
+    last = file->size - 1;
+
+    if (php_swoole_array_get_value(Z_ARRVAL_P(zheader), "if-none-match", zvalue))
+    {
+        if (http_header_match(zvalue, file->etag) || http_header_match(zvalue, "*"))
+        {
+            status = 304;
+        }
+    }
+    else if (php_swoole_array_get_value(Z_ARRVAL_P(zheader), "if-modified-since", zvalue) && http_header_match(zvalue, file->last_modified))
+    {
+        status = 304;
+    }
+    if (status == 200 && file->size > 0 && php_swoole_array_get_value(Z_ARRVAL_P(zheader), "range", zvalue) && Z_TYPE_P(zvalue) == IS_STRING)
+    {
+        zval *zif_range;
+        //a stale If-Range gets the whole file
+        if (!php_swoole_array_get_value(Z_ARRVAL_P(zheader), "if-range", zif_range)
+                || http_header_match(zif_range, file->etag) || http_header_match(zif_range, file->last_modified))
+        {
+            ret = http_parse_range(Z_STRVAL_P(zvalue), Z_STRLEN_P(zvalue), file->size, &first, &last);
+            if (ret > 0)
+            {
+                status = 206;
+            }
+            else if (ret < 0)
+            {
+                status = 416;
+            }
+        }
+    }
+
+    swString_clear(swoole_http_buffer);
+    n = snprintf(buf, sizeof(buf), "HTTP/1.1 %s\r\nServer: "SW_HTTP_SERVER_SOFTWARE"\r\nConnection: %s\r\n",
+            http_status_message(status), ctx->keepalive ? "keep-alive" : "close");
+    swString_append_ptr(swoole_http_buffer, buf, n);
+    date_str = sw_php_format_date(ZEND_STRL(SW_HTTP_DATE_FORMAT), SwooleGS->now, 0 TSRMLS_CC);
+    n = snprintf(buf, sizeof(buf), "Date: %s\r\nLast-Modified: %s\r\nETag: %s\r\nAccept-Ranges: bytes\r\n", date_str, file->last_modified, file->etag);
+    efree(date_str);
+    swString_append_ptr(swoole_http_buffer, buf, n);
+    if (status == 416)
+    {
+        n = snprintf(buf, sizeof(buf), "Content-Range: bytes */%ld\r\nContent-Length: 0\r\n\r\n", (long) file->size);
+    }
+    else if (status == 304)
+    {
+        n = snprintf(buf, sizeof(buf), "\r\n");
+    }
+    else if (status == 206)
+    {
+        n = snprintf(buf, sizeof(buf), "Content-Type: %s\r\nContent-Range: bytes %ld-%ld/%ld\r\nContent-Length: %ld\r\n\r\n", file->mime,
+                (long) first, (long) last, (long) file->size, (long) (last - first + 1));
+    }
+    else
+    {
+        n = snprintf(buf, sizeof(buf), "Content-Type: %s\r\nContent-Length: %ld\r\n\r\n", file->mime, (long) file->size);
+    }
+    swString_append_ptr(swoole_http_buffer, buf, n);
+
+    if (status == 304 || status == 416 || ctx->parser.method == PHP_HTTP_HEAD || file->size == 0)
+    {
+        ret = swServer_tcp_send(serv, ctx->fd, swoole_http_buffer->str, swoole_http_buffer->length);
+    }
+    else if (file->content)
+    {
+        swString_append_ptr(swoole_http_buffer, file->content->str + first, last - first + 1);
+        ret = swServer_tcp_send(serv, ctx->fd, swoole_http_buffer->str, swoole_http_buffer->length);
+    }
+    //the reactor sends the rest of the file
+    else if (last == file->size - 1)
+    {
+        ret = swServer_tcp_send(serv, ctx->fd, swoole_http_buffer->str, swoole_http_buffer->length);
+        if (ret == SW_OK)
+        {
+            ret = swServer_tcp_sendfile(serv, ctx->fd, path, path_len, first);
+        }
+    }
+    else
+    {
+        size_t offset = swoole_http_buffer->length, length = last - first + 1;
+        if (swoole_http_buffer->size < offset + length && swString_extend(swoole_http_buffer, offset + length) < 0)
+        {
+            return SW_ERR;
+        }
+        if (pread(file->fd, swoole_http_buffer->str + offset, length, first) != length)
+        {
+            swSysError("pread(%s) failed.", path);
+            return SW_ERR;
+        }
+        swoole_http_buffer->length += length;
+        ret = swServer_tcp_send(serv, ctx->fd, swoole_http_buffer->str, swoole_http_buffer->length);
+    }
 
-    if (ctx->mt_parser)
+    if (ret < 0 || !ctx->keepalive)
     {
-        multipart_parser_free(ctx->mt_parser);
-        ctx->mt_parser = NULL;
+        serv->factory.end(&serv->factory, ctx->fd);
     }
-
-    return 0;
+    return SW_OK;
 }
 
 static int http_onReceive(swServer *serv, swEventData *req)
@@ -995,6 +1477,7 @@ static int http_onReceive(swServer *serv, swEventData *req)
     zval *zserver = ctx->request.zserver;
 
     parser->data = ctx;
+    ctx->request.upload_trusted = (req->info.flags & SW_EVENT_DATA_UPLOAD) != 0;
 
     zval *zdata;
     SW_MAKE_STD_ZVAL(zdata);
@@ -1002,18 +1485,13 @@ static int http_onReceive(swServer *serv, swEventData *req)
 
     swTrace("httpRequest %d bytes:\n---------------------------------------\n%s\n", (int)Z_STRLEN_P(zdata), Z_STRVAL_P(zdata));
 
-#ifdef SW_USE_PICOHTTPPARSER
-    long n = http_fast_parse(parser, Z_STRVAL_P(zdata), Z_STRLEN_P(zdata));
-#else
-    php_http_parser_init(parser, PHP_HTTP_REQUEST);
-    long n = php_http_parser_execute(parser, &http_parser_settings, Z_STRVAL_P(zdata), Z_STRLEN_P(zdata));
-#endif
+    long n = http_request_parse(ctx, Z_STRVAL_P(zdata), Z_STRLEN_P(zdata));
 
     if (n < 0)
     {
         sw_zval_ptr_dtor(&zdata);
         bzero(client, sizeof(swoole_http_client));
-        swWarn("php_http_parser_execute failed.");
+        swWarn("parse http request failed.");
         if (conn->websocket_status == WEBSOCKET_STATUS_CONNECTION)
         {
             return SwooleG.serv->factory.end(&SwooleG.serv->factory, fd);
@@ -1027,7 +1505,17 @@ static int http_onReceive(swServer *serv, swEventData *req)
         zval *zrequest_object = ctx->request.zobject;
         zval *zresponse_object = ctx->response.zobject;
 
-        ctx->keepalive = php_http_should_keep_alive(parser);
+        if (serv->enable_static_handler && serv->document_root && conn->websocket_status == 0
+                && http_static_handler(serv, ctx TSRMLS_CC) == SW_OK)
+        {
+            ctx->end = 1;
+            swoole_http_context_free(ctx TSRMLS_CC);
+            sw_zval_ptr_dtor(&zrequest_object);
+            sw_zval_ptr_dtor(&zresponse_object);
+            sw_zval_ptr_dtor(&zdata);
+            bzero(client, sizeof(swoole_http_client));
+            return SW_OK;
+        }
         char *method_name = http_get_method_name(parser->method);
 
         sw_add_assoc_string(zserver, "request_method", method_name, 1);
@@ -1272,6 +1760,9 @@ http_context* swoole_http_context_new(swoole_http_client* client TSRMLS_DC)
 void swoole_http_context_free(http_context *ctx TSRMLS_DC)
 {
     swoole_set_object(ctx->response.zobject, NULL);
+#ifdef SW_HAVE_ZLIB
+    http_response_compress_end(ctx);
+#endif
     http_request *req = &ctx->request;
     if (req->path)
     {
@@ -1509,6 +2000,7 @@ static PHP_METHOD(swoole_http_server, start)
     php_swoole_server_before_start(serv, getThis() TSRMLS_CC);
 
     ret = swServer_start(serv);
+    php_swoole_server_after_stop(serv);
     if (ret < 0)
     {
         swoole_php_fatal_error(E_ERROR, "start server failed. Error: %s", sw_error);
@@ -1590,6 +2082,13 @@ static PHP_METHOD(swoole_http_response, write)
     if (!ctx->send_header)
     {
         ctx->chunk = 1;
+#ifdef SW_HAVE_ZLIB
+        http_response_negotiate(ctx, -1);
+        if (ctx->gzip_enable && http_response_compress_begin(ctx) < 0)
+        {
+            ctx->gzip_enable = 0;
+        }
+#endif
         swString_clear(swoole_http_buffer);
         http_build_header(ctx, getThis(), swoole_http_buffer, -1 TSRMLS_CC);
         if (swServer_tcp_send(SwooleG.serv, ctx->fd, swoole_http_buffer->str, swoole_http_buffer->length) < 0)
@@ -1625,8 +2124,15 @@ static PHP_METHOD(swoole_http_response, write)
 #ifdef SW_HAVE_ZLIB
     if (ctx->gzip_enable)
     {
-        http_response_compress(&http_body, ctx->gzip_level);
-
+        if (http_response_compress(ctx, http_body.str, http_body.length, 0) < 0)
+        {
+            RETURN_FALSE;
+        }
+        //a zero-length chunk would end the response
+        if (swoole_zlib_buffer->length == 0)
+        {
+            RETURN_TRUE;
+        }
         hex_string = swoole_dec2hex(swoole_zlib_buffer->length, 16);
         hex_len = strlen(hex_string);
 
@@ -1782,12 +2288,6 @@ static void http_build_header(http_context *ctx, zval *object, swString *respons
      */
     else
     {
-#ifdef SW_HAVE_ZLIB
-        if (ctx->gzip_enable)
-        {
-            body_length = swoole_zlib_buffer->length;
-        }
-#endif
         n = snprintf(buf, sizeof(buf), "Content-Length: %d\r\n", body_length);
         swString_append_ptr(response, buf, n);
     }
@@ -1810,11 +2310,19 @@ static void http_build_header(http_context *ctx, zval *object, swString *respons
     //http compress
     if (ctx->gzip_enable)
     {
-#ifdef SW_HTTP_COMPRESS_GZIP
-        swString_append_ptr(response, SW_STRL("Content-Encoding: gzip\r\n") - 1);
-#else
-        swString_append_ptr(response, SW_STRL("Content-Encoding: deflate\r\n") - 1);
-#endif
+        switch (ctx->compression_method)
+        {
+        case HTTP_COMPRESS_BR:
+            swString_append_ptr(response, SW_STRL("Content-Encoding: br\r\n") - 1);
+            break;
+        case HTTP_COMPRESS_DEFLATE:
+            swString_append_ptr(response, SW_STRL("Content-Encoding: deflate\r\n") - 1);
+            break;
+        default:
+            swString_append_ptr(response, SW_STRL("Content-Encoding: gzip\r\n") - 1);
+            break;
+        }
+        swString_append_ptr(response, SW_STRL("Vary: Accept-Encoding\r\n") - 1);
     }
     swString_append_ptr(response, ZEND_STRL("\r\n"));
     ctx->send_header = 1;
@@ -1831,52 +2339,352 @@ void php_zlib_free(voidpf opaque, voidpf address)
     efree((void*)address);
 }
 
-static int http_response_compress(swString *body, int level)
+/**
+ * deflate streams of this worker, reset and reused by the next response. gzip and raw deflate
+ * differ in windowBits which deflateReset keeps, so each has its own list.
+ */
+typedef struct
 {
-    assert(level > 0 || level < 10);
+    z_stream zstream;
+    int level;
+} http_zstream;
 
-    size_t memory_size = ((size_t) ((double) body->length * (double) 1.015)) + 10 + 8 + 4 + 1;
+static http_zstream *http_zstream_pool[2][SW_HTTP_COMPRESSION_STREAM_NUM];
+static int http_zstream_pool_num[2];
+
+static sw_inline int http_zstream_index(int method)
+{
+    return method == HTTP_COMPRESS_GZIP ? 0 : 1;
+}
 
-    if (memory_size > swoole_zlib_buffer->size)
+static int http_response_compress_begin(http_context *ctx)
+{
+#ifdef SW_HAVE_BROTLI
+    if (ctx->compression_method == HTTP_COMPRESS_BR)
     {
-        swString_extend(swoole_zlib_buffer, memory_size);
+        BrotliEncoderState *state = BrotliEncoderCreateInstance(NULL, NULL, NULL);
+        if (state == NULL)
+        {
+            swWarn("BrotliEncoderCreateInstance() failed.");
+            return SW_ERR;
+        }
+        BrotliEncoderSetParameter(state, BROTLI_PARAM_QUALITY, ctx->gzip_level);
+        BrotliEncoderSetParameter(state, BROTLI_PARAM_LGWIN, SW_HTTP_BROTLI_WINDOW_BITS);
+        ctx->zstream = state;
+        return SW_OK;
     }
+#endif
 
-    z_stream zstream;
-    memset(&zstream, 0, sizeof(zstream));
+    int index = http_zstream_index(ctx->compression_method);
+    int level = ctx->gzip_level > 9 ? 9 : ctx->gzip_level;
+    http_zstream *zs;
 
-    //deflate: -0xf, gzip: 0x1f
-#ifdef SW_HTTP_COMPRESS_GZIP
-    int encoding = 0x1f;
-#else
-    int encoding =  -0xf;
+    if (http_zstream_pool_num[index] > 0)
+    {
+        zs = http_zstream_pool[index][--http_zstream_pool_num[index]];
+        if (zs->level != level)
+        {
+            //nothing has been compressed since the reset, so this never flushes
+            deflateParams(&zs->zstream, level, Z_DEFAULT_STRATEGY);
+            zs->level = level;
+        }
+    }
+    else
+    {
+        //deflate: -0xf, gzip: 0x1f
+        int encoding = ctx->compression_method == HTTP_COMPRESS_GZIP ? 0x1f : -0xf;
+
+        zs = sw_malloc(sizeof(http_zstream));
+        if (zs == NULL)
+        {
+            return SW_ERR;
+        }
+        bzero(zs, sizeof(http_zstream));
+        if (deflateInit2(&zs->zstream, level, Z_DEFLATED, encoding, MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            swWarn("deflateInit2() failed.");
+            sw_free(zs);
+            return SW_ERR;
+        }
+        zs->level = level;
+    }
+    ctx->zstream = zs;
+    return SW_OK;
+}
+
+static void http_response_compress_end(http_context *ctx)
+{
+    if (ctx->zstream == NULL)
+    {
+        return;
+    }
+#ifdef SW_HAVE_BROTLI
+    if (ctx->compression_method == HTTP_COMPRESS_BR)
+    {
+        BrotliEncoderDestroyInstance(ctx->zstream);
+        ctx->zstream = NULL;
+        return;
+    }
 #endif
 
-    int status;
-    zstream.zalloc = php_zlib_alloc;
-    zstream.zfree = php_zlib_free;
+    int index = http_zstream_index(ctx->compression_method);
+    http_zstream *zs = ctx->zstream;
+
+    if (http_zstream_pool_num[index] < SW_HTTP_COMPRESSION_STREAM_NUM && deflateReset(&zs->zstream) == Z_OK)
+    {
+        http_zstream_pool[index][http_zstream_pool_num[index]++] = zs;
+    }
+    else
+    {
+        deflateEnd(&zs->zstream);
+        sw_free(zs);
+    }
+    ctx->zstream = NULL;
+}
+
+/**
+ * compress into swoole_zlib_buffer with the stream of the context, finish ends the stream,
+ * otherwise the output is flushed so that the client can decode every chunk at once.
+ */
+static int http_response_compress(http_context *ctx, char *data, size_t length, int finish)
+{
+    swString *buffer = swoole_zlib_buffer;
 
-    if (Z_OK == deflateInit2(&zstream, level, Z_DEFLATED, encoding, MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY))
+    swString_clear(buffer);
+
+#ifdef SW_HAVE_BROTLI
+    if (ctx->compression_method == HTTP_COMPRESS_BR)
     {
-        zstream.next_in = (Bytef *) body->str;
-        zstream.next_out = (Bytef *) swoole_zlib_buffer->str;
-        zstream.avail_in = body->length;
-        zstream.avail_out = swoole_zlib_buffer->size;
+        BrotliEncoderState *state = ctx->zstream;
+        BrotliEncoderOperation op = finish ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_FLUSH;
+        const uint8_t *next_in = (uint8_t *) data;
+        size_t avail_in = length;
+        size_t avail_out;
+        uint8_t *next_out;
+
+        if (buffer->size < BrotliEncoderMaxCompressedSize(length) && swString_extend(buffer, BrotliEncoderMaxCompressedSize(length)) < 0)
+        {
+            return SW_ERR;
+        }
+        while (1)
+        {
+            if (buffer->size - buffer->length < SW_BUFFER_SIZE_STD && swString_extend(buffer, buffer->size * 2) < 0)
+            {
+                return SW_ERR;
+            }
+            next_out = (uint8_t *) buffer->str + buffer->length;
+            avail_out = buffer->size - buffer->length;
+            if (!BrotliEncoderCompressStream(state, op, &avail_in, &next_in, &avail_out, &next_out, NULL))
+            {
+                swWarn("BrotliEncoderCompressStream() failed.");
+                return SW_ERR;
+            }
+            buffer->length = (char *) next_out - buffer->str;
+            if (avail_in == 0 && !BrotliEncoderHasMoreOutput(state) && (!finish || BrotliEncoderIsFinished(state)))
+            {
+                return SW_OK;
+            }
+        }
+    }
+#endif
 
-        status = deflate(&zstream, Z_FINISH);
-        deflateEnd(&zstream);
+    z_stream *zstream = &((http_zstream *) ctx->zstream)->zstream;
+    int flush = finish ? Z_FINISH : Z_SYNC_FLUSH;
+    int status;
+    size_t bound = deflateBound(zstream, length) + 16;
 
-        if (Z_STREAM_END == status)
+    if (buffer->size < bound && swString_extend(buffer, bound) < 0)
+    {
+        return SW_ERR;
+    }
+    zstream->next_in = (Bytef *) data;
+    zstream->avail_in = length;
+    while (1)
+    {
+        if (buffer->size - buffer->length < 64 && swString_extend(buffer, buffer->size * 2) < 0)
+        {
+            return SW_ERR;
+        }
+        zstream->next_out = (Bytef *) buffer->str + buffer->length;
+        zstream->avail_out = buffer->size - buffer->length;
+        status = deflate(zstream, flush);
+        buffer->length = (char *) zstream->next_out - buffer->str;
+        if (status == Z_STREAM_ERROR)
+        {
+            swWarn("deflate() failed.");
+            return SW_ERR;
+        }
+        if (finish ? status == Z_STREAM_END : zstream->avail_out > 0)
         {
-            swoole_zlib_buffer->length = zstream.total_out;
             return SW_OK;
         }
     }
+}
+
+/**
+ * one-shot compression of a whole body
+ */
+static int http_response_compress_body(http_context *ctx, swString *body)
+{
+    int ret;
+    if (http_response_compress_begin(ctx) < 0)
+    {
+        return SW_ERR;
+    }
+    ret = http_response_compress(ctx, body->str, body->length, 1);
+    http_response_compress_end(ctx);
+    return ret;
+}
+
+static int http_parse_accept_encoding(const char *at, size_t length)
+{
+    const char *p = at, *pe = at + length, *token;
+    size_t token_len;
+    int flags = 0;
+
+    while (p < pe)
+    {
+        while (p < pe && (*p == ' ' || *p == ','))
+        {
+            p++;
+        }
+        token = p;
+        while (p < pe && *p != ',' && *p != ';' && *p != ' ')
+        {
+            p++;
+        }
+        token_len = p - token;
+        while (p < pe && (*p == ' ' || *p == ';'))
+        {
+            p++;
+        }
+        //gzip;q=0 refuses gzip
+        if (p + 2 < pe && (p[0] == 'q' || p[0] == 'Q') && p[1] == '=')
+        {
+            int zero = 1;
+            for (p += 2; p < pe && *p != ',' && *p != ' ' && *p != ';'; p++)
+            {
+                if (*p != '0' && *p != '.')
+                {
+                    zero = 0;
+                }
+            }
+            if (zero)
+            {
+                token_len = 0;
+            }
+        }
+        while (p < pe && *p != ',')
+        {
+            p++;
+        }
+        if (token_len == 4 && strncasecmp(token, "gzip", 4) == 0)
+        {
+            flags |= HTTP_ACCEPT_ENCODING(HTTP_COMPRESS_GZIP);
+        }
+        else if (token_len == 7 && strncasecmp(token, "deflate", 7) == 0)
+        {
+            flags |= HTTP_ACCEPT_ENCODING(HTTP_COMPRESS_DEFLATE);
+        }
+#ifdef SW_HAVE_BROTLI
+        else if (token_len == 2 && strncasecmp(token, "br", 2) == 0)
+        {
+            flags |= HTTP_ACCEPT_ENCODING(HTTP_COMPRESS_BR);
+        }
+#endif
+    }
+    return flags;
+}
+
+static const char *http_compressible_types[] =
+{
+    "text/",
+    "application/json",
+    "application/javascript",
+    "application/x-javascript",
+    "application/xml",
+    "application/xhtml+xml",
+    "image/svg+xml",
+};
+
+/**
+ * compress the response automatically when it is enabled, the client accepts an encoding,
+ * the body is large enough and its content type is textual. body_length < 0 is a chunked response.
+ */
+static void http_response_negotiate(http_context *ctx, int body_length)
+{
+    swServer *serv = SwooleG.serv;
+    char *content_type = "text/html";
+    int i;
+
+    if (ctx->gzip_enable || !serv->http_compression || ctx->accept_encoding == 0)
+    {
+        return;
+    }
+    if (body_length >= 0 && body_length < (serv->http_compression_min_length ? serv->http_compression_min_length : SW_HTTP_COMPRESSION_MIN_LENGTH))
+    {
+        return;
+    }
+    if (ctx->response.status == 204 || ctx->response.status == 304)
+    {
+        return;
+    }
+    if (ctx->response.zheader)
+    {
+        HashTable *ht = Z_ARRVAL_P(ctx->response.zheader);
+        zval *value = NULL;
+        char *key = NULL;
+        uint32_t keylen = 0;
+        int type;
+
+        SW_HASHTABLE_FOREACH_START2(ht, key, keylen, type, value)
+        {
+            if (!key)
+            {
+                break;
+            }
+            //compressed by the application
+            if (strncasecmp(key, "Content-Encoding", keylen) == 0)
+            {
+                return;
+            }
+            else if (strncasecmp(key, "Content-Type", keylen) == 0 && Z_TYPE_P(value) == IS_STRING)
+            {
+                content_type = Z_STRVAL_P(value);
+            }
+        }
+        SW_HASHTABLE_FOREACH_END();
+        (void)type;
+    }
+    for (i = 0; i < sizeof(http_compressible_types) / sizeof(http_compressible_types[0]); i++)
+    {
+        if (strncasecmp(content_type, http_compressible_types[i], strlen(http_compressible_types[i])) == 0)
+        {
+            break;
+        }
+    }
+    if (i == sizeof(http_compressible_types) / sizeof(http_compressible_types[0]))
+    {
+        return;
+    }
+
+#ifdef SW_HAVE_BROTLI
+    if (ctx->accept_encoding & HTTP_ACCEPT_ENCODING(HTTP_COMPRESS_BR))
+    {
+        ctx->compression_method = HTTP_COMPRESS_BR;
+    }
+    else
+#endif
+    if (ctx->accept_encoding & HTTP_ACCEPT_ENCODING(HTTP_COMPRESS_GZIP))
+    {
+        ctx->compression_method = HTTP_COMPRESS_GZIP;
+    }
     else
     {
-        swWarn("deflateInit2() failed.");
+        ctx->compression_method = HTTP_COMPRESS_DEFLATE;
     }
-    return SW_ERR;
+    ctx->gzip_enable = 1;
+    ctx->gzip_level = serv->http_compression_level ? serv->http_compression_level : SW_HTTP_COMPRESSION_LEVEL;
 }
 #endif
 
@@ -1948,7 +2756,29 @@ static PHP_METHOD(swoole_http_response, end)
 
     if (ctx->chunk)
     {
-        ret = swServer_tcp_send(SwooleG.serv, ctx->fd, SW_STRL("0\r\n\r\n") - 1);
+#ifdef SW_HAVE_ZLIB
+        //the trailer of the compressed stream goes into the last chunk
+        if (ctx->gzip_enable && ctx->zstream)
+        {
+            swString_clear(swoole_http_buffer);
+            if (http_response_compress(ctx, NULL, 0, 1) == SW_OK && swoole_zlib_buffer->length > 0)
+            {
+                char *hex_string = swoole_dec2hex(swoole_zlib_buffer->length, 16);
+                swString_append_ptr(swoole_http_buffer, hex_string, strlen(hex_string));
+                swString_append_ptr(swoole_http_buffer, SW_STRL("\r\n") - 1);
+                swString_append(swoole_http_buffer, swoole_zlib_buffer);
+                swString_append_ptr(swoole_http_buffer, SW_STRL("\r\n") - 1);
+                sw_strdup_free(hex_string);
+            }
+            http_response_compress_end(ctx);
+            swString_append_ptr(swoole_http_buffer, SW_STRL("0\r\n\r\n") - 1);
+            ret = swServer_tcp_send(SwooleG.serv, ctx->fd, swoole_http_buffer->str, swoole_http_buffer->length);
+        }
+        else
+#endif
+        {
+            ret = swServer_tcp_send(SwooleG.serv, ctx->fd, SW_STRL("0\r\n\r\n") - 1);
+        }
         if (ret < 0)
         {
             RETURN_FALSE;
@@ -1959,12 +2789,14 @@ static PHP_METHOD(swoole_http_response, end)
     else
     {
         swString_clear(swoole_http_buffer);
+        int body_length = http_body.length;
 #ifdef SW_HAVE_ZLIB
+        http_response_negotiate(ctx, http_body.length);
         if (ctx->gzip_enable)
         {
-            if (http_body.length > 0)
+            if (http_body.length > 0 && http_response_compress_body(ctx, &http_body) == SW_OK)
             {
-                http_response_compress(&http_body, ctx->gzip_level);
+                body_length = swoole_zlib_buffer->length;
             }
             else
             {
@@ -1972,7 +2804,7 @@ static PHP_METHOD(swoole_http_response, end)
             }
         }
 #endif
-        http_build_header(ctx, getThis(), swoole_http_buffer, http_body.length TSRMLS_CC);
+        http_build_header(ctx, getThis(), swoole_http_buffer, body_length TSRMLS_CC);
         if (http_body.length > 0)
         {
 #ifdef SW_HAVE_ZLIB
@@ -2026,14 +2858,6 @@ static PHP_METHOD(swoole_http_response, sendfile)
         RETURN_FALSE;
     }
 
-#ifdef SW_HAVE_ZLIB
-    if (ctx->gzip_enable)
-    {
-        swoole_php_error(E_ERROR, "cannot use sendfile when enable gzip compression.");
-        RETURN_FALSE;
-    }
-#endif
-
     if (ctx->chunk)
     {
         swoole_php_error(E_ERROR, "cannot use sendfile when enable Http-Chunk.");
@@ -2047,6 +2871,53 @@ static PHP_METHOD(swoole_http_response, sendfile)
         RETURN_FALSE;
     }
 
+#ifdef SW_HAVE_ZLIB
+    /**
+     * precompressed file.br or file.gz next to the file, used when it is not older than the file
+     */
+    char static_file[PATH_MAX];
+    if (offset == 0 && (ctx->gzip_enable || SwooleG.serv->http_gzip_static) && filename_length + 4 < sizeof(static_file))
+    {
+        static const struct
+        {
+            int method;
+            char *ext;
+        } sidecars[] = { { HTTP_COMPRESS_BR, ".br" }, { HTTP_COMPRESS_GZIP, ".gz" } };
+        struct stat static_stat;
+        int i;
+
+        for (i = 0; i < sizeof(sidecars) / sizeof(sidecars[0]); i++)
+        {
+            if (!(ctx->accept_encoding & HTTP_ACCEPT_ENCODING(sidecars[i].method)))
+            {
+                continue;
+            }
+            memcpy(static_file, filename, filename_length);
+            memcpy(static_file + filename_length, sidecars[i].ext, 4);
+            if (stat(static_file, &static_stat) == 0 && S_ISREG(static_stat.st_mode) && static_stat.st_size > 0
+                    && static_stat.st_mtime >= file_stat.st_mtime)
+            {
+                filename = static_file;
+                filename_length += 3;
+                file_stat = static_stat;
+                ctx->gzip_enable = 1;
+                ctx->compression_method = sidecars[i].method;
+                break;
+            }
+        }
+        if (i == sizeof(sidecars) / sizeof(sidecars[0]) && ctx->gzip_enable)
+        {
+            swoole_php_error(E_ERROR, "cannot use sendfile when enable gzip compression.");
+            RETURN_FALSE;
+        }
+    }
+    else if (ctx->gzip_enable)
+    {
+        swoole_php_error(E_ERROR, "cannot use sendfile when enable gzip compression.");
+        RETURN_FALSE;
+    }
+#endif
+
     if (file_stat.st_size <= offset)
     {
         swoole_php_error(E_WARNING, "file[offset=%ld] is empty.", offset);
@@ -2412,6 +3283,22 @@ static PHP_METHOD(swoole_http_response, gzip)
 
     context->gzip_enable = 1;
     context->gzip_level = level;
+    if (context->accept_encoding & HTTP_ACCEPT_ENCODING(HTTP_COMPRESS_GZIP))
+    {
+        context->compression_method = HTTP_COMPRESS_GZIP;
+    }
+    else if (context->accept_encoding & HTTP_ACCEPT_ENCODING(HTTP_COMPRESS_DEFLATE))
+    {
+        context->compression_method = HTTP_COMPRESS_DEFLATE;
+    }
+    else
+    {
+#ifdef SW_HTTP_COMPRESS_GZIP
+        context->compression_method = HTTP_COMPRESS_GZIP;
+#else
+        context->compression_method = HTTP_COMPRESS_DEFLATE;
+#endif
+    }
 }
 #endif
 
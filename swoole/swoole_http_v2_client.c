@@ -58,7 +58,7 @@ typedef struct
     zval *object;
 
     swLinkedList *requests;
-    swHashMap *streams;
+    swFlatMap *streams;
 
 } http2_client_property;
 
@@ -163,7 +163,7 @@ static PHP_METHOD(swoole_http2_client, __construct)
     swoole_set_property(getThis(), HTTP2_CLIENT_PROPERTY_INDEX, hcc);
 
     hcc->requests = swLinkedList_new(0, http2_client_request_free);
-    hcc->streams = swHashMap_new(8, http2_client_stream_free);
+    hcc->streams = swFlatMap_new(8, http2_client_stream_free);
 
     zval *ztype;
     SW_MAKE_STD_ZVAL(ztype);
@@ -545,7 +545,7 @@ static int http2_client_onFrame(zval *zobject, zval *zdata TSRMLS_DC)
         return SW_OK;
     }
 
-    http2_client_stream *stream = swHashMap_find_int(hcc->streams, stream_id);
+    http2_client_stream *stream = swFlatMap_find_int(hcc->streams, stream_id);
     if (type == SW_HTTP2_TYPE_HEADERS)
     {
         http2_client_parse_header(hcc, stream, flags, buf, length);
@@ -600,7 +600,7 @@ static int http2_client_onFrame(zval *zobject, zval *zdata TSRMLS_DC)
         {
             sw_zval_ptr_dtor(&retval);
         }
-        swHashMap_del_int(hcc->streams, stream_id);
+        swFlatMap_del_int(hcc->streams, stream_id);
     }
 
     return SW_OK;
@@ -734,7 +734,7 @@ static void http2_client_send_request(zval *zobject, http2_client_request *req T
 
     zend_update_property_long(swoole_http2_response_class_entry_ptr, response_object, ZEND_STRL("streamId"), stream->stream_id TSRMLS_CC);
 
-    swHashMap_add_int(hcc->streams, hcc->stream_id, stream);
+    swFlatMap_add_int(hcc->streams, hcc->stream_id, stream);
     swTraceLog(SW_TRACE_HTTP2, "["SW_ECHO_GREEN", STREAM#%d] length=%d", swHttp2_get_type(SW_HTTP2_TYPE_HEADERS), hcc->stream_id, n);
     cli->send(cli, buffer, n + SW_HTTP2_FRAME_HEADER_SIZE, 0);
 
@@ -1026,7 +1026,7 @@ static PHP_METHOD(swoole_http2_client, __destruct)
         hcc->inflater = NULL;
     }
 
-    swHashMap_free(hcc->streams);
+    swFlatMap_free(hcc->streams);
     efree(hcc);
     swoole_set_property(getThis(), HTTP2_CLIENT_PROPERTY_INDEX, NULL);
 
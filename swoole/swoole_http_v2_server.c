@@ -57,23 +57,148 @@ static sw_inline void http2_onRequest(http_context *ctx, int server_fd TSRMLS_DC
     sw_zval_ptr_dtor(&zresponse_object);
 }
 
-static int http2_build_header(http_context *ctx, uchar *buffer, int body_length TSRMLS_DC)
+static swHttp2_scheduler* http2_get_scheduler(swoole_http_client *client)
+{
+    if (!client->scheduler)
+    {
+        client->scheduler = sw_malloc(sizeof(swHttp2_scheduler));
+        if (!client->scheduler)
+        {
+            swWarn("malloc(%ld) failed.", sizeof(swHttp2_scheduler));
+            return NULL;
+        }
+        swHttp2_scheduler_init(client->scheduler);
+    }
+    return client->scheduler;
+}
+
+static nghttp2_hd_deflater* http2_get_deflater(swoole_http_client *client)
+{
+    if (!client->deflater)
+    {
+        int ret = nghttp2_hd_deflate_new(&client->deflater, SW_HTTP2_HEADER_TABLE_SIZE);
+        if (ret != 0)
+        {
+            swoole_php_error(E_WARNING, "nghttp2_hd_deflate_init failed with error: %s\n", nghttp2_strerror(ret));
+            client->deflater = NULL;
+            return NULL;
+        }
+        //SETTINGS_HEADER_TABLE_SIZE of the peer arrived before the first response
+        if (client->header_table_size > 0)
+        {
+            nghttp2_hd_deflate_change_table_size(client->deflater, client->header_table_size);
+        }
+    }
+    return client->deflater;
+}
+
+static int http2_send_frame(swoole_http_client *client, int type, int flags, uint32_t stream_id, uint32_t value1, uint32_t value2)
+{
+    char frame[SW_HTTP2_FRAME_HEADER_SIZE + SW_HTTP2_GOAWAY_SIZE];
+    int length = 0;
+
+    switch (type)
+    {
+    case SW_HTTP2_TYPE_WINDOW_UPDATE:
+    case SW_HTTP2_TYPE_RST_STREAM:
+        length = 4;
+        *(uint32_t *) (frame + SW_HTTP2_FRAME_HEADER_SIZE) = htonl(value1);
+        break;
+    case SW_HTTP2_TYPE_GOAWAY:
+        length = SW_HTTP2_GOAWAY_SIZE;
+        *(uint32_t *) (frame + SW_HTTP2_FRAME_HEADER_SIZE) = htonl(value1);
+        *(uint32_t *) (frame + SW_HTTP2_FRAME_HEADER_SIZE + 4) = htonl(value2);
+        break;
+    default:
+        break;
+    }
+    swHttp2_set_frame_header(frame, type, length, flags, stream_id);
+    return swServer_tcp_send(SwooleG.serv, client->fd, frame, SW_HTTP2_FRAME_HEADER_SIZE + length);
+}
+
+/**
+ * a connection error, the peer gets GOAWAY and the connection is closed
+ */
+static int http2_connection_error(swoole_http_client *client, int error_code)
+{
+    swWarn("http2 connection error %d.", error_code);
+    http2_send_frame(client, SW_HTTP2_TYPE_GOAWAY, 0, 0, client->last_stream_id, error_code);
+    return SwooleG.serv->factory.end(&SwooleG.serv->factory, client->fd);
+}
+
+/**
+ * write the queued DATA frames to the connection in batches of SW_HTTP2_SEND_BATCH_SIZE, whatever
+ * is already in swoole_http_buffer goes first. The reactor keeps the batches in the output buffer
+ * chain of the connection, the rest waits here for WINDOW_UPDATE.
+ */
+static int http2_send_data(swoole_http_client *client)
+{
+    swHttp2_scheduler *scheduler = client->scheduler;
+    int ret = SW_OK;
+
+    while (1)
+    {
+        if (swHttp2_scheduler_run(scheduler, swoole_http_buffer, SW_HTTP2_SEND_BATCH_SIZE) < 0)
+        {
+            ret = SW_ERR;
+            break;
+        }
+        if (swoole_http_buffer->length == 0)
+        {
+            break;
+        }
+        ret = swServer_tcp_send(SwooleG.serv, client->fd, swoole_http_buffer->str, swoole_http_buffer->length);
+        swString_clear(swoole_http_buffer);
+        if (ret < 0)
+        {
+            break;
+        }
+    }
+    //the bodies must not point to the memory of the caller any more
+    if (swHttp2_scheduler_detach(scheduler) < 0)
+    {
+        return SW_ERR;
+    }
+    return ret < 0 ? SW_ERR : SW_OK;
+}
+
+/**
+ * HEADERS and CONTINUATION frames of the response, encoded with the dynamic table of the connection
+ */
+static int http2_build_header(http_context *ctx, swString *out, int body_length TSRMLS_DC)
 {
     assert(ctx->send_header == 0);
 
-    char buf[SW_HTTP_HEADER_MAX_SIZE];
     char *date_str = NULL;
     char intbuf[2][16];
-
     int ret;
 
+    swoole_http_client *client = ctx->client;
+    nghttp2_hd_deflater *deflater = http2_get_deflater(client);
+    if (!deflater)
+    {
+        return SW_ERR;
+    }
+
     /**
      * http header
      */
     zval *zheader = ctx->response.zheader;
+    zval *zcookie = ctx->response.zcookie;
     int index = 0;
 
-    nghttp2_nv nv[128];
+    //status, server, content-length, date, content-type and content-encoding at most
+    size_t nv_size = 6;
+    if (zheader)
+    {
+        nv_size += zend_hash_num_elements(Z_ARRVAL_P(zheader));
+    }
+    if (zcookie)
+    {
+        nv_size += zend_hash_num_elements(Z_ARRVAL_P(zcookie));
+    }
+    nghttp2_nv nv_stack[64];
+    nghttp2_nv *nv = nv_size <= 64 ? nv_stack : emalloc(sizeof(nghttp2_nv) * nv_size);
 
     /**
      * http status code
@@ -162,8 +287,8 @@ static int http2_build_header(http_context *ctx, uchar *buffer, int body_length
             body_length = swoole_zlib_buffer->length;
         }
 #endif
-        ret = swoole_itoa(buf, body_length);
-        http2_add_header(&nv[index++], ZEND_STRL("content-length"), buf, ret);
+        ret = swoole_itoa(intbuf[1], body_length);
+        http2_add_header(&nv[index++], ZEND_STRL("content-length"), intbuf[1], ret);
     }
     //http cookies
     if (ctx->response.zcookie)
@@ -190,40 +315,54 @@ static int http2_build_header(http_context *ctx, uchar *buffer, int body_length
     }
     ctx->send_header = 1;
 
-    ssize_t rv;
-    size_t buflen;
-    size_t i;
-    size_t sum = 0;
+    /**
+     * the block is encoded behind room for the first frame header, a block larger than the frame
+     * size of the peer is cut into CONTINUATION frames from the back
+     */
+    uint32_t max_frame_size = client->scheduler->max_frame_size;
+    size_t buflen = nghttp2_hd_deflate_bound(deflater, nv, index);
+    size_t size = out->length + buflen + (buflen / max_frame_size + 1) * SW_HTTP2_FRAME_HEADER_SIZE;
+    ssize_t rv = -1;
 
-    nghttp2_hd_deflater *deflater;
-    ret = nghttp2_hd_deflate_new(&deflater, 4096);
-    if (ret != 0)
+    if (size > out->size && swString_extend(out, size) < 0)
     {
-        swoole_php_error(E_WARNING, "nghttp2_hd_deflate_init failed with error: %s\n", nghttp2_strerror(ret));
-        return SW_ERR;
+        goto _end;
     }
-
-    for (i = 0; i < index; ++i)
+    char *block = out->str + out->length + SW_HTTP2_FRAME_HEADER_SIZE;
+    rv = nghttp2_hd_deflate_hd(deflater, (uchar *) block, buflen, nv, index);
+    if (rv < 0)
     {
-        sum += nv[i].namelen + nv[i].valuelen;
+        swoole_php_error(E_WARNING, "nghttp2_hd_deflate_hd() failed with error: %s\n", nghttp2_strerror((int ) rv));
+        goto _end;
     }
 
-    buflen = nghttp2_hd_deflate_bound(deflater, nv, index);
-    rv = nghttp2_hd_deflate_hd(deflater, (uchar *) buffer, buflen, nv, index);
-    if (rv < 0)
+    int frame_num = rv == 0 ? 1 : (rv + max_frame_size - 1) / max_frame_size;
+    int i, flags, length;
+    for (i = frame_num - 1; i >= 0; i--)
     {
-        swoole_php_error(E_WARNING, "nghttp2_hd_deflate_hd() failed with error: %s\n", nghttp2_strerror((int ) rv));
-        return SW_ERR;
+        char *fragment = block + (size_t) i * max_frame_size;
+        char *frame = out->str + out->length + (size_t) i * (max_frame_size + SW_HTTP2_FRAME_HEADER_SIZE);
+        length = i == frame_num - 1 ? rv - (size_t) i * max_frame_size : max_frame_size;
+        flags = i == frame_num - 1 ? SW_HTTP2_FLAG_END_HEADERS : SW_HTTP2_FLAG_NONE;
+        if (i == 0 && body_length == 0)
+        {
+            flags |= SW_HTTP2_FLAG_END_STREAM;
+        }
+        memmove(frame + SW_HTTP2_FRAME_HEADER_SIZE, fragment, length);
+        swHttp2_set_frame_header(frame, i == 0 ? SW_HTTP2_TYPE_HEADERS : SW_HTTP2_TYPE_CONTINUATION, length, flags, ctx->stream_id);
     }
+    out->length += rv + frame_num * SW_HTTP2_FRAME_HEADER_SIZE;
 
+    _end:
     if (date_str)
     {
         efree(date_str);
     }
-
-    nghttp2_hd_deflate_del(deflater);
-
-    return rv;
+    if (nv != nv_stack)
+    {
+        efree(nv);
+    }
+    return rv < 0 ? SW_ERR : SW_OK;
 }
 
 int swoole_http2_do_response(http_context *ctx, swString *body)
@@ -232,43 +371,49 @@ int swoole_http2_do_response(http_context *ctx, swString *body)
     TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
 #endif
 
-    char header_buffer[8192];
+    swoole_http_client *client = ctx->client;
+    swHttp2_scheduler *scheduler = http2_get_scheduler(client);
+    if (!scheduler)
+    {
+        return SW_ERR;
+    }
 
-    int n = http2_build_header(ctx, (uchar *) header_buffer, body->length TSRMLS_CC);
     swString_clear(swoole_http_buffer);
+    if (http2_build_header(ctx, swoole_http_buffer, body->length TSRMLS_CC) < 0)
+    {
+        ctx->send_header = 0;
+        return SW_ERR;
+    }
 
     /**
-     +---------------+
-     |Pad Length? (8)|
-     +-+-------------+-----------------------------------------------+
-     |E|                 Stream Dependency? (31)                     |
-     +-+-------------+-----------------------------------------------+
-     |  Weight? (8)  |
-     +-+-------------+-----------------------------------------------+
-     |                   Header Block Fragment (*)                 ...
-     +---------------------------------------------------------------+
-     |                           Padding (*)                       ...
-     +---------------------------------------------------------------+
+     * the body is sent as far as the windows allow, the rest is kept by the scheduler
      */
-    char frame_header[9];
-    swHttp2_set_frame_header(frame_header, SW_HTTP2_TYPE_HEADERS, n, SW_HTTP2_FLAG_END_HEADERS, ctx->stream_id);
-    swString_append_ptr(swoole_http_buffer, frame_header, 9);
-    swString_append_ptr(swoole_http_buffer, header_buffer, n);
-
-    swHttp2_set_frame_header(frame_header, SW_HTTP2_TYPE_DATA, body->length, SW_HTTP2_FLAG_END_STREAM, ctx->stream_id);
-    swString_append_ptr(swoole_http_buffer, frame_header, 9);
-    swString_append(swoole_http_buffer, body);
+    if (body->length > 0)
+    {
+        swHttp2_stream *stream = swHttp2_scheduler_add(scheduler, ctx->stream_id, body->str, body->length);
+        if (!stream)
+        {
+            ctx->send_header = 0;
+            return SW_ERR;
+        }
+        stream->weight = ctx->weight;
+        stream->dependency = ctx->dependency;
+        stream->send_window += ctx->send_window_delta;
+    }
 
-    int ret = swServer_tcp_send(SwooleG.serv, ctx->fd, swoole_http_buffer->str, swoole_http_buffer->length);
-    if (ret < 0)
+    if (http2_send_data(client) < 0)
     {
+        swHttp2_stream *stream = swHttp2_scheduler_find(scheduler, ctx->stream_id);
+        if (stream)
+        {
+            swHttp2_scheduler_remove(scheduler, stream);
+        }
         ctx->send_header = 0;
         return SW_ERR;
     }
-    swoole_http_client *client = ctx->client;
     if (client->streams)
     {
-        swHashMap_del_int(client->streams, ctx->stream_id);
+        swFlatMap_del_int(client->streams, ctx->stream_id);
     }
     swoole_http_context_free(ctx TSRMLS_CC);
     return SW_OK;
@@ -293,12 +438,26 @@ static int http2_parse_header(swoole_http_client *client, http_context *ctx, int
         client->inflater = inflater;
     }
 
+    if (flags & SW_HTTP2_FLAG_PADDED)
+    {
+        uint8_t padding = in[0];
+        if (padding + 1 > inlen)
+        {
+            return SW_ERR;
+        }
+        in++;
+        inlen -= padding + 1;
+    }
     if (flags & SW_HTTP2_FLAG_PRIORITY)
     {
-        //int stream_deps = ntohl(*(int *) (in));
-        //uint8_t weight = in[4];
-        in += 5;
-        inlen -= 5;
+        if (inlen < SW_HTTP2_PRIORITY_SIZE)
+        {
+            return SW_ERR;
+        }
+        ctx->dependency = ntohl(*(uint32_t *) in) & 0x7fffffff;
+        ctx->weight = (uint8_t) in[4] + 1;
+        in += SW_HTTP2_PRIORITY_SIZE;
+        inlen -= SW_HTTP2_PRIORITY_SIZE;
     }
 
     zval *zheader = ctx->request.zheader;
@@ -428,6 +587,89 @@ static int http2_parse_header(swoole_http_client *client, http_context *ctx, int
     return SW_OK;
 }
 
+/**
+ * SETTINGS of the peer, acknowledged right away
+ */
+static int http2_parse_setting(swoole_http_client *client, char *in, uint32_t length)
+{
+    swHttp2_scheduler *scheduler = http2_get_scheduler(client);
+    uint16_t id;
+    uint32_t value;
+    uint32_t i;
+
+    if (!scheduler)
+    {
+        return SW_ERR;
+    }
+    if (length % SW_HTTP2_SETTING_OPTION_SIZE != 0)
+    {
+        return http2_connection_error(client, SW_HTTP2_ERROR_FRAME_SIZE_ERROR);
+    }
+    for (i = 0; i < length; i += SW_HTTP2_SETTING_OPTION_SIZE)
+    {
+        id = ntohs(*(uint16_t *) (in + i));
+        value = ntohl(*(uint32_t *) (in + i + 2));
+        switch (id)
+        {
+        case SW_HTTP2_SETTING_HEADER_TABLE_SIZE:
+            client->header_table_size = value;
+            if (client->deflater)
+            {
+                nghttp2_hd_deflate_change_table_size(client->deflater, value);
+            }
+            break;
+        case SW_HTTP2_SETTINGS_INIT_WINDOW_SIZE:
+            if (swHttp2_scheduler_set_init_window(scheduler, value) < 0)
+            {
+                return http2_connection_error(client, SW_HTTP2_ERROR_FLOW_CONTROL_ERROR);
+            }
+            break;
+        case SW_HTTP2_SETTINGS_MAX_FRAME_SIZE:
+            if (value < SW_HTTP2_DEFAULT_FRAME_SIZE || value > SW_HTTP2_MAX_FRAME_SIZE)
+            {
+                return http2_connection_error(client, SW_HTTP2_ERROR_PROTOCOL_ERROR);
+            }
+            scheduler->max_frame_size = value;
+            break;
+        default:
+            break;
+        }
+    }
+    http2_send_frame(client, SW_HTTP2_TYPE_SETTINGS, SW_HTTP2_FLAG_ACK, 0, 0, 0);
+    //a larger initial window may unblock the queued bodies
+    return http2_send_data(client);
+}
+
+static int http2_window_update(swoole_http_client *client, uint32_t stream_id, uint32_t increment)
+{
+    swHttp2_scheduler *scheduler = http2_get_scheduler(client);
+    http_context *ctx;
+
+    if (!scheduler)
+    {
+        return SW_ERR;
+    }
+    if (stream_id == 0 || swHttp2_scheduler_find(scheduler, stream_id))
+    {
+        if (swHttp2_scheduler_window_update(scheduler, stream_id, increment) < 0)
+        {
+            if (stream_id == 0)
+            {
+                return http2_connection_error(client, SW_HTTP2_ERROR_FLOW_CONTROL_ERROR);
+            }
+            http2_send_frame(client, SW_HTTP2_TYPE_RST_STREAM, 0, stream_id, SW_HTTP2_ERROR_FLOW_CONTROL_ERROR, 0);
+            swHttp2_scheduler_remove(scheduler, swHttp2_scheduler_find(scheduler, stream_id));
+        }
+    }
+    //the response is not queued yet
+    else if (client->streams && (ctx = swFlatMap_find_int(client->streams, stream_id)))
+    {
+        ctx->send_window_delta += increment;
+        return SW_OK;
+    }
+    return http2_send_data(client);
+}
+
 /**
  * Http2
  */
@@ -466,6 +708,8 @@ int swoole_http2_onFrame(swoole_http_client *client, swEventData *req)
 
         ctx->http2 = 1;
         ctx->stream_id = stream_id;
+        ctx->weight = SW_HTTP2_DEFAULT_WEIGHT;
+        client->last_stream_id = stream_id;
 
         http2_parse_header(client, ctx, flags, buf + SW_HTTP2_FRAME_HEADER_SIZE, length);
 
@@ -490,22 +734,20 @@ int swoole_http2_onFrame(swoole_http_client *client, swEventData *req)
         sw_add_assoc_string(zserver, "server_protocol", "HTTP/2", 1);
         sw_add_assoc_string(zserver, "server_software", SW_HTTP_SERVER_SOFTWARE, 1);
 
-        if (flags & SW_HTTP2_FLAG_END_STREAM)
+        //the stream stays open until the response is queued, WINDOW_UPDATE and PRIORITY may come before
+        if (!client->streams)
         {
-            http2_onRequest(ctx, req->info.from_fd TSRMLS_CC);
+            client->streams = swFlatMap_new(SW_HTTP2_MAX_CONCURRENT_STREAMS, NULL);
         }
-        else
+        swFlatMap_add_int(client->streams, stream_id, ctx);
+        if (flags & SW_HTTP2_FLAG_END_STREAM)
         {
-            if (!client->streams)
-            {
-                client->streams = swHashMap_new(SW_HTTP2_MAX_CONCURRENT_STREAMS, NULL);
-            }
-            swHashMap_add_int(client->streams, stream_id, ctx);
+            http2_onRequest(ctx, req->info.from_fd TSRMLS_CC);
         }
     }
     else if (type == SW_HTTP2_TYPE_DATA)
     {
-        ctx = swHashMap_find_int(client->streams, stream_id);
+        ctx = client->streams ? swFlatMap_find_int(client->streams, stream_id) : NULL;
         if (!ctx)
         {
             sw_zval_ptr_dtor(&zdata);
@@ -513,13 +755,34 @@ int swoole_http2_onFrame(swoole_http_client *client, swEventData *req)
             return SW_ERR;
         }
 
+        //the stream windows we announce never run out, the connection window is 65535
+        client->recv_window_consumed += length;
+        if (client->recv_window_consumed >= SW_HTTP2_DEFAULT_WINDOW / 2)
+        {
+            http2_send_frame(client, SW_HTTP2_TYPE_WINDOW_UPDATE, 0, 0, client->recv_window_consumed, 0);
+            client->recv_window_consumed = 0;
+        }
+
+        char *data = buf + SW_HTTP2_FRAME_HEADER_SIZE;
+        if ((flags & SW_HTTP2_FLAG_PADDED) && length > 0)
+        {
+            uint8_t padding = data[0];
+            if (padding + 1 > length)
+            {
+                sw_zval_ptr_dtor(&zdata);
+                return http2_connection_error(client, SW_HTTP2_ERROR_PROTOCOL_ERROR);
+            }
+            data++;
+            length -= padding + 1;
+        }
+
         swString *buffer = ctx->request.post_buffer;
         if (!buffer)
         {
             buffer = swString_new(SW_HTTP2_DATA_BUFFSER_SIZE);
             ctx->request.post_buffer = buffer;
         }
-        swString_append_ptr(buffer, buf + SW_HTTP2_FRAME_HEADER_SIZE, length);
+        swString_append_ptr(buffer, data, length);
 
         if (flags & SW_HTTP2_FLAG_END_STREAM)
         {
@@ -550,9 +813,45 @@ int swoole_http2_onFrame(swoole_http_client *client, swEventData *req)
         memcpy(ping_frame + SW_HTTP2_FRAME_HEADER_SIZE, buf + SW_HTTP2_FRAME_HEADER_SIZE, SW_HTTP2_FRAME_PING_PAYLOAD_SIZE);
         swServer_tcp_send(SwooleG.serv, fd, ping_frame, SW_HTTP2_FRAME_HEADER_SIZE + SW_HTTP2_FRAME_PING_PAYLOAD_SIZE);
     }
+    else if (type == SW_HTTP2_TYPE_SETTINGS)
+    {
+        if (!(flags & SW_HTTP2_FLAG_ACK))
+        {
+            int ret = http2_parse_setting(client, buf + SW_HTTP2_FRAME_HEADER_SIZE, length);
+            sw_zval_ptr_dtor(&zdata);
+            return ret;
+        }
+    }
     else if (type == SW_HTTP2_TYPE_WINDOW_UPDATE)
     {
-        client->window_size = *(int *) (buf + SW_HTTP2_FRAME_HEADER_SIZE);
+        uint32_t increment = ntohl(*(uint32_t *) (buf + SW_HTTP2_FRAME_HEADER_SIZE)) & 0x7fffffff;
+        sw_zval_ptr_dtor(&zdata);
+        return http2_window_update(client, stream_id, increment);
+    }
+    else if (type == SW_HTTP2_TYPE_PRIORITY)
+    {
+        uint32_t dependency = ntohl(*(uint32_t *) (buf + SW_HTTP2_FRAME_HEADER_SIZE)) & 0x7fffffff;
+        uint16_t weight = (uint8_t) buf[SW_HTTP2_FRAME_HEADER_SIZE + 4] + 1;
+        swHttp2_stream *stream = client->scheduler ? swHttp2_scheduler_find(client->scheduler, stream_id) : NULL;
+        if (stream)
+        {
+            stream->dependency = dependency;
+            stream->weight = weight;
+        }
+        else if (client->streams && (ctx = swFlatMap_find_int(client->streams, stream_id)))
+        {
+            ctx->dependency = dependency;
+            ctx->weight = weight;
+        }
+    }
+    else if (type == SW_HTTP2_TYPE_RST_STREAM)
+    {
+        //the peer does not want the rest of the body
+        swHttp2_stream *stream = client->scheduler ? swHttp2_scheduler_find(client->scheduler, stream_id) : NULL;
+        if (stream)
+        {
+            swHttp2_scheduler_remove(client->scheduler, stream);
+        }
     }
     sw_zval_ptr_dtor(&zdata);
     return SW_OK;
@@ -565,5 +864,24 @@ void swoole_http2_free(swoole_http_client *client)
         nghttp2_hd_inflate_del(client->inflater);
         client->inflater = NULL;
     }
+    if (client->deflater)
+    {
+        nghttp2_hd_deflate_del(client->deflater);
+        client->deflater = NULL;
+    }
+    if (client->scheduler)
+    {
+        swHttp2_scheduler_free(client->scheduler);
+        sw_free(client->scheduler);
+        client->scheduler = NULL;
+    }
+    client->header_table_size = 0;
+    client->last_stream_id = 0;
+    client->recv_window_consumed = 0;
+    if (client->streams)
+    {
+        swFlatMap_free(client->streams);
+        client->streams = NULL;
+    }
 }
 #endif
@@ -31,6 +31,7 @@ static PHP_METHOD(swoole_mysql, connect);
 static PHP_METHOD(swoole_mysql, escape);
 #endif
 static PHP_METHOD(swoole_mysql, query);
+static PHP_METHOD(swoole_mysql, execute);
 static PHP_METHOD(swoole_mysql, close);
 static PHP_METHOD(swoole_mysql, on);
 static PHP_METHOD(swoole_mysql, getBuffer);
@@ -282,6 +283,12 @@ ZEND_BEGIN_ARG_INFO_EX(arginfo_swoole_mysql_query, 0, 0, 2)
     ZEND_ARG_INFO(0, callback)
 ZEND_END_ARG_INFO()
 
+ZEND_BEGIN_ARG_INFO_EX(arginfo_swoole_mysql_execute, 0, 0, 3)
+    ZEND_ARG_INFO(0, sql)
+    ZEND_ARG_ARRAY_INFO(0, params, 0)
+    ZEND_ARG_INFO(0, callback)
+ZEND_END_ARG_INFO()
+
 static const zend_function_entry swoole_mysql_methods[] =
 {
     PHP_ME(swoole_mysql, __construct, arginfo_swoole_void, ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
@@ -291,6 +298,7 @@ static const zend_function_entry swoole_mysql_methods[] =
     PHP_ME(swoole_mysql, escape, arginfo_swoole_mysql_escape, ZEND_ACC_PUBLIC)
 #endif
     PHP_ME(swoole_mysql, query, arginfo_swoole_mysql_query, ZEND_ACC_PUBLIC)
+    PHP_ME(swoole_mysql, execute, arginfo_swoole_mysql_execute, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_mysql, getBuffer, arginfo_swoole_void, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_mysql, close, arginfo_swoole_void, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_mysql, on, arginfo_swoole_mysql_on, ZEND_ACC_PUBLIC)
@@ -298,12 +306,14 @@ static const zend_function_entry swoole_mysql_methods[] =
 };
 
 static int mysql_request(swString *sql, swString *buffer);
+static void mysql_request_free(mysql_request_t *request);
+static void mysql_request_error(zval *zobject, mysql_request_t *request, int code, char *msg TSRMLS_DC);
 static int mysql_handshake(mysql_connector *connector, char *buf, int len);
 static int mysql_get_result(mysql_connector *connector, char *buf, int len);
 static int mysql_get_charset(char *name);
-static void mysql_client_free(mysql_client *client, zval* zobject);
+static void mysql_client_free(mysql_client *client, zval* zobject TSRMLS_DC);
 
-static void mysql_client_free(mysql_client *client, zval* zobject)
+static void mysql_client_free(mysql_client *client, zval* zobject TSRMLS_DC)
 {
     //close the connection
     client->cli->close(client->cli);
@@ -311,6 +321,25 @@ static void mysql_client_free(mysql_client *client, zval* zobject)
     swClient_free(client->cli);
     efree(client->cli);
     client->cli = NULL;
+    //the pending requests get no response, their callbacks are called with false
+    if (client->requests)
+    {
+        mysql_request_t *request;
+        swLinkedList *requests = client->requests;
+        client->requests = NULL;
+        client->send_node = NULL;
+        while ((request = swLinkedList_shift(requests)) != NULL)
+        {
+            mysql_request_error(zobject, request, 2006, "MySQL server has gone away" TSRMLS_CC);
+        }
+        swLinkedList_free(requests);
+    }
+    if (client->statements)
+    {
+        swHashMap_free(client->statements);
+        client->statements = NULL;
+        client->num_statements = 0;
+    }
 }
 
 #ifdef SW_MYSQL_DEBUG
@@ -348,6 +377,354 @@ static int mysql_request(swString *sql, swString *buffer)
     return swString_append(buffer, sql);
 }
 
+static int mysql_stmt_prepare_request(mysql_statement_t *stmt, swString *buffer)
+{
+    bzero(buffer->str, 5);
+    //length
+    mysql_pack_length(stmt->sql_length + 1, buffer->str);
+    //command
+    buffer->str[4] = SW_MYSQL_COM_STMT_PREPARE;
+    buffer->length = 5;
+    return swString_append_ptr(buffer, stmt->sql, stmt->sql_length);
+}
+
+/**
+ * COM_STMT_EXECUTE, the statement id at offset 5 is filled in when the statement is ready
+ */
+static int mysql_stmt_execute_request(zval *params, swString *buffer)
+{
+    HashTable *_ht = Z_ARRVAL_P(params);
+    int num_params = zend_hash_num_elements(_ht);
+    int null_offset = 14;
+    int type_offset = null_offset + ((num_params + 7) >> 3) + 1;
+    size_t length = num_params > 0 ? type_offset + num_params * 2 : null_offset;
+    char *value_str;
+    zend_size_t value_len;
+    double value_double;
+    int i = 0;
+    zval *value;
+
+    if (length + 9 > buffer->size && swString_extend_align(buffer, length + 9) < 0)
+    {
+        return SW_ERR;
+    }
+    bzero(buffer->str, length);
+    buffer->str[4] = SW_MYSQL_COM_STMT_EXECUTE;
+    //flags: CURSOR_TYPE_NO_CURSOR, iteration-count: 1
+    buffer->str[10] = 1;
+    if (num_params > 0)
+    {
+        //new-params-bound-flag
+        buffer->str[type_offset - 1] = 1;
+    }
+    buffer->length = length;
+
+    SW_HASHTABLE_FOREACH_START(_ht, value)
+        //type and the value are at most 9 bytes except for strings
+        if (buffer->length + 9 > buffer->size && swString_extend_align(buffer, buffer->length + 9) < 0)
+        {
+            return SW_ERR;
+        }
+        switch (Z_TYPE_P(value))
+        {
+        case IS_NULL:
+            buffer->str[null_offset + (i >> 3)] |= 1 << (i & 7);
+            buffer->str[type_offset + i * 2] = SW_MYSQL_TYPE_NULL;
+            break;
+#if PHP_MAJOR_VERSION < 7
+        case IS_BOOL:
+#else
+        case IS_TRUE:
+        case IS_FALSE:
+#endif
+            buffer->str[type_offset + i * 2] = SW_MYSQL_TYPE_TINY;
+            buffer->str[buffer->length++] = Z_BVAL_P(value) ? 1 : 0;
+            break;
+        case IS_LONG:
+            buffer->str[type_offset + i * 2] = SW_MYSQL_TYPE_LONGLONG;
+            mysql_int4store(buffer->str + buffer->length, Z_LVAL_P(value));
+            mysql_int4store(buffer->str + buffer->length + 4, (int64_t) Z_LVAL_P(value) >> 32);
+            buffer->length += 8;
+            break;
+        case IS_DOUBLE:
+            buffer->str[type_offset + i * 2] = SW_MYSQL_TYPE_DOUBLE;
+            value_double = Z_DVAL_P(value);
+            memcpy(buffer->str + buffer->length, &value_double, 8);
+            buffer->length += 8;
+            break;
+        default:
+            convert_to_string(value);
+            value_str = Z_STRVAL_P(value);
+            value_len = Z_STRLEN_P(value);
+            if (buffer->length + 9 + value_len > buffer->size && swString_extend_align(buffer, buffer->length + 9 + value_len) < 0)
+            {
+                return SW_ERR;
+            }
+            buffer->str[type_offset + i * 2] = SW_MYSQL_TYPE_VAR_STRING;
+            buffer->length += mysql_write_lcb(buffer->str + buffer->length, value_len);
+            memcpy(buffer->str + buffer->length, value_str, value_len);
+            buffer->length += value_len;
+            break;
+        }
+        i++;
+    SW_HASHTABLE_FOREACH_END();
+
+    mysql_pack_length(buffer->length - 4, buffer->str);
+    return SW_OK;
+}
+
+static void mysql_stmt_close_request(mysql_client *client, mysql_statement_t *stmt)
+{
+    char buf[9];
+    mysql_pack_length(5, buf);
+    buf[3] = 0;
+    buf[4] = SW_MYSQL_COM_STMT_CLOSE;
+    mysql_int4store(buf + 5, stmt->id);
+    //COM_STMT_CLOSE has no response
+    SwooleG.main_reactor->write(SwooleG.main_reactor, client->fd, buf, sizeof(buf));
+}
+
+static void mysql_statement_free(void *data)
+{
+    mysql_statement_t *stmt = data;
+    efree(stmt->sql);
+    efree(stmt);
+}
+
+static mysql_statement_t* mysql_statement_get(mysql_client *client, char *sql, zend_size_t sql_length)
+{
+    mysql_statement_t *stmt;
+    //the key of swHashMap is at most 65535 bytes
+    int cacheable = sql_length <= 65535;
+
+    if (cacheable)
+    {
+        stmt = swHashMap_find(client->statements, sql, sql_length);
+        if (stmt)
+        {
+            return stmt;
+        }
+    }
+
+    stmt = emalloc(sizeof(mysql_statement_t));
+    bzero(stmt, sizeof(mysql_statement_t));
+    stmt->sql = estrndup(sql, sql_length);
+    stmt->sql_length = sql_length;
+
+    //the statement is closed after it is executed once when the cache is full
+    if (cacheable && client->num_statements < SW_MYSQL_STMT_CACHE_SIZE)
+    {
+        swHashMap_add(client->statements, stmt->sql, sql_length, stmt);
+        stmt->cached = 1;
+        client->num_statements++;
+    }
+    return stmt;
+}
+
+static mysql_request_t* mysql_request_new(uint8_t command, zval *callback)
+{
+    mysql_request_t *request = emalloc(sizeof(mysql_request_t));
+    bzero(request, sizeof(mysql_request_t));
+    request->command = command;
+    sw_zval_add_ref(&callback);
+    request->callback = sw_zval_dup(callback);
+    return request;
+}
+
+static void mysql_request_free(mysql_request_t *request)
+{
+    if (request->callback)
+    {
+        sw_zval_free(request->callback);
+    }
+    if (request->packet)
+    {
+        swString_free(request->packet);
+    }
+    if (request->statement && !request->statement->cached)
+    {
+        mysql_statement_free(request->statement);
+    }
+    efree(request);
+}
+
+/**
+ * call back a request that gets no response from the server, with false and the error set on the object
+ */
+static void mysql_request_error(zval *zobject, mysql_request_t *request, int code, char *msg TSRMLS_DC)
+{
+    zval **args[2];
+    zval *retval = NULL;
+    zval *result = NULL;
+
+    zend_update_property_string(swoole_mysql_class_entry_ptr, zobject, ZEND_STRL("error"), msg TSRMLS_CC);
+    zend_update_property_long(swoole_mysql_class_entry_ptr, zobject, ZEND_STRL("errno"), code TSRMLS_CC);
+
+    SW_ALLOC_INIT_ZVAL(result);
+    ZVAL_BOOL(result, 0);
+    args[0] = &zobject;
+    args[1] = &result;
+    if (sw_call_user_function_ex(EG(function_table), NULL, request->callback, &retval, 2, args, 0, NULL TSRMLS_CC) != SUCCESS)
+    {
+        swoole_php_fatal_error(E_WARNING, "swoole_async_mysql callback handler error.");
+    }
+    if (retval)
+    {
+        sw_zval_ptr_dtor(&retval);
+    }
+    sw_zval_free(result);
+    mysql_request_free(request);
+}
+
+/**
+ * the requests queued while the statement was being prepared are checked against its parameter count,
+ * the ones that do not match are not sent and fail at once
+ */
+static int mysql_stmt_check_params(mysql_client *client, mysql_statement_t *stmt TSRMLS_DC)
+{
+    zval *zobject = client->object;
+    int fd = client->fd;
+    swLinkedList_node *node, *next;
+    mysql_request_t *request;
+    swLinkedList *failed = NULL;
+    char msg[128];
+
+    for (node = client->requests->head; node; node = next)
+    {
+        next = node->next;
+        request = node->data;
+        if (request->statement != stmt || request->num_params == stmt->num_params)
+        {
+            continue;
+        }
+        if (failed == NULL && (failed = swLinkedList_new(0, NULL)) == NULL)
+        {
+            return SW_ERR;
+        }
+        if (client->send_node == node)
+        {
+            client->send_node = next;
+        }
+        swLinkedList_remove_node(client->requests, node);
+        swLinkedList_append(failed, request);
+    }
+    if (failed == NULL)
+    {
+        return SW_OK;
+    }
+    client->state = client->requests->num > 0 ? SW_MYSQL_STATE_READ_START : SW_MYSQL_STATE_QUERY;
+
+    while ((request = swLinkedList_shift(failed)) != NULL)
+    {
+        snprintf(msg, sizeof(msg), "statement expects %d parameters, %d given.", stmt->num_params, request->num_params);
+        //a statement out of the cache belongs to this request only
+        if (!stmt->cached)
+        {
+            mysql_stmt_close_request(client, stmt);
+        }
+        //ER_WRONG_ARGUMENTS
+        mysql_request_error(zobject, request, 1210, msg TSRMLS_CC);
+    }
+    swLinkedList_free(failed);
+
+    //the connection is closed in the callback
+    swConnection *_socket = swReactor_get(SwooleG.main_reactor, fd);
+    return _socket->object ? SW_OK : SW_ERR;
+}
+
+/**
+ * send the requests queued behind a statement which is being prepared,
+ * stop at the next statement that has to be prepared first
+ */
+static int mysql_request_flush(mysql_client *client)
+{
+    swLinkedList_node *node;
+    mysql_request_t *request;
+    mysql_statement_t *stmt;
+
+    while ((node = client->send_node) != NULL)
+    {
+        request = node->data;
+        stmt = request->statement;
+        if (request->state == SW_MYSQL_REQUEST_PREPARE)
+        {
+            return SW_OK;
+        }
+        if (stmt && stmt->state != SW_MYSQL_STMT_READY)
+        {
+            if (stmt->state == SW_MYSQL_STMT_NONE)
+            {
+                swString_clear(mysql_request_buffer);
+                if (mysql_stmt_prepare_request(stmt, mysql_request_buffer) < 0
+                        || SwooleG.main_reactor->write(SwooleG.main_reactor, client->fd, mysql_request_buffer->str, mysql_request_buffer->length) < 0)
+                {
+                    return SW_ERR;
+                }
+                stmt->state = SW_MYSQL_STMT_PREPARING;
+                request->state = SW_MYSQL_REQUEST_PREPARE;
+            }
+            return SW_OK;
+        }
+        if (stmt)
+        {
+            mysql_int4store(request->packet->str + 5, stmt->id);
+        }
+        if (SwooleG.main_reactor->write(SwooleG.main_reactor, client->fd, request->packet->str, request->packet->length) < 0)
+        {
+            return SW_ERR;
+        }
+        swString_free(request->packet);
+        request->packet = NULL;
+        request->state = SW_MYSQL_REQUEST_SENT;
+        client->send_node = node->next;
+    }
+    return SW_OK;
+}
+
+/**
+ * pipeline the request, it is written at once unless a statement in front of it is not prepared yet.
+ * the request is released on failure if it was not queued
+ */
+static int mysql_request_send(mysql_client *client, mysql_request_t *request, swString *packet)
+{
+    mysql_statement_t *stmt = request->statement;
+
+    if (client->send_node == NULL && (stmt == NULL || stmt->state == SW_MYSQL_STMT_READY))
+    {
+        if (stmt)
+        {
+            mysql_int4store(packet->str + 5, stmt->id);
+        }
+        if (SwooleG.main_reactor->write(SwooleG.main_reactor, client->fd, packet->str, packet->length) < 0)
+        {
+            mysql_request_free(request);
+            return SW_ERR;
+        }
+        request->state = SW_MYSQL_REQUEST_SENT;
+        swLinkedList_append(client->requests, request);
+    }
+    else
+    {
+        request->packet = swString_dup(packet->str, packet->length);
+        request->state = SW_MYSQL_REQUEST_WAIT;
+        swLinkedList_append(client->requests, request);
+        if (client->send_node == NULL)
+        {
+            client->send_node = client->requests->tail;
+        }
+        if (mysql_request_flush(client) < 0)
+        {
+            return SW_ERR;
+        }
+    }
+
+    if (client->state == SW_MYSQL_STATE_QUERY)
+    {
+        client->state = SW_MYSQL_STATE_READ_START;
+    }
+    return SW_OK;
+}
+
 static int mysql_get_charset(char *name)
 {
     const mysql_charset *c = swoole_mysql_charsets;
@@ -497,7 +874,8 @@ static int mysql_handshake(mysql_connector *connector, char *buf, int len)
     tmp = connector->buf + 4;
 
     //capability flags, CLIENT_PROTOCOL_41 always set
-    value = SW_MYSQL_CLIENT_PROTOCOL_41 | SW_MYSQL_CLIENT_SECURE_CONNECTION | SW_MYSQL_CLIENT_CONNECT_WITH_DB | SW_MYSQL_CLIENT_PLUGIN_AUTH;
+    value = SW_MYSQL_CLIENT_PROTOCOL_41 | SW_MYSQL_CLIENT_SECURE_CONNECTION | SW_MYSQL_CLIENT_CONNECT_WITH_DB | SW_MYSQL_CLIENT_PLUGIN_AUTH
+            | SW_MYSQL_CLIENT_MULTI_RESULTS | SW_MYSQL_CLIENT_PS_MULTI_RESULTS | connector->capability_flags;
     memcpy(tmp, &value, sizeof(value));
     tmp += 4;
 
@@ -576,18 +954,21 @@ static int mysql_handshake(mysql_connector *connector, char *buf, int len)
 static int mysql_response(mysql_client *client)
 {
     swString *buffer = client->buffer;
-
-    char *p = buffer->str + buffer->offset;
+    mysql_request_t *request = client->requests->head->data;
+    mysql_statement_t *stmt;
+    char *p;
     int ret;
     char nul;
-    int n_buf = buffer->length - buffer->offset;
+    int n_buf;
 
-    while (n_buf > 0)
+    while (1)
     {
         switch (client->state)
         {
         case SW_MYSQL_STATE_READ_START:
-            if (buffer->length - buffer->offset < 5)
+            p = buffer->str + buffer->offset;
+            n_buf = buffer->length - buffer->offset;
+            if (n_buf < 5)
             {
                 client->response.wait_recv = 1;
                 return SW_ERR;
@@ -604,6 +985,7 @@ static int mysql_response(mysql_client *client)
             }
 
             client->response.response_type = p[0];
+            client->response.binary = (request->command == SW_MYSQL_COM_STMT_EXECUTE && request->state == SW_MYSQL_REQUEST_SENT);
             p ++;
             n_buf --;
 
@@ -623,6 +1005,7 @@ static int mysql_response(mysql_client *client)
                  * }
                  */
                 client->response.l_server_msg = client->response.packet_length - 9;
+                buffer->offset += client->response.packet_length + 4;
                 client->state = SW_MYSQL_STATE_READ_END;
                 return SW_OK;
             }
@@ -631,9 +1014,28 @@ static int mysql_response(mysql_client *client)
             {
                 client->response.warnings = mysql_uint2korr(p);
                 client->response.status_code = mysql_uint2korr(p + 2);
+                buffer->offset += client->response.packet_length + 4;
                 client->state = SW_MYSQL_STATE_READ_END;
                 return SW_OK;
             }
+            /**
+             * COM_STMT_PREPARE_OK
+             * int<4> statement_id, int<2> num_columns, int<2> num_params, int<1> filler, int<2> warning_count
+             */
+            else if (client->response.response_type == 0 && request->state == SW_MYSQL_REQUEST_PREPARE)
+            {
+                stmt = request->statement;
+                stmt->id = mysql_uint4korr(p);
+                stmt->num_columns = mysql_uint2korr(p + 4);
+                stmt->num_params = mysql_uint2korr(p + 6);
+                client->response.warnings = mysql_uint2korr(p + 9);
+                //parameter definitions and column definitions, each block ends with an EOF packet
+                client->response.skip_packets = (stmt->num_params > 0 ? stmt->num_params + 1 : 0)
+                        + (stmt->num_columns > 0 ? stmt->num_columns + 1 : 0);
+                buffer->offset += client->response.packet_length + 4;
+                client->state = SW_MYSQL_STATE_READ_PREPARE;
+                break;
+            }
             /* ok */
             else if (client->response.response_type == 0)
             {
@@ -655,6 +1057,7 @@ static int mysql_response(mysql_client *client)
                 /* server warnings */
                 client->response.warnings = mysql_uint2korr(p);
 
+                buffer->offset += client->response.packet_length + 4;
                 client->state = SW_MYSQL_STATE_READ_END;
                 return SW_OK;
             }
@@ -673,6 +1076,20 @@ static int mysql_response(mysql_client *client)
                 break;
             }
 
+        case SW_MYSQL_STATE_READ_PREPARE:
+            for (; client->response.skip_packets > 0; client->response.skip_packets--)
+            {
+                n_buf = buffer->length - buffer->offset;
+                if (n_buf < 4 || n_buf - 4 < mysql_uint3korr(buffer->str + buffer->offset))
+                {
+                    client->response.wait_recv = 1;
+                    return SW_ERR;
+                }
+                buffer->offset += mysql_uint3korr(buffer->str + buffer->offset) + 4;
+            }
+            client->state = SW_MYSQL_STATE_READ_END;
+            return SW_OK;
+
         case SW_MYSQL_STATE_READ_FIELD:
             if (mysql_read_columns(client) < 0)
             {
@@ -699,8 +1116,6 @@ static int mysql_response(mysql_client *client)
             return SW_ERR;
         }
     }
-
-    return SW_OK;
 }
 
 #ifdef SW_MYSQL_DEBUG
@@ -854,6 +1269,16 @@ static PHP_METHOD(swoole_mysql, connect)
     {
         connector->character_set = 0;
     }
+    //allow several statements in one query, the callback gets an array of results
+    if (php_swoole_array_get_value(_ht, "multi_statements", value))
+    {
+        convert_to_boolean(value);
+        connector->capability_flags = Z_BVAL_P(value) ? SW_MYSQL_CLIENT_MULTI_STATEMENTS : 0;
+    }
+    else
+    {
+        connector->capability_flags = 0;
+    }
 
     swClient *cli = emalloc(sizeof(swClient));
     int type = SW_SOCK_TCP;
@@ -912,6 +1337,8 @@ static PHP_METHOD(swoole_mysql, connect)
     zend_update_property_long(swoole_mysql_class_entry_ptr, getThis(), ZEND_STRL("sock"), cli->socket->fd TSRMLS_CC);
 
     client->buffer = swString_new(SW_BUFFER_SIZE_BIG);
+    client->requests = swLinkedList_new(0, NULL);
+    client->statements = swHashMap_new(SW_HASHMAP_INIT_BUCKET_N, mysql_statement_free);
     client->fd = cli->socket->fd;
     client->object = getThis();
     client->cli = cli;
@@ -956,23 +1383,82 @@ static PHP_METHOD(swoole_mysql, query)
         RETURN_FALSE;
     }
 
-    if (client->state != SW_MYSQL_STATE_QUERY)
+    swString_clear(mysql_request_buffer);
+
+    if (mysql_request(&sql, mysql_request_buffer) < 0)
     {
-        swoole_php_fatal_error(E_WARNING, "mysql client is waiting response, cannot send new sql query.");
         RETURN_FALSE;
     }
 
-    sw_zval_add_ref(&callback);
-    client->callback = sw_zval_dup(callback);
+    mysql_request_t *request = mysql_request_new(SW_MYSQL_COM_QUERY, callback);
+    //send query
+    if (mysql_request_send(client, request, mysql_request_buffer) < 0)
+    {
+        //connection is closed
+        if (swConnection_error(errno) == SW_CLOSE)
+        {
+            zend_update_property_bool(swoole_mysql_class_entry_ptr, getThis(), ZEND_STRL("connected"), 0 TSRMLS_CC);
+            zend_update_property_bool(swoole_mysql_class_entry_ptr, getThis(), ZEND_STRL("errno"), 2006 TSRMLS_CC);
+        }
+        RETURN_FALSE;
+    }
+    RETURN_TRUE;
+}
+
+static PHP_METHOD(swoole_mysql, execute)
+{
+    zval *params;
+    zval *callback;
+    char *sql;
+    zend_size_t sql_length;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "saz", &sql, &sql_length, &params, &callback) == FAILURE)
+    {
+        return;
+    }
+
+    if (sql_length <= 0)
+    {
+        swoole_php_fatal_error(E_WARNING, "Query is empty.");
+        RETURN_FALSE;
+    }
+
+    mysql_client *client = swoole_get_object(getThis());
+    if (!client)
+    {
+        swoole_php_fatal_error(E_WARNING, "object is not instanceof swoole_mysql.");
+        RETURN_FALSE;
+    }
+
+    if (!client->cli)
+    {
+        swoole_php_fatal_error(E_WARNING, "mysql connection#%d is closed.", client->fd);
+        RETURN_FALSE;
+    }
 
     swString_clear(mysql_request_buffer);
 
-    if (mysql_request(&sql, mysql_request_buffer) < 0)
+    int num_params = zend_hash_num_elements(Z_ARRVAL_P(params));
+    php_swoole_array_separate(params);
+    int ret = mysql_stmt_execute_request(params, mysql_request_buffer);
+    sw_zval_ptr_dtor(&params);
+    if (ret < 0)
     {
         RETURN_FALSE;
     }
-    //send query
-    if (SwooleG.main_reactor->write(SwooleG.main_reactor, client->fd, mysql_request_buffer->str, mysql_request_buffer->length) < 0)
+
+    mysql_request_t *request = mysql_request_new(SW_MYSQL_COM_STMT_EXECUTE, callback);
+    request->statement = mysql_statement_get(client, sql, sql_length);
+    request->num_params = num_params;
+    //a statement that is not prepared yet is checked when COM_STMT_PREPARE returns
+    if (request->statement->state == SW_MYSQL_STMT_READY && request->statement->num_params != request->num_params)
+    {
+        swoole_php_fatal_error(E_WARNING, "statement expects %d parameters, %d given.", request->statement->num_params, request->num_params);
+        mysql_request_free(request);
+        RETURN_FALSE;
+    }
+    //send COM_STMT_EXECUTE, COM_STMT_PREPARE goes first if the statement is not in the cache
+    if (mysql_request_send(client, request, mysql_request_buffer) < 0)
     {
         //connection is closed
         if (swConnection_error(errno) == SW_CLOSE)
@@ -982,11 +1468,7 @@ static PHP_METHOD(swoole_mysql, query)
         }
         RETURN_FALSE;
     }
-    else
-    {
-        client->state = SW_MYSQL_STATE_READ_START;
-        RETURN_TRUE;
-    }
+    RETURN_TRUE;
 }
 
 static PHP_METHOD(swoole_mysql, __destruct)
@@ -1054,7 +1536,7 @@ static PHP_METHOD(swoole_mysql, close)
             sw_zval_ptr_dtor(&retval);
         }
     }
-    mysql_client_free(client, getThis());
+    mysql_client_free(client, getThis() TSRMLS_CC);
     if (!is_destroyed)
     {
         sw_zval_ptr_dtor(&object);
@@ -1206,7 +1688,7 @@ static int swoole_mysql_onWrite(swReactor *reactor, swEvent *event)
         client->connector.error_code = SwooleG.error;
         client->connector.error_msg = strerror(SwooleG.error);
         client->connector.error_length = strlen(client->connector.error_msg);
-        mysql_client_free(client, client->object);
+        mysql_client_free(client, client->object TSRMLS_CC);
         swoole_mysql_onConnect(client TSRMLS_CC);
     }
     return SW_OK;
@@ -1284,6 +1766,130 @@ static int swoole_mysql_onHandShake(mysql_client *client TSRMLS_DC)
     return SW_OK;
 }
 
+static int swoole_mysql_onResponse(mysql_client *client TSRMLS_DC)
+{
+    zval *zobject = client->object;
+    mysql_request_t *request = client->requests->head->data;
+    mysql_statement_t *stmt = request->statement;
+    int fd = client->fd;
+
+    zval **args[2];
+    zval *retval = NULL;
+    zval *result = NULL;
+    zval *results;
+
+    if (request->state == SW_MYSQL_REQUEST_PREPARE)
+    {
+        //the statement is ready, COM_STMT_EXECUTE can be sent now
+        if (client->response.response_type == 0)
+        {
+            stmt->state = SW_MYSQL_STMT_READY;
+            request->state = SW_MYSQL_REQUEST_WAIT;
+            bzero(&client->response, sizeof(client->response));
+            client->state = SW_MYSQL_STATE_READ_START;
+            if (mysql_stmt_check_params(client, stmt TSRMLS_CC) < 0)
+            {
+                return SW_ERR;
+            }
+            return mysql_request_flush(client);
+        }
+        //the next request using the statement prepares it again
+        stmt->state = SW_MYSQL_STMT_NONE;
+    }
+
+    zend_update_property_long(swoole_mysql_class_entry_ptr, zobject, ZEND_STRL("affected_rows"), client->response.affected_rows TSRMLS_CC);
+    zend_update_property_long(swoole_mysql_class_entry_ptr, zobject, ZEND_STRL("insert_id"), client->response.insert_id TSRMLS_CC);
+
+    //OK
+    if (client->response.response_type == 0)
+    {
+        SW_ALLOC_INIT_ZVAL(result);
+        ZVAL_BOOL(result, 1);
+    }
+    //ERROR
+    else if (client->response.response_type == 255)
+    {
+        SW_ALLOC_INIT_ZVAL(result);
+        ZVAL_BOOL(result, 0);
+
+        zend_update_property_stringl(swoole_mysql_class_entry_ptr, zobject, ZEND_STRL("error"), client->response.server_msg, client->response.l_server_msg TSRMLS_CC);
+        zend_update_property_long(swoole_mysql_class_entry_ptr, zobject, ZEND_STRL("errno"), client->response.error_code TSRMLS_CC);
+    }
+    //ResultSet
+    else
+    {
+        result = client->response.result_array;
+    }
+
+    //multi-statement query, collect the results until the last one
+    results = client->response.results;
+    if (client->response.response_type != 255 && (client->response.status_code & SW_MYSQL_SERVER_MORE_RESULTS_EXISTS))
+    {
+        if (!results)
+        {
+            SW_ALLOC_INIT_ZVAL(results);
+            array_init(results);
+        }
+        add_next_index_zval(results, result);
+#if PHP_MAJOR_VERSION > 5
+        efree(result);
+#endif
+        bzero(&client->response, sizeof(client->response));
+        client->response.results = results;
+        client->state = SW_MYSQL_STATE_READ_START;
+        return SW_OK;
+    }
+    if (results)
+    {
+        add_next_index_zval(results, result);
+#if PHP_MAJOR_VERSION > 5
+        efree(result);
+#endif
+        result = results;
+    }
+
+    if (client->send_node == client->requests->head)
+    {
+        client->send_node = client->send_node->next;
+    }
+    swLinkedList_shift(client->requests);
+    //a statement out of the cache is used only once
+    if (stmt && !stmt->cached && stmt->state == SW_MYSQL_STMT_READY)
+    {
+        mysql_stmt_close_request(client, stmt);
+    }
+    client->state = client->requests->num > 0 ? SW_MYSQL_STATE_READ_START : SW_MYSQL_STATE_QUERY;
+    bzero(&client->response, sizeof(client->response));
+
+    args[0] = &zobject;
+    args[1] = &result;
+    if (sw_call_user_function_ex(EG(function_table), NULL, request->callback, &retval, 2, args, 0, NULL TSRMLS_CC) != SUCCESS)
+    {
+        swoole_php_fatal_error(E_WARNING, "swoole_async_mysql callback[2] handler error.");
+        SwooleG.main_reactor->del(SwooleG.main_reactor, fd);
+    }
+    /* free memory */
+    if (retval)
+    {
+        sw_zval_ptr_dtor(&retval);
+    }
+    if (result)
+    {
+        sw_zval_free(result);
+    }
+    //free callback object
+    mysql_request_free(request);
+
+    //the connection is closed in the callback
+    swConnection *_socket = swReactor_get(SwooleG.main_reactor, fd);
+    if (!_socket->object)
+    {
+        return SW_ERR;
+    }
+    //a failed COM_STMT_PREPARE has released the requests behind it
+    return mysql_request_flush(client);
+}
+
 static int swoole_mysql_onRead(swReactor *reactor, swEvent *event)
 {
 #if PHP_MAJOR_VERSION < 7
@@ -1302,10 +1908,7 @@ static int swoole_mysql_onRead(swReactor *reactor, swEvent *event)
     zval *zobject = client->object;
     swString *buffer = client->buffer;
 
-    zval **args[2];
-    zval *callback = NULL;
     zval *retval = NULL;
-    zval *result = NULL;
 
     while(1)
     {
@@ -1361,62 +1964,28 @@ static int swoole_mysql_onRead(swReactor *reactor, swEvent *event)
             }
 
             parse_response:
-            if (mysql_response(client) < 0)
-            {
-                return SW_OK;
-            }
-
-            zend_update_property_long(swoole_mysql_class_entry_ptr, zobject, ZEND_STRL("affected_rows"), client->response.affected_rows TSRMLS_CC);
-            zend_update_property_long(swoole_mysql_class_entry_ptr, zobject, ZEND_STRL("insert_id"), client->response.insert_id TSRMLS_CC);
-            client->state = SW_MYSQL_STATE_QUERY;
-
-            args[0] = &zobject;
-
-            //OK
-            if (client->response.response_type == 0)
-            {
-                SW_ALLOC_INIT_ZVAL(result);
-                ZVAL_BOOL(result, 1);
-            }
-            //ERROR
-            else if (client->response.response_type == 255)
-            {
-                SW_ALLOC_INIT_ZVAL(result);
-                ZVAL_BOOL(result, 0);
-
-                zend_update_property_stringl(swoole_mysql_class_entry_ptr, zobject, ZEND_STRL("error"), client->response.server_msg, client->response.l_server_msg TSRMLS_CC);
-                zend_update_property_long(swoole_mysql_class_entry_ptr, zobject, ZEND_STRL("errno"), client->response.error_code TSRMLS_CC);
-            }
-            //ResultSet
-            else
-            {
-                result = client->response.result_array;
-            }
-
-            args[1] = &result;
-            callback = client->callback;
-            if (sw_call_user_function_ex(EG(function_table), NULL, callback, &retval, 2, args, 0, NULL TSRMLS_CC) != SUCCESS)
+            //responses of the pipelined requests
+            while (client->state != SW_MYSQL_STATE_QUERY)
             {
-                swoole_php_fatal_error(E_WARNING, "swoole_async_mysql callback[2] handler error.");
-                reactor->del(SwooleG.main_reactor, event->fd);
-            }
-            /* free memory */
-            if (retval)
-            {
-                sw_zval_ptr_dtor(&retval);
+                if (mysql_response(client) < 0)
+                {
+                    break;
+                }
+                if (swoole_mysql_onResponse(client TSRMLS_CC) < 0)
+                {
+                    return SW_OK;
+                }
             }
-            if (result)
+            //keep the incomplete response
+            if (client->state == SW_MYSQL_STATE_QUERY)
             {
-                sw_zval_free(result);
+                swString_clear(buffer);
             }
-            //free callback object
-            sw_zval_free(callback);
-            swConnection *_socket = swReactor_get(SwooleG.main_reactor, event->fd);
-            if (_socket->object)
+            else if (buffer->offset > 0)
             {
-                //clear buffer
-                swString_clear(client->buffer);
-                bzero(&client->response, sizeof(client->response));
+                memmove(buffer->str, buffer->str + buffer->offset, buffer->length - buffer->offset);
+                buffer->length -= buffer->offset;
+                buffer->offset = 0;
             }
             return SW_OK;
         }
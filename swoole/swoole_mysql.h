@@ -70,10 +70,31 @@ enum mysql_read_state
     SW_MYSQL_STATE_READ_START,
     SW_MYSQL_STATE_READ_FIELD,
     SW_MYSQL_STATE_READ_ROW,
+    SW_MYSQL_STATE_READ_PREPARE,
     SW_MYSQL_STATE_READ_END,
     SW_MYSQL_STATE_CLOSED,
 };
 
+enum mysql_request_state
+{
+    /**
+     * packet is kept in request->packet until the requests before it are sent
+     */
+    SW_MYSQL_REQUEST_WAIT,
+    /**
+     * COM_STMT_PREPARE is in flight, COM_STMT_EXECUTE follows the prepare response
+     */
+    SW_MYSQL_REQUEST_PREPARE,
+    SW_MYSQL_REQUEST_SENT,
+};
+
+enum mysql_statement_state
+{
+    SW_MYSQL_STMT_NONE,
+    SW_MYSQL_STMT_PREPARING,
+    SW_MYSQL_STMT_READY,
+};
+
 enum mysql_error_code
 {
     SW_MYSQL_ERR_PROTOCOL_ERROR = 1,
@@ -139,6 +160,12 @@ enum mysql_field_types
 #define SW_MYSQL_CLIENT_PLUGIN_AUTH              (1UL << 19)
 #define SW_MYSQL_CLIENT_CONNECT_ATTRS            (1UL << 20)
 #define SW_MYSQL_CLIENT_SECURE_CONNECTION        32768
+#define SW_MYSQL_CLIENT_MULTI_STATEMENTS         (1UL << 16)
+#define SW_MYSQL_CLIENT_MULTI_RESULTS            (1UL << 17)
+#define SW_MYSQL_CLIENT_PS_MULTI_RESULTS         (1UL << 18)
+
+#define SW_MYSQL_SERVER_MORE_RESULTS_EXISTS      8
+#define SW_MYSQL_UNSIGNED_FLAG                   32
 
 typedef struct
 {
@@ -244,8 +271,44 @@ typedef struct
     ulong_t affected_rows;
     ulong_t insert_id;
     zval *result_array;
+    /**
+     * binary protocol rows of COM_STMT_EXECUTE
+     */
+    uint8_t binary;
+    /**
+     * parameter and column definitions following the prepare response
+     */
+    uint32_t skip_packets;
+    /**
+     * results of a multi-statement query
+     */
+    zval *results;
 } mysql_response_t;
 
+typedef struct
+{
+    uint32_t id;
+    uint16_t num_params;
+    uint16_t num_columns;
+    uint8_t state;
+    uint8_t cached;
+    uint32_t sql_length;
+    char *sql;
+} mysql_statement_t;
+
+typedef struct
+{
+    uint8_t command;
+    uint8_t state;
+    zval *callback;
+    mysql_statement_t *statement;
+    /**
+     * parameters bound by execute(), checked against the statement once it is prepared
+     */
+    uint16_t num_params;
+    swString *packet;
+} mysql_request_t;
+
 typedef struct
 {
     uint8_t state;
@@ -253,10 +316,17 @@ typedef struct
     swString *buffer;
     swClient *cli;
     zval *object;
-    zval *callback;
     zval *onClose;
     int fd;
 
+    /**
+     * pipelined requests, the responses arrive in the same order
+     */
+    swLinkedList *requests;
+    swLinkedList_node *send_node;
+    swHashMap *statements;
+    uint32_t num_statements;
+
     mysql_connector connector;
 
 #if PHP_MAJOR_VERSION >= 7
@@ -292,6 +362,43 @@ static sw_inline void mysql_pack_length(int length, char *buf)
     buf[0] = length;
 }
 
+static sw_inline void mysql_int4store(char *buf, uint32_t value)
+{
+    buf[0] = value;
+    buf[1] = value >> 8;
+    buf[2] = value >> 16;
+    buf[3] = value >> 24;
+}
+
+static sw_inline int mysql_write_lcb(char *buf, ulong_t length)
+{
+    if (length < 251)
+    {
+        buf[0] = length;
+        return 1;
+    }
+    else if (length < 65536)
+    {
+        buf[0] = (char) 0xfc;
+        buf[1] = length;
+        buf[2] = length >> 8;
+        return 3;
+    }
+    else if (length < 16777216)
+    {
+        buf[0] = (char) 0xfd;
+        mysql_pack_length(length, buf + 1);
+        return 4;
+    }
+    else
+    {
+        buf[0] = (char) 0xfe;
+        mysql_int4store(buf + 1, length);
+        mysql_int4store(buf + 5, (uint64_t) length >> 32);
+        return 9;
+    }
+}
+
 static sw_inline int mysql_lcb_ll(char *m, ulong_t *r, char *nul, int len)
 {
     if (len < 1)
@@ -692,6 +799,250 @@ static sw_inline int mysql_decode_row(mysql_client *client, char *buf, int packe
     return read_n;
 }
 
+static sw_inline int mysql_decode_datetime(mysql_field *field, char *buf, int len, char *out)
+{
+    int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0, n;
+    uint32_t usec = 0;
+
+    if (len >= 4)
+    {
+        year = mysql_uint2korr(buf);
+        month = (uchar) buf[2];
+        day = (uchar) buf[3];
+    }
+    if (len >= 7)
+    {
+        hour = (uchar) buf[4];
+        minute = (uchar) buf[5];
+        second = (uchar) buf[6];
+    }
+    if (len >= 11)
+    {
+        usec = mysql_uint4korr(buf + 7);
+    }
+    if (field->type == SW_MYSQL_TYPE_DATE)
+    {
+        return sprintf(out, "%04d-%02d-%02d", year, month, day);
+    }
+    n = sprintf(out, "%04d-%02d-%02d %02d:%02d:%02d", year, month, day, hour, minute, second);
+    if (field->decimals > 0 && field->decimals <= 6)
+    {
+        n += sprintf(out + n, ".%06u", usec % 1000000);
+        n -= (6 - field->decimals);
+    }
+    return n;
+}
+
+static sw_inline int mysql_decode_time(mysql_field *field, char *buf, int len, char *out)
+{
+    int negative = 0, n;
+    uint32_t hour = 0, minute = 0, second = 0, usec = 0;
+
+    if (len >= 8)
+    {
+        negative = buf[0];
+        hour = mysql_uint4korr(buf + 1) * 24 + (uchar) buf[5];
+        minute = (uchar) buf[6];
+        second = (uchar) buf[7];
+    }
+    if (len >= 12)
+    {
+        usec = mysql_uint4korr(buf + 8);
+    }
+    n = sprintf(out, "%s%02u:%02u:%02u", negative ? "-" : "", hour, minute, second);
+    if (field->decimals > 0 && field->decimals <= 6)
+    {
+        n += sprintf(out + n, ".%06u", usec % 1000000);
+        n -= (6 - field->decimals);
+    }
+    return n;
+}
+
+/**
+ * binary protocol row of COM_STMT_EXECUTE, numbers are copied out as they are,
+ * there is no string to number conversion
+ */
+static sw_inline int mysql_decode_binary_row(mysql_client *client, char *buf, int packet_len)
+{
+    int i, tmp_len;
+    ulong_t len;
+    char nul;
+    char value_buffer[64];
+    uint64_t ubigint;
+    float mfloat;
+    double mdouble;
+    mysql_field *field;
+
+    //int<1> 0x00 header, the null bitmap has an offset of 2 bits
+    uchar *null_bitmap = (uchar *) buf + 1;
+    int read_n = 1 + ((client->response.num_column + 9) >> 3);
+    if (read_n > packet_len)
+    {
+        return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
+    }
+
+    zval *result_array = client->response.result_array;
+    zval *row_array = NULL;
+    SW_ALLOC_INIT_ZVAL(row_array);
+    array_init(row_array);
+
+    for (i = 0; i < client->response.num_column; i++)
+    {
+        field = &client->response.columns[i];
+        if (null_bitmap[(i + 2) >> 3] & (1 << ((i + 2) & 7)))
+        {
+            add_assoc_null(row_array, field->name);
+            continue;
+        }
+
+        switch (field->type)
+        {
+        case SW_MYSQL_TYPE_TINY:
+            if (read_n + 1 > packet_len)
+            {
+                goto corrupt;
+            }
+            if (field->flags & SW_MYSQL_UNSIGNED_FLAG)
+            {
+                add_assoc_long(row_array, field->name, (uchar) buf[read_n]);
+            }
+            else
+            {
+                add_assoc_long(row_array, field->name, (signed char) buf[read_n]);
+            }
+            read_n += 1;
+            break;
+
+        case SW_MYSQL_TYPE_SHORT:
+        case SW_MYSQL_TYPE_YEAR:
+            if (read_n + 2 > packet_len)
+            {
+                goto corrupt;
+            }
+            if (field->flags & SW_MYSQL_UNSIGNED_FLAG)
+            {
+                add_assoc_long(row_array, field->name, mysql_uint2korr(buf + read_n));
+            }
+            else
+            {
+                add_assoc_long(row_array, field->name, (int16_t) mysql_uint2korr(buf + read_n));
+            }
+            read_n += 2;
+            break;
+
+        case SW_MYSQL_TYPE_INT24:
+        case SW_MYSQL_TYPE_LONG:
+            if (read_n + 4 > packet_len)
+            {
+                goto corrupt;
+            }
+            if (field->flags & SW_MYSQL_UNSIGNED_FLAG)
+            {
+                add_assoc_long(row_array, field->name, (long) mysql_uint4korr(buf + read_n));
+            }
+            else
+            {
+                add_assoc_long(row_array, field->name, (int32_t) mysql_uint4korr(buf + read_n));
+            }
+            read_n += 4;
+            break;
+
+        case SW_MYSQL_TYPE_LONGLONG:
+            if (read_n + 8 > packet_len)
+            {
+                goto corrupt;
+            }
+            ubigint = mysql_uint8korr(buf + read_n);
+            //out of the range of php integer
+            if ((field->flags & SW_MYSQL_UNSIGNED_FLAG) && ubigint > LONG_MAX)
+            {
+                tmp_len = sprintf(value_buffer, "%llu", (unsigned long long) ubigint);
+                sw_add_assoc_stringl(row_array, field->name, value_buffer, tmp_len, 1);
+            }
+            else
+            {
+                add_assoc_long(row_array, field->name, (long) (int64_t) ubigint);
+            }
+            read_n += 8;
+            break;
+
+        case SW_MYSQL_TYPE_FLOAT:
+            if (read_n + 4 > packet_len)
+            {
+                goto corrupt;
+            }
+            memcpy(&mfloat, buf + read_n, 4);
+            add_assoc_double(row_array, field->name, mfloat);
+            read_n += 4;
+            break;
+
+        case SW_MYSQL_TYPE_DOUBLE:
+            if (read_n + 8 > packet_len)
+            {
+                goto corrupt;
+            }
+            memcpy(&mdouble, buf + read_n, 8);
+            add_assoc_double(row_array, field->name, mdouble);
+            read_n += 8;
+            break;
+
+        case SW_MYSQL_TYPE_DATE:
+        case SW_MYSQL_TYPE_DATETIME:
+        case SW_MYSQL_TYPE_TIMESTAMP:
+        case SW_MYSQL_TYPE_TIME:
+            if (read_n + 1 > packet_len)
+            {
+                goto corrupt;
+            }
+            len = (uchar) buf[read_n];
+            if (read_n + 1 + len > packet_len)
+            {
+                goto corrupt;
+            }
+            if (field->type == SW_MYSQL_TYPE_TIME)
+            {
+                tmp_len = mysql_decode_time(field, buf + read_n + 1, len, value_buffer);
+            }
+            else
+            {
+                tmp_len = mysql_decode_datetime(field, buf + read_n + 1, len, value_buffer);
+            }
+            sw_add_assoc_stringl(row_array, field->name, value_buffer, tmp_len, 1);
+            read_n += 1 + len;
+            break;
+
+        /* String, Decimal, Blob, Bit, Enum, Set, Geometry */
+        default:
+            tmp_len = mysql_length_coded_binary(&buf[read_n], &len, &nul, packet_len - read_n);
+            if (tmp_len == -1)
+            {
+                sw_zval_free(row_array);
+                return -SW_MYSQL_ERR_BAD_LCB;
+            }
+            read_n += tmp_len;
+            if (read_n + len > packet_len)
+            {
+                goto corrupt;
+            }
+            sw_add_assoc_stringl(row_array, field->name, buf + read_n, len, 1);
+            read_n += len;
+            break;
+        }
+    }
+
+    add_next_index_zval(result_array, row_array);
+
+#if PHP_MAJOR_VERSION > 5
+    efree(row_array);
+#endif
+
+    return read_n;
+
+    corrupt:
+    sw_zval_free(row_array);
+    return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
+}
+
 static sw_inline int mysql_read_eof(mysql_client *client, char *buffer, int n_buf)
 {
     //EOF, length (3byte) + id(1byte) + 0xFE + warning(2byte) + status(2byte)
@@ -785,14 +1136,19 @@ static sw_inline int mysql_read_rows(mysql_client *client)
     //RecordSet parse
     while (n_buf > 0)
     {
-        if (n_buf < 4)
+        if (n_buf < 5)
         {
             client->response.wait_recv = 1;
             return SW_ERR;
         }
-        //RecordSet end
-        else if (n_buf == 9 && mysql_read_eof(client, buffer, n_buf) == 0)
+        //RecordSet end, a row packet starting with 0xfe is never shorter than 9 bytes
+        else if ((uint8_t) buffer[4] == 0xfe && mysql_uint3korr(buffer) < 9)
         {
+            if (mysql_read_eof(client, buffer, n_buf) < 0)
+            {
+                return SW_ERR;
+            }
+            client->buffer->offset += 9;
             if (client->response.columns)
             {
                 int i;
@@ -805,6 +1161,7 @@ static sw_inline int mysql_read_rows(mysql_client *client)
                     }
                 }
                 efree(client->response.columns);
+                client->response.columns = NULL;
             }
             return SW_OK;
         }
@@ -822,7 +1179,14 @@ static sw_inline int mysql_read_rows(mysql_client *client)
         }
 
         //decode
-        ret = mysql_decode_row(client, buffer, client->response.packet_length);
+        if (client->response.binary)
+        {
+            ret = mysql_decode_binary_row(client, buffer, client->response.packet_length);
+        }
+        else
+        {
+            ret = mysql_decode_row(client, buffer, client->response.packet_length);
+        }
         if (ret < 0)
         {
             break;
@@ -23,6 +23,12 @@ zend_class_entry swoole_redis_server_ce;
 zend_class_entry *swoole_redis_server_class_entry_ptr;
 
 static swString *format_buffer;
+static swString *reply_buffer;
+/**
+ * the connection the buffered replies belong to
+ */
+static int reply_fd = -1;
+static swRedis_arg redis_args[SW_REDIS_MAX_ARGS];
 
 static PHP_METHOD(swoole_redis_server, start);
 static PHP_METHOD(swoole_redis_server, setHandler);
@@ -66,125 +72,76 @@ void swoole_redis_server_init(int module_number TSRMLS_DC)
     zend_declare_class_constant_long(swoole_redis_server_class_entry_ptr, SW_STRL("MAP")-1, SW_REDIS_REPLY_MAP TSRMLS_CC);
 }
 
-static int redis_onReceive(swServer *serv, swEventData *req)
+/**
+ * send the replies buffered for the connection, called before anything that is sent or closed
+ * directly, so that the client sees the replies in the order of its commands
+ */
+void swoole_redis_server_flush(swServer *serv, int fd)
 {
-    if (swEventData_is_dgram(req->info.type))
+    if (reply_buffer == NULL || reply_fd != fd || reply_buffer->length == 0)
     {
-        return php_swoole_onReceive(serv, req);
+        return;
     }
+    serv->send(serv, fd, reply_buffer->str, reply_buffer->length);
+    swString_clear(reply_buffer);
+}
 
-    int fd = req->info.fd;
-    swConnection *conn = swWorker_get_connection(SwooleG.serv, fd);
-    if (!conn)
+/**
+ * call the handler of one command, the reply is appended to reply_buffer
+ */
+static int redis_onCommand(swServer *serv, int fd, char *data, swRedis_parser *parser TSRMLS_DC)
+{
+    swRedis_arg *arg = &parser->args[0];
+    char *command = data + arg->offset;
+    int command_len = arg->length;
+    int i;
+
+    if (arg->type != SW_REDIS_REPLY_STRING || command_len >= SW_REDIS_MAX_COMMAND_SIZE)
     {
-        swWarn("connection[%d] is closed.", fd);
+        swoole_php_error(E_WARNING, "command is too long.");
+        swoole_redis_server_flush(serv, fd);
+        serv->close(serv, fd, 0);
         return SW_ERR;
     }
 
-    swListenPort *port = serv->connection_list[req->info.from_fd].object;
-    //other server port
-    if (!port->open_redis_protocol)
+    char _command[SW_REDIS_MAX_COMMAND_SIZE];
+    int _command_len = snprintf(_command, sizeof(_command), "_handler_%.*s", command_len, command);
+    php_strtolower(_command, _command_len);
+
+    zval *zobject = serv->ptr2;
+    zval *zcallback = sw_zend_read_property(swoole_redis_server_class_entry_ptr, zobject, _command, _command_len, 1 TSRMLS_CC);
+    if (!zcallback || ZVAL_IS_NULL(zcallback))
     {
-        return php_swoole_onReceive(serv, req);
+        char err_msg[256];
+        int length = snprintf(err_msg, sizeof(err_msg), "ERR unknown command '%.*s'", command_len, command);
+        swRedis_reply_error(reply_buffer, err_msg, length);
+        return SW_OK;
     }
 
-    SWOOLE_GET_TSRMLS;
-
-    zval *zdata;
-    SW_MAKE_STD_ZVAL(zdata);
-    php_swoole_get_recv_data(zdata, req, NULL, 0);
-    char *p = Z_STRVAL_P(zdata);
-    char *pe = p + Z_STRLEN_P(zdata);
-    int ret;
-    int length = 0;
-
     zval *zparams;
     SW_MAKE_STD_ZVAL(zparams);
     array_init(zparams);
 
-    zval *retval;
-
-    int state = SW_REDIS_RECEIVE_TOTAL_LINE;
-    int add_param = 0;
-    char *command = NULL;
-    int command_len = 0;
-
-    do
+    for (i = 1; i < parser->n_args; i++)
     {
-        switch (state)
+        arg = &parser->args[i];
+        if (arg->type == SW_REDIS_REPLY_NIL)
         {
-        case SW_REDIS_RECEIVE_TOTAL_LINE:
-            if (*p == '*' && (p = swRedis_get_number(p, &ret)))
-            {
-                state = SW_REDIS_RECEIVE_LENGTH;
-                break;
-            }
-            /* no break */
-
-        case SW_REDIS_RECEIVE_LENGTH:
-            if (*p == '$' && (p = swRedis_get_number(p, &ret)))
-            {
-                if (ret == -1)
-                {
-                    add_next_index_null(zparams);
-                    break;
-                }
-                length = ret;
-                state = SW_REDIS_RECEIVE_STRING;
-                break;
-            }
-            //integer
-            else if (*p == ':' && (p = swRedis_get_number(p, &ret)))
-            {
-                add_next_index_long(zparams, ret);
-                break;
-            }
-            /* no break */
-
-        case SW_REDIS_RECEIVE_STRING:
-            if (add_param == 0)
-            {
-                command = p;
-                command_len = length;
-                add_param = 1;
-            }
-            else
-            {
-                sw_add_next_index_stringl(zparams, p, length, 1);
-            }
-            p += length + SW_CRLF_LEN;
-            state = SW_REDIS_RECEIVE_LENGTH;
-            break;
-
-        default:
-            break;
+            add_next_index_null(zparams);
+        }
+        else if (arg->type == SW_REDIS_REPLY_INT)
+        {
+            //the digits are followed by CRLF
+            add_next_index_long(zparams, strtol(data + arg->offset, NULL, 10));
+        }
+        else
+        {
+            sw_add_next_index_stringl(zparams, data + arg->offset, arg->length, 1);
         }
-    } while(p < pe);
-
-    if (command_len >= SW_REDIS_MAX_COMMAND_SIZE)
-    {
-        swoole_php_error(E_WARNING, "command is too long.");
-        serv->close(serv, fd, 0);
-        return SW_OK;
     }
 
-    char _command[SW_REDIS_MAX_COMMAND_SIZE];
-    command[command_len] = 0;
-    int _command_len = snprintf(_command, sizeof(_command), "_handler_%*s", command_len, command);
-    php_strtolower(_command, _command_len);
-
     zval **args[2];
-    zval *zobject = serv->ptr2;
-    zval *zcallback = sw_zend_read_property(swoole_redis_server_class_entry_ptr, zobject, _command, _command_len, 1 TSRMLS_CC);
-
-    char err_msg[256];
-    if (!zcallback || ZVAL_IS_NULL(zcallback))
-    {
-        length = snprintf(err_msg, sizeof(err_msg), "-ERR unknown command '%*s'\r\n", command_len, command);
-        swServer_tcp_send(serv, fd, err_msg, length);
-        return SW_OK;
-    }
-
+    zval *retval;
     zval *zfd;
     SW_MAKE_STD_ZVAL(zfd);
     ZVAL_LONG(zfd, fd);
@@ -205,16 +162,97 @@ static int redis_onReceive(swServer *serv, swEventData *req)
     {
         if (Z_TYPE_P(retval) == IS_STRING)
         {
-            serv->send(serv, fd, Z_STRVAL_P(retval), Z_STRLEN_P(retval));
+            swString_append_ptr(reply_buffer, Z_STRVAL_P(retval), Z_STRLEN_P(retval));
         }
         sw_zval_ptr_dtor(&retval);
     }
     sw_zval_ptr_dtor(&zfd);
-    sw_zval_ptr_dtor(&zdata);
     sw_zval_ptr_dtor(&zparams);
     return SW_OK;
 }
 
+static int redis_onReceive(swServer *serv, swEventData *req)
+{
+    if (swEventData_is_dgram(req->info.type))
+    {
+        return php_swoole_onReceive(serv, req);
+    }
+
+    int fd = req->info.fd;
+    swConnection *conn = swWorker_get_connection(SwooleG.serv, fd);
+    if (!conn)
+    {
+        swWarn("connection[%d] is closed.", fd);
+        return SW_ERR;
+    }
+
+    swListenPort *port = serv->connection_list[req->info.from_fd].object;
+    //other server port
+    if (!port->open_redis_protocol)
+    {
+        return php_swoole_onReceive(serv, req);
+    }
+
+    SWOOLE_GET_TSRMLS;
+
+    char *data;
+    int length;
+
+    //the commands are parsed in place, the package is not copied into a zval
+#ifdef SW_USE_RINGBUFFER
+    swPackage package;
+    if (req->info.type == SW_EVENT_PACKAGE)
+    {
+        memcpy(&package, req->data, sizeof (package));
+        data = package.data;
+        length = package.length;
+    }
+#else
+    if (req->info.type == SW_EVENT_PACKAGE_END)
+    {
+        swString *worker_buffer = swWorker_get_buffer(serv, req->info.from_id);
+        data = worker_buffer->str;
+        length = worker_buffer->length;
+    }
+#endif
+    else
+    {
+        data = req->data;
+        length = req->info.len;
+    }
+
+    swRedis_parser parser;
+    swRedis_parser_init(&parser, redis_args, SW_REDIS_MAX_ARGS);
+    swString_clear(reply_buffer);
+    reply_fd = fd;
+
+    int ret;
+    while ((ret = swRedis_parse(&parser, data, length)) == SW_REDIS_PARSE_COMPLETE)
+    {
+        if (redis_onCommand(serv, fd, data, &parser TSRMLS_CC) < 0)
+        {
+            break;
+        }
+    }
+    //the replies of all the pipelined commands are sent with one write
+    swoole_redis_server_flush(serv, fd);
+    reply_fd = -1;
+    if (ret == SW_REDIS_PARSE_ERROR)
+    {
+        swoole_php_error(E_WARNING, "redis protocol error.");
+        serv->close(serv, fd, 0);
+    }
+
+#ifdef SW_USE_RINGBUFFER
+    if (req->info.type == SW_EVENT_PACKAGE)
+    {
+        swReactorThread *thread = swServer_get_thread(serv, req->info.from_id);
+        thread->buffer_input->free(thread->buffer_input, data);
+    }
+#endif
+    return SW_OK;
+}
+
 static PHP_METHOD(swoole_redis_server, start)
 {
     int ret;
@@ -237,6 +275,13 @@ static PHP_METHOD(swoole_redis_server, start)
         RETURN_FALSE;
     }
 
+    reply_buffer = swString_new(SW_BUFFER_SIZE_STD);
+    if (!reply_buffer)
+    {
+        swoole_php_fatal_error(E_ERROR, "[2] swString_new(%d) failed.", SW_BUFFER_SIZE_STD);
+        RETURN_FALSE;
+    }
+
     zval *zsetting = sw_zend_read_property(swoole_server_class_entry_ptr, getThis(), ZEND_STRL("setting"), 1 TSRMLS_CC);
     if (zsetting == NULL || ZVAL_IS_NULL(zsetting))
     {
@@ -262,6 +307,7 @@ static PHP_METHOD(swoole_redis_server, start)
     php_swoole_server_before_start(serv, getThis() TSRMLS_CC);
 
     ret = swServer_start(serv);
+    php_swoole_server_after_stop(serv);
     if (ret < 0)
     {
         swoole_php_fatal_error(E_ERROR, "start server failed. Error: %s", sw_error);
@@ -315,10 +361,10 @@ static PHP_METHOD(swoole_redis_server, format)
         return;
     }
 
-    char message[256];
-    int length;
     zval *item;
 
+    swString_clear(format_buffer);
+
     if (type == SW_REDIS_REPLY_NIL)
     {
         SW_RETURN_STRINGL(SW_REDIS_RETURN_NIL, sizeof(SW_REDIS_RETURN_NIL)-1, 1);
@@ -328,26 +374,24 @@ static PHP_METHOD(swoole_redis_server, format)
         if (value)
         {
             convert_to_string(value);
-            length = snprintf(message, sizeof(message), "+%*s\r\n", Z_STRLEN_P(value), Z_STRVAL_P(value));
+            swRedis_reply_status(format_buffer, Z_STRVAL_P(value), Z_STRLEN_P(value));
         }
         else
         {
-            length = snprintf(message, sizeof(message), "+%s\r\n", "OK");
+            swRedis_reply_status(format_buffer, SW_STRL("OK") - 1);
         }
-        SW_RETURN_STRINGL(message, length, 1);
     }
     else if (type == SW_REDIS_REPLY_ERROR)
     {
         if (value)
         {
             convert_to_string(value);
-            length = snprintf(message, sizeof(message), "-%*s\r\n", Z_STRLEN_P(value), Z_STRVAL_P(value));
+            swRedis_reply_error(format_buffer, Z_STRVAL_P(value), Z_STRLEN_P(value));
         }
         else
         {
-            length = snprintf(message, sizeof(message), "-%s\r\n", "ERR");
+            swRedis_reply_error(format_buffer, SW_STRL("ERR") - 1);
         }
-        SW_RETURN_STRINGL(message, length, 1);
     }
     else if (type == SW_REDIS_REPLY_INT)
     {
@@ -355,10 +399,8 @@ static PHP_METHOD(swoole_redis_server, format)
         {
             goto no_value;
         }
-
         convert_to_long(value);
-        length = snprintf(message, sizeof(message), ":%d\r\n", Z_LVAL_P(value));
-        SW_RETURN_STRINGL(message, length, 1);
+        swRedis_reply_int(format_buffer, Z_LVAL_P(value));
     }
     else if (type == SW_REDIS_REPLY_STRING)
     {
@@ -374,12 +416,7 @@ static PHP_METHOD(swoole_redis_server, format)
             swoole_php_fatal_error(E_WARNING, "invalid string size.");
             RETURN_FALSE;
         }
-        swString_clear(format_buffer);
-        length = snprintf(message, sizeof(message), "$%d\r\n", Z_STRLEN_P(value));
-        swString_append_ptr(format_buffer, message, length);
-        swString_append_ptr(format_buffer, Z_STRVAL_P(value), Z_STRLEN_P(value));
-        swString_append_ptr(format_buffer, SW_CRLF, SW_CRLF_LEN);
-        SW_RETURN_STRINGL(format_buffer->str, format_buffer->length, 1);
+        swRedis_reply_string(format_buffer, Z_STRVAL_P(value), Z_STRLEN_P(value));
     }
     else if (type == SW_REDIS_REPLY_SET)
     {
@@ -390,10 +427,9 @@ static PHP_METHOD(swoole_redis_server, format)
         if (Z_TYPE_P(value) != IS_ARRAY)
         {
             swoole_php_fatal_error(E_WARNING, "parameters 2 must be array.");
+            RETURN_FALSE;
         }
-        swString_clear(format_buffer);
-        length = snprintf(message, sizeof(message), "*%d\r\n", zend_hash_num_elements(Z_ARRVAL_P(value)));
-        swString_append_ptr(format_buffer, message, length);
+        swRedis_reply_array(format_buffer, zend_hash_num_elements(Z_ARRVAL_P(value)));
 
         SW_HASHTABLE_FOREACH_START(Z_ARRVAL_P(value), item)
 #if PHP_MAJOR_VERSION >= 7
@@ -406,10 +442,7 @@ static PHP_METHOD(swoole_redis_server, format)
             }
 #endif
             convert_to_string(item);
-            length = snprintf(message, sizeof(message), "$%d\r\n", Z_STRLEN_P(item));
-            swString_append_ptr(format_buffer, message, length);
-            swString_append_ptr(format_buffer, Z_STRVAL_P(item), Z_STRLEN_P(item));
-            swString_append_ptr(format_buffer, SW_CRLF, SW_CRLF_LEN);
+            swRedis_reply_string(format_buffer, Z_STRVAL_P(item), Z_STRLEN_P(item));
 #if PHP_MAJOR_VERSION >= 7
             if (item == &_copy)
             {
@@ -417,8 +450,6 @@ static PHP_METHOD(swoole_redis_server, format)
             }
 #endif
         SW_HASHTABLE_FOREACH_END();
-
-        SW_RETURN_STRINGL(format_buffer->str, format_buffer->length, 1);
     }
     else if (type == SW_REDIS_REPLY_MAP)
     {
@@ -429,10 +460,9 @@ static PHP_METHOD(swoole_redis_server, format)
         if (Z_TYPE_P(value) != IS_ARRAY)
         {
             swoole_php_fatal_error(E_WARNING, "parameters 2 must be array.");
+            RETURN_FALSE;
         }
-        swString_clear(format_buffer);
-        length = snprintf(message, sizeof(message), "*%d\r\n", 2 * zend_hash_num_elements(Z_ARRVAL_P(value)));
-        swString_append_ptr(format_buffer, message, length);
+        swRedis_reply_array(format_buffer, 2 * zend_hash_num_elements(Z_ARRVAL_P(value)));
 
         char *key;
         uint32_t keylen;
@@ -452,11 +482,9 @@ static PHP_METHOD(swoole_redis_server, format)
                 item = &_copy;
             }
 #endif
-            length = snprintf(message, sizeof(message), "$%d\r\n%s\r\n$%d\r\n", keylen, key, Z_STRLEN_P(item));
-            swString_append_ptr(format_buffer, message, length);
-            swString_append_ptr(format_buffer, Z_STRVAL_P(item), Z_STRLEN_P(item));
-            swString_append_ptr(format_buffer, SW_CRLF, SW_CRLF_LEN);
-
+            convert_to_string(item);
+            swRedis_reply_string(format_buffer, key, keylen);
+            swRedis_reply_string(format_buffer, Z_STRVAL_P(item), Z_STRLEN_P(item));
 #if PHP_MAJOR_VERSION >= 7
             if (item == &_copy)
             {
@@ -465,12 +493,12 @@ static PHP_METHOD(swoole_redis_server, format)
 #endif
             (void) keytype;
         SW_HASHTABLE_FOREACH_END();
-
-        SW_RETURN_STRINGL(format_buffer->str, format_buffer->length, 1);
     }
     else
     {
         swoole_php_error(E_WARNING, "Unknown type[%ld]", type);
         RETURN_FALSE;
     }
+
+    SW_RETURN_STRINGL(format_buffer->str, format_buffer->length, 1);
 }
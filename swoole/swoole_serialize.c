@@ -31,7 +31,7 @@ ZEND_ARG_INFO (0, args)
 ZEND_END_ARG_INFO ()
 
 static void swoole_serialize_object (seriaString *buffer, zval *zvalue, size_t start);
-static void swoole_serialize_arr (seriaString *buffer, zend_array *zvalue);
+static void swoole_serialize_arr (seriaString *buffer, zend_array *zvalue, zend_uchar values_only);
 static void* swoole_unserialize_arr (void *buffer, zval *zvalue, uint32_t num);
 static void* swoole_unserialize_object (void *buffer, zval *return_value, zend_uchar bucket_len, zval *args);
 
@@ -59,8 +59,11 @@ void swoole_serialize_init (int module_number TSRMLS_DC)
 
     memset (&swSeriaG.filter, 0, sizeof (swSeriaG.filter));
     memset (&mini_filter, 0, sizeof (mini_filter));
+    memset (&unser_pool, 0, sizeof (unser_pool));
+    swSeriaG.pack_schema = 1;
 
     REGISTER_LONG_CONSTANT ("SWOOLE_FAST_PACK", SW_FAST_PACK, CONST_CS | CONST_PERSISTENT);
+    REGISTER_LONG_CONSTANT ("SWOOLE_PACK_NO_SCHEMA", SW_PACK_NO_SCHEMA, CONST_CS | CONST_PERSISTENT);
 }
 
 static CPINLINE int swoole_string_new (size_t size, seriaString *str, zend_uchar type)
@@ -321,6 +324,137 @@ static CPINLINE swPoolstr* swoole_mini_filter_find (zend_string *zstr)
     }
 }
 
+/*
+ * schema
+ */
+static CPINLINE void swoole_schema_clear (swSeriaSchema *schemas, uint32_t *num)
+{
+    uint32_t i, j;
+    for (i = 0; i < *num; i++)
+    {
+        for (j = 0; j < schemas[i].num; j++)
+        {
+            zend_string_release (schemas[i].props[j].key);
+        }
+        if (schemas[i].props)
+        {
+            efree (schemas[i].props);
+        }
+    }
+    *num = 0;
+}
+
+/*
+ * only string keys and no unset declared property, the values are packed in the same order
+ */
+static int swoole_schema_init (swSeriaSchema *schema, zend_class_entry *ce, zend_array *props)
+{
+    zend_string *key;
+    zval *value;
+    uint32_t i = 0;
+
+    ZEND_HASH_FOREACH_STR_KEY_VAL (props, key, value)
+    {
+        if (!key || (Z_TYPE_P (value) == IS_INDIRECT && Z_TYPE_P (Z_INDIRECT_P (value)) == IS_UNDEF))
+        {
+            return 0;
+        }
+    }
+    ZEND_HASH_FOREACH_END ();
+
+    schema->ce = ce;
+    schema->num = zend_hash_num_elements (props);
+    schema->props = schema->num ? emalloc (sizeof (swSeriaProp) * schema->num) : NULL;
+
+    ZEND_HASH_FOREACH_STR_KEY (props, key)
+    {
+        const char *class_name;
+        schema->props[i].key = zend_string_copy (key);
+        //hashed once, every object of the schema is looked up with it
+        zend_string_hash_val (schema->props[i].key);
+        zend_unmangle_property_name_ex (key, &class_name, &schema->props[i].name, &schema->props[i].name_len);
+        i++;
+    }
+    ZEND_HASH_FOREACH_END ();
+
+    return 1;
+}
+
+static CPINLINE swSeriaSchema* swoole_schema_find (zend_class_entry *ce)
+{
+    uint32_t i;
+    for (i = 0; i < pack_schema_num; i++)
+    {
+        if (pack_schema[i].ce == ce)
+        {
+            return &pack_schema[i];
+        }
+    }
+    return NULL;
+}
+
+static CPINLINE int swoole_schema_match (swSeriaSchema *schema, zend_array *props)
+{
+    zend_string *key;
+    zval *value;
+    uint32_t i = 0;
+
+    if (zend_hash_num_elements (props) != schema->num)
+    {
+        return 0;
+    }
+    ZEND_HASH_FOREACH_STR_KEY_VAL (props, key, value)
+    {
+        //declared properties share the interned name with the class
+        if (!key || (key != schema->props[i].key && !zend_string_equals (key, schema->props[i].key)))
+        {
+            return 0;
+        }
+        if (Z_TYPE_P (value) == IS_INDIRECT && Z_TYPE_P (Z_INDIRECT_P (value)) == IS_UNDEF)
+        {
+            return 0;
+        }
+        i++;
+    }
+    ZEND_HASH_FOREACH_END ();
+    return 1;
+}
+
+/*
+ * unpack string pool, a string referenced again by offset is shared instead of copied
+ */
+static CPINLINE uint32_t swoole_unser_pool_slot (uint32_t offset)
+{
+    return (offset * 2654435761u) >> (32 - 10) & (FILTER_SIZE - 1);
+}
+
+static CPINLINE void swoole_unser_pool_add (uint32_t offset, zend_string *str)
+{
+    uint32_t slot = swoole_unser_pool_slot (offset);
+    if (unser_pool[slot].str)
+    {
+        zend_string_release (unser_pool[slot].str);
+    }
+    else
+    {
+        unser_pool_slots[unser_pool_num++] = slot;
+    }
+    unser_pool[slot].str = zend_string_copy (str);
+    unser_pool[slot].offset = offset;
+}
+
+static CPINLINE void swoole_unser_pool_clear ()
+{
+    uint32_t i, slot;
+    for (i = 0; i < unser_pool_num; i++)
+    {
+        slot = unser_pool_slots[i];
+        zend_string_release (unser_pool[slot].str);
+        unser_pool[slot].str = NULL;
+    }
+    unser_pool_num = 0;
+}
+
 /*
  * arr layout
  * type|key?|bucketlen|buckets
@@ -367,7 +501,7 @@ static CPINLINE void* get_array_real_len (void *buffer, zend_uchar data_len, uin
     }
 }
 
-static CPINLINE void * get_pack_string_len_addr (void ** buffer, size_t *strlen)
+static CPINLINE void * get_pack_string_len_addr (void ** buffer, size_t *strlen, uint32_t *offset)
 {
 
     uint8_t overhead = (*(uint8_t*) * buffer);
@@ -387,6 +521,7 @@ static CPINLINE void * get_pack_string_len_addr (void ** buffer, size_t *strlen)
         (*buffer) += 2;
     }
     void *str_pool_addr = unser_start + real_offset;
+    *offset = real_offset;
     if (len_byte == 1)
     {
         *strlen = *((zend_uchar*) str_pool_addr);
@@ -406,6 +541,24 @@ static CPINLINE void * get_pack_string_len_addr (void ** buffer, size_t *strlen)
     return str_pool_addr;
 }
 
+/*
+ * string referenced by offset, share the one created before
+ */
+static CPINLINE zend_string* swoole_unserialize_pool_string (void **buffer)
+{
+    size_t len;
+    uint32_t offset;
+    void *str_pool_addr = get_pack_string_len_addr (buffer, &len, &offset);
+    swPoolstr *pooled = &unser_pool[swoole_unser_pool_slot (offset)];
+    if (pooled->str && pooled->offset == offset)
+    {
+        return zend_string_copy (pooled->str);
+    }
+    zend_string *str = zend_string_init ((char*) str_pool_addr, len, 0);
+    swoole_unser_pool_add (offset, str);
+    return str;
+}
+
 /*
  * array
  */
@@ -461,13 +614,12 @@ static void* swoole_unserialize_arr (void *buffer, zval *zvalue, uint32_t nNumOf
             size_t key_len;
             if (type.key_len == 3)
             {//read the same mem 
-                void *str_pool_addr = get_pack_string_len_addr (&buffer, &key_len);
-                p->key = zend_string_init ((char*) str_pool_addr, key_len, 0);
-                h = zend_inline_hash_func ((char*) str_pool_addr, key_len);
-                p->key->h = p->h = h;
+                p->key = swoole_unserialize_pool_string (&buffer);
+                h = p->h = zend_string_hash_val (p->key);
             }
             else
             {//move step
+                uint32_t key_offset = buffer - unser_start;
                 if (type.key_len == 1)
                 {
                     key_len = *((zend_uchar*) buffer);
@@ -484,10 +636,9 @@ static void* swoole_unserialize_arr (void *buffer, zval *zvalue, uint32_t nNumOf
                     buffer += sizeof (size_t);
                 }
                 p->key = zend_string_init ((char*) buffer, key_len, 0);
-                //           h = zend_inline_hash_func((char*) buffer, key_len);
-                h = zend_inline_hash_func ((char*) buffer, key_len);
+                h = p->h = zend_string_hash_val (p->key);
                 buffer += key_len;
-                p->key->h = p->h = h;
+                swoole_unser_pool_add (key_offset, p->key);
             }
         }
         else
@@ -540,11 +691,11 @@ static void* swoole_unserialize_arr (void *buffer, zval *zvalue, uint32_t nNumOf
             size_t data_len;
             if (type.data_len == 3)
             {//read the same mem
-                void *str_pool_addr = get_pack_string_len_addr (&buffer, &data_len);
-                p->val.value.str = zend_string_init ((char*) str_pool_addr, data_len, 0);
+                p->val.value.str = swoole_unserialize_pool_string (&buffer);
             }
             else
             {
+                uint32_t data_offset = buffer - unser_start;
                 if (type.data_len == 1)
                 {
                     data_len = *((zend_uchar*) buffer);
@@ -562,6 +713,7 @@ static void* swoole_unserialize_arr (void *buffer, zval *zvalue, uint32_t nNumOf
                 }
                 p->val.value.str = zend_string_init ((char*) buffer, data_len, 0);
                 buffer += data_len;
+                swoole_unser_pool_add (data_offset, p->val.value.str);
             }
             Z_TYPE_INFO (p->val) = IS_STRING_EX;
         }
@@ -596,8 +748,9 @@ static void* swoole_unserialize_arr (void *buffer, zval *zvalue, uint32_t nNumOf
 /*
  * arr layout
  * type|key?|bucketlen|buckets
+ * values_only: the keys are known by the reader (object schema)
  */
-static void swoole_serialize_arr (seriaString *buffer, zend_array *zvalue)
+static void swoole_serialize_arr (seriaString *buffer, zend_array *zvalue, zend_uchar values_only)
 {
     zval *data;
     zend_string *key;
@@ -612,7 +765,7 @@ static void swoole_serialize_arr (seriaString *buffer, zend_array *zvalue)
         //start point
         size_t p = buffer->offset;
 
-        if (is_pack && zvalue->nNextFreeElement == zvalue->nNumOfElements)
+        if (values_only || (is_pack && zvalue->nNextFreeElement == zvalue->nNumOfElements))
         {
             type.key_type = KEY_TYPE_INDEX;
             type.key_len = 0;
@@ -759,12 +912,12 @@ try_again:
                 if (ZEND_HASH_APPLY_PROTECTION (ht))
                 {
                     ZEND_HASH_INC_APPLY_COUNT (ht);
-                    swoole_serialize_arr (buffer, ht);
+                    swoole_serialize_arr (buffer, ht, 0);
                     ZEND_HASH_DEC_APPLY_COUNT (ht);
                 }
                 else
                 {
-                    swoole_serialize_arr (buffer, ht);
+                    swoole_serialize_arr (buffer, ht, 0);
                 }
 
             }
@@ -848,10 +1001,14 @@ static CPINLINE void swoole_serialize_raw (seriaString *buffer, zval *zvalue)
 /*
  * obj layout
  * type|bucket key|name len| name| buket len |buckets
+ * type|bucket key|0|SCHEMA_DEFINE|name len| name| buket len |buckets
+ * type|bucket key|0|SCHEMA_REF|schema id|values
  */
 static void swoole_serialize_object (seriaString *buffer, zval *obj, size_t start)
 {
     zend_string *name = Z_OBJCE_P (obj)->name;
+    zend_class_entry *ce = Z_OBJ_P (obj)->ce;
+    zend_uchar has_sleep = ce && zend_hash_exists (&ce->function_table, Z_STR (swSeriaG.sleep_fname));
     if (ZEND_HASH_GET_APPLY_COUNT (Z_OBJPROP_P (obj)) > 1)
     {
         zend_throw_exception_ex (NULL, 0, "the object %s have cycle ref!", name->val);
@@ -863,12 +1020,33 @@ static void swoole_serialize_object (seriaString *buffer, zval *obj, size_t star
     }
     else
     {
+        if (swSeriaG.pack_schema && !has_sleep)
+        {
+            zend_uchar op = 0;
+            swSeriaSchema *schema = swoole_schema_find (ce);
+            if (schema && swoole_schema_match (schema, Z_OBJPROP_P (obj)))
+            {
+                op = SCHEMA_REF;
+                SERIA_SET_ENTRY_SHORT (buffer, 0);
+                SERIA_SET_ENTRY_TYPE (buffer, op);
+                SERIA_SET_ENTRY_SHORT (buffer, schema - pack_schema);
+                swoole_serialize_arr (buffer, Z_OBJPROP_P (obj), 1);
+                return;
+            }
+            //the first shape of a class becomes its schema, ids are given in the order the objects are written
+            if (!schema && pack_schema_num < SCHEMA_SIZE && swoole_schema_init (&pack_schema[pack_schema_num], ce, Z_OBJPROP_P (obj)))
+            {
+                pack_schema_num++;
+                op = SCHEMA_DEFINE;
+                SERIA_SET_ENTRY_SHORT (buffer, 0);
+                SERIA_SET_ENTRY_TYPE (buffer, op);
+            }
+        }
         SERIA_SET_ENTRY_SHORT (buffer, name->len);
         swoole_string_cpy (buffer, name->val, name->len);
     }
 
-    zend_class_entry *ce = Z_OBJ_P (obj)->ce;
-    if (ce && zend_hash_exists (&ce->function_table, Z_STR (swSeriaG.sleep_fname)))
+    if (has_sleep)
     {
         zval retval;
         if (call_user_function_ex (NULL, obj, &swSeriaG.sleep_fname, &retval, 0, 0, 1, NULL) == SUCCESS)
@@ -931,7 +1109,7 @@ static void swoole_serialize_object (seriaString *buffer, zval *obj, size_t star
 
                 }
                 seria_array_type (ht, buffer, start, buffer->offset);
-                swoole_serialize_arr (buffer, ht);
+                swoole_serialize_arr (buffer, ht, 0);
                 ZSTR_ALLOCA_FREE (ht_addr, use_heap);
                 zval_dtor (&retval);
                 return;
@@ -947,7 +1125,7 @@ static void swoole_serialize_object (seriaString *buffer, zval *obj, size_t star
         }
     }
     seria_array_type (Z_OBJPROP_P (obj), buffer, start, buffer->offset);
-    swoole_serialize_arr (buffer, Z_OBJPROP_P (obj));
+    swoole_serialize_arr (buffer, Z_OBJPROP_P (obj), 0);
     //    printf("hash2 %u\n",ce->properties_info.arData[0].key->h);
 }
 
@@ -1005,16 +1183,114 @@ static CPINLINE zend_class_entry* swoole_try_get_ce (zend_string *class_name)
     }
 }
 
+/*
+ * write a property by its mangled name, a private property of a parent class stays private
+ * and lands in its declared slot, no name is allocated or hashed again
+ */
+static CPINLINE void swoole_unserialize_prop (HashTable *props, zend_string *key, zval *data)
+{
+    zval *slot = zend_hash_find (props, key);
+
+    if (!slot)
+    {
+        Z_TRY_ADDREF_P (data);
+        zend_hash_add_new (props, key, data);
+        return;
+    }
+    if (Z_TYPE_P (slot) == IS_INDIRECT)
+    {
+        slot = Z_INDIRECT_P (slot);
+    }
+    zval_ptr_dtor (slot);
+    ZVAL_COPY (slot, data);
+}
+
+static CPINLINE void swoole_unserialize_wakeup (zend_class_entry *ce, zval *return_value)
+{
+    //call object __wakeup
+    if (zend_hash_str_exists (&ce->function_table, "__wakeup", sizeof ("__wakeup") - 1))
+    {
+        zval ret, wakeup;
+        zend_string *fname = swoole_string_init ("__wakeup", sizeof ("__wakeup") - 1);
+        Z_STR (wakeup) = fname;
+        Z_TYPE_INFO (wakeup) = IS_STRING_EX;
+        call_user_function_ex (CG (function_table), return_value, &wakeup, &ret, 0, NULL, 1, NULL);
+        swoole_string_release (fname);
+        zval_ptr_dtor (&ret);
+    }
+}
+
+/*
+ * obj layout
+ * type| key[0|1] |0|SCHEMA_REF|schema id|values
+ * the class and the property names come from the schema
+ */
+static void* swoole_unserialize_schema_object (void *buffer, zval *return_value)
+{
+    zval values;
+    zval *data;
+    uint32_t i = 0;
+    uint32_t id = *((unsigned short*) buffer);
+    buffer += 2;
+
+    if (id >= unser_schema_num || !unser_schema[id].ce)
+    {
+        php_error_docref (NULL TSRMLS_CC, E_NOTICE, "illegal unserialize data");
+        return NULL;
+    }
+    swSeriaSchema *schema = &unser_schema[id];
+
+    buffer = swoole_unserialize_arr (buffer, &values, schema->num);
+    if (!buffer)
+    {
+        return NULL;
+    }
+
+    object_init_ex (return_value, schema->ce);
+    HashTable *props = Z_OBJPROP_P (return_value);
+    ZEND_HASH_FOREACH_VAL (Z_ARRVAL (values), data)
+    {
+        swoole_unserialize_prop (props, schema->props[i].key, data);
+        i++;
+    }
+    ZEND_HASH_FOREACH_END ();
+    zval_dtor (&values);
+
+    swoole_unserialize_wakeup (schema->ce, return_value);
+    return buffer;
+}
+
 /*
  * obj layout
  * type| key[0|1] |name len| name| buket len |buckets
+ * type| key[0|1] |0|SCHEMA_DEFINE|name len| name| buket len |buckets
  */
 static void* swoole_unserialize_object (void *buffer, zval *return_value, zend_uchar bucket_len, zval *args)
 {
     zval property;
     uint32_t arr_num = 0;
+    zend_uchar op = 0;
     size_t name_len = *((unsigned short*) buffer);
     buffer += 2;
+    //class name is never empty
+    if (name_len == 0)
+    {
+        op = *((zend_uchar*) buffer);
+        buffer += 1;
+        if (op == SCHEMA_REF)
+        {
+            return swoole_unserialize_schema_object (buffer, return_value);
+        }
+        name_len = *((unsigned short*) buffer);
+        buffer += 2;
+    }
+    //take the id before the properties, which can define schemas of their own
+    swSeriaSchema *schema = NULL;
+    if (op == SCHEMA_DEFINE && unser_schema_num < SCHEMA_SIZE)
+    {
+        schema = &unser_schema[unser_schema_num++];
+        memset (schema, 0, sizeof (swSeriaSchema));
+    }
     zend_string *class_name = swoole_string_init ((char*) buffer, name_len);
     buffer += name_len;
 
@@ -1029,6 +1305,11 @@ static void* swoole_unserialize_object (void *buffer, zval *return_value, zend_u
     buffer = get_array_real_len (buffer, bucket_len, &arr_num);
     buffer = swoole_unserialize_arr (buffer, &property, arr_num);
 
+    if (op == SCHEMA_DEFINE && (!schema || !swoole_schema_init (schema, ce, Z_ARRVAL (property))))
+    {
+        php_error_docref (NULL TSRMLS_CC, E_NOTICE, "illegal unserialize data");
+    }
+
     object_init_ex (return_value, ce);
 
     zval *data;
@@ -1037,12 +1318,9 @@ static void* swoole_unserialize_object (void *buffer, zval *return_value, zend_u
 
     ZEND_HASH_FOREACH_KEY_VAL (Z_ARRVAL (property), index, key, data)
     {
-        const char *prop_name, *tmp;
-        size_t prop_len;
         if (key)
         {
-            zend_unmangle_property_name_ex (key, &tmp, &prop_name, &prop_len);
-            zend_update_property (ce, return_value, prop_name, prop_len, data);
+            swoole_unserialize_prop (Z_OBJPROP_P (return_value), (zend_string *) key, data);
         }
         else
         {
@@ -1082,17 +1360,7 @@ static void* swoole_unserialize_object (void *buffer, zval *return_value, zend_u
     }
 
 
-    //call object __wakeup
-    if (zend_hash_str_exists (&ce->function_table, "__wakeup", sizeof ("__wakeup") - 1))
-    {
-        zval ret, wakeup;
-        zend_string *fname = swoole_string_init ("__wakeup", sizeof ("__wakeup") - 1);
-        Z_STR (wakeup) = fname;
-        Z_TYPE_INFO (wakeup) = IS_STRING_EX;
-        call_user_function_ex (CG (function_table), return_value, &wakeup, &ret, 0, NULL, 1, NULL);
-        swoole_string_release (fname);
-        zval_ptr_dtor (&ret);
-    }
+    swoole_unserialize_wakeup (ce, return_value);
 
     return buffer;
 
@@ -1126,7 +1394,7 @@ again:
     case IS_ARRAY:
     {
         seria_array_type (Z_ARRVAL_P (zvalue), buffer, _STR_HEADER_SIZE, _STR_HEADER_SIZE + 1);
-        swoole_serialize_arr (buffer, Z_ARRVAL_P (zvalue));
+        swoole_serialize_arr (buffer, Z_ARRVAL_P (zvalue), 0);
         swoole_mini_filter_clear ();
         break;
     }
@@ -1155,6 +1423,7 @@ PHPAPI zend_string* php_swoole_serialize (zval *zvalue)
     seriaString str;
     swoole_string_new (SERIA_SIZE, &str, Z_TYPE_P (zvalue));
     swoole_seria_dispatch (&str, zvalue); //serialize into a string
+    swoole_schema_clear (pack_schema, &pack_schema_num);
     zend_string *z_str = (zend_string *) str.buffer;
 
     z_str->val[str.offset] = '\0';
@@ -1213,6 +1482,8 @@ PHPAPI int php_swoole_unserialize (void *buffer, size_t len, zval *return_value,
         php_error_docref (NULL TSRMLS_CC, E_NOTICE, "swoole serialize not support this type ");
         return SW_FALSE;
     }
+    swoole_schema_clear (unser_schema, &unser_schema_num);
+    swoole_unser_pool_clear ();
 
     return SW_TRUE;
 }
@@ -1220,14 +1491,17 @@ PHPAPI int php_swoole_unserialize (void *buffer, size_t len, zval *return_value,
 static PHP_METHOD (swoole_serialize, pack)
 {
     zval *zvalue;
-    zend_size_t is_fast = 0;
+    zend_size_t flag = 0;
 
-    if (zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "z|l", &zvalue, &is_fast) == FAILURE)
+    if (zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "z|l", &zvalue, &flag) == FAILURE)
     {
         RETURN_FALSE;
     }
-    swSeriaG.pack_string = !is_fast;
+    swSeriaG.pack_string = !(flag & SW_FAST_PACK);
+    //SWOOLE_PACK_NO_SCHEMA keeps the output readable by the unpack without schema support
+    swSeriaG.pack_schema = !(flag & SW_PACK_NO_SCHEMA);
     zend_string *z_str = php_swoole_serialize (zvalue);
+    swSeriaG.pack_schema = 1;
 
     RETURN_STR (z_str);
 }
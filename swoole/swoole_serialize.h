@@ -25,6 +25,7 @@ extern "C"
 
 #define SERIA_SIZE 1024
 #define FILTER_SIZE 1024
+#define SCHEMA_SIZE 256
 
 typedef struct _seriaString
 {
@@ -53,9 +54,28 @@ struct _swSeriaG
     zval sleep_fname;
     zval weekup_fname;
     zend_uchar pack_string;
+    zend_uchar pack_schema;
     struct _swMinFilter filter;
 };
 
+typedef struct _swSeriaProp
+{
+    zend_string *key; //mangled name in the property table
+    const char *name; //unmangled name, points into key
+    size_t name_len;
+} swSeriaProp;
+
+/*
+ * the class and the property names of an object shape,
+ * objects with the same shape are packed as schema id + values
+ */
+typedef struct _swSeriaSchema
+{
+    zend_class_entry *ce;
+    uint32_t num;
+    swSeriaProp *props;
+} swSeriaSchema;
+
 #pragma pack (4)
 
 typedef struct _swPoolstr
@@ -72,6 +92,16 @@ static void *unser_start = 0;
 static swPoolstr mini_filter[FILTER_SIZE];
 static swPoolstr *bigger_filter = NULL;
 
+static swSeriaSchema pack_schema[SCHEMA_SIZE];
+static uint32_t pack_schema_num = 0;
+static swSeriaSchema unser_schema[SCHEMA_SIZE];
+static uint32_t unser_schema_num = 0;
+
+//strings already created by unpack, keyed by their offset in the packed data
+static swPoolstr unser_pool[FILTER_SIZE];
+static uint16_t unser_pool_slots[FILTER_SIZE];
+static uint32_t unser_pool_num = 0;
+
 #define SERIA_SET_ENTRY_TYPE_WITH_MINUS(buffer,type)        swoole_check_size(buffer, 1);\
                                                         *(char*) (buffer->buffer + buffer->offset) = *((char*) & type);\
                                                         buffer->offset += 1;
@@ -106,7 +136,14 @@ static swPoolstr *bigger_filter = NULL;
 #define KEY_TYPE_STRING               1
 #define KEY_TYPE_INDEX                0
 
+/*
+ * an object whose class name length is 0 is followed by one of these
+ */
+#define SCHEMA_DEFINE                 1
+#define SCHEMA_REF                    2
+
 #define SW_FAST_PACK                  1
+#define SW_PACK_NO_SCHEMA             2
 
 #endif
 
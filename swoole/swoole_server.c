@@ -37,13 +37,68 @@ static struct
 } server_port_list;
 
 zval *php_sw_server_callbacks[PHP_SERVER_CALLBACK_NUM];
-static swHashMap *task_callbacks;
+static swFlatMap *task_callbacks;
 
 #if PHP_MAJOR_VERSION >= 7
 zval _php_sw_server_callbacks[PHP_SERVER_CALLBACK_NUM];
 #endif
 
+/**
+ * dispatch_mode = SW_DISPATCH_LEASTREQ, the real callbacks are wrapped to release the in-flight counter
+ */
+static struct
+{
+    int (*onReceive)(swServer *, swEventData *);
+    int (*onPacket)(swServer *, swEventData *);
+    void (*onConnect)(swServer *, swDataHead *);
+    void (*onClose)(swServer *, swDataHead *);
+} leastreq_callbacks;
+
+/**
+ * enable_stats, the callbacks are wrapped to count the requests, their latency and the bytes sent
+ */
+static struct
+{
+    int (*onReceive)(swServer *, swEventData *);
+    int (*onPacket)(swServer *, swEventData *);
+    int (*finish)(swFactory *, swSendData *);
+    void (*onManagerStart)(swServer *);
+} stats_callbacks;
+
+/**
+ * heartbeat_check_interval in SW_MODE_BASE, the callbacks are wrapped to keep the idle wheel of the worker,
+ * a timer of the worker expires it
+ */
+static struct
+{
+    void (*onConnect)(swServer *, swDataHead *);
+    void (*onClose)(swServer *, swDataHead *);
+} heartbeat_callbacks;
+
+/**
+ * cpu_affinity_numa, the reactor threads are placed when the master starts
+ */
+static struct
+{
+    void (*onStart)(swServer *);
+} affinity_callbacks;
+
+/**
+ * pipe_ring, the reactor threads write the stream events into the ring of the worker
+ */
+static struct
+{
+    int (*dispatch)(swFactory *, swDispatchData *);
+} pipe_ring_callbacks;
+
 static int php_swoole_task_finish(swServer *serv, zval *data TSRMLS_DC);
+static void php_swoole_leastreq_wrap(swServer *serv);
+static void php_swoole_stats_wrap(swServer *serv);
+static void php_swoole_heartbeat_wrap(swServer *serv);
+static void php_swoole_heartbeat_onTimeout(swTimer_node *tnode, void *data);
+static void php_swoole_affinity_wrap(swServer *serv);
+static void php_swoole_pipe_ring_wrap(swServer *serv);
+static int php_swoole_pipe_ring_onRead(swReactor *reactor, swEvent *event);
 static void php_swoole_onPipeMessage(swServer *serv, swEventData *req);
 static void php_swoole_onStart(swServer *);
 static void php_swoole_onShutdown(swServer *);
@@ -112,7 +167,9 @@ int php_swoole_task_pack(swEventData *task, zval *data TSRMLS_DC)
 
     if (task_data_len >= SW_IPC_MAX_SIZE - sizeof(task->info))
     {
-        if (swTaskWorker_large_pack(task, task_data_str, task_data_len) < 0)
+        //shared arena first, tmpfile when it is full
+        if (swTaskWorker_arena_pack(task, task_data_str, task_data_len) < 0
+                && swTaskWorker_large_pack(task, task_data_str, task_data_len) < 0)
         {
             swoole_php_fatal_error(E_WARNING, "large task pack failed().");
             task->info.fd = SW_ERR;
@@ -258,7 +315,7 @@ zval* php_swoole_task_unpack(swEventData *task_result TSRMLS_DC)
     /**
      * Large result package
      */
-    if (swTask_type(task_result) & SW_TASK_TMPFILE)
+    if (swTask_type(task_result) & (SW_TASK_TMPFILE | SW_TASK_SHM))
     {
         large_packet = swTaskWorker_large_unpack(task_result);
         /**
@@ -352,6 +409,17 @@ void php_swoole_server_before_start(swServer *serv, zval *zobject TSRMLS_DC)
         swoole_php_fatal_error(E_ERROR, "create server failed. Error: %s", sw_error);
         return;
     }
+    /**
+     * shared by the workers and task workers, so it must exist before fork
+     */
+    if (SwooleG.task_worker_num > 0 && SwooleG.task_arena == NULL)
+    {
+        SwooleG.task_arena = swSlab_new(SW_TASK_ARENA_SIZE, 1);
+        if (SwooleG.task_arena == NULL)
+        {
+            swoole_php_fatal_error(E_WARNING, "create task arena failed, large tasks use tmpfile.");
+        }
+    }
 
     swTrace("Create swoole_server host=%s, port=%d, mode=%d, type=%d", serv->listen_list->host, (int) serv->listen_list->port, serv->factory_mode, (int) serv->listen_list->type);
 
@@ -405,6 +473,380 @@ void php_swoole_server_before_start(swServer *serv, zval *zobject TSRMLS_DC)
             }
         }
     }
+
+    /**
+     * nothing is dispatched in SWOOLE_BASE mode, the worker that accepts a connection handles all of it
+     */
+    if (serv->dispatch_mode == SW_DISPATCH_LEASTREQ && serv->factory_mode != SW_MODE_PROCESS)
+    {
+        swoole_php_fatal_error(E_WARNING, "dispatch_mode=%d is ignored in SWOOLE_BASE mode.", SW_DISPATCH_LEASTREQ);
+        //stats() must not report in-flight requests
+        serv->dispatch_mode = SW_DISPATCH_FDMOD;
+    }
+    else if (serv->dispatch_mode == SW_DISPATCH_LEASTREQ)
+    {
+        /**
+         * like dispatch_mode = 1/3, onConnect/onClose may run in another worker than onReceive,
+         * and every dispatched notification would be counted as a request
+         */
+        if (!serv->enable_unsafe_event)
+        {
+            serv->onConnect = NULL;
+            serv->onClose = NULL;
+            serv->disable_notify = 1;
+        }
+        php_swoole_leastreq_wrap(serv);
+    }
+    /**
+     * in SW_MODE_BASE the worker accepts and closes its connections itself, onConnect/onClose and
+     * the heartbeat timer run in the process that owns the wheel.
+     * the reactor threads of SW_MODE_PROCESS scan connection_list.
+     */
+    if (serv->heartbeat_check_interval > 0 && serv->heartbeat_idle_time > 0 && serv->factory_mode == SW_MODE_BASE)
+    {
+        if (swServer_heartbeat_init(serv) < 0)
+        {
+            swoole_php_fatal_error(E_WARNING, "create idle wheels failed, heartbeat scans all connections.");
+        }
+        else
+        {
+            php_swoole_heartbeat_wrap(serv);
+        }
+    }
+    if (serv->open_cpu_affinity && serv->cpu_affinity_numa)
+    {
+        if (swServer_cpu_affinity_init(serv) < 0)
+        {
+            swoole_php_fatal_error(E_WARNING, "NUMA cpu placement failed, fall back to the cpu list.");
+        }
+        else
+        {
+            php_swoole_affinity_wrap(serv);
+        }
+    }
+    if (serv->enable_stats)
+    {
+        if (swServer_stats_init(serv) < 0)
+        {
+            swoole_php_fatal_error(E_WARNING, "create stats segment failed.");
+        }
+        else
+        {
+            php_swoole_stats_wrap(serv);
+        }
+    }
+    if (serv->enable_pipe_ring)
+    {
+        if (serv->factory_mode != SW_MODE_PROCESS)
+        {
+            swoole_php_fatal_error(E_WARNING, "pipe_ring is ignored, it only works in SWOOLE_PROCESS mode.");
+        }
+        else if (swServer_pipe_ring_init(serv) < 0)
+        {
+            swoole_php_fatal_error(E_WARNING, "create pipe rings failed, fall back to the unix socket.");
+        }
+        else
+        {
+            php_swoole_pipe_ring_wrap(serv);
+        }
+    }
+}
+
+/**
+ * in the master when swServer_start() returns, the workers are gone
+ */
+void php_swoole_server_after_stop(swServer *serv)
+{
+    swServer_heartbeat_free(serv);
+    swServer_stats_free(serv);
+    if (serv->stats_file)
+    {
+        free(serv->stats_file);
+        serv->stats_file = NULL;
+    }
+    swServer_cpu_affinity_free(serv);
+    swServer_pipe_ring_free(serv);
+}
+
+static int php_swoole_stats_onReceive(swServer *serv, swEventData *req)
+{
+    uint32_t length = swPackage_length(req);
+    uint32_t start = swServer_stats_usec();
+    int ret = stats_callbacks.onReceive(serv, req);
+    swServer_stats_request_end(serv, SwooleWG.id, start, length);
+    return ret;
+}
+
+static int php_swoole_stats_onPacket(swServer *serv, swEventData *req)
+{
+    uint32_t length = swPackage_length(req);
+    uint32_t start = swServer_stats_usec();
+    int ret = stats_callbacks.onPacket(serv, req);
+    swServer_stats_request_end(serv, SwooleWG.id, start, length);
+    return ret;
+}
+
+/**
+ * every response of the worker, from swoole_server::send() and the HTTP/WebSocket/Redis servers, goes through it
+ */
+static int php_swoole_stats_finish(swFactory *factory, swSendData *resp)
+{
+    int ret = stats_callbacks.finish(factory, resp);
+    if (ret == SW_OK && resp->info.type == SW_EVENT_TCP && swIsWorker())
+    {
+        swServer_stats_worker_send(SwooleG.serv, SwooleWG.id, resp->length > 0 ? resp->length : resp->info.len);
+    }
+    return ret;
+}
+
+static void php_swoole_stats_onFileTimeout(swTimer_node *tnode, void *data)
+{
+    swServer *serv = data;
+    swServer_stats_dump_file(serv, serv->stats_file, serv->stats_file_format);
+}
+
+static void php_swoole_stats_onManagerStart(swServer *serv)
+{
+    swServer_stats_dump_file(serv, serv->stats_file, serv->stats_file_format);
+    if (php_swoole_add_internal_timer(SW_STATS_FILE_INTERVAL, 1, php_swoole_stats_onFileTimeout, serv) < 0)
+    {
+        swWarn("cannot rewrite stats_file %s.", serv->stats_file);
+    }
+    if (stats_callbacks.onManagerStart)
+    {
+        stats_callbacks.onManagerStart(serv);
+    }
+}
+
+static void php_swoole_stats_wrap(swServer *serv)
+{
+    stats_callbacks.onReceive = serv->onReceive;
+    stats_callbacks.onPacket = serv->onPacket;
+    stats_callbacks.finish = serv->factory.finish;
+    stats_callbacks.onManagerStart = serv->onManagerStart;
+
+    if (serv->onReceive)
+    {
+        serv->onReceive = php_swoole_stats_onReceive;
+    }
+    if (serv->onPacket)
+    {
+        serv->onPacket = php_swoole_stats_onPacket;
+    }
+    serv->factory.finish = php_swoole_stats_finish;
+    //the manager dumps the stats for scrapers that cannot call stats() in a worker, worker#0 in SWOOLE_BASE
+    if (serv->stats_file && serv->factory_mode == SW_MODE_PROCESS)
+    {
+        serv->onManagerStart = php_swoole_stats_onManagerStart;
+    }
+}
+
+/**
+ * every dispatched event releases the counter exactly once, after its callback has returned
+ */
+static int php_swoole_leastreq_onReceive(swServer *serv, swEventData *req)
+{
+    int ret = leastreq_callbacks.onReceive(serv, req);
+    swServer_worker_request_end(serv, SwooleWG.id);
+    return ret;
+}
+
+static int php_swoole_leastreq_onPacket(swServer *serv, swEventData *req)
+{
+    int ret = leastreq_callbacks.onPacket(serv, req);
+    swServer_worker_request_end(serv, SwooleWG.id);
+    return ret;
+}
+
+static void php_swoole_leastreq_onConnect(swServer *serv, swDataHead *info)
+{
+    leastreq_callbacks.onConnect(serv, info);
+    swServer_worker_request_end(serv, SwooleWG.id);
+}
+
+static void php_swoole_leastreq_onClose(swServer *serv, swDataHead *info)
+{
+    //closed by the server itself, nothing was dispatched
+    swConnection *conn = swServer_connection_get(serv, info->fd);
+    int dispatched = conn == NULL || !conn->close_actively;
+
+    if (leastreq_callbacks.onClose)
+    {
+        leastreq_callbacks.onClose(serv, info);
+    }
+    if (dispatched)
+    {
+        swServer_worker_request_end(serv, SwooleWG.id);
+    }
+}
+
+static void php_swoole_leastreq_wrap(swServer *serv)
+{
+    leastreq_callbacks.onReceive = serv->onReceive;
+    leastreq_callbacks.onPacket = serv->onPacket;
+    leastreq_callbacks.onConnect = serv->onConnect;
+    leastreq_callbacks.onClose = serv->onClose;
+
+    if (serv->onReceive)
+    {
+        serv->onReceive = php_swoole_leastreq_onReceive;
+    }
+    //without onPacket the datagrams go to onReceive
+    if (serv->onPacket)
+    {
+        serv->onPacket = php_swoole_leastreq_onPacket;
+    }
+    //connect is only dispatched when there is a callback
+    if (serv->onConnect)
+    {
+        serv->onConnect = php_swoole_leastreq_onConnect;
+    }
+    //close is dispatched to clean up the session unless disable_notify is set
+    if (!serv->disable_notify)
+    {
+        serv->onClose = php_swoole_leastreq_onClose;
+    }
+}
+
+static void php_swoole_heartbeat_onConnect(swServer *serv, swDataHead *info)
+{
+    swConnection *conn = swServer_connection_get(serv, info->fd);
+    if (conn)
+    {
+        swServer_heartbeat_add(serv, conn);
+    }
+    if (heartbeat_callbacks.onConnect)
+    {
+        heartbeat_callbacks.onConnect(serv, info);
+    }
+}
+
+static void php_swoole_heartbeat_onClose(swServer *serv, swDataHead *info)
+{
+    swConnection *conn = swServer_connection_get(serv, info->fd);
+    if (conn)
+    {
+        swServer_heartbeat_del(serv, conn);
+    }
+    if (heartbeat_callbacks.onClose)
+    {
+        heartbeat_callbacks.onClose(serv, info);
+    }
+}
+
+static void php_swoole_heartbeat_wrap(swServer *serv)
+{
+    heartbeat_callbacks.onConnect = serv->onConnect;
+    heartbeat_callbacks.onClose = serv->onClose;
+
+    //connect must be notified even without a callback
+    serv->onConnect = php_swoole_heartbeat_onConnect;
+    //with disable_notify the slot is taken off the wheel by the next accept
+    if (!serv->disable_notify)
+    {
+        serv->onClose = php_swoole_heartbeat_onClose;
+    }
+}
+
+/**
+ * close the connections of the worker idle longer than heartbeat_idle_time
+ */
+static void php_swoole_heartbeat_onTimeout(swTimer_node *tnode, void *data)
+{
+    swServer *serv = data;
+    swConnection *conn;
+    uint32_t i;
+    int fd;
+
+    swArray *fds = swArray_new(1024, sizeof(int));
+    if (fds == NULL)
+    {
+        return;
+    }
+    swServer_heartbeat_expire(serv, SwooleWG.id, time(NULL), fds);
+    for (i = 0; i < fds->item_num; i++)
+    {
+        fd = *(int *) swArray_fetch(fds, i);
+        conn = &serv->connection_list[fd];
+        if (conn->active)
+        {
+            conn->close_force = 1;
+            serv->factory.end(&serv->factory, fd);
+        }
+    }
+    swArray_free(fds);
+}
+
+static void php_swoole_affinity_onStart(swServer *serv)
+{
+    int i;
+    for (i = 0; i < serv->reactor_num; i++)
+    {
+        swServer_cpu_affinity_reactor(serv, i);
+    }
+    if (affinity_callbacks.onStart)
+    {
+        affinity_callbacks.onStart(serv);
+    }
+}
+
+static void php_swoole_affinity_wrap(swServer *serv)
+{
+    //in SWOOLE_BASE mode the workers are the reactors, placed in onWorkerStart
+    if (serv->factory_mode != SW_MODE_BASE)
+    {
+        affinity_callbacks.onStart = serv->onStart;
+        serv->onStart = php_swoole_affinity_onStart;
+    }
+}
+
+/**
+ * all stream events of a connection take the ring, so they stay in order, UDP keeps the unix socket
+ */
+static int php_swoole_pipe_ring_dispatch(swFactory *factory, swDispatchData *task)
+{
+    swServer *serv = SwooleG.serv;
+    uint32_t target_worker_id;
+    swPipe *p;
+
+    if (!swEventData_is_stream(task->data.info.type) || task->target_worker_id >= serv->worker_num)
+    {
+        return pipe_ring_callbacks.dispatch(factory, task);
+    }
+    if (task->target_worker_id < 0)
+    {
+        target_worker_id = swServer_worker_schedule(serv, task->data.info.fd);
+    }
+    else
+    {
+        target_worker_id = task->target_worker_id;
+    }
+    p = &serv->pipe_rings[target_worker_id];
+    if (p->write(p, &task->data, sizeof(task->data.info) + task->data.info.len) < 0)
+    {
+        return SW_ERR;
+    }
+    return SW_OK;
+}
+
+static int php_swoole_pipe_ring_onRead(swReactor *reactor, swEvent *event)
+{
+    swServer *serv = SwooleG.serv;
+    swPipe *p = &serv->pipe_rings[SwooleWG.id];
+    swEventData task;
+
+    //drain the ring, the eventfd is written again only after the worker has found it empty
+    while (p->read(p, &task, sizeof(task)) > 0)
+    {
+        swWorker_onTask(&serv->factory, &task);
+    }
+    return SW_OK;
+}
+
+static void php_swoole_pipe_ring_wrap(swServer *serv)
+{
+    pipe_ring_callbacks.dispatch = serv->factory.dispatch;
+    serv->factory.dispatch = php_swoole_pipe_ring_dispatch;
 }
 
 void php_swoole_register_callback(swServer *serv)
@@ -830,7 +1272,7 @@ static int php_swoole_onFinish(swServer *serv, swEventData *req)
     zval *callback = NULL;
     if (swTask_type(req) & SW_TASK_CALLBACK)
     {
-        callback = swHashMap_find_int(task_callbacks, req->info.fd);
+        callback = swFlatMap_find_int(task_callbacks, req->info.fd);
         if (callback == NULL)
         {
             swTask_type(req) = swTask_type(req) & (~SW_TASK_CALLBACK);
@@ -859,7 +1301,7 @@ static int php_swoole_onFinish(swServer *serv, swEventData *req)
     }
     if (swTask_type(req) & SW_TASK_CALLBACK)
     {
-        swHashMap_del_int(task_callbacks, req->info.fd);
+        swFlatMap_del_int(task_callbacks, req->info.fd);
         sw_zval_ptr_dtor(&callback);
 #if PHP_MAJOR_VERSION >= 7
         efree(callback);
@@ -992,6 +1434,38 @@ static void php_swoole_onWorkerStart(swServer *serv, int worker_id)
 
     SWOOLE_GET_TSRMLS;
 
+    //cpu_affinity_numa, the task workers keep the cpu list placement
+    if (serv->worker_cpu && worker_id < serv->worker_num)
+    {
+        swServer_cpu_affinity_worker(serv, worker_id);
+    }
+    //the idle wheel of the worker, only the event workers accept connections
+    if (serv->idle_wheels && worker_id < serv->worker_num
+            && php_swoole_add_internal_timer(serv->heartbeat_check_interval * 1000, 1, php_swoole_heartbeat_onTimeout, serv) < 0)
+    {
+        swWarn("cannot start the heartbeat check of worker#%d.", worker_id);
+    }
+    //the worker reads its ring from the reactor, it must not block on the eventfd
+    if (serv->pipe_rings && worker_id < serv->worker_num)
+    {
+        swPipe *p = &serv->pipe_rings[worker_id];
+        p->blocking = 0;
+        SwooleG.main_reactor->setHandle(SwooleG.main_reactor, SW_FD_PIPE_RING, php_swoole_pipe_ring_onRead);
+        if (SwooleG.main_reactor->add(SwooleG.main_reactor, p->getFd(p, SW_PIPE_WORKER), SW_FD_PIPE_RING) < 0)
+        {
+            swWarn("cannot read the pipe ring of worker#%d.", worker_id);
+        }
+    }
+    //no manager in SWOOLE_BASE, the first worker rewrites the stats_file
+    if (serv->stats_file && serv->worker_stats && serv->factory_mode == SW_MODE_BASE && worker_id == 0)
+    {
+        swServer_stats_dump_file(serv, serv->stats_file, serv->stats_file_format);
+        if (php_swoole_add_internal_timer(SW_STATS_FILE_INTERVAL, 1, php_swoole_stats_onFileTimeout, serv) < 0)
+        {
+            swWarn("cannot rewrite stats_file %s.", serv->stats_file);
+        }
+    }
+
     SW_MAKE_STD_ZVAL(zworker_id);
     ZVAL_LONG(zworker_id, worker_id);
 
@@ -1023,6 +1497,8 @@ static void php_swoole_onWorkerStart(swServer *serv, int worker_id)
     else
     {
         zend_update_property_bool(swoole_server_class_entry_ptr, zserv, ZEND_STRL("taskworker"), 0 TSRMLS_CC);
+        //whatever the previous process of this worker was handling will never finish
+        serv->workers[worker_id].inflight_num = 0;
     }
 
     /**
@@ -1496,6 +1972,11 @@ PHP_METHOD(swoole_server, set)
     if (php_swoole_array_get_value(vht, "dispatch_mode", v))
     {
         convert_to_long(v);
+        if (Z_LVAL_P(v) < SW_DISPATCH_ROUND || Z_LVAL_P(v) > SW_DISPATCH_UIDHASH)
+        {
+            swoole_php_fatal_error(E_WARNING, "dispatch_mode must be between %d and %d.", SW_DISPATCH_ROUND, SW_DISPATCH_UIDHASH);
+            RETURN_FALSE;
+        }
         serv->dispatch_mode = (int) Z_LVAL_P(v);
     }
     //c/c++ function
@@ -1543,12 +2024,39 @@ PHP_METHOD(swoole_server, set)
         convert_to_boolean(v);
         serv->enable_delay_receive = Z_BVAL_P(v);
     }
+    //per-worker stats
+    if (php_swoole_array_get_value(vht, "enable_stats", v))
+    {
+        convert_to_boolean(v);
+        serv->enable_stats = Z_BVAL_P(v);
+    }
+    //shared memory ring from the reactor threads to the workers, SWOOLE_PROCESS only
+    if (php_swoole_array_get_value(vht, "pipe_ring", v))
+    {
+        convert_to_boolean(v);
+        serv->enable_pipe_ring = Z_BVAL_P(v);
+    }
+    //stats dumped by the manager or worker#0, SWOOLE_STATS_TEXT or SWOOLE_STATS_PROMETHEUS
+    if (php_swoole_array_get_value(vht, "stats_file", v))
+    {
+        convert_to_string(v);
+        if (serv->stats_file)
+        {
+            free(serv->stats_file);
+        }
+        serv->stats_file = strndup(Z_STRVAL_P(v), Z_STRLEN_P(v));
+    }
+    if (php_swoole_array_get_value(vht, "stats_file_format", v))
+    {
+        convert_to_long(v);
+        serv->stats_file_format = Z_LVAL_P(v) == SW_STATS_PROMETHEUS ? SW_STATS_PROMETHEUS : SW_STATS_TEXT;
+    }
     //task_worker_num
     if (php_swoole_array_get_value(vht, "task_worker_num", v))
     {
         convert_to_long(v);
         SwooleG.task_worker_num = (int) Z_LVAL_P(v);
-        task_callbacks = swHashMap_new(1024, NULL);
+        task_callbacks = swFlatMap_new(1024, NULL);
     }
     //task ipc mode, 1,2,3
     if (php_swoole_array_get_value(vht, "task_ipc_mode", v))
@@ -1657,12 +2165,74 @@ PHP_METHOD(swoole_server, set)
         serv->cpu_affinity_available_num = available_num;
         serv->cpu_affinity_available = available_cpu;
     }
+    //place reactors and workers by NUMA node
+    if (php_swoole_array_get_value(vht, "cpu_affinity_numa", v))
+    {
+        convert_to_boolean(v);
+        serv->cpu_affinity_numa = Z_BVAL_P(v);
+    }
+    //follow the RX queue interrupts of the network device
+    if (php_swoole_array_get_value(vht, "cpu_affinity_irq_device", v))
+    {
+        convert_to_string(v);
+        if (serv->cpu_affinity_irq_device)
+        {
+            free(serv->cpu_affinity_irq_device);
+        }
+        serv->cpu_affinity_irq_device = strndup(Z_STRVAL_P(v), Z_STRLEN_P(v));
+    }
     //paser x-www-form-urlencoded form data
     if (php_swoole_array_get_value(vht, "http_parse_post", v))
     {
         convert_to_boolean(v);
         serv->http_parse_post = Z_BVAL_P(v);
     }
+    //compress the response when the client accepts it
+    if (php_swoole_array_get_value(vht, "http_compression", v))
+    {
+        convert_to_boolean(v);
+        serv->http_compression = Z_BVAL_P(v);
+    }
+    if (php_swoole_array_get_value(vht, "http_compression_level", v))
+    {
+        convert_to_long(v);
+        if (Z_LVAL_P(v) < 1 || Z_LVAL_P(v) > 11)
+        {
+            swoole_php_fatal_error(E_WARNING, "http_compression_level must be between 1 and 11.");
+            RETURN_FALSE;
+        }
+        serv->http_compression_level = (uint8_t) Z_LVAL_P(v);
+    }
+    if (php_swoole_array_get_value(vht, "http_compression_min_length", v))
+    {
+        convert_to_long(v);
+        serv->http_compression_min_length = (uint32_t) Z_LVAL_P(v);
+    }
+    //static file handler
+    if (php_swoole_array_get_value(vht, "document_root", v))
+    {
+        char real_path[PATH_MAX];
+        convert_to_string(v);
+        if (realpath(Z_STRVAL_P(v), real_path) == NULL)
+        {
+            swoole_php_fatal_error(E_ERROR, "document_root[%s] does not exist.", Z_STRVAL_P(v));
+            RETURN_FALSE;
+        }
+        sw_free(serv->document_root);
+        serv->document_root = strdup(real_path);
+        serv->document_root_len = strlen(real_path);
+    }
+    if (php_swoole_array_get_value(vht, "enable_static_handler", v))
+    {
+        convert_to_boolean(v);
+        serv->enable_static_handler = Z_BVAL_P(v);
+    }
+    //serve precompressed file.gz/file.br in sendfile
+    if (php_swoole_array_get_value(vht, "http_gzip_static", v))
+    {
+        convert_to_boolean(v);
+        serv->http_gzip_static = Z_BVAL_P(v);
+    }
     //temporary directory for HTTP uploaded file.
     if (php_swoole_array_get_value(vht, "upload_tmp_dir", v))
     {
@@ -1927,6 +2497,7 @@ PHP_METHOD(swoole_server, start)
     php_swoole_server_before_start(serv, zobject TSRMLS_CC);
 
     ret = swServer_start(serv);
+    php_swoole_server_after_stop(serv);
     if (ret < 0)
     {
         swoole_php_fatal_error(E_ERROR, "start server failed. Error: %s", sw_error);
@@ -2023,6 +2594,7 @@ PHP_METHOD(swoole_server, send)
     //TCP
     else
     {
+        swoole_redis_server_flush(serv, fd);
         SW_CHECK_RETURN(swServer_tcp_send(serv, fd, data, length));
     }
 }
@@ -2132,6 +2704,7 @@ PHP_METHOD(swoole_server, sendfile)
     }
 
     swServer *serv = swoole_get_object(zobject);
+    swoole_redis_server_flush(serv, (int) fd);
     SW_CHECK_RETURN(swServer_tcp_sendfile(serv, (int) fd, filename, len, offset));
 }
 
@@ -2159,6 +2732,7 @@ PHP_METHOD(swoole_server, close)
     }
 
     swServer *serv = swoole_get_object(zobject);
+    swoole_redis_server_flush(serv, (int) fd);
     SW_CHECK_RETURN(serv->close(serv, (int )fd, (int )reset));
 }
 
@@ -2270,14 +2844,70 @@ PHP_METHOD(swoole_server, resume)
     SW_CHECK_RETURN(ret);
 }
 
+static void php_swoole_server_stats_detail(swServer *serv, zval *return_value)
+{
+    swWorkerStats worker;
+    zval *zworkers, *zitem;
+    uint64_t count;
+    int i, j;
+
+    SW_MAKE_STD_ZVAL(zworkers);
+    array_init(zworkers);
+    for (i = 0; i < serv->worker_num; i++)
+    {
+        swServer_stats_worker(serv, i, &worker);
+        for (j = 0, count = 0; j < SW_STATS_LATENCY_BUCKETS; j++)
+        {
+            count += worker.latency[j];
+        }
+        SW_MAKE_STD_ZVAL(zitem);
+        array_init(zitem);
+        sw_add_assoc_long_ex(zitem, ZEND_STRS("request_count"), worker.request_count);
+        //only counted by the least-request dispatch
+        if (serv->dispatch_mode == SW_DISPATCH_LEASTREQ)
+        {
+            sw_add_assoc_long_ex(zitem, ZEND_STRS("inflight"), serv->workers[i].inflight_num);
+        }
+        sw_add_assoc_long_ex(zitem, ZEND_STRS("bytes_in"), worker.bytes_in);
+        sw_add_assoc_long_ex(zitem, ZEND_STRS("bytes_out"), worker.bytes_out);
+        sw_add_assoc_long_ex(zitem, ZEND_STRS("latency_avg_usec"), count ? worker.latency_usec / count : 0);
+        sw_add_assoc_long_ex(zitem, ZEND_STRS("latency_p50_usec"), swWorkerStats_percentile(&worker, 50));
+        sw_add_assoc_long_ex(zitem, ZEND_STRS("latency_p99_usec"), swWorkerStats_percentile(&worker, 99));
+        add_next_index_zval(zworkers, zitem);
+    }
+    add_assoc_zval(return_value, "workers", zworkers);
+}
+
 PHP_METHOD(swoole_server, stats)
 {
+    long mode = SW_STATS_DEFAULT;
+
     if (SwooleGS->start == 0)
     {
         swoole_php_fatal_error(E_WARNING, "Server is not running.");
         RETURN_FALSE;
     }
 
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|l", &mode) == FAILURE)
+    {
+        return;
+    }
+
+    swServer *serv = swoole_get_object(getThis());
+
+    if (mode == SW_STATS_TEXT || mode == SW_STATS_PROMETHEUS)
+    {
+        swString *buffer = swString_new(SW_BUFFER_SIZE_STD);
+        if (buffer == NULL)
+        {
+            RETURN_FALSE;
+        }
+        swServer_stats_dump(serv, buffer, mode);
+        SW_RETVAL_STRINGL(buffer->str, buffer->length, 1);
+        swString_free(buffer);
+        return;
+    }
+
     array_init(return_value);
     sw_add_assoc_long_ex(return_value, ZEND_STRS("start_time"), SwooleStats->start_time);
     sw_add_assoc_long_ex(return_value, ZEND_STRS("connection_num"), SwooleStats->connection_num);
@@ -2297,6 +2927,11 @@ PHP_METHOD(swoole_server, stats)
             sw_add_assoc_long_ex(return_value, ZEND_STRS("task_queue_bytes"), queue_bytes);
         }
     }
+
+    if (serv->worker_stats)
+    {
+        php_swoole_server_stats_detail(serv, return_value);
+    }
 }
 
 PHP_METHOD(swoole_server, reload)
@@ -2323,6 +2958,28 @@ PHP_METHOD(swoole_server, reload)
     RETURN_TRUE;
 }
 
+static void php_swoole_server_heartbeat_close(swServer *serv, swConnection *conn, zend_bool close_connection, zval *return_value)
+{
+    int fd = conn->fd;
+#ifdef SW_REACTOR_USE_SESSION
+    long session_id = conn->session_id;
+#endif
+
+    conn->close_force = 1;
+    /**
+     * Close the connection
+     */
+    if (close_connection)
+    {
+        serv->factory.end(&serv->factory, fd);
+    }
+#ifdef SW_REACTOR_USE_SESSION
+    add_next_index_long(return_value, session_id);
+#else
+    add_next_index_long(return_value, fd);
+#endif
+}
+
 PHP_METHOD(swoole_server, heartbeat)
 {
     zval *zobject = getThis();
@@ -2347,15 +3004,40 @@ PHP_METHOD(swoole_server, heartbeat)
         RETURN_FALSE;
     }
 
-    int serv_max_fd = swServer_get_maxfd(serv);
-    int serv_min_fd = swServer_get_minfd(serv);
-
     array_init(return_value);
 
     int fd;
-    int checktime = (int) SwooleGS->now - serv->heartbeat_idle_time;
     swConnection *conn;
 
+    /**
+     * only the connections expired in the idle wheels of the workers, read only:
+     * the wheels are moved by the heartbeat timer of their worker
+     */
+    if (serv->idle_wheels)
+    {
+        swArray *fds = swArray_new(1024, sizeof(int));
+        if (fds == NULL)
+        {
+            RETURN_FALSE;
+        }
+        uint32_t i;
+        for (i = 0; i < serv->idle_wheel_num; i++)
+        {
+            swServer_heartbeat_idle(serv, i, SwooleGS->now, fds);
+        }
+        for (i = 0; i < fds->item_num; i++)
+        {
+            fd = *(int *) swArray_fetch(fds, i);
+            php_swoole_server_heartbeat_close(serv, &serv->connection_list[fd], close_connection, return_value);
+        }
+        swArray_free(fds);
+        return;
+    }
+
+    int serv_max_fd = swServer_get_maxfd(serv);
+    int serv_min_fd = swServer_get_minfd(serv);
+    int checktime = (int) SwooleGS->now - serv->heartbeat_idle_time;
+
     for (fd = serv_min_fd; fd <= serv_max_fd; fd++)
     {
         swTrace("heartbeat check fd=%d", fd);
@@ -2363,19 +3045,7 @@ PHP_METHOD(swoole_server, heartbeat)
 
         if (1 == conn->active && conn->last_time < checktime)
         {
-            conn->close_force = 1;
-            /**
-             * Close the connection
-             */
-            if (close_connection)
-            {
-                serv->factory.end(&serv->factory, fd);
-            }
-#ifdef SW_REACTOR_USE_SESSION
-            add_next_index_long(return_value, conn->session_id);
-#else
-            add_next_index_long(return_value, fd);
-#endif
+            php_swoole_server_heartbeat_close(serv, conn, close_connection, return_value);
         }
     }
 }
@@ -2607,7 +3277,7 @@ PHP_METHOD(swoole_server, task)
 #endif
         swTask_type(&buf) |= SW_TASK_CALLBACK;
         sw_zval_add_ref(&callback);
-        swHashMap_add_int(task_callbacks, buf.info.fd, sw_zval_dup(callback));
+        swFlatMap_add_int(task_callbacks, buf.info.fd, sw_zval_dup(callback));
     }
 
     swTask_type(&buf) |= SW_TASK_NONBLOCK;
@@ -2865,7 +3535,7 @@ PHP_METHOD(swoole_server, connection_info)
     {
         array_init(return_value);
 
-        if (serv->dispatch_mode == SW_DISPATCH_UIDMOD)
+        if (serv->dispatch_mode == SW_DISPATCH_UIDMOD || serv->dispatch_mode == SW_DISPATCH_UIDHASH)
         {
             add_assoc_long(return_value, "uid", conn->uid);
         }
@@ -3031,6 +3701,7 @@ PHP_METHOD(swoole_server, sendwait)
     //TCP
     else
     {
+        swoole_redis_server_flush(serv, fd);
         SW_CHECK_RETURN(swServer_tcp_sendwait(serv, fd, data, length));
     }
 }
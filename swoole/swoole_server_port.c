@@ -183,6 +183,13 @@ static PHP_METHOD(swoole_server_port, set)
         convert_to_boolean(v);
         port->open_websocket_protocol = Z_BVAL_P(v);
     }
+#ifdef SW_HAVE_ZLIB
+    if (php_swoole_array_get_value(vht, "websocket_compression", v))
+    {
+        convert_to_boolean(v);
+        port->websocket_compression = Z_BVAL_P(v);
+    }
+#endif
     if (php_swoole_array_get_value(vht, "websocket_subprotocol", v))
     {
         convert_to_string(v);
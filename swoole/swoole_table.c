@@ -37,6 +37,7 @@ ZEND_BEGIN_ARG_INFO_EX(arginfo_swoole_table_column, 0, 0, 2)
     ZEND_ARG_INFO(0, name)
     ZEND_ARG_INFO(0, type)
     ZEND_ARG_INFO(0, size)
+    ZEND_ARG_INFO(0, flags)
 ZEND_END_ARG_INFO()
 
 ZEND_BEGIN_ARG_INFO_EX(arginfo_swoole_table_set, 0, 0, 2)
@@ -52,6 +53,12 @@ ZEND_BEGIN_ARG_INFO_EX(arginfo_swoole_table_del, 0, 0, 1)
     ZEND_ARG_INFO(0, key)
 ZEND_END_ARG_INFO()
 
+ZEND_BEGIN_ARG_INFO_EX(arginfo_swoole_table_find, 0, 0, 2)
+    ZEND_ARG_INFO(0, column)
+    ZEND_ARG_INFO(0, value)
+    ZEND_ARG_INFO(0, operator)
+ZEND_END_ARG_INFO()
+
 ZEND_BEGIN_ARG_INFO_EX(arginfo_swoole_table_incr, 0, 0, 2)
     ZEND_ARG_INFO(0, key)
     ZEND_ARG_INFO(0, column)
@@ -71,6 +78,7 @@ static PHP_METHOD(swoole_table, set);
 static PHP_METHOD(swoole_table, get);
 static PHP_METHOD(swoole_table, del);
 static PHP_METHOD(swoole_table, exist);
+static PHP_METHOD(swoole_table, find);
 static PHP_METHOD(swoole_table, incr);
 static PHP_METHOD(swoole_table, decr);
 static PHP_METHOD(swoole_table, count);
@@ -95,6 +103,7 @@ static const zend_function_entry swoole_table_methods[] =
     PHP_ME(swoole_table, count,       arginfo_swoole_table_void, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_table, del,         arginfo_swoole_table_del, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_table, exist,       arginfo_swoole_table_get, ZEND_ACC_PUBLIC)
+    PHP_ME(swoole_table, find,        arginfo_swoole_table_find, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_table, incr,        arginfo_swoole_table_incr, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_table, decr,        arginfo_swoole_table_decr, ZEND_ACC_PUBLIC)
 #ifdef HAVE_PCRE
@@ -112,18 +121,13 @@ static void php_swoole_table_row2array(swTable *table, swTableRow *row, zval *re
     array_init(return_value);
 
     swTableColumn *col = NULL;
+    swTableColumn **column_list = table->column_list;
     swTable_string_length_t vlen = 0;
     double dval = 0;
     int64_t lval = 0;
-    char *k;
 
-    while(1)
+    while ((col = *column_list++) != NULL)
     {
-        col = swHashMap_each(table->columns, &k);
-        if (col == NULL)
-        {
-            break;
-        }
         if (col->type == SW_TABLE_STRING)
         {
             memcpy(&vlen, row->data + col->index, sizeof(swTable_string_length_t));
@@ -172,6 +176,17 @@ void swoole_table_init(int module_number TSRMLS_DC)
     zend_declare_class_constant_long(swoole_table_class_entry_ptr, SW_STRL("TYPE_INT")-1, SW_TABLE_INT TSRMLS_CC);
     zend_declare_class_constant_long(swoole_table_class_entry_ptr, SW_STRL("TYPE_STRING")-1, SW_TABLE_STRING TSRMLS_CC);
     zend_declare_class_constant_long(swoole_table_class_entry_ptr, SW_STRL("TYPE_FLOAT")-1, SW_TABLE_FLOAT TSRMLS_CC);
+
+    zend_declare_class_constant_long(swoole_table_class_entry_ptr, SW_STRL("FLAG_INDEX")-1, SW_TABLE_FLAG_INDEX TSRMLS_CC);
+    zend_declare_class_constant_long(swoole_table_class_entry_ptr, SW_STRL("FLAG_COLUMNAR")-1, SW_TABLE_FLAG_COLUMNAR TSRMLS_CC);
+
+    zend_declare_class_constant_long(swoole_table_class_entry_ptr, SW_STRL("FIND_EQ")-1, SW_TABLE_FIND_EQ TSRMLS_CC);
+    zend_declare_class_constant_long(swoole_table_class_entry_ptr, SW_STRL("FIND_NEQ")-1, SW_TABLE_FIND_NEQ TSRMLS_CC);
+    zend_declare_class_constant_long(swoole_table_class_entry_ptr, SW_STRL("FIND_GT")-1, SW_TABLE_FIND_GT TSRMLS_CC);
+    zend_declare_class_constant_long(swoole_table_class_entry_ptr, SW_STRL("FIND_LT")-1, SW_TABLE_FIND_LT TSRMLS_CC);
+    zend_declare_class_constant_long(swoole_table_class_entry_ptr, SW_STRL("FIND_LEFTLIKE")-1, SW_TABLE_FIND_LEFTLIKE TSRMLS_CC);
+    zend_declare_class_constant_long(swoole_table_class_entry_ptr, SW_STRL("FIND_RIGHTLIKE")-1, SW_TABLE_FIND_RIGHTLIKE TSRMLS_CC);
+    zend_declare_class_constant_long(swoole_table_class_entry_ptr, SW_STRL("FIND_LIKE")-1, SW_TABLE_FIND_LIKE TSRMLS_CC);
 }
 
 void swoole_table_column_free(swTableColumn *col)
@@ -207,8 +222,9 @@ PHP_METHOD(swoole_table, column)
     zend_size_t len;
     long type;
     long size = 0;
+    long flags = 0;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "sl|l", &name, &len, &type, &size) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "sl|ll", &name, &len, &type, &size, &flags) == FAILURE)
     {
         RETURN_FALSE;
     }
@@ -228,7 +244,7 @@ PHP_METHOD(swoole_table, column)
         swoole_php_fatal_error(E_WARNING, "Must be used before create table.");
         RETURN_FALSE;
     }
-    swTableColumn_add(table, name, len, type, size);
+    swTableColumn_add(table, name, len, type, size, flags);
     RETURN_TRUE;
 }
 
@@ -279,11 +295,11 @@ static PHP_METHOD(swoole_table, set)
         RETURN_FALSE;
     }
 
-    sw_atomic_t *_lock = NULL;
-    swTableRow *row = swTableRow_set(table, key, keylen, &_lock);
+    swTableBucket *_bucket = NULL;
+    swTableRow *row = swTableRow_set(table, key, keylen, &_bucket);
     if (!row)
     {
-        sw_spinlock_release(_lock);
+        swTableRow_commit(table, row, _bucket);
         swoole_php_error(E_WARNING, "Unable to allocate memory.");
         RETURN_FALSE;
     }
@@ -320,7 +336,7 @@ static PHP_METHOD(swoole_table, set)
     }
     (void)ktype;
     SW_HASHTABLE_FOREACH_END();
-    sw_spinlock_release(_lock);
+    swTableRow_commit(table, row, _bucket);
     RETURN_TRUE;
 }
 
@@ -337,7 +353,7 @@ static PHP_METHOD(swoole_table, incr)
         RETURN_FALSE;
     }
 
-    sw_atomic_t *_lock = NULL;
+    swTableBucket *_bucket = NULL;
     swTable *table = swoole_get_object(getThis());
     if (!table->memory)
     {
@@ -345,10 +361,10 @@ static PHP_METHOD(swoole_table, incr)
         RETURN_FALSE;
     }
 
-    swTableRow *row = swTableRow_set(table, key, key_len, &_lock);
+    swTableRow *row = swTableRow_set(table, key, key_len, &_bucket);
     if (!row)
     {
-        sw_spinlock_release(_lock);
+        swTableRow_commit(table, row, _bucket);
         swoole_php_fatal_error(E_WARNING, "Unable to allocate memory.");
         RETURN_FALSE;
     }
@@ -357,13 +373,13 @@ static PHP_METHOD(swoole_table, incr)
     column = swTableColumn_get(table, col, col_len);
     if (column == NULL)
     {
-        sw_spinlock_release(_lock);
+        swTableRow_commit(table, row, _bucket);
         swoole_php_fatal_error(E_WARNING, "column[%s] not exist.", col);
         RETURN_FALSE;
     }
     else if (column->type == SW_TABLE_STRING)
     {
-        sw_spinlock_release(_lock);
+        swTableRow_commit(table, row, _bucket);
         swoole_php_fatal_error(E_WARNING, "cannot use incr with string column.");
         RETURN_FALSE;
     }
@@ -399,7 +415,7 @@ static PHP_METHOD(swoole_table, incr)
         swTableRow_set_value(row, column, &set_value, 0);
         RETVAL_LONG(set_value);
     }
-    sw_spinlock_release(_lock);
+    swTableRow_commit(table, row, _bucket);
 }
 
 static PHP_METHOD(swoole_table, decr)
@@ -415,7 +431,7 @@ static PHP_METHOD(swoole_table, decr)
         RETURN_FALSE;
     }
 
-    sw_atomic_t *_lock = NULL;
+    swTableBucket *_bucket = NULL;
     swTable *table = swoole_get_object(getThis());
     if (!table->memory)
     {
@@ -423,10 +439,10 @@ static PHP_METHOD(swoole_table, decr)
         RETURN_FALSE;
     }
 
-    swTableRow *row = swTableRow_set(table, key, key_len, &_lock);
+    swTableRow *row = swTableRow_set(table, key, key_len, &_bucket);
     if (!row)
     {
-        sw_spinlock_release(_lock);
+        swTableRow_commit(table, row, _bucket);
         swoole_php_fatal_error(E_WARNING, "Unable to allocate memory.");
         RETURN_FALSE;
     }
@@ -435,13 +451,13 @@ static PHP_METHOD(swoole_table, decr)
     column = swTableColumn_get(table, col, col_len);
     if (column == NULL)
     {
-        sw_spinlock_release(_lock);
+        swTableRow_commit(table, row, _bucket);
         swoole_php_fatal_error(E_WARNING, "column[%s] not exist.", col);
         RETURN_FALSE;
     }
     else if (column->type == SW_TABLE_STRING)
     {
-        sw_spinlock_release(_lock);
+        swTableRow_commit(table, row, _bucket);
         swoole_php_fatal_error(E_WARNING, "cannot use incr with string column.");
         RETURN_FALSE;
     }
@@ -477,7 +493,7 @@ static PHP_METHOD(swoole_table, decr)
         swTableRow_set_value(row, column, &set_value, 0);
         RETVAL_LONG(set_value);
     }
-    sw_spinlock_release(_lock);
+    swTableRow_commit(table, row, _bucket);
 }
 
 static PHP_METHOD(swoole_table, get)
@@ -489,7 +505,6 @@ static PHP_METHOD(swoole_table, get)
     {
         RETURN_FALSE;
     }
-    sw_atomic_t *_lock = NULL;
     swTable *table = swoole_get_object(getThis());
     if (!table->memory)
     {
@@ -497,8 +512,8 @@ static PHP_METHOD(swoole_table, get)
         RETURN_FALSE;
     }
 
-    swTableRow *row = swTableRow_get(table, key, keylen, &_lock);
-    if (!row)
+    swTableRow *row = emalloc(table->row_size);
+    if (swTableRow_read(table, key, keylen, row) < 0)
     {
         RETVAL_FALSE;
     }
@@ -506,7 +521,7 @@ static PHP_METHOD(swoole_table, get)
     {
         php_swoole_table_row2array(table, row, return_value);
     }
-    sw_spinlock_release(_lock);
+    efree(row);
 }
 
 static PHP_METHOD(swoole_table, exist)
@@ -519,7 +534,6 @@ static PHP_METHOD(swoole_table, exist)
         RETURN_FALSE;
     }
 
-    sw_atomic_t *_lock = NULL;
     swTable *table = swoole_get_object(getThis());
     if (!table->memory)
     {
@@ -527,15 +541,73 @@ static PHP_METHOD(swoole_table, exist)
         RETURN_FALSE;
     }
 
-    swTableRow *row = swTableRow_get(table, key, keylen, &_lock);
-    sw_spinlock_release(_lock);
-    if (!row)
+    SW_CHECK_RETURN(swTableRow_read(table, key, keylen, NULL));
+}
+
+static void php_swoole_table_find_handler(swTable *table, swTableRow *row, void *udata)
+{
+    zval *return_value = udata;
+    zval *item;
+    char key[SW_TABLE_KEY_SIZE + 1];
+
+    memcpy(key, row->key, SW_TABLE_KEY_SIZE);
+    key[SW_TABLE_KEY_SIZE] = 0;
+
+    SW_MAKE_STD_ZVAL(item);
+    php_swoole_table_row2array(table, row, item);
+    add_assoc_zval(return_value, key, item);
+}
+
+static PHP_METHOD(swoole_table, find)
+{
+    char *name;
+    zend_size_t len;
+    zval *value;
+    long op = SW_TABLE_FIND_EQ;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "sz|l", &name, &len, &value, &op) == FAILURE)
     {
         RETURN_FALSE;
     }
+
+    swTable *table = swoole_get_object(getThis());
+    if (!table->memory)
+    {
+        swoole_php_fatal_error(E_ERROR, "Must create table first.");
+        RETURN_FALSE;
+    }
+
+    swTable_condition cond;
+    bzero(&cond, sizeof(cond));
+    cond.column = swTableColumn_get(table, name, len);
+    if (cond.column == NULL)
+    {
+        swoole_php_fatal_error(E_WARNING, "column[%s] not exist.", name);
+        RETURN_FALSE;
+    }
+    cond.op = op;
+    if (cond.column->type == SW_TABLE_STRING)
+    {
+        convert_to_string(value);
+        cond.str = Z_STRVAL_P(value);
+        cond.length = Z_STRLEN_P(value);
+    }
+    else if (cond.column->type == SW_TABLE_FLOAT)
+    {
+        convert_to_double(value);
+        cond.dval = Z_DVAL_P(value);
+    }
     else
     {
-        RETURN_TRUE;
+        convert_to_long(value);
+        cond.lval = Z_LVAL_P(value);
+    }
+
+    array_init(return_value);
+    if (swTable_find(table, &cond, php_swoole_table_find_handler, return_value) < 0)
+    {
+        zval_dtor(return_value);
+        RETURN_FALSE;
     }
 }
 
@@ -609,9 +681,11 @@ static PHP_METHOD(swoole_table, current)
         RETURN_FALSE;
     }
     swTableRow *row = swTable_iterator_current(table);
-    sw_spinlock(&row->lock);
+    if (!row)
+    {
+        RETURN_NULL();
+    }
     php_swoole_table_row2array(table, row, return_value);
-    sw_spinlock_release(&row->lock);
 }
 
 static PHP_METHOD(swoole_table, key)
@@ -623,9 +697,11 @@ static PHP_METHOD(swoole_table, key)
         RETURN_FALSE;
     }
     swTableRow *row = swTable_iterator_current(table);
-    sw_spinlock(&row->lock);
+    if (!row)
+    {
+        RETURN_NULL();
+    }
     SW_RETVAL_STRING(row->key, 1);
-    sw_spinlock_release(&row->lock);
 }
 
 static PHP_METHOD(swoole_table, next)
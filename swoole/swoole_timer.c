@@ -33,9 +33,14 @@ typedef struct _swTimer_callback
 #endif
     int interval;
     int type;
+    /**
+     * timers of the extension itself, set tnode->remove to stop a tick
+     */
+    void (*handler)(swTimer_node *tnode, void *data);
+    void *handler_data;
 } swTimer_callback;
 
-static swHashMap *timer_map;
+static swFlatMap *timer_map;
 
 static void php_swoole_onTimeout(swTimer *timer, swTimer_node *tnode);
 static void php_swoole_onInterval(swTimer *timer, swTimer_node *tnode);
@@ -117,19 +122,45 @@ static long php_swoole_add_timer(int ms, zval *callback, zval *param, int is_tic
     }
     else
     {
-        swHashMap_add_int(timer_map, tnode->id, tnode);
+        swFlatMap_add_int(timer_map, tnode->id, tnode);
         return tnode->id;
     }
 }
 
+long php_swoole_add_internal_timer(int ms, int is_tick, void (*handler)(swTimer_node *tnode, void *data), void *data)
+{
+    if (SwooleG.serv && swIsMaster())
+    {
+        return SW_ERR;
+    }
+
+    php_swoole_check_timer(ms);
+    swTimer_callback *cb = emalloc(sizeof(swTimer_callback));
+    bzero(cb, sizeof(swTimer_callback));
+    cb->type = is_tick ? SW_TIMER_TICK : SW_TIMER_AFTER;
+    cb->handler = handler;
+    cb->handler_data = data;
+
+    swTimer_node *tnode = swTimer_add(&SwooleG.timer, ms, is_tick, cb);
+    if (tnode == NULL)
+    {
+        efree(cb);
+        swWarn("addtimer failed.");
+        return SW_ERR;
+    }
+    //kept out of timer_map, swoole_timer_exists() and swoole_timer_clear() cannot see it
+    return tnode->id;
+}
+
 static int php_swoole_del_timer(swTimer_node *tnode TSRMLS_DC)
 {
-    if (swHashMap_del_int(timer_map, tnode->id) < 0)
+    swTimer_callback *cb = tnode->data;
+    //internal timers are not in timer_map
+    if (!(cb && cb->handler) && swFlatMap_del_int(timer_map, tnode->id) < 0)
     {
         return SW_ERR;
     }
     tnode->id = -1;
-    swTimer_callback *cb = tnode->data;
     if (!cb)
     {
         return SW_ERR;
@@ -157,6 +188,13 @@ static void php_swoole_onTimeout(swTimer *timer, swTimer_node *tnode)
     zval **args[1];
     int argc = 0;
 
+    if (cb->handler)
+    {
+        cb->handler(tnode, cb->handler_data);
+        php_swoole_del_timer(tnode TSRMLS_CC);
+        return;
+    }
+
     if (cb->data)
     {
         args[0] = &cb->data;
@@ -196,6 +234,12 @@ static void php_swoole_onInterval(swTimer *timer, swTimer_node *tnode)
 
     swTimer_callback *cb = tnode->data;
 
+    if (cb->handler)
+    {
+        cb->handler(tnode, cb->handler_data);
+        goto _end;
+    }
+
     SW_MAKE_STD_ZVAL(ztimer_id);
     ZVAL_LONG(ztimer_id, tnode->id);
 
@@ -226,6 +270,7 @@ static void php_swoole_onInterval(swTimer *timer, swTimer_node *tnode)
     }
     sw_zval_ptr_dtor(&ztimer_id);
 
+    _end:
     if (tnode->remove)
     {
         php_swoole_del_timer(tnode TSRMLS_CC);
@@ -240,7 +285,7 @@ void php_swoole_check_timer(int msec)
         SwooleG.timer.onAfter = php_swoole_onTimeout;
         SwooleG.timer.onTick = php_swoole_onInterval;
 
-        timer_map = swHashMap_new(SW_HASHMAP_INIT_BUCKET_N, NULL);
+        timer_map = swFlatMap_new(SW_HASHMAP_INIT_BUCKET_N, NULL);
     }
 }
 
@@ -302,7 +347,7 @@ PHP_FUNCTION(swoole_timer_clear)
         return;
     }
 
-    swTimer_node *tnode = swHashMap_find_int(timer_map, id);
+    swTimer_node *tnode = swFlatMap_find_int(timer_map, id);
     if (tnode == NULL)
     {
         swoole_php_error(E_WARNING, "timer#%ld is not found.", id);
@@ -348,7 +393,7 @@ PHP_FUNCTION(swoole_timer_exists)
         return;
     }
 
-    swTimer_node *tnode = swHashMap_find_int(timer_map, id);
+    swTimer_node *tnode = swFlatMap_find_int(timer_map, id);
     if (tnode == NULL)
     {
        RETURN_FALSE;
@@ -197,6 +197,22 @@ static int websocket_handshake(swListenPort *port, http_context *ctx)
         swString_append_ptr(swoole_http_buffer, port->websocket_subprotocol, port->websocket_subprotocol_length);
         swString_append_ptr(swoole_http_buffer, ZEND_STRL("\r\n"));
     }
+#ifdef SW_HAVE_ZLIB
+    if (port->websocket_compression
+            && sw_zend_hash_find(ht, ZEND_STRS("sec-websocket-extensions"), (void **) &pData) == SUCCESS)
+    {
+        convert_to_string(pData);
+        if (strstr(Z_STRVAL_P(pData), "permessage-deflate"))
+        {
+            swConnection *conn = swWorker_get_connection(SwooleG.serv, ctx->fd);
+            if (conn)
+            {
+                conn->websocket_compression = 1;
+                swString_append_ptr(swoole_http_buffer, ZEND_STRL("Sec-WebSocket-Extensions: "SW_WEBSOCKET_EXTENSION_DEFLATE"\r\n"));
+            }
+        }
+    }
+#endif
     swString_append_ptr(swoole_http_buffer, ZEND_STRL("Server: "SW_WEBSOCKET_SERVER_SOFTWARE"\r\n\r\n"));
 
     swTrace("websocket header len:%ld\n%s \n", swoole_http_buffer->length, swoole_http_buffer->str);
@@ -218,9 +234,27 @@ int swoole_websocket_onMessage(swEventData *req)
     char frame_header[2];
     php_swoole_get_recv_data(zdata, req, frame_header, 2);
 
-    long finish = frame_header[0] ? 1 : 0;
+    long finish = (frame_header[0] & SW_WEBSOCKET_FLAG_FIN) ? 1 : 0;
     long opcode = frame_header[1];
 
+#ifdef SW_HAVE_ZLIB
+    if (frame_header[0] & SW_WEBSOCKET_FLAG_COMPRESS)
+    {
+        swListenPort *port = swServer_get_port(SwooleG.serv, fd);
+        if (swWebSocket_inflate(swoole_zlib_buffer, Z_STRVAL_P(zdata), Z_STRLEN_P(zdata),
+                port->protocol.package_max_length) < 0)
+        {
+            swoole_php_fatal_error(E_WARNING, "failed to inflate the message from connection[%d].", fd);
+            sw_zval_ptr_dtor(&zdata);
+            SwooleG.serv->factory.end(&SwooleG.serv->factory, fd);
+            return SW_OK;
+        }
+        sw_zval_ptr_dtor(&zdata);
+        SW_MAKE_STD_ZVAL(zdata);
+        SW_ZVAL_STRINGL(zdata, swoole_zlib_buffer->str, swoole_zlib_buffer->length, 1);
+    }
+#endif
+
     zval *zframe;
     SW_MAKE_STD_ZVAL(zframe);
     object_init_ex(zframe, swoole_websocket_frame_class_entry_ptr);
@@ -409,8 +443,24 @@ static PHP_METHOD(swoole_websocket_server, push)
         swoole_php_fatal_error(E_WARNING, "connection[%d] is not a websocket client.", (int ) fd);
         RETURN_FALSE;
     }
+    /**
+     * the frame still has to be contiguous: swServer_tcp_send() copies it into the worker to reactor pipe,
+     * only the reactor's own frames (PONG) are written with swWebSocket_send_frame() without assembling them
+     */
     swString_clear(swoole_http_buffer);
-    swWebSocket_encode(swoole_http_buffer, data, length, opcode, (int) fin, 0);
+#ifdef SW_HAVE_ZLIB
+    if (conn->websocket_compression && fin && length >= SW_WEBSOCKET_COMPRESS_MIN_LENGTH
+            && (opcode == WEBSOCKET_OPCODE_TEXT_FRAME || opcode == WEBSOCKET_OPCODE_BINARY_FRAME)
+            && swWebSocket_deflate(swoole_zlib_buffer, data, length) == SW_OK)
+    {
+        swWebSocket_encode(swoole_http_buffer, swoole_zlib_buffer->str, swoole_zlib_buffer->length, opcode,
+                SW_WEBSOCKET_FLAG_FIN | SW_WEBSOCKET_FLAG_COMPRESS, 0);
+    }
+    else
+#endif
+    {
+        swWebSocket_encode(swoole_http_buffer, data, length, opcode, fin ? SW_WEBSOCKET_FLAG_FIN : 0, 0);
+    }
     SW_CHECK_RETURN(swServer_tcp_send(SwooleG.serv, fd, swoole_http_buffer->str, swoole_http_buffer->length));
 }
 
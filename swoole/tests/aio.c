@@ -85,3 +85,134 @@ swUnitTest(aio_test)
 	//printf("buf: %s\n", buf);
 	return 0;
 }
+
+#define AIO_BENCH_FILE_SIZE   (64 * 1024 * 1024)
+#define AIO_BENCH_DEPTH       32
+
+static int aio_bench_block;
+static int aio_bench_random;
+static int aio_bench_total;
+static int aio_bench_submitted;
+static int aio_bench_finished;
+static char *aio_bench_buffers;
+
+static void aio_bench_submit(int fd, char *buf)
+{
+	off_t offset;
+	int blocks = AIO_BENCH_FILE_SIZE / aio_bench_block;
+
+	if (aio_bench_random)
+	{
+		offset = (off_t) (rand() % blocks) * aio_bench_block;
+	}
+	else
+	{
+		offset = (off_t) (aio_bench_submitted % blocks) * aio_bench_block;
+	}
+	aio_bench_submitted++;
+	SwooleAIO.read(fd, buf, aio_bench_block, offset);
+}
+
+static void aio_bench_callback(swAio_event *event)
+{
+	if (event->ret != aio_bench_block)
+	{
+		printf("aio read failed, ret=%d, error=%d\n", event->ret, event->error);
+	}
+	aio_bench_finished++;
+	if (aio_bench_submitted < aio_bench_total)
+	{
+		aio_bench_submit(event->fd, event->buf);
+	}
+	else if (aio_bench_finished == aio_bench_total)
+	{
+		SwooleG.running = 0;
+	}
+}
+
+static double aio_bench_run(int mode, int fd, int block, int total, int random)
+{
+	swReactor reactor;
+	struct timeval start, end;
+	int i;
+
+	if (swReactorEpoll_create(&reactor, 128) < 0)
+	{
+		return -1;
+	}
+	bzero(&SwooleAIO, sizeof(SwooleAIO));
+	SwooleAIO.mode = mode;
+	SwooleG.main_reactor = &reactor;
+	if (swAio_init() < 0)
+	{
+		return -1;
+	}
+	SwooleAIO.callback = aio_bench_callback;
+
+	aio_bench_block = block;
+	aio_bench_random = random;
+	aio_bench_total = total;
+	aio_bench_submitted = 0;
+	aio_bench_finished = 0;
+	srand(1);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < AIO_BENCH_DEPTH && i < total; i++)
+	{
+		aio_bench_submit(fd, aio_bench_buffers + (size_t) i * block);
+	}
+	SwooleG.running = 1;
+	reactor.wait(&reactor, NULL);
+	gettimeofday(&end, NULL);
+
+	SwooleAIO.destroy();
+	reactor.free(&reactor);
+	return (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+}
+
+/**
+ * random 4K reads and sequential 1M reads, thread pool against io_uring, page cache warm
+ */
+swUnitTest(aio_bench)
+{
+	char *test_file = "aio_bench_file";
+	char *block;
+	int fd, i;
+	double t;
+
+	fd = open(test_file, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		perror("open");
+		return 3;
+	}
+	block = malloc(BUF_SIZE);
+	memset(block, 'A', BUF_SIZE);
+	for (i = 0; i < AIO_BENCH_FILE_SIZE / BUF_SIZE; i++)
+	{
+		if (write(fd, block, BUF_SIZE) != BUF_SIZE)
+		{
+			perror("write");
+			return 4;
+		}
+	}
+	free(block);
+	aio_bench_buffers = malloc((size_t) AIO_BENCH_DEPTH * BUF_SIZE);
+
+	t = aio_bench_run(SW_AIO_BASE, fd, 4096, 100000, 1);
+	printf("thread pool: random 4K read x 100000, %f sec\n", t);
+	t = aio_bench_run(SW_AIO_BASE, fd, BUF_SIZE, 1024, 0);
+	printf("thread pool: sequential 1M read x 1024, %f sec\n", t);
+
+#ifdef HAVE_IO_URING
+	t = aio_bench_run(SW_AIO_URING, fd, 4096, 100000, 1);
+	printf("io_uring: random 4K read x 100000, %f sec\n", t);
+	t = aio_bench_run(SW_AIO_URING, fd, BUF_SIZE, 1024, 0);
+	printf("io_uring: sequential 1M read x 1024, %f sec\n", t);
+#endif
+
+	free(aio_bench_buffers);
+	close(fd);
+	unlink(test_file);
+	return 0;
+}
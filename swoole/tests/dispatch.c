@@ -0,0 +1,156 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "swoole.h"
+#include "Server.h"
+#include "tests.h"
+#include <math.h>
+
+#define DISPATCH_SIM_WORKERS     8
+#define DISPATCH_SIM_REQUESTS    200000
+#define DISPATCH_SIM_SESSIONS    1000
+#define DISPATCH_SIM_LOAD        0.85
+
+typedef struct
+{
+    double *finish;
+    uint32_t head;
+    uint32_t tail;
+    double last_finish;
+} dispatch_sim_worker;
+
+static double dispatch_sim_random()
+{
+    return (rand() + 1.0) / (RAND_MAX + 2.0);
+}
+
+/**
+ * 90% of requests take 1ms, 10% take 50ms
+ */
+static double dispatch_sim_service_time()
+{
+    return dispatch_sim_random() < 0.9 ? 0.001 : 0.050;
+}
+
+static int dispatch_sim_compare(const void *a, const void *b)
+{
+    double x = *(double *) a, y = *(double *) b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static void dispatch_sim_run(int dispatch_mode, char *name)
+{
+    swServer serv;
+    swWorker workers[DISPATCH_SIM_WORKERS];
+    dispatch_sim_worker sim[DISPATCH_SIM_WORKERS];
+    double *latency = sw_malloc(sizeof(double) * DISPATCH_SIM_REQUESTS);
+    double mean_service = 0.9 * 0.001 + 0.1 * 0.050;
+    double rate = DISPATCH_SIM_LOAD * DISPATCH_SIM_WORKERS / mean_service;
+    double now = 0, sum = 0;
+    uint32_t i, w, depth, max_depth = 0;
+
+    bzero(&serv, sizeof(serv));
+    bzero(workers, sizeof(workers));
+    serv.worker_num = DISPATCH_SIM_WORKERS;
+    serv.workers = workers;
+    serv.dispatch_mode = dispatch_mode;
+
+    for (w = 0; w < DISPATCH_SIM_WORKERS; w++)
+    {
+        sim[w].finish = sw_malloc(sizeof(double) * DISPATCH_SIM_REQUESTS);
+        sim[w].head = sim[w].tail = 0;
+        sim[w].last_finish = 0;
+    }
+
+    srand(1);
+    for (i = 0; i < DISPATCH_SIM_REQUESTS; i++)
+    {
+        now += -log(dispatch_sim_random()) / rate;
+        //retire finished requests, the worker reports them like swWorker_onTask does
+        for (w = 0; w < DISPATCH_SIM_WORKERS; w++)
+        {
+            while (sim[w].head < sim[w].tail && sim[w].finish[sim[w].head] <= now)
+            {
+                sim[w].head++;
+                swServer_worker_request_end(&serv, w);
+            }
+        }
+
+        w = swServer_worker_schedule(&serv, 3 + rand() % DISPATCH_SIM_SESSIONS);
+        double start = sim[w].last_finish > now ? sim[w].last_finish : now;
+        sim[w].last_finish = start + dispatch_sim_service_time();
+        sim[w].finish[sim[w].tail++] = sim[w].last_finish;
+        latency[i] = sim[w].last_finish - now;
+        sum += latency[i];
+
+        depth = sim[w].tail - sim[w].head;
+        if (depth > max_depth)
+        {
+            max_depth = depth;
+        }
+    }
+
+    qsort(latency, DISPATCH_SIM_REQUESTS, sizeof(double), dispatch_sim_compare);
+    printf("%-10s mean=%7.2fms p99=%8.2fms p999=%8.2fms max_queue=%u\n", name, sum / DISPATCH_SIM_REQUESTS * 1000,
+            latency[DISPATCH_SIM_REQUESTS * 99 / 100] * 1000, latency[DISPATCH_SIM_REQUESTS * 999 / 1000] * 1000,
+            max_depth);
+
+    for (w = 0; w < DISPATCH_SIM_WORKERS; w++)
+    {
+        sw_free(sim[w].finish);
+    }
+    sw_free(latency);
+}
+
+/**
+ * fraction of keys that move to another worker when worker_num grows by one
+ */
+static double dispatch_sim_remap(int dispatch_mode, uint32_t worker_num)
+{
+    swServer serv;
+    uint32_t key, moved = 0, n = 1000000;
+
+    bzero(&serv, sizeof(serv));
+    serv.dispatch_mode = dispatch_mode;
+
+    for (key = 3; key < n + 3; key++)
+    {
+        serv.worker_num = worker_num;
+        uint32_t before = swServer_worker_schedule(&serv, key * 2654435761u);
+        serv.worker_num = worker_num + 1;
+        if (swServer_worker_schedule(&serv, key * 2654435761u) != before)
+        {
+            moved++;
+        }
+    }
+    return (double) moved / n;
+}
+
+swUnitTest(dispatch_test)
+{
+    printf("%d workers, load %.0f%%, service time 1ms(90%%)/50ms(10%%)\n", DISPATCH_SIM_WORKERS,
+            DISPATCH_SIM_LOAD * 100);
+    dispatch_sim_run(SW_DISPATCH_FDMOD, "fdmod");
+    dispatch_sim_run(SW_DISPATCH_ROUND, "round");
+    dispatch_sim_run(SW_DISPATCH_LEASTREQ, "leastreq");
+
+    double mod = dispatch_sim_remap(SW_DISPATCH_UIDMOD, DISPATCH_SIM_WORKERS);
+    double jump = dispatch_sim_remap(SW_DISPATCH_UIDHASH, DISPATCH_SIM_WORKERS);
+    printf("worker_num %d -> %d: uidmod remaps %.1f%% of keys, uidhash remaps %.1f%%\n", DISPATCH_SIM_WORKERS,
+            DISPATCH_SIM_WORKERS + 1, mod * 100, jump * 100);
+
+    return jump < 1.5 / (DISPATCH_SIM_WORKERS + 1) ? 0 : 1;
+}
@@ -2,6 +2,7 @@
 #include "swoole.h"
 #include "Server.h"
 #include "rbtree.h"
+#include "table.h"
 #include <netinet/tcp.h>
 #include "tests.h"
 
@@ -19,6 +20,45 @@ swUnitTest(type_test1)
 	return 0;
 }
 
+swUnitTest(memfind_test)
+{
+	char buf[1024];
+	char *needles[] = {"\n", "\r\n", "\r\n\r\n", "--boundary--"};
+	int i, j, k, n;
+
+	for (i = 0; i < 10000; i++)
+	{
+		char *needle = needles[i % 4];
+		int needle_length = strlen(needle);
+		int length = rand() % sizeof(buf);
+		int expect = -1;
+
+		for (j = 0; j < length; j++)
+		{
+			buf[j] = "ab-\r\n"[rand() % 5];
+		}
+		if (length > needle_length && rand() % 2)
+		{
+			memcpy(buf + rand() % (length - needle_length), needle, needle_length);
+		}
+		for (k = 0; k + needle_length <= length; k++)
+		{
+			if (memcmp(buf + k, needle, needle_length) == 0)
+			{
+				expect = k;
+				break;
+			}
+		}
+		n = swoole_memfind(buf, length, needle, needle_length);
+		if (n != expect)
+		{
+			printf("swoole_memfind(%s) = %d, expect %d\n", needle, n, expect);
+			return 1;
+		}
+	}
+	return 0;
+}
+
 swUnitTest(hashmap_test1)
 {
 	swHashMap *hm = swHashMap_new(16, NULL);
@@ -141,6 +181,140 @@ swUnitTest(chan_test)
 	return 0;
 }
 
+#define CHAN_BENCH_N        1000000
+#define CHAN_BENCH_ITEM     64
+#define CHAN_BENCH_BATCH    16
+
+static sw_atomic_t *chan_bench_received;
+
+static void chan_bench_producer(swChannel *chan, int flags, int n, int batch)
+{
+	char item[CHAN_BENCH_ITEM];
+	void *items[CHAN_BENCH_BATCH];
+	int lengths[CHAN_BENCH_BATCH];
+	int i, j, ret;
+
+	memset(item, 'A', sizeof(item));
+	for (j = 0; j < CHAN_BENCH_BATCH; j++)
+	{
+		items[j] = item;
+		lengths[j] = sizeof(item);
+	}
+	for (i = 0; i < n; i += ret)
+	{
+		if (batch)
+		{
+			ret = swChannel_push_batch(chan, items, lengths, n - i < CHAN_BENCH_BATCH ? n - i : CHAN_BENCH_BATCH);
+		}
+		else
+		{
+			ret = swChannel_push(chan, item, sizeof(item)) < 0 ? 0 : 1;
+		}
+		if (ret == 0)
+		{
+			swYield();
+		}
+		else if (flags & SW_CHAN_NOTIFY)
+		{
+			swChannel_notify(chan);
+		}
+	}
+}
+
+static int chan_bench_consumer(swChannel *chan, int flags, int batch)
+{
+	char buf[CHAN_BENCH_ITEM * CHAN_BENCH_BATCH];
+	int lengths[CHAN_BENCH_BATCH];
+	int ret;
+
+	while (*chan_bench_received < CHAN_BENCH_N)
+	{
+		if (flags & SW_CHAN_NOTIFY)
+		{
+			swChannel_wait(chan);
+			ret = swChannel_pop(chan, buf, sizeof(buf)) < 0 ? 0 : 1;
+		}
+		else if (batch)
+		{
+			ret = swChannel_pop_batch(chan, buf, sizeof(buf), lengths, CHAN_BENCH_BATCH);
+			if (ret == 0)
+			{
+				ret = swChannel_pop_wait(chan, buf, sizeof(buf), 10) < 0 ? 0 : 1;
+			}
+		}
+		else
+		{
+			ret = swChannel_pop_wait(chan, buf, sizeof(buf), 10) < 0 ? 0 : 1;
+		}
+		if (ret > 0 && buf[CHAN_BENCH_ITEM - 1] != 'A')
+		{
+			return SW_ERR;
+		}
+		sw_atomic_fetch_add(chan_bench_received, ret);
+	}
+	return SW_OK;
+}
+
+/**
+ * producers and consumers in separate processes, the channel in shared memory
+ */
+static double chan_bench_run(int flags, int producer_num, int consumer_num, int batch)
+{
+	swChannel *chan = swChannel_new(1024 * 1024, CHAN_BENCH_ITEM * CHAN_BENCH_BATCH, flags | SW_CHAN_SHM);
+	double start = swoole_microtime();
+	int i, status, failed = 0;
+	pid_t pid;
+
+	if (chan == NULL)
+	{
+		return -1;
+	}
+	if (chan_bench_received == NULL)
+	{
+		chan_bench_received = sw_shm_malloc(sizeof(sw_atomic_t));
+	}
+	*chan_bench_received = 0;
+	for (i = 0; i < producer_num + consumer_num; i++)
+	{
+		pid = fork();
+		if (pid < 0)
+		{
+			return -1;
+		}
+		else if (pid > 0)
+		{
+			continue;
+		}
+		if (i < producer_num)
+		{
+			chan_bench_producer(chan, flags, CHAN_BENCH_N / producer_num, batch);
+			exit(0);
+		}
+		exit(chan_bench_consumer(chan, flags, batch) == SW_OK ? 0 : 1);
+	}
+	for (i = 0; i < producer_num + consumer_num; i++)
+	{
+		wait(&status);
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		{
+			failed = 1;
+		}
+	}
+	swChannel_free(chan);
+	return failed ? -1 : swoole_microtime() - start;
+}
+
+swUnitTest(chan_bench_test)
+{
+	printf("mutex + eventfd, 1:1        %f sec\n", chan_bench_run(SW_CHAN_LOCK | SW_CHAN_NOTIFY, 1, 1, 0));
+	printf("spsc + futex, 1:1           %f sec\n", chan_bench_run(SW_CHAN_SPSC, 1, 1, 0));
+	printf("spsc + futex, 1:1, batch    %f sec\n", chan_bench_run(SW_CHAN_SPSC, 1, 1, 1));
+	printf("mpmc + futex, 1:1           %f sec\n", chan_bench_run(SW_CHAN_MPMC, 1, 1, 0));
+	printf("mpmc + futex, 4:2           %f sec\n", chan_bench_run(SW_CHAN_MPMC, 4, 2, 0));
+	printf("mpmc + futex, 4:2, batch    %f sec\n", chan_bench_run(SW_CHAN_MPMC, 4, 2, 1));
+	return 0;
+}
+
 /**
  * HashTable Test
  */
@@ -166,6 +340,119 @@ swUnitTest(ds_test2)
 	return 0;
 }
 
+#define FLATMAP_BENCH_N    (1024 * 1024)
+
+swUnitTest(flatmap_test)
+{
+	swHashMap *hm = swHashMap_new(SW_HASHMAP_INIT_BUCKET_N, NULL);
+	swFlatMap *fm = swFlatMap_new(SW_HASHMAP_INIT_BUCKET_N, NULL);
+	uint64_t i, key;
+	long sum1 = 0, sum2 = 0;
+	double t;
+	char skey[32];
+	int len;
+
+	//correctness against swHashMap with a mix of deletes and moves
+	for (i = 1; i <= 100000; i++)
+	{
+		swHashMap_add_int(hm, i, (void *) i);
+		swFlatMap_add_int(fm, i, (void *) i);
+		if (i % 3 == 0)
+		{
+			swHashMap_del_int(hm, i / 3);
+			swFlatMap_del_int(fm, i / 3);
+		}
+		if (i % 7 == 0)
+		{
+			swHashMap_move_int(hm, i, i + 1000000);
+			swFlatMap_move_int(fm, i, i + 1000000);
+		}
+	}
+	for (i = 0; i < 1200000; i++)
+	{
+		if (swHashMap_find_int(hm, i) != swFlatMap_find_int(fm, i))
+		{
+			printf("find_int(%ld) mismatch\n", (long) i);
+			return 1;
+		}
+	}
+	for (i = 0; i < 10000; i++)
+	{
+		len = sprintf(skey, i % 2 ? "k%ld" : "session-key-%ld", (long) i);
+		swFlatMap_add(fm, skey, len, (void *) (i + 1));
+	}
+	for (i = 0; i < 10000; i++)
+	{
+		len = sprintf(skey, i % 2 ? "k%ld" : "session-key-%ld", (long) i);
+		if (swFlatMap_find(fm, skey, len) != (void *) (i + 1))
+		{
+			printf("find(%s) failed\n", skey);
+			return 2;
+		}
+	}
+	swHashMap_free(hm);
+	swFlatMap_free(fm);
+
+	hm = swHashMap_new(SW_HASHMAP_INIT_BUCKET_N, NULL);
+	fm = swFlatMap_new(SW_HASHMAP_INIT_BUCKET_N, NULL);
+
+	t = swoole_microtime();
+	for (i = 0; i < FLATMAP_BENCH_N; i++)
+	{
+		swHashMap_add_int(hm, i * 7, (void *) (i + 1));
+	}
+	printf("swHashMap insert:  %.3fs\n", swoole_microtime() - t);
+	t = swoole_microtime();
+	for (i = 0; i < FLATMAP_BENCH_N; i++)
+	{
+		swFlatMap_add_int(fm, i * 7, (void *) (i + 1));
+	}
+	printf("swFlatMap insert:  %.3fs\n", swoole_microtime() - t);
+
+	t = swoole_microtime();
+	for (i = 0; i < FLATMAP_BENCH_N; i++)
+	{
+		sum1 += (long) swHashMap_find_int(hm, ((i * 2654435761U) % FLATMAP_BENCH_N) * 7);
+	}
+	printf("swHashMap find:    %.3fs\n", swoole_microtime() - t);
+	t = swoole_microtime();
+	for (i = 0; i < FLATMAP_BENCH_N; i++)
+	{
+		sum2 += (long) swFlatMap_find_int(fm, ((i * 2654435761U) % FLATMAP_BENCH_N) * 7);
+	}
+	printf("swFlatMap find:    %.3fs\n", swoole_microtime() - t);
+
+	t = swoole_microtime();
+	while (swHashMap_each_int(hm, &key))
+	{
+		sum1 += key;
+	}
+	printf("swHashMap iterate: %.3fs\n", swoole_microtime() - t);
+	t = swoole_microtime();
+	while (swFlatMap_each_int(fm, &key))
+	{
+		sum2 += key;
+	}
+	printf("swFlatMap iterate: %.3fs\n", swoole_microtime() - t);
+
+	t = swoole_microtime();
+	for (i = 0; i < FLATMAP_BENCH_N; i++)
+	{
+		swHashMap_del_int(hm, i * 7);
+	}
+	printf("swHashMap delete:  %.3fs\n", swoole_microtime() - t);
+	t = swoole_microtime();
+	for (i = 0; i < FLATMAP_BENCH_N; i++)
+	{
+		swFlatMap_del_int(fm, i * 7);
+	}
+	printf("swFlatMap delete:  %.3fs\n", swoole_microtime() - t);
+
+	swHashMap_free(hm);
+	swFlatMap_free(fm);
+	return sum1 == sum2 ? 0 : 3;
+}
+
 swUnitTest(rbtree_test)
 {
 	swRbtree *tree = swRbtree_new();
@@ -179,3 +466,227 @@ swUnitTest(rbtree_test)
 	printf("find_n %d\n", (int) swRbtree_find(tree, 17532));
 	return 0;
 }
+
+static void table_find_count(swTable *table, swTableRow *row, void *udata)
+{
+	(*(int *) udata)++;
+}
+
+swUnitTest(table_find_test)
+{
+	int i, n, m, count;
+	char key[32];
+	int64_t value;
+	swTableBucket *bucket;
+	swTableRow *row;
+	swTable_condition cond;
+
+	swTable *table = swTable_new(16384);
+	swTableColumn_add(table, SW_STRL("room_id")-1, SW_TABLE_INT, 8, SW_TABLE_FLAG_INDEX);
+	swTableColumn_add(table, SW_STRL("score")-1, SW_TABLE_INT, 8, SW_TABLE_FLAG_COLUMNAR);
+	swTableColumn_add(table, SW_STRL("score_rows")-1, SW_TABLE_INT, 8, 0);
+	if (swTable_create(table) < 0)
+	{
+		return 1;
+	}
+	swTableColumn *room_id = swTableColumn_get(table, SW_STRL("room_id")-1);
+	swTableColumn *score = swTableColumn_get(table, SW_STRL("score")-1);
+	swTableColumn *score_rows = swTableColumn_get(table, SW_STRL("score_rows")-1);
+
+	for (i = 0; i < 10000; i++)
+	{
+		n = sprintf(key, "user_%d", i);
+		row = swTableRow_set(table, key, n, &bucket);
+		value = i % 100;
+		swTableRow_set_value(row, room_id, &value, 0);
+		value = i;
+		swTableRow_set_value(row, score, &value, 0);
+		swTableRow_set_value(row, score_rows, &value, 0);
+		swTableRow_commit(table, row, bucket);
+	}
+	//move user_7 to room 8
+	row = swTableRow_set(table, SW_STRL("user_7")-1, &bucket);
+	value = 8;
+	swTableRow_set_value(row, room_id, &value, 0);
+	swTableRow_commit(table, row, bucket);
+	swTableRow_del(table, SW_STRL("user_107")-1);
+
+	bzero(&cond, sizeof(cond));
+	cond.column = room_id;
+	cond.op = SW_TABLE_FIND_EQ;
+	cond.lval = 7;
+	count = 0;
+	n = swTable_find(table, &cond, table_find_count, &count);
+	printf("room_id=7: %d rows\n", n);
+	if (n != 98 || count != n)
+	{
+		return 2;
+	}
+
+	cond.column = score;
+	cond.op = SW_TABLE_FIND_GT;
+	cond.lval = 9000;
+	double t = swoole_microtime();
+	for (i = 0; i < 1000; i++)
+	{
+		n = swTable_find(table, &cond, table_find_count, &count);
+	}
+	printf("columnar score>9000: %d rows, %.3fs\n", n, swoole_microtime() - t);
+
+	cond.column = score_rows;
+	t = swoole_microtime();
+	for (i = 0; i < 1000; i++)
+	{
+		m = swTable_find(table, &cond, table_find_count, &count);
+	}
+	printf("row scan score>9000: %d rows, %.3fs\n", m, swoole_microtime() - t);
+
+	swTable_free(table);
+	return n == 999 && m == 999 ? 0 : 3;
+}
+
+#define RQ_TEST_N    1000000
+
+typedef struct
+{
+	swRingQueue *queue;
+	int id;
+	int num;
+	int producer_num;
+	uint64_t sum;
+	sw_atomic_t *popped;
+	uint8_t *seen;
+	int dup;
+} rq_worker;
+
+static void* rq_producer(void *arg)
+{
+	rq_worker *w = arg;
+	uintptr_t value;
+	int i;
+
+	for (i = 0; i < w->num; i++)
+	{
+		//never push NULL, value - 1 is the global serial number
+		value = (uintptr_t) i * w->producer_num + w->id + 1;
+		while (swRingQueue_push(w->queue, (void *) value) < 0)
+		{
+			swYield();
+		}
+	}
+	return NULL;
+}
+
+static void* rq_consumer(void *arg)
+{
+	rq_worker *w = arg;
+	void *data;
+
+	while (*w->popped < RQ_TEST_N)
+	{
+		if (swRingQueue_pop(w->queue, &data) < 0)
+		{
+			swYield();
+			continue;
+		}
+		sw_atomic_fetch_add(w->popped, 1);
+		w->sum += (uintptr_t) data;
+		if (w->seen)
+		{
+			if (w->seen[(uintptr_t) data - 1])
+			{
+				w->dup++;
+			}
+			w->seen[(uintptr_t) data - 1] = 1;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * every value pushed by producer_num threads is popped exactly once by consumer_num threads
+ */
+static double rq_run(swRingQueue *queue, int producer_num, int consumer_num, uint8_t *seen, int *error)
+{
+	pthread_t threads[16];
+	rq_worker workers[16];
+	sw_atomic_t popped = 0;
+	uint64_t sum = 0, expect = (uint64_t) RQ_TEST_N * (RQ_TEST_N + 1) / 2;
+	double start = swoole_microtime();
+	int i, n = producer_num + consumer_num, dup = 0;
+
+	for (i = 0; i < n; i++)
+	{
+		bzero(&workers[i], sizeof(rq_worker));
+		workers[i].queue = queue;
+		workers[i].id = i;
+		workers[i].num = RQ_TEST_N / producer_num;
+		workers[i].producer_num = producer_num;
+		workers[i].popped = &popped;
+		workers[i].seen = seen;
+		pthread_create(&threads[i], NULL, i < producer_num ? rq_producer : rq_consumer, &workers[i]);
+	}
+	for (i = 0; i < n; i++)
+	{
+		pthread_join(threads[i], NULL);
+		sum += workers[i].sum;
+		dup += workers[i].dup;
+	}
+	*error = (sum != expect || dup > 0 || !swRingQueue_empty(queue));
+	return swoole_microtime() - start;
+}
+
+swUnitTest(ringqueue_test)
+{
+	swRingQueue queue;
+	uint8_t *seen = sw_calloc(RQ_TEST_N, 1);
+	int error = 0, ret = 0;
+	void *data;
+	int counts[][2] = {{1, 1}, {2, 2}, {4, 1}, {1, 4}, {4, 4}};
+	int i;
+
+	if (swRingQueue_init(&queue, 1000) < 0)
+	{
+		return 1;
+	}
+	//the capacity is rounded up to 1024
+	for (i = 0; swRingQueue_push(&queue, (void *) (uintptr_t) (i + 1)) == SW_OK; i++);
+	if (i != 1024 || swRingQueue_pop(&queue, &data) < 0 || data != (void *) 1)
+	{
+		printf("capacity error: %d\n", i);
+		return 2;
+	}
+	while (swRingQueue_pop(&queue, &data) == SW_OK);
+
+	for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+	{
+		memset(seen, 0, RQ_TEST_N);
+		rq_run(&queue, counts[i][0], counts[i][1], seen, &error);
+		printf("producer=%d, consumer=%d: %s\n", counts[i][0], counts[i][1], error ? "FAIL" : "OK");
+		ret |= error;
+	}
+	swRingQueue_free(&queue);
+	sw_free(seen);
+	return ret;
+}
+
+swUnitTest(ringqueue_bench_test)
+{
+	swRingQueue *queue = swRingQueue_new(4096, 1);
+	int counts[][2] = {{1, 1}, {2, 2}, {4, 4}, {8, 8}};
+	int error, i;
+	double t;
+
+	if (queue == NULL)
+	{
+		return 1;
+	}
+	for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+	{
+		t = rq_run(queue, counts[i][0], counts[i][1], NULL, &error);
+		printf("producer=%d, consumer=%d: %d ops in %f sec, %.2f Mops/s%s\n", counts[i][0], counts[i][1], RQ_TEST_N,
+				t, RQ_TEST_N / t / 1000000, error ? " FAIL" : "");
+	}
+	swRingQueue_free(queue);
+	return 0;
+}
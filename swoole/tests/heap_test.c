@@ -65,3 +65,131 @@ swUnitTest(heap_test1)
 
     return 0;
 }
+
+/**
+ * every millisecond TIMER_BENCH_RATE requests start with a timeout of 5-6s,
+ * 98% of them finish after 20ms and cancel the timer, the rest expire.
+ */
+#define TIMER_BENCH_MSEC      2000
+#define TIMER_BENCH_RATE      500
+#define TIMER_BENCH_FINISH    20
+#define TIMER_BENCH_TIMEOUT   5000
+
+typedef struct
+{
+	swHeap_node *heap_node;
+	swTimeWheel_node wheel_node;
+	int64_t exec_msec;
+	int64_t fired_msec;
+} timer_bench_node;
+
+static int timer_bench_fired;
+static int64_t timer_bench_now;
+
+static void timer_bench_onTimeout(swTimeWheel *wheel, swTimeWheel_node *node)
+{
+	timer_bench_node *tn = node->data;
+	tn->fired_msec = timer_bench_now;
+	timer_bench_fired++;
+}
+
+static int timer_bench_run(timer_bench_node *nodes, int use_wheel)
+{
+	swHeap *heap = swHeap_new(1024, SW_MIN_HEAP);
+	swTimeWheel *wheel = swTimeWheel_new(1, 0);
+	swHeap_node *top;
+	timer_bench_node *tn;
+	int64_t ms;
+	int i, id;
+
+	timer_bench_fired = 0;
+	for (ms = 0; ms < TIMER_BENCH_MSEC + TIMER_BENCH_TIMEOUT * 2; ms++)
+	{
+		timer_bench_now = ms;
+		if (ms < TIMER_BENCH_MSEC)
+		{
+			for (i = 0; i < TIMER_BENCH_RATE; i++)
+			{
+				tn = &nodes[ms * TIMER_BENCH_RATE + i];
+				if (use_wheel)
+				{
+					tn->wheel_node.data = tn;
+					swTimeWheel_add(wheel, &tn->wheel_node, tn->exec_msec);
+				}
+				else
+				{
+					tn->heap_node = swHeap_push(heap, tn->exec_msec, tn);
+				}
+			}
+		}
+		if (ms >= TIMER_BENCH_FINISH && ms < TIMER_BENCH_MSEC + TIMER_BENCH_FINISH)
+		{
+			for (i = 0; i < TIMER_BENCH_RATE; i++)
+			{
+				id = (ms - TIMER_BENCH_FINISH) * TIMER_BENCH_RATE + i;
+				if (id % 50 == 0)
+				{
+					continue;
+				}
+				if (use_wheel)
+				{
+					swTimeWheel_del(wheel, &nodes[id].wheel_node);
+				}
+				else
+				{
+					swHeap_remove(heap, nodes[id].heap_node);
+					sw_free(nodes[id].heap_node);
+				}
+			}
+		}
+		if (use_wheel)
+		{
+			swTimeWheel_expire(wheel, ms, timer_bench_onTimeout);
+		}
+		else
+		{
+			while ((top = swHeap_top(heap)) && top->priority <= ms)
+			{
+				tn = swHeap_pop(heap);
+				tn->fired_msec = ms;
+				timer_bench_fired++;
+			}
+		}
+	}
+	swHeap_free(heap);
+	swTimeWheel_free(wheel);
+	return timer_bench_fired;
+}
+
+swUnitTest(timer_bench_test)
+{
+	int n = TIMER_BENCH_MSEC * TIMER_BENCH_RATE;
+	timer_bench_node *nodes = sw_calloc(n, sizeof(timer_bench_node));
+	double t;
+	int i, fired;
+
+	for (i = 0; i < n; i++)
+	{
+		nodes[i].exec_msec = i / TIMER_BENCH_RATE + TIMER_BENCH_TIMEOUT + swoole_system_random(0, 1000);
+	}
+
+	t = swoole_microtime();
+	fired = timer_bench_run(nodes, 0);
+	printf("swHeap:      %d timers, %d expired, %.3fs\n", n, fired, swoole_microtime() - t);
+
+	t = swoole_microtime();
+	fired = timer_bench_run(nodes, 1);
+	printf("swTimeWheel: %d timers, %d expired, %.3fs\n", n, fired, swoole_microtime() - t);
+
+	//the wheel must fire every remaining timer exactly on time
+	for (i = 0; i < n; i += 50)
+	{
+		if (nodes[i].fired_msec != nodes[i].exec_msec)
+		{
+			printf("timer#%d expired at %ld, expect %ld\n", i, (long) nodes[i].fired_msec, (long) nodes[i].exec_msec);
+			return 1;
+		}
+	}
+	sw_free(nodes);
+	return fired == n / 50 ? 0 : 2;
+}
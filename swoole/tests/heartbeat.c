@@ -0,0 +1,180 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+#include "swoole.h"
+#include "Server.h"
+#include "tests.h"
+
+#define HEARTBEAT_TEST_CONN    2000
+#define HEARTBEAT_TEST_IDLE    600
+
+/**
+ * fds of the idle connections of all wheels, as a bitmap, the same check as the full scan
+ */
+static int heartbeat_test_check(swServer *serv, time_t now, int expire, const char *step)
+{
+	char found[HEARTBEAT_TEST_CONN];
+	swConnection *conn;
+	int i, fd, n = 0, error = 0;
+
+	swArray *fds = swArray_new(1024, sizeof(int));
+	bzero(found, sizeof(found));
+	for (i = 0; i < serv->idle_wheel_num; i++)
+	{
+		if (expire)
+		{
+			swServer_heartbeat_expire(serv, i, now, fds);
+		}
+		else
+		{
+			swServer_heartbeat_idle(serv, i, now, fds);
+		}
+	}
+	for (i = 0; i < fds->item_num; i++)
+	{
+		fd = *(int *) swArray_fetch(fds, i);
+		if (found[fd])
+		{
+			printf("%s: fd#%d reported twice\n", step, fd);
+			error = 1;
+		}
+		found[fd] = 1;
+	}
+	for (fd = 0; fd < HEARTBEAT_TEST_CONN; fd++)
+	{
+		conn = &serv->connection_list[fd];
+		if (found[fd] != (conn->active && conn->last_time < now - serv->heartbeat_idle_time))
+		{
+			printf("%s: fd#%d last_time=%ld now=%ld, found=%d\n", step, fd, (long) conn->last_time, (long) now, found[fd]);
+			error = 1;
+		}
+		n += found[fd];
+	}
+	swArray_free(fds);
+	printf("%s: %d idle connections\n", step, n);
+	return error;
+}
+
+swUnitTest(heartbeat_test)
+{
+	swServer serv;
+	swConnection *conn;
+	//the wheels start at the current time
+	time_t now = time(NULL), start = now;
+	uint32_t num[2], i;
+	uint64_t current[2];
+	int fd;
+
+	bzero(&serv, sizeof(serv));
+	serv.factory_mode = SW_MODE_BASE;
+	serv.worker_num = 2;
+	serv.heartbeat_idle_time = HEARTBEAT_TEST_IDLE;
+	serv.heartbeat_check_interval = 60;
+	serv.connection_list = sw_calloc(HEARTBEAT_TEST_CONN, sizeof(swConnection));
+
+	if (swServer_heartbeat_init(&serv) < 0)
+	{
+		return 1;
+	}
+	//spread over the root level and the first levels of the wheels
+	for (fd = 0; fd < HEARTBEAT_TEST_CONN; fd++)
+	{
+		conn = &serv.connection_list[fd];
+		conn->fd = fd;
+		conn->active = 1;
+		conn->from_id = fd % serv.worker_num;
+		conn->last_time = now - swoole_system_random(0, HEARTBEAT_TEST_IDLE * 3);
+		swServer_heartbeat_add(&serv, conn);
+	}
+
+	//swoole_server::heartbeat() must not move anything
+	for (i = 0; i < serv.idle_wheel_num; i++)
+	{
+		num[i] = serv.idle_wheels[i].wheel.num;
+		current[i] = serv.idle_wheels[i].wheel.current;
+	}
+	if (heartbeat_test_check(&serv, now, 0, "idle") || heartbeat_test_check(&serv, now, 0, "idle again"))
+	{
+		return 2;
+	}
+	for (i = 0; i < serv.idle_wheel_num; i++)
+	{
+		if (num[i] != serv.idle_wheels[i].wheel.num || current[i] != serv.idle_wheels[i].wheel.current)
+		{
+			printf("wheel#%d was changed by swServer_heartbeat_idle\n", i);
+			return 3;
+		}
+	}
+
+	//received data, closed by the server, closed with disable_notify
+	for (fd = 0; fd < HEARTBEAT_TEST_CONN; fd += 7)
+	{
+		serv.connection_list[fd].last_time = now;
+	}
+	for (fd = 1; fd < HEARTBEAT_TEST_CONN; fd += 11)
+	{
+		swServer_heartbeat_del(&serv, &serv.connection_list[fd]);
+		serv.connection_list[fd].active = 0;
+	}
+	for (fd = 2; fd < HEARTBEAT_TEST_CONN; fd += 13)
+	{
+		serv.connection_list[fd].active = 0;
+	}
+	if (heartbeat_test_check(&serv, now, 0, "idle after close"))
+	{
+		return 4;
+	}
+
+	//the reactor check, then the user call between two checks must see the same connections
+	if (heartbeat_test_check(&serv, now, 1, "expire") || heartbeat_test_check(&serv, now, 0, "idle after expire"))
+	{
+		return 5;
+	}
+	for (now += 30; now < start + HEARTBEAT_TEST_IDLE * 2; now += 30)
+	{
+		if (heartbeat_test_check(&serv, now, 0, "idle"))
+		{
+			return 6;
+		}
+		if ((now - start) % serv.heartbeat_check_interval == 0 && heartbeat_test_check(&serv, now, 1, "expire"))
+		{
+			return 6;
+		}
+	}
+
+	//the slot of a connection closed with disable_notify is taken by an accept of the other worker
+	fd = 4;
+	conn = &serv.connection_list[fd];
+	conn->active = 1;
+	conn->from_id = 0;
+	conn->last_time = now;
+	swServer_heartbeat_add(&serv, conn);
+	conn->active = 0;
+	num[0] = serv.idle_wheels[0].wheel.num;
+	num[1] = serv.idle_wheels[1].wheel.num;
+	conn->active = 1;
+	conn->from_id = 1;
+	swServer_heartbeat_add(&serv, conn);
+	if (serv.idle_wheels[0].wheel.num != num[0] - 1 || serv.idle_wheels[1].wheel.num != num[1] + 1
+			|| conn->idle_node.data != &serv.idle_wheels[1])
+	{
+		printf("fd#%d is still on the wheel of its last worker\n", fd);
+		return 7;
+	}
+
+	swServer_heartbeat_free(&serv);
+	sw_free(serv.connection_list);
+	return 0;
+}
@@ -13,9 +13,202 @@
   | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
   +----------------------------------------------------------------------+
 */
-#if 0
 #include "swoole.h"
 #include "tests.h"
+#include "http.h"
+
+static int http_parser_check(char *data, swHttp_parser *parser, swHttp_header *headers, char *expect[][2], int n)
+{
+	int i;
+	if (parser->header_num != n)
+	{
+		printf("%d headers, expect %d\n", parser->header_num, n);
+		return -1;
+	}
+	for (i = 0; i < n; i++)
+	{
+		if (headers[i].name_len != strlen(expect[i][0]) || memcmp(data + headers[i].name_offset, expect[i][0], headers[i].name_len) != 0
+				|| headers[i].value_len != strlen(expect[i][1]) || memcmp(data + headers[i].value_offset, expect[i][1], headers[i].value_len) != 0)
+		{
+			printf("header#%d: %.*s: %.*s\n", i, headers[i].name_len, data + headers[i].name_offset, headers[i].value_len,
+					data + headers[i].value_offset);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+swUnitTest(http_parser_test)
+{
+	char request[] = "POST /index.php?a=1&b=%20 HTTP/1.1\r\n"
+			"Host: www.example.com\r\n"
+			"User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/61.0.3163.100 Safari/537.36\r\n"
+			"Accept:\t text/html,application/xhtml+xml,application/xml;q=0.9,image/webp,*/*;q=0.8  \r\n"
+			"Content-Length: 11\r\n"
+			"Connection: Keep-Alive, Upgrade\n"
+			"X-Empty:\r\n"
+			"\r\n"
+			"hello world";
+	char *expect[][2] = {
+		{"Host", "www.example.com"},
+		{"User-Agent", "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/61.0.3163.100 Safari/537.36"},
+		{"Accept", "text/html,application/xhtml+xml,application/xml;q=0.9,image/webp,*/*;q=0.8"},
+		{"Content-Length", "11"},
+		{"Connection", "Keep-Alive, Upgrade"},
+		{"X-Empty", ""},
+	};
+	size_t length = sizeof(request) - 1, head_length = strstr(request, "\r\n\r\n") + 4 - request;
+	swHttp_header headers[SW_HTTP_HEADER_NUM];
+	swHttp_parser parser;
+	size_t received;
+	int i, j, ret;
+
+	//every split point of the head, the parser resumes at the last complete line
+	for (i = 0; i <= head_length; i++)
+	{
+		swHttp_parser_init(&parser, headers, SW_HTTP_HEADER_NUM);
+		ret = swHttp_parse_request(&parser, request, i);
+		if (ret != (i == head_length ? SW_HTTP_PARSE_COMPLETE : SW_HTTP_PARSE_PARTIAL))
+		{
+			printf("ret=%d for %d bytes\n", ret, i);
+			return 1;
+		}
+		for (received = i; ret == SW_HTTP_PARSE_PARTIAL; received = received + 7 > length ? length : received + 7)
+		{
+			ret = swHttp_parse_request(&parser, request, received);
+		}
+		if (ret != SW_HTTP_PARSE_COMPLETE || parser.offset != head_length || parser.method != HTTP_POST
+				|| parser.version != HTTP_VERSION_11 || parser.content_length != 11 || !swHttp_parser_keepalive(&parser)
+				|| !(parser.flags & SW_HTTP_CONNECTION_UPGRADE) || (parser.flags & SW_HTTP_UPGRADE))
+		{
+			printf("split at %d: ret=%d, offset=%d, method=%d, flags=%d\n", i, ret, parser.offset, parser.method, parser.flags);
+			return 1;
+		}
+		if (parser.path_len != 10 || memcmp(request + parser.path_offset, "/index.php", 10) != 0
+				|| parser.query_len != 9 || memcmp(request + parser.query_offset, "a=1&b=%20", 9) != 0)
+		{
+			printf("path=%.*s, query=%.*s\n", parser.path_len, request + parser.path_offset, parser.query_len,
+					request + parser.query_offset);
+			return 1;
+		}
+		if (http_parser_check(request, &parser, headers, expect, sizeof(expect) / sizeof(expect[0])) < 0)
+		{
+			return 1;
+		}
+	}
+
+	//a control character at every position of a long value, so that each lane of the vector scan is hit
+	char line[256];
+	for (i = 0; i < 100; i++)
+	{
+		for (j = 0; j < 3; j++)
+		{
+			int n = sprintf(line, "GET / HTTP/1.0\r\nX-Long: ");
+			memset(line + n, 'x', 100);
+			line[n + i] = j == 0 ? '\t' : (j == 1 ? '\x01' : '\x7f');
+			strcpy(line + n + 100, "\r\n\r\n");
+			swHttp_parser_init(&parser, headers, SW_HTTP_HEADER_NUM);
+			ret = swHttp_parse_request(&parser, line, strlen(line));
+			if (ret != (j == 0 ? SW_HTTP_PARSE_COMPLETE : SW_HTTP_PARSE_ERROR))
+			{
+				printf("control character %d at %d, ret=%d\n", line[n + i], i, ret);
+				return 1;
+			}
+			if (j == 0 && (headers[0].value_len != (i == 0 || i == 99 ? 99 : 100) || swHttp_parser_keepalive(&parser)))
+			{
+				printf("value length %d with HTAB at %d\n", headers[0].value_len, i);
+				return 1;
+			}
+		}
+	}
+
+	char *invalid[] = {
+		"get / HTTP/1.1\r\n\r\n",
+		"GETX / HTTP/1.1\r\n\r\n",
+		"GET  HTTP/1.1\r\n\r\n",
+		"GET / HTTP/2.0\r\n\r\n",
+		"GET / HTTP/1.1\rX",
+		"GET /\x01 HTTP/1.1\r\n\r\n",
+		"GET / HTTP/1.1\r\nHost : a\r\n\r\n",
+		"GET / HTTP/1.1\r\n: a\r\n\r\n",
+		"GET / HTTP/1.1\r\nHost: a\r\n folded\r\n\r\n",
+		"POST / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n",
+		"POST / HTTP/1.1\r\nContent-Length: 99999999999\r\n\r\n",
+		"POST / HTTP/1.1\r\nContent-Length: 1\r\nContent-Length: 2\r\n\r\n",
+		"POST / HTTP/1.1\r\nContent-Length: 1\r\nTransfer-Encoding: chunked\r\n\r\n",
+	};
+	for (i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+	{
+		swHttp_parser_init(&parser, headers, SW_HTTP_HEADER_NUM);
+		ret = swHttp_parse_request(&parser, invalid[i], strlen(invalid[i]));
+		if (ret != SW_HTTP_PARSE_ERROR)
+		{
+			printf("invalid request#%d is accepted, ret=%d\n", i, ret);
+			return 1;
+		}
+	}
+
+	//the reactor side keeps no header slices
+	swHttpRequest req;
+	bzero(&req, sizeof(req));
+	req.buffer = swString_new(1024);
+	swString_append_ptr(req.buffer, request, 40);
+	if (swHttpRequest_get_protocol(&req) < 0 || req.method != HTTP_POST || swHttpRequest_get_header_length(&req) == SW_OK)
+	{
+		printf("request line is not parsed.\n");
+		return 1;
+	}
+	swString_append_ptr(req.buffer, request + 40, length - 40);
+	if (swHttpRequest_get_content_length(&req) < 0 || req.content_length != 11
+			|| swHttpRequest_get_header_length(&req) < 0 || req.header_length != head_length)
+	{
+		printf("content_length=%d, header_length=%d\n", req.content_length, req.header_length);
+		return 1;
+	}
+	swString_free(req.buffer);
+	return 0;
+}
+
+#define HTTP_BENCH_REQUESTS    (1024 * 1024)
+
+swUnitTest(http_parser_bench_test)
+{
+	char request[] = "GET /wp-content/uploads/2010/03/hello-kitty-darth-vader-pink.jpg HTTP/1.1\r\n"
+			"Host: www.kittyhell.com\r\n"
+			"User-Agent: Mozilla/5.0 (Macintosh; U; Intel Mac OS X 10.6; ja-JP-mac; rv:1.9.2.3) Gecko/20100401 Firefox/3.6.3 Pathtraq/0.9\r\n"
+			"Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+			"Accept-Language: ja,en-us;q=0.7,en;q=0.3\r\n"
+			"Accept-Encoding: gzip,deflate\r\n"
+			"Accept-Charset: Shift_JIS,utf-8;q=0.7,*;q=0.7\r\n"
+			"Keep-Alive: 115\r\n"
+			"Connection: keep-alive\r\n"
+			"Cookie: wp_ozh_wsa_visits=2; wp_ozh_wsa_visit_lasttime=xxxxxxxxxx; "
+			"__utma=xxxxxxxxx.xxxxxxxxxx.xxxxxxxxxx.xxxxxxxxxx.xxxxxxxxxx.x; "
+			"__utmz=xxxxxxxxx.xxxxxxxxxx.x.x.utmccn=(referral)|utmcsr=reader.livedoor.com|utmcct=/reader/|utmcmd=referral\r\n"
+			"\r\n";
+	size_t length = sizeof(request) - 1;
+	swHttp_header headers[SW_HTTP_HEADER_NUM];
+	swHttp_parser parser;
+	long i, headers_found = 0;
+
+	double start = swoole_microtime();
+	for (i = 0; i < HTTP_BENCH_REQUESTS; i++)
+	{
+		swHttp_parser_init(&parser, headers, SW_HTTP_HEADER_NUM);
+		if (swHttp_parse_request(&parser, request, length) != SW_HTTP_PARSE_COMPLETE)
+		{
+			printf("parse error.\n");
+			return 1;
+		}
+		headers_found += parser.header_num;
+	}
+	double t = swoole_microtime() - start;
+	printf("%ld headers, %.0f requests per second, %.2f GB/s\n", headers_found, HTTP_BENCH_REQUESTS / t,
+			HTTP_BENCH_REQUESTS * length / t / 1024 / 1024 / 1024);
+	return 0;
+}
+
+#if 0
 #include "Http.h"
 
 static int http_get_path(http_parser *, const char *at, size_t length);
@@ -81,4 +274,4 @@ swUnitTest(http_test2)
     swString_free(content);
     return 0;
 }
-#endif
\ No newline at end of file
+#endif
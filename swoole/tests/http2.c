@@ -0,0 +1,203 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "swoole.h"
+#include "http2.h"
+#include "tests.h"
+
+/**
+ * walk the DATA frames in out, count the bytes of each stream and check their order and flags
+ */
+static int http2_check_frames(swString *out, swHttp2_scheduler *scheduler, char **bodies, size_t *received, int stream_num)
+{
+	char *p = out->str, *pe = out->str + out->length;
+	uint32_t length, id;
+	int flags;
+
+	while (p < pe)
+	{
+		length = swHttp2_get_length(p);
+		flags = p[4];
+		id = ntohl(*(uint32_t *) (p + 5));
+		if (p[3] != SW_HTTP2_TYPE_DATA || length > scheduler->max_frame_size || id == 0 || (id - 1) / 2 >= stream_num)
+		{
+			printf("bad frame: type=%d, length=%d, stream=%d\n", p[3], length, id);
+			return -1;
+		}
+		id = (id - 1) / 2;
+		if (memcmp(p + SW_HTTP2_FRAME_HEADER_SIZE, bodies[id] + received[id], length) != 0)
+		{
+			printf("stream#%d is corrupted at %ld\n", id * 2 + 1, received[id]);
+			return -1;
+		}
+		received[id] += length;
+		if ((flags & SW_HTTP2_FLAG_END_STREAM) && swHttp2_scheduler_find(scheduler, id * 2 + 1))
+		{
+			printf("stream#%d ended but is still queued\n", id * 2 + 1);
+			return -1;
+		}
+		p += SW_HTTP2_FRAME_HEADER_SIZE + length;
+	}
+	swString_clear(out);
+	return 0;
+}
+
+swUnitTest(http2_scheduler_test)
+{
+	swHttp2_scheduler scheduler;
+	swString *out = swString_new(1024 * 1024);
+	char *bodies[4];
+	size_t received[4] = {0};
+	size_t lengths[4] = {200000, 200000, 50000, 300000};
+	int i, j;
+
+	for (i = 0; i < 4; i++)
+	{
+		bodies[i] = malloc(lengths[i]);
+		for (j = 0; j < lengths[i]; j++)
+		{
+			bodies[i][j] = rand();
+		}
+	}
+
+	swHttp2_scheduler_init(&scheduler);
+	//stream 1 weight 16, stream 3 weight 256, stream 5 depends on stream 1
+	swHttp2_scheduler_add(&scheduler, 1, bodies[0], lengths[0]);
+	swHttp2_scheduler_add(&scheduler, 3, bodies[1], lengths[1])->weight = 256;
+	swHttp2_scheduler_add(&scheduler, 5, bodies[2], lengths[2])->dependency = 1;
+
+	//the connection window of the peer is 65535
+	swHttp2_scheduler_run(&scheduler, out, SIZE_MAX);
+	if (http2_check_frames(out, &scheduler, bodies, received, 4) < 0)
+	{
+		return 1;
+	}
+	if (received[0] + received[1] + received[2] != SW_HTTP2_DEFAULT_WINDOW || received[2] != 0 || received[1] <= received[0])
+	{
+		printf("first window: %ld %ld %ld\n", received[0], received[1], received[2]);
+		return 1;
+	}
+
+	//the connection opens up, stream 1 and 3 stop at their own window and stream 5 takes the rest
+	swHttp2_scheduler_window_update(&scheduler, 0, 1024 * 1024);
+	swHttp2_scheduler_run(&scheduler, out, SIZE_MAX);
+	if (http2_check_frames(out, &scheduler, bodies, received, 4) < 0)
+	{
+		return 1;
+	}
+	if (received[0] != SW_HTTP2_DEFAULT_WINDOW || received[1] != SW_HTTP2_DEFAULT_WINDOW || received[2] != lengths[2])
+	{
+		printf("stream windows: %ld %ld %ld\n", received[0], received[1], received[2]);
+		return 1;
+	}
+
+	//the body of stream 7 lives on the caller's side until detach
+	char *copy = malloc(lengths[3]);
+	memcpy(copy, bodies[3], lengths[3]);
+	swHttp2_scheduler_set_init_window(&scheduler, 1 << 30);
+	swHttp2_scheduler_add(&scheduler, 7, copy, lengths[3]);
+	swHttp2_scheduler_run(&scheduler, out, 100000);
+	swHttp2_scheduler_detach(&scheduler);
+	memset(copy, 0, lengths[3]);
+	free(copy);
+
+	if (swHttp2_scheduler_window_update(&scheduler, 0, SW_HTTP2_MAX_WINDOW) == SW_OK)
+	{
+		printf("window overflow is accepted.\n");
+		return 1;
+	}
+	swHttp2_scheduler_window_update(&scheduler, 0, 1 << 30);
+	swHttp2_scheduler_run(&scheduler, out, SIZE_MAX);
+	if (http2_check_frames(out, &scheduler, bodies, received, 4) < 0)
+	{
+		return 1;
+	}
+	for (i = 0; i < 4; i++)
+	{
+		if (received[i] != lengths[i])
+		{
+			printf("stream#%d: %ld of %ld bytes\n", i * 2 + 1, received[i], lengths[i]);
+			return 1;
+		}
+		free(bodies[i]);
+	}
+	if (scheduler.stream_num != 0)
+	{
+		printf("%d streams left\n", scheduler.stream_num);
+		return 1;
+	}
+	swString_free(out);
+	return 0;
+}
+
+#define HTTP2_BENCH_STREAMS      100
+#define HTTP2_BENCH_BODY_SIZE    (1024 * 1024)
+#define HTTP2_BENCH_BATCH_SIZE   (256 * 1024)
+
+/**
+ * h2load -m 100 against one connection, every stream sends a 1MB body. The peer acknowledges
+ * each batch with WINDOW_UPDATE for the connection and the streams, as a client reading at once would.
+ */
+static int http2_bench_run(uint32_t window)
+{
+	swHttp2_scheduler scheduler;
+	swString *out = swString_new(HTTP2_BENCH_BATCH_SIZE + SW_HTTP2_DEFAULT_FRAME_SIZE * 2);
+	char *body = malloc(HTTP2_BENCH_BODY_SIZE);
+	long frames = 0, bytes = 0, batches = 0;
+	int i;
+
+	memset(body, 'x', HTTP2_BENCH_BODY_SIZE);
+	swHttp2_scheduler_init(&scheduler);
+	swHttp2_scheduler_set_init_window(&scheduler, window);
+	swHttp2_scheduler_window_update(&scheduler, 0, window - SW_HTTP2_DEFAULT_WINDOW);
+	for (i = 0; i < HTTP2_BENCH_STREAMS; i++)
+	{
+		swHttp2_scheduler_add(&scheduler, i * 2 + 1, body, HTTP2_BENCH_BODY_SIZE)->weight = i % 2 ? 32 : 16;
+	}
+
+	double start = swoole_microtime();
+	while (scheduler.stream_num > 0)
+	{
+		frames += swHttp2_scheduler_run(&scheduler, out, HTTP2_BENCH_BATCH_SIZE);
+		batches++;
+		char *p = out->str, *pe = out->str + out->length;
+		while (p < pe)
+		{
+			uint32_t length = swHttp2_get_length(p);
+			swHttp2_scheduler_window_update(&scheduler, 0, length);
+			swHttp2_scheduler_window_update(&scheduler, ntohl(*(uint32_t *) (p + 5)), length);
+			bytes += length;
+			p += SW_HTTP2_FRAME_HEADER_SIZE + length;
+		}
+		swString_clear(out);
+	}
+	double t = swoole_microtime() - start;
+
+	printf("window %10u: %ld frames in %ld batches, %.0f frames per second, %.2f GB/s\n", window, frames, batches,
+			frames / t, bytes / t / 1024 / 1024 / 1024);
+	free(body);
+	swString_free(out);
+	return bytes == (long) HTTP2_BENCH_STREAMS * HTTP2_BENCH_BODY_SIZE ? 0 : -1;
+}
+
+swUnitTest(http2_scheduler_bench_test)
+{
+	if (http2_bench_run(SW_HTTP2_DEFAULT_WINDOW) < 0 || http2_bench_run(1 << 30) < 0)
+	{
+		return 1;
+	}
+	return 0;
+}
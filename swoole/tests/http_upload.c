@@ -0,0 +1,125 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+#include "swoole.h"
+#include "tests.h"
+#include "http.h"
+
+swUnitTest(http_upload_test)
+{
+	char *boundary = "----WebKitFormBoundaryUmkNgDObDKYRRSUb";
+	swString *body = swString_new(4 * 1024 * 1024);
+	swString *header = swString_new(1024);
+	swString *out = swString_new(1024);
+	swHttpRequest request;
+	int i, n;
+	size_t offset;
+	int file_size = 3 * 1024 * 1024 + 17;
+
+	swString_append_ptr(body, SW_STRL("--") - 1);
+	swString_append_ptr(body, boundary, strlen(boundary));
+	swString_append_ptr(body, SW_STRL("\r\nContent-Disposition: form-data; name=\"title\"\r\n\r\nhello world\r\n--") - 1);
+	swString_append_ptr(body, boundary, strlen(boundary));
+	swString_append_ptr(body, SW_STRL("\r\nContent-Disposition: form-data; name=\"file\"; filename=\"a.bin\"\r\nContent-Type: application/octet-stream\r\n\r\n") - 1);
+	for (i = 0; i < file_size; i++)
+	{
+		//CR and LF inside the data
+		char c = i % 7 == 0 ? '\r' : (i % 11 == 0 ? '\n' : 'a' + i % 26);
+		swString_append_ptr(body, &c, 1);
+	}
+	swString_append_ptr(body, SW_STRL("\r\n--") - 1);
+	swString_append_ptr(body, boundary, strlen(boundary));
+	swString_append_ptr(body, SW_STRL("--\r\n") - 1);
+
+	n = sprintf(header->str, "POST /upload HTTP/1.1\r\nHost: localhost\r\nContent-Type: multipart/form-data; boundary=%s\r\n"
+			"Content-Length: %ld\r\n\r\n", boundary, (long) body->length);
+	header->length = n;
+
+	bzero(&request, sizeof(request));
+	request.buffer = header;
+	request.header_length = n;
+	request.content_length = body->length;
+	if (swHttpRequest_upload_begin(&request, "/tmp") < 0)
+	{
+		printf("boundary not found.\n");
+		return SW_ERR;
+	}
+
+	//the body arrives in pieces of any size
+	for (offset = 0, i = 1; offset < body->length; offset += n, i++)
+	{
+		n = (i * 7919) % 65536 + 1;
+		if (offset + n > body->length)
+		{
+			n = body->length - offset;
+		}
+		if (swHttpMultipart_execute(request.multipart, body->str + offset, n) < 0)
+		{
+			return SW_ERR;
+		}
+	}
+	swHttpRequest_pack_upload(&request, out);
+	printf("%.*s", (int) (strstr(out->str, "\r\n\r\n") + 4 - out->str), out->str);
+
+	char *p = strstr(out->str, "\r\n\r\n") + 4;
+	while (p < out->str + out->length)
+	{
+		swHttpUpload_item item;
+		memcpy(&item, p, sizeof(item));
+		p += sizeof(item);
+		printf("type=%d, error=%d, name=%.*s, filename=%.*s, content_type=%.*s, size=%ld, value=%.*s\n", item.type, item.error,
+				item.name_len, p, item.filename_len, p + item.name_len, item.content_type_len, p + item.name_len + item.filename_len,
+				(long) item.size, item.value_len, p + item.name_len + item.filename_len + item.content_type_len);
+		p += item.name_len + item.filename_len + item.content_type_len;
+		if (item.type == SW_HTTP_UPLOAD_FILE)
+		{
+			char file[SW_HTTP_UPLOAD_TMPDIR_SIZE];
+			memcpy(file, p, item.value_len);
+			file[item.value_len] = 0;
+			swString *content = swoole_file_get_contents(file);
+			char *data = strstr(body->str, "octet-stream\r\n\r\n") + sizeof("octet-stream\r\n\r\n") - 1;
+			if (!content || content->length != file_size || memcmp(content->str, data, file_size) != 0)
+			{
+				printf("upload file is corrupted.\n");
+				return SW_ERR;
+			}
+			swString_free(content);
+			unlink(file);
+		}
+		p += item.value_len;
+	}
+
+	//form fields are kept in memory and must not grow without limit
+	swString_clear(body);
+	swString_append_ptr(body, SW_STRL("--") - 1);
+	swString_append_ptr(body, boundary, strlen(boundary));
+	swString_append_ptr(body, SW_STRL("\r\nContent-Disposition: form-data; name=\"big\"\r\n\r\n") - 1);
+	for (i = 0; i <= SW_HTTP_UPLOAD_FIELD_MAX_SIZE; i++)
+	{
+		swString_append_ptr(body, "a", 1);
+	}
+	request.multipart = swHttpMultipart_new(boundary, strlen(boundary), "/tmp");
+	if (swHttpMultipart_execute(request.multipart, body->str, body->length) == SW_OK)
+	{
+		printf("oversized form field is accepted.\n");
+		return SW_ERR;
+	}
+	swHttpMultipart_free(request.multipart, 1);
+
+	swString_free(body);
+	swString_free(header);
+	swString_free(out);
+	return 0;
+}
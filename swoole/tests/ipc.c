@@ -0,0 +1,247 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "swoole.h"
+#include "Server.h"
+#include "tests.h"
+
+#define IPC_BENCH_TOTAL_BYTES    (512*1024*1024)
+#define IPC_BENCH_MAX_PACKET     (1024*1024)
+
+static int ipc_bench_sizes[] = {1024, 64 * 1024, 1024 * 1024};
+
+/**
+ * swFactoryProcess style: split into SW_EVENT_PACKAGE_START/PACKAGE/PACKAGE_END fragments
+ */
+static void ipc_unsock_send(swPipe *p, char *data, int length)
+{
+    swEventData ev;
+    int offset = 0, n;
+
+    while (offset < length)
+    {
+        n = length - offset > SW_BUFFER_SIZE ? SW_BUFFER_SIZE : length - offset;
+        if (offset == 0 && n == length)
+        {
+            ev.info.type = SW_EVENT_TCP;
+        }
+        else if (offset == 0)
+        {
+            ev.info.type = SW_EVENT_PACKAGE_START;
+        }
+        else if (offset + n == length)
+        {
+            ev.info.type = SW_EVENT_PACKAGE_END;
+        }
+        else
+        {
+            ev.info.type = SW_EVENT_PACKAGE;
+        }
+        ev.info.len = n;
+        memcpy(ev.data, data + offset, n);
+        if (p->write(p, &ev, sizeof(ev.info) + n) < 0)
+        {
+            swSysError("write() failed.");
+            return;
+        }
+        offset += n;
+    }
+}
+
+static void ipc_unsock_recv(swPipe *p, swString *buffer, int count)
+{
+    swEventData ev;
+    int i = 0;
+
+    while (i < count)
+    {
+        if (p->read(p, &ev, sizeof(ev)) < 0)
+        {
+            continue;
+        }
+        if (ev.info.type == SW_EVENT_PACKAGE_START || ev.info.type == SW_EVENT_TCP)
+        {
+            swString_clear(buffer);
+        }
+        swString_append_ptr(buffer, ev.data, ev.info.len);
+        if (ev.info.type == SW_EVENT_PACKAGE_END || ev.info.type == SW_EVENT_TCP)
+        {
+            i++;
+        }
+    }
+}
+
+static double ipc_bench_run(swPipe *p, int use_ring, int size)
+{
+    int count = IPC_BENCH_TOTAL_BYTES / size;
+    int i, status;
+    char *packet = sw_malloc(size);
+    memset(packet, 'A', size);
+
+    double start = swoole_microtime();
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        return -1;
+    }
+    else if (pid == 0)
+    {
+        swString *buffer = swString_new(IPC_BENCH_MAX_PACKET);
+        if (use_ring)
+        {
+            for (i = 0; i < count;)
+            {
+                if (p->read(p, buffer->str, buffer->size) > 0)
+                {
+                    i++;
+                }
+            }
+        }
+        else
+        {
+            ipc_unsock_recv(p, buffer, count);
+        }
+        exit(0);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (use_ring)
+        {
+            p->write(p, packet, size);
+        }
+        else
+        {
+            ipc_unsock_send(p, packet, size);
+        }
+    }
+    swWaitpid(pid, &status, 0);
+    sw_free(packet);
+    return swoole_microtime() - start;
+}
+
+#define IPC_CHECK_RING_SIZE      4096
+#define IPC_CHECK_PACKETS        100000
+
+static int ipc_check_length(int n)
+{
+    return (n * 7919) % (IPC_CHECK_RING_SIZE / 2) + 1;
+}
+
+static void ipc_check_fill(char *data, int n, int length)
+{
+    int i;
+    for (i = 0; i < length; i++)
+    {
+        data[i] = (char) (n + i * 31);
+    }
+}
+
+/**
+ * odd sized packets through a small ring, so most of them wrap around its end
+ */
+static int ipc_ring_check(void)
+{
+    swPipe p;
+    char send_buf[IPC_CHECK_RING_SIZE], recv_buf[IPC_CHECK_RING_SIZE], expect[IPC_CHECK_RING_SIZE];
+    int n, length, status;
+
+    if (swPipeRing_create(&p, 1, IPC_CHECK_RING_SIZE) < 0)
+    {
+        return SW_ERR;
+    }
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        return SW_ERR;
+    }
+    else if (pid == 0)
+    {
+        for (n = 0; n < IPC_CHECK_PACKETS; n++)
+        {
+            length = ipc_check_length(n);
+            ipc_check_fill(expect, n, length);
+            if (p.read(&p, recv_buf, sizeof(recv_buf)) != length || memcmp(recv_buf, expect, length) != 0)
+            {
+                printf("packet#%d is broken.\n", n);
+                exit(1);
+            }
+        }
+        exit(0);
+    }
+    //a full ring must not hang the test when the reader has given up
+    p.blocking = 0;
+    for (n = 0; n < IPC_CHECK_PACKETS; n++)
+    {
+        length = ipc_check_length(n);
+        ipc_check_fill(send_buf, n, length);
+        while (p.write(&p, send_buf, length) < 0)
+        {
+            if (errno != EAGAIN)
+            {
+                kill(pid, SIGKILL);
+                swWaitpid(pid, &status, 0);
+                p.close(&p);
+                return SW_ERR;
+            }
+            if (waitpid(pid, &status, WNOHANG) == pid)
+            {
+                p.close(&p);
+                return SW_ERR;
+            }
+            swYield();
+        }
+    }
+    swWaitpid(pid, &status, 0);
+    p.close(&p);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? SW_OK : SW_ERR;
+}
+
+swUnitTest(ipc_ring_test)
+{
+    swPipe p;
+    double t;
+    int i;
+
+    if (ipc_ring_check() < 0)
+    {
+        return 3;
+    }
+
+    for (i = 0; i < sizeof(ipc_bench_sizes) / sizeof(ipc_bench_sizes[0]); i++)
+    {
+        int size = ipc_bench_sizes[i];
+
+        if (swPipeUnsock_create(&p, 1, SOCK_DGRAM) < 0)
+        {
+            return 1;
+        }
+        t = ipc_bench_run(&p, 0, size);
+        printf("unsock   packet=%8d bytes, %8d packets, %.3fs, %.1f MB/s\n", size, IPC_BENCH_TOTAL_BYTES / size, t,
+                IPC_BENCH_TOTAL_BYTES / t / 1024 / 1024);
+        p.close(&p);
+
+        if (swPipeRing_create(&p, 1, SW_PIPE_RING_SIZE) < 0)
+        {
+            return 2;
+        }
+        t = ipc_bench_run(&p, 1, size);
+        printf("shm ring packet=%8d bytes, %8d packets, %.3fs, %.1f MB/s\n", size, IPC_BENCH_TOTAL_BYTES / size, t,
+                IPC_BENCH_TOTAL_BYTES / t / 1024 / 1024);
+        p.close(&p);
+    }
+    return 0;
+}
@@ -15,15 +15,21 @@ int main(int argc, char **argv)
 	swUnitTest_steup(mem_test2, 1, "tests for fixed memory pool");
 	swUnitTest_steup(mem_test3, 1, "tests for global memory pool");
 	swUnitTest_steup(mem_test4, 1, "tests for ring buffer memory pool");
+	swUnitTest_steup(mem_slab_test, 1, "size-class slab vs fixed pool and malloc benchmark");
 
 	swUnitTest_steup(server_test, 1, "socket server test");
 	swUnitTest_steup(client_test, 1, "socket client test");
     swUnitTest_steup(dnslookup_test, 1, "dns lookup test");
 
 	swUnitTest_steup(chan_test, 1, "channel test");
+	swUnitTest_steup(chan_bench_test, 1, "mutex vs lock-free shared memory channel benchmark");
+	swUnitTest_steup(ringqueue_test, 1, "MPMC ring queue stress test");
+	swUnitTest_steup(ringqueue_bench_test, 1, "MPMC ring queue throughput benchmark");
 
 	swUnitTest_steup(ds_test2, 1, "user data struct test");
 	swUnitTest_steup(hashmap_test1, 1, "hashmap data struct test");
+	swUnitTest_steup(flatmap_test, 1, "open addressing hashmap vs swHashMap benchmark");
+	swUnitTest_steup(table_find_test, 1, "swoole_table index and columnar find test");
 
 	swUnitTest_steup(u1_test1, 1, "user1 test");
 	swUnitTest_steup(u1_test2, 1, "user2 test");
@@ -31,20 +37,35 @@ int main(int argc, char **argv)
 
 	swUnitTest_steup(aio_test, 1, "linux native aio test");
 	swUnitTest_steup(aio_test2, 1, "thread pool aio test");
+	swUnitTest_steup(aio_bench, 1, "thread pool and io_uring aio benchmark");
 
 	swUnitTest_steup(rbtree_test, 1, "rbtree data struct test");
 	//swUnitTest_steup(pool_thread, 1);
+	swUnitTest_steup(pool_slab_test, 1, "slab allocator with threads and processes");
 
 	swUnitTest_steup(type_test1, 1, "type test");
+	swUnitTest_steup(memfind_test, 1, "vectorized delimiter search test");
 
 	//swUnitTest_steup(ws_test1, 1, "websocket decode test");
+	swUnitTest_steup(ws_mask_test, 1, "websocket frame unmask test");
 
 	//swUnitTest_steup(http_test1, 1, "http get test");
 	//swUnitTest_steup(http_test2, 1, "http post test");
+	swUnitTest_steup(http_upload_test, 1, "streaming multipart upload test");
+	swUnitTest_steup(http_parser_test, 1, "incremental HTTP request head parser test");
+	swUnitTest_steup(http_parser_bench_test, 1, "vectorized HTTP request head parser benchmark");
+	swUnitTest_steup(http2_scheduler_test, 1, "HTTP/2 flow control and stream priority test");
+	swUnitTest_steup(http2_scheduler_bench_test, 1, "HTTP/2 concurrent streams send scheduler benchmark");
 
+	swUnitTest_steup(redis_parser_test, 1, "incremental RESP parser test");
+	swUnitTest_steup(redis_bench_test, 1, "pipelined RESP parser benchmark");
 
 	swUnitTest_steup(heap_test1, 1, "heap test");
+	swUnitTest_steup(timer_bench_test, 1, "timing wheel vs heap timer benchmark");
+	swUnitTest_steup(heartbeat_test, 1, "heartbeat idle wheel test");
 
 	swUnitTest_steup(ringbuffer_test1, 1, "ringbuffer test");
+	swUnitTest_steup(ipc_ring_test, 1, "shared memory ring pipe round trip, benchmark vs unix socket");
+	swUnitTest_steup(dispatch_test, 1, "dispatch mode load imbalance simulation");
 	return swUnitTest_run(&test);
 }
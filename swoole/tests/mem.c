@@ -199,3 +199,81 @@ swUnitTest(mem_test4)
 	}
 	return 0;
 }
+
+static double mem_bench(swMemoryPool *pool, int n, int loop, int random_size)
+{
+	char **ptrs = malloc(sizeof(char *) * n);
+	double start = swoole_microtime();
+	int i, j;
+
+	for (j = 0; j < loop; j++)
+	{
+		for (i = 0; i < n; i++)
+		{
+			ptrs[i] = pool->alloc(pool, random_size ? 16 + (i * 37) % 2000 : 128);
+			ptrs[i][0] = i;
+		}
+		for (i = 0; i < n; i++)
+		{
+			pool->free(pool, ptrs[i]);
+		}
+	}
+	free(ptrs);
+	return swoole_microtime() - start;
+}
+
+swUnitTest(mem_slab_test)
+{
+	swMemoryPool *slab = swSlab_new(64 * 1024 * 1024, 1);
+	swMemoryPool *fixed = swFixedPool_new(4096, 128, 1);
+	swMemoryPool *sys = swMalloc_new();
+	char *str[1024];
+	int i, j;
+
+	if (slab == NULL || fixed == NULL)
+	{
+		return SW_ERR;
+	}
+
+	//every size class and the page runs
+	for (i = 0; i < 1024; i++)
+	{
+		int size = 1 + (i * 97) % (i % 16 == 0 ? 200000 : 16384);
+		str[i] = slab->alloc(slab, size);
+		if (str[i] == NULL)
+		{
+			printf("alloc(%d) failed.\n", size);
+			return SW_ERR;
+		}
+		memset(str[i], i & 0xff, size);
+		str[i][size - 1] = i & 0xff;
+	}
+	for (i = 0; i < 1024; i++)
+	{
+		int size = 1 + (i * 97) % (i % 16 == 0 ? 200000 : 16384);
+		for (j = 0; j < size; j++)
+		{
+			if ((uint8_t) str[i][j] != (i & 0xff))
+			{
+				printf("block %d is corrupted.\n", i);
+				return SW_ERR;
+			}
+		}
+	}
+	for (i = 1023; i >= 0; i--)
+	{
+		slab->free(slab, str[i]);
+	}
+
+	printf("fixed size 128, 4096 blocks x 1000\n");
+	printf("  swFixedPool: %.3fs\n", mem_bench(fixed, 4096, 1000, 0));
+	printf("  swSlab:      %.3fs\n", mem_bench(slab, 4096, 1000, 0));
+	printf("  malloc:      %.3fs\n", mem_bench(sys, 4096, 1000, 0));
+	printf("random size 16-2K, 4096 blocks x 1000\n");
+	printf("  swSlab:      %.3fs\n", mem_bench(slab, 4096, 1000, 1));
+	printf("  malloc:      %.3fs\n", mem_bench(sys, 4096, 1000, 1));
+
+	fixed->destroy(fixed);
+	slab->destroy(slab);
+	return 0;
+}
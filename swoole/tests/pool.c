@@ -36,3 +36,126 @@ swUnitTest(pool_thread)
 	free(workingnum);
 	return 0;
 }
+
+#define SLAB_WORKER_NUM   4
+#define SLAB_LOOP         200000
+
+static pthread_mutex_t slab_test_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *slab_worker(void *arg)
+{
+	swMemoryPool *pool = arg;
+	char *ptrs[64];
+	int i, j;
+
+	for (i = 0; i < SLAB_LOOP / 64; i++)
+	{
+		for (j = 0; j < 64; j++)
+		{
+			ptrs[j] = pool->alloc(pool, 32 + ((i + j) % 8) * 64);
+			ptrs[j][0] = j;
+		}
+		for (j = 0; j < 64; j++)
+		{
+			pool->free(pool, ptrs[j]);
+		}
+	}
+	return NULL;
+}
+
+static void* locked_alloc(swMemoryPool *pool, uint32_t size)
+{
+	swMemoryPool *fixed = pool->object;
+	void *ptr;
+	pthread_mutex_lock(&slab_test_lock);
+	ptr = fixed->alloc(fixed, size);
+	pthread_mutex_unlock(&slab_test_lock);
+	return ptr;
+}
+
+static void locked_free(swMemoryPool *pool, void *ptr)
+{
+	swMemoryPool *fixed = pool->object;
+	pthread_mutex_lock(&slab_test_lock);
+	fixed->free(fixed, ptr);
+	pthread_mutex_unlock(&slab_test_lock);
+}
+
+static double slab_thread_bench(swMemoryPool *pool)
+{
+	pthread_t threads[SLAB_WORKER_NUM];
+	double start = swoole_microtime();
+	int i;
+
+	for (i = 0; i < SLAB_WORKER_NUM; i++)
+	{
+		pthread_create(&threads[i], NULL, slab_worker, pool);
+	}
+	for (i = 0; i < SLAB_WORKER_NUM; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+	return swoole_microtime() - start;
+}
+
+swUnitTest(pool_slab_test)
+{
+	swMemoryPool *slab = swSlab_new(32 * 1024 * 1024, 1);
+	swMemoryPool *fixed = swFixedPool_new(SLAB_WORKER_NUM * 64, 512, 1);
+	swMemoryPool locked;
+	int i, status;
+	char **blocks;
+	double start;
+
+	if (slab == NULL || fixed == NULL)
+	{
+		return SW_ERR;
+	}
+	locked.object = fixed;
+	locked.alloc = locked_alloc;
+	locked.free = locked_free;
+
+	printf("%d threads, %d alloc/free each\n", SLAB_WORKER_NUM, SLAB_LOOP);
+	printf("  swFixedPool+mutex: %.3fs\n", slab_thread_bench(&locked));
+	printf("  swSlab:            %.3fs\n", slab_thread_bench(slab));
+
+	/**
+	 * the workers allocate, the parent frees
+	 */
+	blocks = slab->alloc(slab, sizeof(char *) * SLAB_WORKER_NUM * 1024);
+	start = swoole_microtime();
+	for (i = 0; i < SLAB_WORKER_NUM; i++)
+	{
+		if (fork() == 0)
+		{
+			int j;
+			for (j = 0; j < 1024; j++)
+			{
+				blocks[i * 1024 + j] = slab->alloc(slab, 64 + j);
+				sprintf(blocks[i * 1024 + j], "%d-%d", i, j);
+			}
+			_exit(0);
+		}
+	}
+	for (i = 0; i < SLAB_WORKER_NUM; i++)
+	{
+		wait(&status);
+	}
+	for (i = 0; i < SLAB_WORKER_NUM * 1024; i++)
+	{
+		char buf[32];
+		sprintf(buf, "%d-%d", i / 1024, i % 1024);
+		if (strcmp(blocks[i], buf) != 0)
+		{
+			printf("block %d is corrupted.\n", i);
+			return SW_ERR;
+		}
+		slab->free(slab, blocks[i]);
+	}
+	printf("%d processes, cross-process free: %.3fs\n", SLAB_WORKER_NUM, swoole_microtime() - start);
+
+	slab->free(slab, blocks);
+	fixed->destroy(fixed);
+	slab->destroy(slab);
+	return 0;
+}
@@ -0,0 +1,224 @@
+#include "swoole.h"
+#include "redis.h"
+#include "tests.h"
+
+static int redis_check_reply(swString *buffer, char *expect)
+{
+	if (buffer->length != strlen(expect) || memcmp(buffer->str, expect, buffer->length) != 0)
+	{
+		printf("reply: %.*s, expect: %s\n", (int) buffer->length, buffer->str, expect);
+		return -1;
+	}
+	swString_clear(buffer);
+	return 0;
+}
+
+swUnitTest(redis_parser_test)
+{
+	char stream[] = "*3\r\n$3\r\nSET\r\n$3\r\nkey\r\n$5\r\nva\r\nl\r\n"
+			"*1\r\n$4\r\nPING\r\n"
+			"*4\r\n$4\r\nHSET\r\n$-1\r\n:-42\r\n$0\r\n\r\n";
+	char *expect[][4] = {
+		{"SET", "key", "va\r\nl"},
+		{"PING"},
+		{"HSET", "", "-42", ""},
+	};
+	int expect_types[] = {SW_REDIS_REPLY_STRING, SW_REDIS_REPLY_NIL, SW_REDIS_REPLY_INT, SW_REDIS_REPLY_STRING};
+	int expect_args[] = {3, 1, 4};
+	swRedis_arg args[8];
+	swRedis_parser parser;
+	size_t length = sizeof(stream) - 1, received, chunk;
+	int i, j, round, ret, n_commands;
+
+	//feed the stream in random pieces, every command must come out exactly once
+	for (round = 0; round < 10000; round++)
+	{
+		swRedis_parser_init(&parser, args, 8);
+		received = 0;
+		n_commands = 0;
+		while (received < length)
+		{
+			chunk = round == 0 ? 1 : 1 + rand() % 16;
+			received = received + chunk > length ? length : received + chunk;
+			while ((ret = swRedis_parse(&parser, stream, received)) == SW_REDIS_PARSE_COMPLETE)
+			{
+				if (parser.n_args != expect_args[n_commands])
+				{
+					printf("command#%d has %d args\n", n_commands, parser.n_args);
+					return 1;
+				}
+				for (j = 0; j < parser.n_args; j++)
+				{
+					if (n_commands == 2 && args[j].type != expect_types[j])
+					{
+						printf("command#%d arg#%d type=%d\n", n_commands, j, args[j].type);
+						return 1;
+					}
+					if (args[j].length != strlen(expect[n_commands][j])
+							|| memcmp(stream + args[j].offset, expect[n_commands][j], args[j].length) != 0)
+					{
+						printf("command#%d arg#%d = %.*s\n", n_commands, j, args[j].length, stream + args[j].offset);
+						return 1;
+					}
+				}
+				n_commands++;
+			}
+			if (ret == SW_REDIS_PARSE_ERROR)
+			{
+				printf("parse error at %ld\n", received);
+				return 1;
+			}
+		}
+		if (n_commands != 3 || parser.offset != length)
+		{
+			printf("%d commands, offset=%ld\n", n_commands, parser.offset);
+			return 1;
+		}
+	}
+
+	char *invalid[] = {
+		"$3\r\nSET\r\n",
+		"*0\r\n",
+		"*9\r\n$3\r\nSET\r\n",
+		"*1\r\n$3\r\nSETX\r\n",
+		"*1\r\n$-3\r\n",
+		"*1\r\n$3x\r\nSET\r\n",
+		"*1\r\n$99999999999999999999\r\n",
+		"*1\r\n$1111111111111111111111111",
+	};
+	for (i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+	{
+		swRedis_parser_init(&parser, args, 8);
+		ret = swRedis_parse(&parser, invalid[i], strlen(invalid[i]));
+		if (ret != SW_REDIS_PARSE_ERROR)
+		{
+			printf("invalid command#%d is accepted, ret=%d\n", i, ret);
+			return 1;
+		}
+	}
+	//the reactor only finds the boundaries, but must reject what the worker cannot hold
+	swRedis_parser_init(&parser, NULL, SW_REDIS_MAX_ARGS);
+	if (swRedis_parse(&parser, SW_STRL("*1025\r\n") - 1) != SW_REDIS_PARSE_ERROR)
+	{
+		printf("command with too many arguments is accepted.\n");
+		return 1;
+	}
+	//longer than a long can hold, rejected before it overflows
+	swRedis_parser_init(&parser, NULL, SW_REDIS_MAX_ARGS);
+	if (swRedis_parse(&parser, SW_STRL("*1\r\n$99999999999999999999\r\n") - 1) != SW_REDIS_PARSE_ERROR)
+	{
+		printf("overlong length header is accepted.\n");
+		return 1;
+	}
+	swRedis_parser_init(&parser, NULL, SW_REDIS_MAX_ARGS);
+	if (swRedis_parse(&parser, SW_STRL("*9999999999999999999999\r\n") - 1) != SW_REDIS_PARSE_ERROR)
+	{
+		printf("overlong argument count is accepted.\n");
+		return 1;
+	}
+
+	swString *reply = swString_new(16);
+	swRedis_reply_status(reply, SW_STRL("OK") - 1);
+	swRedis_reply_error(reply, SW_STRL("ERR unknown") - 1);
+	swRedis_reply_int(reply, -1234567);
+	swRedis_reply_nil(reply);
+	swRedis_reply_array(reply, 2);
+	swRedis_reply_string(reply, SW_STRL("hello") - 1);
+	swRedis_reply_string(reply, "", 0);
+	ret = redis_check_reply(reply, "+OK\r\n-ERR unknown\r\n:-1234567\r\n$-1\r\n*2\r\n$5\r\nhello\r\n$0\r\n\r\n");
+	swString_free(reply);
+	return ret == 0 ? 0 : 1;
+}
+
+#define REDIS_BENCH_REQUESTS    (1024 * 1024)
+#define REDIS_BENCH_READ_SIZE   65536
+
+/**
+ * redis-benchmark -t set,get -P <pipeline> against the parser and the reply encoder,
+ * the requests arrive in REDIS_BENCH_READ_SIZE reads and each read is answered with one write
+ */
+static double redis_bench_run(int pipeline, int incremental)
+{
+	swString *input = swString_new(REDIS_BENCH_READ_SIZE);
+	swString *reply = swString_new(REDIS_BENCH_READ_SIZE);
+	swRedis_arg args[SW_REDIS_MAX_LINES];
+	swRedis_parser parser;
+	char command[128];
+	int i, j, n, ret;
+	long done = 0, writes = 0;
+	size_t offset, received, handled;
+
+	for (i = 0; i < pipeline; i++)
+	{
+		if (i % 2 == 0)
+		{
+			n = sprintf(command, "*3\r\n$3\r\nSET\r\n$16\r\nkey:%012d\r\n$3\r\nxxx\r\n", rand() % 100000);
+		}
+		else
+		{
+			n = sprintf(command, "*2\r\n$3\r\nGET\r\n$16\r\nkey:%012d\r\n", rand() % 100000);
+		}
+		swString_append_ptr(input, command, n);
+	}
+
+	double start = swoole_microtime();
+	while (done < REDIS_BENCH_REQUESTS)
+	{
+		swRedis_parser_init(&parser, args, SW_REDIS_MAX_LINES);
+		handled = 0;
+		for (offset = 0; offset < input->length; offset = received)
+		{
+			received = offset + REDIS_BENCH_READ_SIZE > input->length ? input->length : offset + REDIS_BENCH_READ_SIZE;
+			if (!incremental)
+			{
+				//scan the whole buffer again on every read
+				swRedis_parser_init(&parser, args, SW_REDIS_MAX_LINES);
+			}
+			while ((ret = swRedis_parse(&parser, input->str, received)) == SW_REDIS_PARSE_COMPLETE)
+			{
+				if (parser.offset <= handled)
+				{
+					continue;
+				}
+				handled = parser.offset;
+				if (parser.n_args == 3)
+				{
+					swRedis_reply_status(reply, SW_STRL("OK") - 1);
+				}
+				else
+				{
+					swRedis_reply_string(reply, SW_STRL("xxx") - 1);
+				}
+				done++;
+			}
+			if (ret == SW_REDIS_PARSE_ERROR)
+			{
+				printf("parse error.\n");
+				return -1;
+			}
+			for (j = 0; j < reply->length; j += 64)
+			{
+				writes += reply->str[j];
+			}
+			swString_clear(reply);
+		}
+	}
+	double t = swoole_microtime() - start;
+
+	swString_free(input);
+	swString_free(reply);
+	return writes == 0 ? -1 : REDIS_BENCH_REQUESTS / t;
+}
+
+swUnitTest(redis_bench_test)
+{
+	int pipelines[] = {1, 16, 64, 1024, 16384};
+	int i;
+
+	for (i = 0; i < sizeof(pipelines) / sizeof(pipelines[0]); i++)
+	{
+		printf("SET/GET -P %-5d incremental  %12.0f requests per second\n", pipelines[i], redis_bench_run(pipelines[i], 1));
+		printf("SET/GET -P %-5d reparse      %12.0f requests per second\n", pipelines[i], redis_bench_run(pipelines[i], 0));
+	}
+	return 0;
+}
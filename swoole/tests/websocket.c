@@ -13,11 +13,52 @@
   | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
   +----------------------------------------------------------------------+
 */
-#if 0
 #include "swoole.h"
 #include "tests.h"
 #include "websocket.h"
 
+swUnitTest(ws_mask_test)
+{
+	char mask_key[SW_WEBSOCKET_MASK_LEN] = {0x37, (char) 0xfa, 0x21, 0x3d};
+	char data[1024], expect[1024];
+	int length, offset, i;
+
+	//every tail length and misaligned start must match the byte-at-a-time result
+	for (length = 0; length < 300; length++)
+	{
+		for (offset = 0; offset < 8; offset++)
+		{
+			for (i = 0; i < length; i++)
+			{
+				data[offset + i] = expect[offset + i] = rand();
+			}
+			swWebSocket_mask(data + offset, length, mask_key);
+			for (i = 0; i < length; i++)
+			{
+				expect[offset + i] ^= mask_key[i % SW_WEBSOCKET_MASK_LEN];
+			}
+			if (memcmp(data + offset, expect + offset, length) != 0)
+			{
+				printf("mask error, length=%d, offset=%d\n", length, offset);
+				return 1;
+			}
+		}
+	}
+
+	int n = 1024 * 1024;
+	char *buf = sw_malloc(n);
+	memset(buf, 'A', n);
+	double t = swoole_microtime();
+	for (i = 0; i < 1000; i++)
+	{
+		swWebSocket_mask(buf, n, mask_key);
+	}
+	printf("unmask 1000MB, %.3fs\n", swoole_microtime() - t);
+	sw_free(buf);
+	return 0;
+}
+
+#if 0
 swUnitTest(ws_test1)
 {
 	char buf[65536];
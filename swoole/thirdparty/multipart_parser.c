@@ -141,6 +141,8 @@ size_t multipart_parser_execute(multipart_parser* p, const char *buf, size_t len
         }
 
         if (c == '-') {
+          if (is_last)
+              EMIT_DATA_CB(header_field, buf + mark, (i - mark) + 1);
           break;
         }
 
@@ -184,7 +186,7 @@ size_t multipart_parser_execute(multipart_parser* p, const char *buf, size_t len
           EMIT_DATA_CB(header_value, buf + mark, i - mark);
           p->state = s_header_value_almost_done;
         }
-        if (is_last)
+        else if (is_last)
             EMIT_DATA_CB(header_value, buf + mark, (i - mark) + 1);
         break;
 